@@ -0,0 +1,195 @@
+// Types of the RKNN SDK rknn_api.h used by this project, for building without the SDK.
+// Only used when building with -DRKNN_CPU_RUNTIME=ON (x86 CI, off-device benchmarking), where
+// rknn::CpuBackend (include/backend.hpp) stands in for librknnrt. Struct layouts follow the SDK
+// header; the rknn_* functions are not declared, so any call that bypasses rknn::Backend fails to compile.
+#ifndef _RKNN_API_H
+#define _RKNN_API_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RKNN_SUCC                               0
+#define RKNN_ERR_FAIL                           -1
+#define RKNN_ERR_TIMEOUT                        -2
+#define RKNN_ERR_DEVICE_UNAVAILABLE             -3
+#define RKNN_ERR_MALLOC_FAIL                    -4
+#define RKNN_ERR_PARAM_INVALID                  -5
+#define RKNN_ERR_MODEL_INVALID                  -6
+#define RKNN_ERR_CTX_INVALID                    -7
+#define RKNN_ERR_INPUT_INVALID                  -8
+#define RKNN_ERR_OUTPUT_INVALID                 -9
+
+#define RKNN_MAX_DIMS                           16
+#define RKNN_MAX_NAME_LEN                       256
+
+typedef uint64_t rknn_context;
+
+typedef enum _rknn_query_cmd {
+    RKNN_QUERY_IN_OUT_NUM = 0,
+    RKNN_QUERY_INPUT_ATTR = 1,
+    RKNN_QUERY_OUTPUT_ATTR = 2,
+    RKNN_QUERY_PERF_DETAIL = 3,
+    RKNN_QUERY_PERF_RUN = 4,
+    RKNN_QUERY_SDK_VERSION = 5,
+    RKNN_QUERY_CMD_MAX
+} rknn_query_cmd;
+
+typedef enum _rknn_tensor_type {
+    RKNN_TENSOR_FLOAT32 = 0,
+    RKNN_TENSOR_FLOAT16,
+    RKNN_TENSOR_INT8,
+    RKNN_TENSOR_UINT8,
+    RKNN_TENSOR_INT16,
+    RKNN_TENSOR_UINT16,
+    RKNN_TENSOR_INT32,
+    RKNN_TENSOR_UINT32,
+    RKNN_TENSOR_INT64,
+    RKNN_TENSOR_BOOL,
+    RKNN_TENSOR_TYPE_MAX
+} rknn_tensor_type;
+
+typedef enum _rknn_tensor_qnt_type {
+    RKNN_TENSOR_QNT_NONE = 0,
+    RKNN_TENSOR_QNT_DFP,
+    RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC,
+    RKNN_TENSOR_QNT_MAX
+} rknn_tensor_qnt_type;
+
+typedef enum _rknn_tensor_format {
+    RKNN_TENSOR_NCHW = 0,
+    RKNN_TENSOR_NHWC,
+    RKNN_TENSOR_NC1HWC2,
+    RKNN_TENSOR_UNDEFINED,
+    RKNN_TENSOR_FORMAT_MAX
+} rknn_tensor_format;
+
+typedef enum _rknn_core_mask {
+    RKNN_NPU_CORE_AUTO = 0,
+    RKNN_NPU_CORE_0 = 1,
+    RKNN_NPU_CORE_1 = 2,
+    RKNN_NPU_CORE_2 = 4,
+    RKNN_NPU_CORE_0_1 = RKNN_NPU_CORE_0 | RKNN_NPU_CORE_1,
+    RKNN_NPU_CORE_0_1_2 = RKNN_NPU_CORE_0_1 | RKNN_NPU_CORE_2,
+    RKNN_NPU_CORE_UNDEFINED
+} rknn_core_mask;
+
+typedef struct _rknn_input_output_num {
+    uint32_t n_input;
+    uint32_t n_output;
+} rknn_input_output_num;
+
+typedef struct _rknn_tensor_attr {
+    uint32_t index;
+    uint32_t n_dims;
+    uint32_t dims[RKNN_MAX_DIMS];
+    char name[RKNN_MAX_NAME_LEN];
+    uint32_t n_elems;
+    uint32_t size;
+    rknn_tensor_format fmt;
+    rknn_tensor_type type;
+    rknn_tensor_qnt_type qnt_type;
+    int8_t fl;
+    int32_t zp;
+    float scale;
+    uint32_t w_stride;
+    uint32_t size_with_stride;
+    uint8_t pass_through;
+    uint32_t h_stride;
+} rknn_tensor_attr;
+
+typedef struct _rknn_sdk_version {
+    char api_version[256];
+    char drv_version[256];
+} rknn_sdk_version;
+
+typedef struct _rknn_tensor_memory {
+    void* virt_addr;
+    uint64_t phys_addr;
+    int32_t fd;
+    int32_t offset;
+    uint32_t size;
+    uint32_t flags;
+    void* priv_data;
+} rknn_tensor_mem;
+
+typedef struct _rknn_input {
+    uint32_t index;
+    void* buf;
+    uint32_t size;
+    uint8_t pass_through;
+    rknn_tensor_type type;
+    rknn_tensor_format fmt;
+} rknn_input;
+
+typedef struct _rknn_output {
+    uint8_t want_float;
+    uint8_t is_prealloc;
+    uint32_t index;
+    void* buf;
+    uint32_t size;
+} rknn_output;
+
+typedef struct _rknn_init_extend {
+    rknn_context ctx;
+    int32_t real_model_offset;
+    uint32_t real_model_size;
+    uint8_t reserved[120];
+} rknn_init_extend;
+
+typedef struct _rknn_run_extend {
+    uint64_t frame_id;
+    int32_t non_block;
+    int32_t timeout_ms;
+    int32_t fence_fd;
+} rknn_run_extend;
+
+typedef struct _rknn_output_extend {
+    uint64_t frame_id;
+} rknn_output_extend;
+
+static inline const char* get_format_string(rknn_tensor_format fmt)
+{
+    switch (fmt) {
+    case RKNN_TENSOR_NCHW: return "NCHW";
+    case RKNN_TENSOR_NHWC: return "NHWC";
+    case RKNN_TENSOR_NC1HWC2: return "NC1HWC2";
+    case RKNN_TENSOR_UNDEFINED: return "UNDEFINED";
+    default: return "UNKNOW";
+    }
+}
+
+static inline const char* get_type_string(rknn_tensor_type type)
+{
+    switch (type) {
+    case RKNN_TENSOR_FLOAT32: return "FP32";
+    case RKNN_TENSOR_FLOAT16: return "FP16";
+    case RKNN_TENSOR_INT8: return "INT8";
+    case RKNN_TENSOR_UINT8: return "UINT8";
+    case RKNN_TENSOR_INT16: return "INT16";
+    case RKNN_TENSOR_UINT16: return "UINT16";
+    case RKNN_TENSOR_INT32: return "INT32";
+    case RKNN_TENSOR_UINT32: return "UINT32";
+    case RKNN_TENSOR_INT64: return "INT64";
+    case RKNN_TENSOR_BOOL: return "BOOL";
+    default: return "UNKNOW";
+    }
+}
+
+static inline const char* get_qnt_type_string(rknn_tensor_qnt_type type)
+{
+    switch (type) {
+    case RKNN_TENSOR_QNT_NONE: return "NONE";
+    case RKNN_TENSOR_QNT_DFP: return "DFP";
+    case RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC: return "AFFINE";
+    default: return "UNKNOW";
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _RKNN_API_H
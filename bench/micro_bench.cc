@@ -0,0 +1,1078 @@
+// rknn_bench --micro NAME: 单项测量, 对比某个模块的不同实现或配置, 输出到日志.
+// 需要模型的项使用./model/下的yolo11.rknn/yolov5.rknn和--image指定的图片; dfl/scan/nms/queue/steal只使用合成数据
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "micro_bench.hpp"
+#include "yolo11.hpp"
+#include "yolov5.hpp"
+#include "RknnPool.hpp"
+#include "StreamIngest.hpp"
+#include "MutexThreadPool.hpp"
+#include "preprocess.hpp"
+#include "postprocess.hpp"
+#include "utils.hpp"
+#include "latency.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+// 获取微秒级时间戳
+static int64_t __get_us(struct timeval t) {
+    return (t.tv_sec * 1000000 + t.tv_usec);
+}
+
+// 测试零拷贝模式：对比rknn_inputs_set/rknn_outputs_get与rknn_set_io_mem绑定内存的耗时
+static void test_zero_copy(const std::string& img_path) {
+    LOG("========== Testing Zero Copy (rknn_create_mem/rknn_set_io_mem) ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int test_count = 20;
+
+    for (bool zero_copy : {false, true}) {
+        rknn::ModelConfig config;
+        config.zero_copy = zero_copy;
+        auto yolo11 = std::make_unique<detector::YOLO11>(model_path, logger::Level::INFO, detect_param, config);
+
+        struct timeval start_time, stop_time;
+        int count = 0;
+        gettimeofday(&start_time, NULL);
+        for (int i = 0; i < test_count; ++i) {
+            count = yolo11->infer(img).count;
+        }
+        gettimeofday(&stop_time, NULL);
+
+        LOG("zero_copy=%d: detected %d objects, average run %f ms", zero_copy, count,
+            (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count);
+    }
+}
+
+// 测试预处理后端的耗时 (不依赖NPU); 与OpenCV参考实现的逐字节比较见tests/test_preprocess.cc
+static void test_preprocess(const std::string& img_path) {
+    LOG("========== Testing Preprocess Backends ==========");
+    cv::Mat img = cv::imread(img_path);
+    if (img.empty()) {
+        LOGW("read %s fail!", img_path.c_str());
+        return;
+    }
+    int test_count = 100;
+    // 覆盖一般双线性缩放、整2倍缩小(INTER_AREA快速路径)和不缩放三种情况
+    std::vector<cv::Size> target_sizes = {cv::Size(640, 640), cv::Size(320, 320),
+                                          cv::Size(img.cols / 2, img.rows / 2), cv::Size(img.cols, img.rows)};
+    rknn::PreprocessType types[3] = {rknn::PreprocessType::OPENCV, rknn::PreprocessType::FUSED,
+                                     rknn::PreprocessType::RGA};
+
+    for (auto& target_size : target_sizes) {
+        float scale = std::min((float)target_size.width / img.cols, (float)target_size.height / img.rows);
+        for (auto type : types) {
+            auto preprocessor = rknn::create_preprocessor(type);
+            cv::Mat out(target_size.height, target_size.width, CV_8UC3);
+            image_rect_t pads;
+
+            struct timeval start_time, stop_time;
+            gettimeofday(&start_time, NULL);
+            for (int i = 0; i < test_count; ++i) {
+                preprocessor->run(img, out, scale, pads, 128);
+            }
+            gettimeofday(&stop_time, NULL);
+            LOG("%dx%d -> %dx%d: %-6s %.3f ms", img.cols, img.rows, target_size.width, target_size.height,
+                preprocessor->name(), (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count);
+        }
+    }
+}
+
+// 测试NV12输入: 各预处理后端run_buffer的耗时, 并对比Mat/NV12两种推理入口 (与参考实现的误差见tests/test_preprocess.cc)
+static void test_nv12(const std::string& img_path) {
+    LOG("========== Testing NV12 Input ==========");
+    cv::Mat img = cv::imread(img_path);
+    if (img.empty() || img.cols % 2 != 0 || img.rows % 2 != 0) {
+        LOGW("read %s fail or size is odd!", img_path.c_str());
+        return;
+    }
+    int test_count = 100;
+
+    // 模拟解码器输出: BGR -> I420 -> NV12 (UV交织)
+    cv::Mat i420;
+    cv::cvtColor(img, i420, cv::COLOR_BGR2YUV_I420);
+    int y_size = img.cols * img.rows;
+    std::vector<uint8_t> nv12(y_size * 3 / 2);
+    memcpy(nv12.data(), i420.data, y_size);
+    const uint8_t* u_plane = i420.data + y_size;
+    const uint8_t* v_plane = u_plane + y_size / 4;
+    for (int i = 0; i < y_size / 4; i++) {
+        nv12[y_size + 2 * i] = u_plane[i];
+        nv12[y_size + 2 * i + 1] = v_plane[i];
+    }
+    image_buffer_t buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.width = img.cols;
+    buffer.height = img.rows;
+    buffer.format = IMAGE_FORMAT_YUV420SP_NV12;
+    buffer.virt_addr = nv12.data();
+    buffer.size = (int)nv12.size();
+    buffer.fd = -1;
+
+    cv::Size target_size(640, 640);
+    float scale = std::min((float)target_size.width / img.cols, (float)target_size.height / img.rows);
+    rknn::PreprocessType types[3] = {rknn::PreprocessType::OPENCV, rknn::PreprocessType::FUSED,
+                                     rknn::PreprocessType::RGA};
+    for (auto type : types) {
+        auto preprocessor = rknn::create_preprocessor(type);
+        cv::Mat out(target_size.height, target_size.width, CV_8UC3);
+        image_rect_t pads;
+
+        struct timeval start_time, stop_time;
+        gettimeofday(&start_time, NULL);
+        for (int i = 0; i < test_count; ++i) {
+            preprocessor->run_buffer(buffer, out, scale, pads, 128);
+        }
+        gettimeofday(&stop_time, NULL);
+        LOG("NV12 %dx%d -> %dx%d: %-6s %.3f ms", img.cols, img.rows, target_size.width, target_size.height,
+            preprocessor->name(), (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count);
+    }
+
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    detector::YOLO11 model("./model/yolo11.rknn", logger::Level::INFO, detect_param);
+    object_detect_result_list mat_result = model.infer(img);
+    object_detect_result_list nv12_result = model.infer(buffer);
+
+    struct timeval start_time, stop_time;
+    gettimeofday(&start_time, NULL);
+    for (int i = 0; i < test_count; ++i) {
+        model.infer(buffer);
+    }
+    gettimeofday(&stop_time, NULL);
+    LOG("YOLO11 NV12 input: avg %.2f ms/frame, %d objects (BGR input: %d objects)",
+        (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count,
+        nv12_result.count, mat_result.count);
+}
+
+// 在合成的量化box输出上比较DFL解码的耗时: 反量化+compute_dfl 与 查表解码, 不需要NPU (误差见tests/test_postprocess.cc)
+static void test_dfl_decode() {
+    LOG("========== Testing DFL Decode ==========");
+    const int dfl_len = 16;
+    const int grid_len = 80 * 80;
+    const int32_t box_zp = -128;
+    const float box_scale = 0.1f;
+    int test_count = 20;
+
+    std::vector<int8_t> box_tensor((size_t)dfl_len * 4 * grid_len);
+    srand(0);
+    for (auto& v : box_tensor) {
+        v = (int8_t)(rand() % 256 - 128);
+    }
+
+    detector::DflDecoder decoder;
+    decoder.init(box_scale, dfl_len);
+    std::vector<float> ref_boxes((size_t)grid_len * 4);
+    std::vector<float> lut_boxes((size_t)grid_len * 4);
+
+    struct timeval start_time, stop_time;
+    gettimeofday(&start_time, NULL);
+    for (int n = 0; n < test_count; ++n) {
+        float before_dfl[dfl_len * 4];
+        for (int offset = 0; offset < grid_len; offset++) {
+            for (int k = 0; k < dfl_len * 4; k++) {
+                before_dfl[k] = deqnt_affine_to_f32(box_tensor[(size_t)k * grid_len + offset], box_zp, box_scale);
+            }
+            compute_dfl(before_dfl, dfl_len, &ref_boxes[offset * 4]);
+        }
+    }
+    gettimeofday(&stop_time, NULL);
+    double ref_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+
+    gettimeofday(&start_time, NULL);
+    for (int n = 0; n < test_count; ++n) {
+        for (int offset = 0; offset < grid_len; offset++) {
+            decoder.decode(box_tensor.data() + offset, grid_len, &lut_boxes[offset * 4]);
+        }
+    }
+    gettimeofday(&stop_time, NULL);
+    double lut_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+
+    LOG("%d boxes (dfl_len %d): compute_dfl %.3f ms, lut %.3f ms (%.1fx)", grid_len, dfl_len,
+        ref_ms, lut_ms, ref_ms / lut_ms);
+}
+
+// 逐cell标量扫描, 与改造前process_i8中的类别循环相同, 作为参考
+template <typename T>
+static int scan_class_scores_scalar(const T* scores, int class_num, int grid_len, T threshold,
+                             std::vector<int>& cells, std::vector<int>& class_ids) {
+    int count = 0;
+    for (int x = 0; x < grid_len; x++) {
+        int offset = x;
+        int max_class_id = -1;
+        T max_score = threshold;
+        for (int c = 0; c < class_num; c++) {
+            if (scores[offset] > max_score) {
+                max_score = scores[offset];
+                max_class_id = c;
+            }
+            offset += grid_len;
+        }
+        if (max_class_id >= 0) {
+            cells[count] = x;
+            class_ids[count] = max_class_id;
+            count++;
+        }
+    }
+    return count;
+}
+
+template <typename T>
+static void bench_class_scan(const char* name, const std::vector<T>& scores, int class_num, int grid_len, T threshold) {
+    int test_count = 50;
+    std::vector<int> ref_cells(grid_len);
+    std::vector<int> ref_ids(grid_len);
+    detector::ClassScoreScanner<T> scanner;
+    scanner.reserve(grid_len);
+
+    struct timeval start_time, stop_time;
+    gettimeofday(&start_time, NULL);
+    for (int i = 0; i < test_count; ++i) {
+        scan_class_scores_scalar(scores.data(), class_num, grid_len, threshold, ref_cells, ref_ids);
+    }
+    gettimeofday(&stop_time, NULL);
+    double ref_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+
+    int count = 0;
+    gettimeofday(&start_time, NULL);
+    for (int i = 0; i < test_count; ++i) {
+        count = scanner.scan(scores.data(), class_num, grid_len, threshold);
+    }
+    gettimeofday(&stop_time, NULL);
+    double simd_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+
+    LOG("%-5s %d cells x %d classes: scalar %.3f ms, simd %.3f ms (%.1fx), %d candidates",
+        name, grid_len, class_num, ref_ms, simd_ms, ref_ms / simd_ms, count);
+}
+
+// 在合成的分类输出上比较逐cell标量扫描与向量化扫描的耗时, 不需要NPU (结果一致性见tests/test_postprocess.cc)
+static void test_class_scan() {
+    LOG("========== Testing Class Score Scan ==========");
+    const int class_num = 80;
+    const int grid_len = 80 * 80;
+    std::vector<int8_t> scores_i8((size_t)class_num * grid_len);
+    std::vector<uint8_t> scores_u8(scores_i8.size());
+    std::vector<float> scores_f32(scores_i8.size());
+    srand(0);
+    // 大部分分数接近0, 少量cell有高分, 接近真实检测输出的分布
+    for (size_t i = 0; i < scores_i8.size(); i++) {
+        int q = rand() % 1000 < 2 ? rand() % 256 : rand() % 32;
+        scores_u8[i] = (uint8_t)q;
+        scores_i8[i] = (int8_t)(q - 128);
+        scores_f32[i] = q / 255.f;
+    }
+    bench_class_scan<int8_t>("int8", scores_i8, class_num, grid_len, (int8_t)(64 - 128));
+    bench_class_scan<uint8_t>("uint8", scores_u8, class_num, grid_len, (uint8_t)64);
+    bench_class_scan<float>("fp32", scores_f32, class_num, grid_len, 64 / 255.f);
+}
+
+// 在合成的候选框上比较 quick_sort_indice_inverse + 逐类别nms() 与 NmsEngine 的耗时, 不需要NPU (保留的框一致性见tests/test_nms.cc)
+static void test_nms() {
+    LOG("========== Testing NMS ==========");
+    const int class_num = 80;
+    const float nms_threshold = 0.45f;
+    int test_count = 10;
+    srand(0);
+
+    for (int count : {100, 1000, 5000}) {
+        std::vector<float> boxes(count * 4);
+        std::vector<float> scores(count);
+        std::vector<int> class_ids(count);
+        // 候选集中在少数物体周围, 与低阈值下的真实输出相似
+        for (int i = 0; i < count; i++) {
+            int object = rand() % 50;
+            boxes[i * 4 + 0] = (object * 37) % 560 + rand() % 16;
+            boxes[i * 4 + 1] = (object * 91) % 560 + rand() % 16;
+            boxes[i * 4 + 2] = 40 + rand() % 24;
+            boxes[i * 4 + 3] = 40 + rand() % 24;
+            scores[i] = (float)((i * 7919) % count + 1) / count;  // 分数互不相同, 排序结果唯一
+            class_ids[i] = (object + rand() % 3) % class_num;
+        }
+
+        std::vector<int> ref_keep;
+        struct timeval start_time, stop_time;
+        gettimeofday(&start_time, NULL);
+        for (int n = 0; n < test_count; ++n) {
+            std::vector<float> sorted_scores = scores;
+            std::vector<int> order(count);
+            for (int i = 0; i < count; i++) {
+                order[i] = i;
+            }
+            quick_sort_indice_inverse(sorted_scores, 0, count - 1, order);
+            for (int c = 0; c < class_num; c++) {
+                nms(count, boxes, class_ids, order, c, nms_threshold);
+            }
+            ref_keep.clear();
+            for (int i = 0; i < count; i++) {
+                if (order[i] != -1) {
+                    ref_keep.push_back(order[i]);
+                }
+            }
+        }
+        gettimeofday(&stop_time, NULL);
+        double ref_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+
+        detector::NmsEngine engine;
+        engine.reserve(count, class_num);
+        detector::NmsMode modes[2] = {detector::NmsMode::PER_CLASS, detector::NmsMode::CLASS_OFFSET};
+        const char* mode_names[2] = {"per-class", "offset"};
+        for (int m = 0; m < 2; m++) {
+            int kept = 0;
+            gettimeofday(&start_time, NULL);
+            for (int n = 0; n < test_count; ++n) {
+                kept = engine.run(boxes.data(), scores.data(), class_ids.data(), count, nms_threshold, 0, modes[m]);
+            }
+            gettimeofday(&stop_time, NULL);
+            double cost_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count;
+            LOG("%5d candidates: old %.3f ms, %-9s %.3f ms (%.1fx), kept %d/%d", count, ref_ms,
+                mode_names[m], cost_ms, ref_ms / cost_ms, kept, (int)ref_keep.size());
+        }
+    }
+}
+
+// 比较RknnPool的任务模式(每帧一个任务串行执行三个阶段)与流水线模式的吞吐
+static void test_pipeline(const std::string& img_path) {
+    LOG("========== Testing Pipelined RknnPool ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int thread_num = 3;
+    int task_count = 300;
+    const char* mode_names[2] = {"task", "pipeline"};
+
+    for (int mode = 0; mode < 2; mode++) {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.pipeline = (mode == 1);
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+
+        struct timeval start_time, stop_time;
+        gettimeofday(&start_time, NULL);
+        // 最多保持 thread_num * 2 帧在途, 与视频流的生产者-消费者方式相同
+        int submitted = 0;
+        int result_count = 0;
+        object_detect_result_list result;
+        while (result_count < task_count) {
+            while (submitted < task_count && submitted - result_count < thread_num * 2) {
+                pool.put(img);
+                submitted++;
+            }
+            if (pool.get(result) == 0) {
+                result_count++;
+            }
+        }
+        gettimeofday(&stop_time, NULL);
+        double cost_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+        LOG("%-8s: %d frames in %.1f ms, %.1f FPS (last frame %d objects)", mode_names[mode], result_count,
+            cost_ms, result_count * 1000.0 / cost_ms, result.count);
+    }
+}
+
+// 拥挤帧与空帧交替(代价不均)时, 比较轮询分配与核心绑定(空闲/最少在途优先)的吞吐
+static void test_core_affine(const std::string& img_path) {
+    LOG("========== Testing Core-Affine Dispatch ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat crowded = cv::imread(img_path);
+    cv::Mat empty = cv::Mat::zeros(crowded.size(), crowded.type());
+    int thread_num = 3;
+    int task_count = 300;
+    const char* mode_names[2] = {"round-robin", "core-affine"};
+
+    for (int mode = 0; mode < 2; mode++) {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.coreAffine = (mode == 1);
+        // 使用编号最大的thread_num个CPU (RK3588上为大核)
+        int cpu_num = (int)sysconf(_SC_NPROCESSORS_CONF);
+        for (int i = 0; i < thread_num && i < cpu_num; i++) {
+            config.cpuAffinity.push_back(cpu_num - 1 - i);
+        }
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+
+        struct timeval start_time, stop_time;
+        gettimeofday(&start_time, NULL);
+        int submitted = 0;
+        int result_count = 0;
+        object_detect_result_list result;
+        while (result_count < task_count) {
+            while (submitted < task_count && submitted - result_count < thread_num * 2) {
+                // 每3帧一帧拥挤帧: 轮询时总落在同一个实例上
+                pool.put(submitted % 3 == 0 ? crowded : empty);
+                submitted++;
+            }
+            if (pool.get(result) == 0) {
+                result_count++;
+            }
+        }
+        gettimeofday(&stop_time, NULL);
+        double cost_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+        LOG("%-11s: %d frames in %.1f ms, %.1f FPS", mode_names[mode], result_count, cost_ms,
+            result_count * 1000.0 / cost_ms);
+    }
+}
+
+// 两路流交替提交, 比较三种结果交付顺序下从put到交付的平均延迟 (as-completed使用回调交付)
+static void test_result_order(const std::string& img_path) {
+    LOG("========== Testing Result Ordering ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat crowded = cv::imread(img_path);
+    cv::Mat empty = cv::Mat::zeros(crowded.size(), crowded.type());
+    int thread_num = 3;
+    int task_count = 300;
+    const char* order_names[3] = {"global", "per-stream", "as-completed"};
+
+    for (int order = 0; order < 3; order++) {
+        // 回调引用的统计量要比pool活得久, 先于pool声明
+        std::vector<int64_t> put_us(task_count);
+        std::atomic<int64_t> latency_sum{0};
+        std::atomic<int> delivered{0};
+        auto on_result = [&](const rknn::FrameInfo& info, object_detect_result_list&) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            latency_sum += __get_us(now) - put_us[info.seq];
+            delivered++;
+        };
+
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.order = (rknn::ResultOrder)order;
+        pool.setConfig(config);
+        if (config.order == rknn::ResultOrder::AS_COMPLETED) {
+            pool.setResultCallback(on_result);
+        }
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+
+        struct timeval start_time, stop_time;
+        gettimeofday(&start_time, NULL);
+        object_detect_result_list result;
+        rknn::FrameInfo info;
+        for (int i = 0; i < task_count; i++) {
+            // 流0为拥挤帧, 流1为空帧
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            put_us[i] = __get_us(now);
+            pool.put(i % 2 == 0 ? crowded : empty, i % 2);
+            while (pool.getPendingCount() >= (size_t)thread_num * 2 && pool.get(result, info) == 0) {
+                on_result(info, result);
+            }
+        }
+        while (pool.get(result, info) == 0) {
+            on_result(info, result);
+        }
+        while (delivered < task_count) {
+            std::this_thread::yield();
+        }
+        gettimeofday(&stop_time, NULL);
+        double cost_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+        LOG("%-12s: %d frames in %.1f ms, mean put->delivery latency %.2f ms", order_names[order],
+            delivered.load(), cost_ms, latency_sum.load() / 1000.0 / delivered.load());
+    }
+}
+
+// 逐帧推理与infer_batch比较, 再比较RknnPool逐帧任务模式与动态批处理模式.
+// batch=1的模型上infer_batch仍逐帧执行rknn_run, 只省掉逐次加锁; 需用batch>1导出的模型才能看到NPU侧的收益
+static void test_batch(const std::string& img_path) {
+    LOG("========== Testing Batched Inference ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int frame_num = 64;
+    struct timeval start_time, stop_time;
+
+    {
+        detector::YOLO11 yolo(model_path, logger::Level::INFO, detect_param);
+        int batch = yolo.batch_size();
+        if (batch == 1) {
+            LOG("model batch size is 1, infer_batch falls back to one rknn_run per frame");
+        }
+        std::vector<cv::Mat> frames(frame_num, img);
+        object_detect_result_list single;
+        yolo.infer(img);    // warm up
+
+        gettimeofday(&start_time, NULL);
+        for (int i = 0; i < frame_num; i++) {
+            single = yolo.infer(frames[i]);
+        }
+        gettimeofday(&stop_time, NULL);
+        double single_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+
+        gettimeofday(&start_time, NULL);
+        std::vector<object_detect_result_list> results = yolo.infer_batch(frames);
+        gettimeofday(&stop_time, NULL);
+        double batch_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+
+        LOG("single     : %d frames in %.1f ms, %.2f ms/frame", frame_num, single_ms, single_ms / frame_num);
+        // 批量与逐帧结果一致由tests/test_model.cc检查
+        LOG("batch (%d)  : %d frames in %.1f ms, %.2f ms/frame (last frame %d vs %d boxes)", batch,
+            (int)results.size(), batch_ms, batch_ms / frame_num, results.empty() ? 0 : results.back().count,
+            single.count);
+    }
+
+    int thread_num = 3;
+    int task_count = 300;
+    const char* mode_names[2] = {"per-frame", "dynamic"};
+    for (int mode = 0; mode < 2; mode++) {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.maxBatch = (mode == 1) ? 4 : 0;
+        config.batchDeadlineUs = 2000;
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+
+        gettimeofday(&start_time, NULL);
+        int submitted = 0;
+        int result_count = 0;
+        object_detect_result_list result;
+        while (result_count < task_count) {
+            while (submitted < task_count && submitted - result_count < thread_num * 8) {
+                pool.put(img);
+                submitted++;
+            }
+            if (pool.get(result) == 0) {
+                result_count++;
+            }
+        }
+        gettimeofday(&stop_time, NULL);
+        double cost_ms = (__get_us(stop_time) - __get_us(start_time)) / 1000.0;
+        LOG("%-9s: %d frames in %.1f ms, %.1f FPS", mode_names[mode], result_count, cost_ms,
+            result_count * 1000.0 / cost_ms);
+    }
+}
+
+// 多路流接入: uris为空时用测试图片生成临时裸帧文件, 模拟16路25FPS摄像头 (循环播放)
+static void test_streams(const std::vector<std::string>& uris, const std::string& img_path) {
+    LOG("========== Testing Multi-Stream Ingestion ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    std::vector<std::string> sources = uris;
+    std::string raw_path;
+    rknn::StreamOptions options;
+    int run_seconds = 10;
+    if (sources.empty()) {
+        cv::Mat img = cv::imread(img_path);
+        if (img.empty()) {
+            LOGW("cannot read %s", img_path.c_str());
+            return;
+        }
+        const char* tmp = getenv("TMPDIR");
+        raw_path = std::string(tmp != NULL ? tmp : "/tmp") + "/rknn_stream_XXXXXX";
+        int fd = mkstemp(&raw_path[0]);
+        FILE* fp = fd >= 0 ? fdopen(fd, "wb") : NULL;
+        if (fp == NULL) {
+            LOGW("cannot create %s", raw_path.c_str());
+            if (fd >= 0) {
+                close(fd);
+                unlink(raw_path.c_str());
+            }
+            return;
+        }
+        cv::Mat frame = img.isContinuous() ? img : img.clone();
+        for (int i = 0; i < 25; i++) {
+            fwrite(frame.data, 1, frame.total() * frame.elemSize(), fp);
+        }
+        fclose(fp);
+        char uri[256];
+        snprintf(uri, sizeof(uri), "raw:%dx%d:%s", img.cols, img.rows, raw_path.c_str());
+        sources.assign(16, uri);
+        options.fps = 25;
+        options.loop = true;
+    }
+
+    rknn::StreamIngest<detector::YOLO11> ingest(model_path, 3, logger::Level::INFO);
+    for (auto& uri : sources) {
+        if (ingest.addStream(uri, options) < 0) {
+            LOGW("skip stream %s", uri.c_str());
+        }
+    }
+    // 各路流已打开文件, 删除后仍可读取, 进程退出时释放
+    if (!raw_path.empty()) {
+        unlink(raw_path.c_str());
+    }
+    if (ingest.streamNum() == 0 || ingest.init(detect_param) != 0) {
+        LOGW("StreamIngest init failed!");
+        return;
+    }
+
+    std::atomic<int> boxes{0};
+    ingest.setResultCallback([&](int, const cv::Mat&, object_detect_result_list& result) {
+        boxes += result.count;
+    });
+    ingest.start();
+    if (options.loop) {
+        std::this_thread::sleep_for(std::chrono::seconds(run_seconds));
+        ingest.stop();
+    } else {
+        ingest.wait();
+        ingest.stop();
+    }
+
+    uint64_t total_inferred = 0;
+    double total_fps = 0;
+    for (int i = 0; i < ingest.streamNum(); i++) {
+        rknn::StreamStats stats = ingest.stats(i);
+        LOG("stream %2d: decoded %llu, dropped %llu, inferred %llu, decode %.1f FPS, infer %.1f FPS, "
+            "latency mean %.1f ms max %.1f ms",
+            i, (unsigned long long)stats.decoded, (unsigned long long)stats.dropped,
+            (unsigned long long)stats.inferred, stats.decodeFps, stats.inferFps,
+            stats.meanLatencyMs, stats.maxLatencyMs);
+        total_inferred += stats.inferred;
+        total_fps += stats.inferFps;
+    }
+    LOG("total: %d streams, %llu frames inferred, %.1f FPS, %d boxes", ingest.streamNum(),
+        (unsigned long long)total_inferred, total_fps, boxes.load());
+}
+
+// 各阶段耗时分布: 单实例逐帧推理, 然后是流水线模式的RknnPool (阶段分布在不同线程上记录).
+// 只报告数值; 直方图误差和各阶段的记录次数由tests/test_latency.cc和tests/test_model.cc检查
+static void test_latency(const std::string& img_path) {
+    LOG("========== Testing Per-Stage Latency ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int frame_num = 200;
+
+    rknn::LatencyStats::set_enabled(true);
+    {
+        detector::YOLO11 yolo(model_path, logger::Level::INFO, detect_param);
+        yolo.infer(img);    // warm up
+        rknn::LatencyStats::reset();
+        for (int i = 0; i < frame_num; i++) {
+            yolo.infer(img);
+        }
+        LOG("--- single instance, %d frames ---", frame_num);
+        rknn::LatencyStats::report();
+    }
+
+    {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, 3, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.pipeline = true;
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+        rknn::LatencyStats::reset();
+        object_detect_result_list result;
+        for (int i = 0; i < frame_num; i++) {
+            pool.put(img);
+            while (pool.getPendingCount() >= 6 && pool.get(result) == 0) {
+            }
+        }
+        while (pool.get(result) == 0) {
+        }
+        LOG("--- pipeline pool, %d frames ---", frame_num);
+        rknn::LatencyStats::report();
+    }
+    rknn::LatencyStats::set_enabled(false);
+}
+
+// 指标导出: 在回环地址上提供 /metrics, 推理期间可以用 curl http://127.0.0.1:9464/metrics 查看, 结束时写入文件
+static void test_metrics(const std::string& img_path) {
+    LOG("========== Testing Metrics Exporter ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int thread_num = 3;
+    int run_seconds = 30;
+
+    rknn::LatencyStats::set_enabled(true);
+    rknn::MetricsServer server;
+    if (!server.start(9464)) {
+        LOGW("metrics server start failed, metrics will only be written to file");
+    }
+
+    {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.capacity = thread_num * 2;
+        config.overflow = rknn::OverflowPolicy::DROP_OLDEST;
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+        LOG("running %d s, try: curl http://127.0.0.1:%d/metrics", run_seconds, server.port());
+
+        struct timeval start_time, now;
+        gettimeofday(&start_time, NULL);
+        object_detect_result_list result;
+        do {
+            pool.put(img);
+            pool.getFor(result, std::chrono::milliseconds(10));
+            gettimeofday(&now, NULL);
+        } while (__get_us(now) - __get_us(start_time) < run_seconds * 1000000LL);
+        while (pool.get(result) == 0) {
+        }
+        rknn::MetricsRegistry::instance().write_file("./metrics.prom");
+    }
+    LOG("metrics written to ./metrics.prom");
+    server.stop();
+    rknn::LatencyStats::set_enabled(false);
+}
+
+// 推理时间线: 分别记录几种调度方式, 导出的json用 chrome://tracing 或 https://ui.perfetto.dev 打开,
+// 各NPU核心的线程并排显示, wait_model_lock区间即共用实例时的锁等待 (参见 docs/inference锁对性能的影响分析.md)
+static void test_trace(const std::string& img_path) {
+    LOG("========== Testing Inference Timeline Trace ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int thread_num = 3;
+    int frame_num = 100;
+
+    // 3个线程共用一个实例: 推理被实例锁串行化
+    {
+        detector::YOLO11 yolo(model_path, logger::Level::INFO, detect_param);
+        yolo.infer(img);    // warm up
+        rknn::Tracer::start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < thread_num; t++) {
+            threads.emplace_back([&yolo, &img, t, frame_num, thread_num]() {
+                rknn::Tracer::set_thread_name("shared instance caller " + std::to_string(t));
+                for (int i = 0; i < frame_num / thread_num; i++) {
+                    yolo.infer(img);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        rknn::Tracer::stop();
+        rknn::Tracer::dump("./trace_shared.json");
+    }
+
+    // 线程池任务模式与流水线模式, 每个模式一个文件
+    const char* modes[2] = {"task", "pipeline"};
+    for (int m = 0; m < 2; m++) {
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.pipeline = (m == 1);
+        pool.setConfig(config);
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+        rknn::Tracer::start();
+        object_detect_result_list result;
+        for (int i = 0; i < frame_num; i++) {
+            pool.put(img);
+            while (pool.getPendingCount() >= (size_t)thread_num * 2 && pool.get(result) == 0) {
+            }
+        }
+        while (pool.get(result) == 0) {
+        }
+        rknn::Tracer::stop();
+        rknn::Tracer::dump(std::string("./trace_") + modes[m] + ".json");
+    }
+}
+
+// 线程池启动方式对比: 从构造到第一帧结果的时间, 以及全部实例就绪的时间
+static void test_startup(const std::string& img_path) {
+    LOG("========== Testing Pool Startup (time to first frame) ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int thread_num = 3;
+
+    const rknn::InitMode modes[4] = {rknn::InitMode::SYNC, rknn::InitMode::PARALLEL, rknn::InitMode::ASYNC,
+                                     rknn::InitMode::LAZY};
+    const char* names[4] = {"sync", "parallel", "async", "lazy"};
+    for (int m = 0; m < 4; m++) {
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed_ms = [&start]() {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(
+            model_path, thread_num, logger::Level::INFO);
+        rknn::PoolConfig config;
+        config.initMode = modes[m];
+        pool.setConfig(config);
+        pool.setReadyCallback([&elapsed_ms](int model_id, int core_id) {
+            LOG("  instance %d ready on core %d at %.1f ms", model_id, core_id, elapsed_ms());
+        });
+        if (pool.init(detect_param) != 0) {
+            LOGW("RknnPool init failed!");
+            return;
+        }
+        double init_ms = elapsed_ms();
+
+        object_detect_result_list result;
+        pool.put(img);
+        pool.get(result);
+        double first_ms = elapsed_ms();
+        // lazy模式下持续提交, 实例随负载增加
+        for (int i = 0; i < 100; i++) {
+            pool.put(img);
+            while (pool.getPendingCount() >= (size_t)thread_num * 2 && pool.get(result) == 0) {
+            }
+        }
+        while (pool.get(result) == 0) {
+        }
+        bool all_ready = pool.waitReadyFor(0, std::chrono::milliseconds(5000));
+        LOG("%-8s: init %.1f ms, first result %.1f ms, %d/%d instances ready%s", names[m], init_ms, first_ms,
+            pool.readyCount(), thread_num, all_ready ? "" : " (not all created)");
+    }
+}
+
+// 用默认后端推理并录制输出张量, 再用CPU参考后端回放录制结果, 逐帧比较检测结果.
+// 回放只替换rknn_run, 预处理/后处理照常执行, 结果应完全一致; 可把录制目录拷到x86上复现
+static void test_backend(const std::string& img_path) {
+    LOG("========== Testing Backend Record/Replay ==========");
+    std::string model_path = "./model/yolo11.rknn";
+    std::string record_dir = "./record_yolo11";
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    cv::Mat img = cv::imread(img_path);
+    int test_count = 10;
+
+    std::vector<object_detect_result_list> recorded;
+    {
+        rknn::ModelConfig config;
+        config.record_dir = record_dir;
+        config.record_frames = test_count;
+        auto yolo11 = std::make_unique<detector::YOLO11>(model_path, logger::Level::INFO, detect_param, config);
+        for (int i = 0; i < test_count; ++i) {
+            recorded.push_back(yolo11->infer(img));
+        }
+        LOG("recorded %d frames with the %s backend", test_count, yolo11->backend_name());
+    }
+
+    // 录制器在最后一个实例析构时写出model.spec
+    rknn::ModelConfig config;
+    config.backend = rknn::BackendType::CPU;
+    auto replay = std::make_unique<detector::YOLO11>(record_dir + "/model.spec", logger::Level::INFO, detect_param,
+                                                     config);
+    int mismatch = 0;
+    struct timeval start_time, stop_time;
+    gettimeofday(&start_time, NULL);
+    for (int i = 0; i < test_count; ++i) {
+        object_detect_result_list result = replay->infer(img);
+        bool same = result.count == recorded[i].count;
+        for (int k = 0; same && k < result.count; k++) {
+            const object_detect_result& a = result.results[k];
+            const object_detect_result& b = recorded[i].results[k];
+            same = a.cls_id == b.cls_id && a.prop == b.prop && memcmp(&a.box, &b.box, sizeof(a.box)) == 0;
+        }
+        mismatch += same ? 0 : 1;
+    }
+    gettimeofday(&stop_time, NULL);
+    LOG("replayed %d frames with the %s backend, average %f ms, %d frames differ", test_count,
+        replay->backend_name(), (__get_us(stop_time) - __get_us(start_time)) / 1000.0 / test_count, mismatch);
+}
+
+// 多个生产者同时提交大量极小任务, 比较有锁线程池与无锁MPMC队列线程池的吞吐和提交延迟
+template <typename SubmitFunc>
+static void bench_pool_submit(const char* name, int producer_num, int task_num, SubmitFunc submit,
+                              std::atomic<int>& done) {
+    std::vector<std::vector<uint32_t>> latency(producer_num, std::vector<uint32_t>(task_num));
+    done.store(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producer_num; p++) {
+        producers.emplace_back([&, p]() {
+            uint32_t* samples = latency[p].data();
+            for (int i = 0; i < task_num; i++) {
+                auto t0 = std::chrono::steady_clock::now();
+                submit();
+                auto t1 = std::chrono::steady_clock::now();
+                samples[i] = (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    int total = producer_num * task_num;
+    while (done.load(std::memory_order_acquire) < total) {
+        std::this_thread::yield();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    std::vector<uint32_t> all;
+    all.reserve(total);
+    for (auto& v : latency) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    size_t p50 = all.size() / 2;
+    size_t p99 = all.size() * 99 / 100;
+    std::nth_element(all.begin(), all.begin() + p50, all.end());
+    uint32_t p50_ns = all[p50];
+    std::nth_element(all.begin(), all.begin() + p99, all.end());
+    uint32_t p99_ns = all[p99];
+
+    double cost_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    LOG("%-22s: %.1f ms, %.2f M tasks/s, submit p50 %u ns, p99 %u ns", name, cost_ms,
+        total / cost_ms / 1000.0, p50_ns, p99_ns);
+}
+
+static void test_task_queue() {
+    LOG("========== Testing Thread Pool Task Queue ==========");
+    const int producer_num = 4;
+    const int worker_num = 4;
+    const int task_num = 1000000;   // 每个生产者
+    std::atomic<int> done{0};
+    auto tiny_task = [&done]() { done.fetch_add(1, std::memory_order_release); };
+
+    LOG("%d producers x %d tasks, %d workers", producer_num, task_num, worker_num);
+    {
+        dpool::MutexThreadPool pool(worker_num);
+        bench_pool_submit("mutex pool submit", producer_num, task_num, [&]() { pool.submit(tiny_task); }, done);
+    }
+    {
+        dpool::ThreadPool pool(worker_num);
+        bench_pool_submit("lock-free pool submit", producer_num, task_num, [&]() { pool.submit(tiny_task); }, done);
+    }
+    {
+        dpool::ThreadPool pool(worker_num);
+        bench_pool_submit("lock-free pool post", producer_num, task_num, [&]() { pool.post(tiny_task); }, done);
+    }
+}
+
+// 每帧一个外部任务, 在任务内部再拆出若干CPU子任务 (模拟解码/letterbox/NMS/编码),
+// 比较全局队列线程池与工作窃取线程池
+template <typename Pool>
+static void bench_fork_join(const char* name, int worker_num, int frame_num, int sub_num, int work) {
+    std::atomic<int> done{0};
+    std::atomic<uint32_t> sink{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        // 队列容纳全部任务: 工作线程向已满的ThreadPool队列提交子任务会阻塞, 全部阻塞就会死锁
+        Pool pool(worker_num, (size_t)frame_num * (sub_num + 1));
+        for (int f = 0; f < frame_num; f++) {
+            pool.post([&pool, &done, &sink, sub_num, work]() {
+                for (int s = 0; s < sub_num; s++) {
+                    pool.post([&done, &sink, work, s]() {
+                        uint32_t x = s + 1;
+                        for (int i = 0; i < work; i++) {
+                            x = x * 1664525u + 1013904223u;
+                        }
+                        sink.fetch_add(x & 1, std::memory_order_relaxed);
+                        done.fetch_add(1, std::memory_order_release);
+                    });
+                }
+            });
+        }
+        while (done.load(std::memory_order_acquire) < frame_num * sub_num) {
+            std::this_thread::yield();
+        }
+    }
+    double cost_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG("%-18s: %.1f ms, %.2f M subtasks/s", name, cost_ms, frame_num * sub_num / cost_ms / 1000.0);
+}
+
+static void test_work_stealing() {
+    LOG("========== Testing Work-Stealing Pool ==========");
+    const int worker_num = 4;
+    const int frame_num = 20000;
+    const int sub_num = 16;
+    LOG("%d frames x %d subtasks, %d workers", frame_num, sub_num, worker_num);
+    for (int work : {0, 2000}) {
+        LOG("subtask work: %d iterations", work);
+        bench_fork_join<dpool::ThreadPool>("global queue pool", worker_num, frame_num, sub_num, work);
+        bench_fork_join<dpool::WorkStealingPool>("work-stealing pool", worker_num, frame_num, sub_num, work);
+    }
+}
+
+struct MicroBench {
+    const char* name;
+    const char* help;
+    void (*run)(const std::string& img_path, const std::vector<std::string>& sources);
+};
+
+static const MicroBench MICRO_BENCHES[] = {
+    {"zerocopy", "zero copy io mem vs rknn_inputs_set/rknn_outputs_get",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_zero_copy(img_path); }},
+    {"preprocess", "time the preprocess backends (opencv/fused/rga)",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_preprocess(img_path); }},
+    {"nv12", "NV12 image_buffer_t input (preprocess backends + inference)",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_nv12(img_path); }},
+    {"dfl", "quantized DFL decode (lut vs compute_dfl) on synthetic tensors",
+     [](const std::string&, const std::vector<std::string>&) { test_dfl_decode(); }},
+    {"scan", "SIMD class score scan (int8/uint8/fp32) on synthetic tensors",
+     [](const std::string&, const std::vector<std::string>&) { test_class_scan(); }},
+    {"nms", "NmsEngine against quicksort + per-class nms() on synthetic boxes",
+     [](const std::string&, const std::vector<std::string>&) { test_nms(); }},
+    {"pipeline", "RknnPool task mode vs the staged pipeline mode",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_pipeline(img_path); }},
+    {"affine", "round-robin dispatch vs core-affine dedicated workers",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_core_affine(img_path); }},
+    {"order", "global, per-stream and as-completed result delivery",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_result_order(img_path); }},
+    {"batch", "per-frame inference vs infer_batch and the pool's dynamic batcher",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_batch(img_path); }},
+    {"latency", "per-stage latency histograms (preprocess/inputs_set/rknn_run/outputs_get/postprocess/nms)",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_latency(img_path); }},
+    {"metrics", "serve Prometheus metrics on 127.0.0.1:9464/metrics while inferring, then dump to file",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_metrics(img_path); }},
+    {"trace", "record the inference timeline (shared instance/task/pipeline) as Chrome trace JSON",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_trace(img_path); }},
+    {"startup", "pool init modes (sync/parallel/async/lazy) by time to first result",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_startup(img_path); }},
+    {"backend", "record output tensors, replay them on the CPU reference backend and compare",
+     [](const std::string& img_path, const std::vector<std::string>&) { test_backend(img_path); }},
+    {"streams", "multi-stream ingestion from --source (dir:<dir>, raw:<w>x<h>:<file>, video, rtsp://)",
+     [](const std::string& img_path, const std::vector<std::string>& sources) { test_streams(sources, img_path); }},
+    {"queue", "thread pool task submission under contention (no model)",
+     [](const std::string&, const std::vector<std::string>&) { test_task_queue(); }},
+    {"steal", "nested CPU subtasks on the work-stealing pool (no model)",
+     [](const std::string&, const std::vector<std::string>&) { test_work_stealing(); }},
+};
+
+bool has_micro_bench(const std::string& name) {
+    for (const auto& bench : MICRO_BENCHES) {
+        if (name == bench.name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_micro_benches() {
+    for (const auto& bench : MICRO_BENCHES) {
+        printf("    %-12s %s\n", bench.name, bench.help);
+    }
+}
+
+int run_micro_bench(const std::string& name, const std::string& img_path, const std::vector<std::string>& sources) {
+    for (const auto& bench : MICRO_BENCHES) {
+        if (name == bench.name) {
+            bench.run(img_path, sources);
+            return 0;
+        }
+    }
+    fprintf(stderr, "unknown micro benchmark %s\n", name.c_str());
+    return 1;
+}
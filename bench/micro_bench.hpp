@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// rknn_bench --micro NAME 的单项测量 (见micro_bench.cc)
+bool has_micro_bench(const std::string& name);
+
+// 每项一行: 名称和说明
+void print_micro_benches();
+
+// img_path为需要图片的项使用的测试图片, sources为streams的流地址 (为空时用img_path模拟); 名称未知时返回1
+int run_micro_bench(const std::string& name, const std::string& img_path, const std::vector<std::string>& sources);
@@ -0,0 +1,9 @@
+# rknn::CpuBackend的模型描述 (格式见include/backend.hpp), 代替model/yolo11.rknn
+# RK3588单核上640x640 int8 YOLO11n的rknn_run约20ms
+model=yolo11
+input=640x640
+batch=1
+classes=80
+dtype=int8
+run_us=20000
+objects=8
@@ -0,0 +1,8 @@
+# batch=4的YOLO11, 配合--batch测试动态批处理; 一次rknn_run处理4帧
+model=yolo11
+input=640x640
+batch=4
+classes=80
+dtype=int8
+run_us=60000
+objects=8
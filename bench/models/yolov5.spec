@@ -0,0 +1,8 @@
+# rknn::CpuBackend的模型描述 (格式见include/backend.hpp), 代替model/yolov5.rknn
+model=yolov5
+input=640x640
+batch=1
+classes=80
+dtype=int8
+run_us=25000
+objects=8
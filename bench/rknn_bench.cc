@@ -0,0 +1,542 @@
+// rknn_bench: 在一组图片上扫描 模型 x 线程数 x NPU核心掩码 x 批大小 x 输入分辨率,
+// 每个组合先预热再计时, 输出逐帧端到端延迟的p50/p95/p99/max和吞吐(FPS), 以及各阶段耗时, 可写成JSON/CSV.
+//
+// 提交端保持固定的在途帧数(闭环), 延迟为put到get取得结果的时间, 不含提交端等待空位的时间.
+// --backend cpu 使用CPU参考后端 (rknn::CpuBackend), 可在x86上回归测试CPU侧各阶段; -DRKNN_CPU_RUNTIME=ON构建时为默认.
+// --micro NAME 不做扫描, 只运行一项单独的测量 (见micro_bench.cc)
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RknnPool.hpp"
+#include "latency.hpp"
+#include "micro_bench.hpp"
+#include "yolo11.hpp"
+#include "yolov5.hpp"
+
+#ifdef RKNN_CPU_RUNTIME
+static const char* DEFAULT_BACKEND = "cpu";
+#else
+static const char* DEFAULT_BACKEND = "npu";
+#endif
+static const char* DEFAULT_NPU_MODEL = "./model/yolo11.rknn";
+static const char* DEFAULT_CPU_MODEL = "bench/models/yolo11.spec";
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchModel {
+    std::string kind;   // yolo11 / yolov5, 决定使用的检测器类
+    std::string path;
+};
+
+struct BenchOptions {
+    std::vector<BenchModel> models;
+    std::string backend = DEFAULT_BACKEND;
+    std::string images = "datasets/COCO/subset";
+    std::vector<int> threads = {3};
+    std::vector<int> coreMasks = {7};
+    std::vector<int> batches = {0};
+    std::vector<std::string> resolutions = {"orig"};
+    int warmup = 20;
+    int iterations = 200;
+    double duration = 0;        // 秒, >0时按时长计时, 忽略iterations
+    int inflight = 0;           // 在途帧数, 0为按线程数和批大小自动选择
+    std::string jsonPath;
+    std::string csvPath;
+    bool verbose = false;
+    std::string micro;                          // 单项测量的名称, 非空时不做扫描
+    std::string image = "./model/car.jpg";      // 单项测量使用的图片
+    std::vector<std::string> sources;           // --micro streams的流地址
+};
+
+struct BenchCase {
+    BenchModel model;
+    int threads;
+    int coreMask;
+    int batch;
+    std::string resolution;
+};
+
+struct BenchResult {
+    BenchCase config;
+    int inflight = 0;
+    size_t frames = 0;
+    double seconds = 0;
+    double fps = 0;
+    double meanMs = 0;
+    double p50Ms = 0;
+    double p95Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+    double detections = 0;      // 平均每帧检测数, 确认结果有效
+    rknn::LatencySummary stages[(int)rknn::Stage::COUNT];
+};
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --backend NAME       inference backend, npu or cpu (default %s)\n", DEFAULT_BACKEND);
+    printf("  --model KIND=PATH    model to benchmark, KIND is yolo11 or yolov5 (repeatable, default yolo11=%s\n"
+           "                       with the npu backend, yolo11=%s with the cpu backend)\n",
+           DEFAULT_NPU_MODEL, DEFAULT_CPU_MODEL);
+    printf("  --images DIR         benchmark images (default datasets/COCO/subset)\n");
+    printf("  --threads LIST       RknnPool thread counts, e.g. 1,2,3 (default 3)\n");
+    printf("  --cores LIST         NPU core masks, bit i = core i, e.g. 1,3,7 (default 7)\n");
+    printf("  --batch LIST         dynamic batching PoolConfig::maxBatch, 0 = off (default 0)\n");
+    printf("  --resolution LIST    source frame size, orig or WxH, e.g. orig,1920x1080 (default orig)\n");
+    printf("  --warmup N           frames before timing (default 20)\n");
+    printf("  --iterations N       timed frames per case (default 200)\n");
+    printf("  --duration SEC       time each case for SEC seconds instead of a frame count\n");
+    printf("  --inflight N         frames kept in flight (default threads * max(2, 2 * batch))\n");
+    printf("  --json FILE          write results as JSON\n");
+    printf("  --csv FILE           write results as CSV\n");
+    printf("  --verbose            keep model/runtime INFO logs\n");
+    printf("  --micro NAME         run one focused measurement instead of the sweep:\n");
+    print_micro_benches();
+    printf("  --image FILE         test image for --micro (default ./model/car.jpg)\n");
+    printf("  --source URI         stream source for --micro streams (repeatable, default: simulate from --image)\n");
+}
+
+template <typename T, typename Parse>
+static std::vector<T> split_list(const std::string& text, Parse parse) {
+    std::vector<T> out;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (end > start) {
+            out.push_back(parse(text.substr(start, end - start)));
+        }
+        start = end + 1;
+    }
+    return out;
+}
+
+static std::vector<int> parse_ints(const std::string& text) {
+    return split_list<int>(text, [](const std::string& s) { return (int)strtol(s.c_str(), NULL, 0); });
+}
+
+static bool parse_args(int argc, char* argv[], BenchOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (arg == "--verbose") {
+            opt.verbose = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--model") {
+            size_t eq = value.find('=');
+            BenchModel model;
+            model.kind = eq == std::string::npos ? "yolo11" : value.substr(0, eq);
+            model.path = eq == std::string::npos ? value : value.substr(eq + 1);
+            if (model.kind != "yolo11" && model.kind != "yolov5") {
+                fprintf(stderr, "unknown model kind %s\n", model.kind.c_str());
+                return false;
+            }
+            opt.models.push_back(model);
+        } else if (arg == "--backend") {
+            if (value != "npu" && value != "cpu") {
+                fprintf(stderr, "unknown backend %s\n", value.c_str());
+                return false;
+            }
+            opt.backend = value;
+        } else if (arg == "--images") {
+            opt.images = value;
+        } else if (arg == "--threads") {
+            opt.threads = parse_ints(value);
+        } else if (arg == "--cores") {
+            opt.coreMasks = parse_ints(value);
+        } else if (arg == "--batch") {
+            opt.batches = parse_ints(value);
+        } else if (arg == "--resolution") {
+            opt.resolutions = split_list<std::string>(value, [](const std::string& s) { return s; });
+        } else if (arg == "--warmup") {
+            opt.warmup = atoi(value.c_str());
+        } else if (arg == "--iterations") {
+            opt.iterations = atoi(value.c_str());
+        } else if (arg == "--duration") {
+            opt.duration = atof(value.c_str());
+        } else if (arg == "--inflight") {
+            opt.inflight = atoi(value.c_str());
+        } else if (arg == "--json") {
+            opt.jsonPath = value;
+        } else if (arg == "--csv") {
+            opt.csvPath = value;
+        } else if (arg == "--micro") {
+            if (!has_micro_bench(value)) {
+                fprintf(stderr, "unknown micro benchmark %s\n", value.c_str());
+                return false;
+            }
+            opt.micro = value;
+        } else if (arg == "--image") {
+            opt.image = value;
+        } else if (arg == "--source") {
+            opt.sources.push_back(value);
+        } else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (opt.models.empty()) {
+        opt.models.push_back({"yolo11", opt.backend == "cpu" ? DEFAULT_CPU_MODEL : DEFAULT_NPU_MODEL});
+    }
+    for (int t : opt.threads) {
+        if (t <= 0) {
+            fprintf(stderr, "invalid thread count %d\n", t);
+            return false;
+        }
+    }
+    for (int mask : opt.coreMasks) {
+        if (mask <= 0 || mask > 7) {
+            fprintf(stderr, "invalid core mask %d (1..7)\n", mask);
+            return false;
+        }
+    }
+    if (opt.threads.empty() || opt.coreMasks.empty() || opt.batches.empty() || opt.resolutions.empty() ||
+        (opt.iterations <= 0 && opt.duration <= 0)) {
+        fprintf(stderr, "empty sweep\n");
+        return false;
+    }
+    return true;
+}
+
+// 目录下的jpg/png, 按文件名排序, 每次运行顺序一致
+static std::vector<cv::Mat> load_images(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* dp = opendir(dir.c_str());
+    if (dp == NULL) {
+        fprintf(stderr, "cannot open image directory %s: %s (run from the repository root or pass --images DIR)\n",
+                dir.c_str(), strerror(errno));
+        return {};
+    }
+    while (struct dirent* entry = readdir(dp)) {
+        std::string name = entry->d_name;
+        size_t dot = name.rfind('.');
+        if (dot == std::string::npos) {
+            continue;
+        }
+        std::string ext = name.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == "jpg" || ext == "jpeg" || ext == "png") {
+            names.push_back(name);
+        }
+    }
+    closedir(dp);
+    std::sort(names.begin(), names.end());
+
+    std::vector<cv::Mat> images;
+    for (auto& name : names) {
+        cv::Mat img = cv::imread(dir + "/" + name);
+        if (!img.empty()) {
+            images.push_back(img);
+        } else {
+            fprintf(stderr, "cannot decode %s/%s, skipped\n", dir.c_str(), name.c_str());
+        }
+    }
+    if (images.empty()) {
+        fprintf(stderr, "no jpg/png images found in %s\n", dir.c_str());
+    }
+    return images;
+}
+
+static bool resize_frames(const std::vector<cv::Mat>& images, const std::string& resolution,
+                          std::vector<cv::Mat>& frames) {
+    frames.clear();
+    if (resolution == "orig") {
+        frames = images;
+        return true;
+    }
+    int width = 0;
+    int height = 0;
+    if (sscanf(resolution.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        fprintf(stderr, "invalid resolution %s\n", resolution.c_str());
+        return false;
+    }
+    for (auto& img : images) {
+        cv::Mat resized;
+        cv::resize(img, resized, cv::Size(width, height));
+        frames.push_back(resized);
+    }
+    return true;
+}
+
+// 闭环提交count帧 (duration > 0时提交duration秒), 保持inflight帧在途; latencies非空时记录每帧延迟(ms)
+template <typename Pool>
+static double run_frames(Pool& pool, const std::vector<cv::Mat>& frames, int count, double duration, int inflight,
+                         std::vector<double>* latencies, size_t& detections) {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Clock::time_point> stamps;   // 结果按提交顺序交付, 与stamps一一对应
+    bool done = false;
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::duration_cast<Clock::duration>(
+                                             std::chrono::duration<double>(duration));
+    std::thread producer([&]() {
+        for (size_t i = 0;; i++) {
+            if (duration > 0 ? Clock::now() >= deadline : i >= (size_t)count) {
+                break;
+            }
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&]() { return stamps.size() < (size_t)inflight; });
+                stamps.push_back(Clock::now());
+            }
+            pool.put(frames[i % frames.size()]);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        done = true;
+    });
+
+    object_detect_result_list result;
+    Clock::time_point last = start;
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (done && stamps.empty()) {
+                break;
+            }
+        }
+        // 时间戳已记录而put还没调用时没有可取的结果
+        if (pool.getFor(result, std::chrono::milliseconds(10)) != 0) {
+            continue;
+        }
+        last = Clock::now();
+        Clock::time_point submitted;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            submitted = stamps.front();
+            stamps.pop_front();
+        }
+        cv.notify_one();
+        if (latencies != nullptr) {
+            latencies->push_back(std::chrono::duration<double, std::milli>(last - submitted).count());
+        }
+        detections += result.count;
+    }
+    producer.join();
+    return std::chrono::duration<double>(last - start).count();
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    // nearest-rank
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+template <typename ModelType>
+static bool run_case(const BenchOptions& opt, const BenchCase& c, const std::vector<cv::Mat>& frames,
+                     BenchResult& out) {
+    detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+    rknn::ModelConfig model_config;
+    model_config.core_mask = c.coreMask;
+    model_config.backend = opt.backend == "cpu" ? rknn::BackendType::CPU : rknn::BackendType::NPU;
+    logger::Level level = opt.verbose ? logger::Level::INFO : logger::Level::WARN;
+
+    rknn::RknnPool<ModelType, cv::Mat, object_detect_result_list> pool(c.model.path, c.threads, level);
+    rknn::PoolConfig config;
+    config.maxBatch = c.batch;
+    pool.setConfig(config);
+    if (pool.init(detect_param, model_config) != 0) {
+        fprintf(stderr, "RknnPool init failed for %s\n", c.model.path.c_str());
+        return false;
+    }
+
+    int inflight = opt.inflight > 0 ? opt.inflight : c.threads * std::max(2, 2 * c.batch);
+    size_t detections = 0;
+    if (opt.warmup > 0) {
+        run_frames(pool, frames, opt.warmup, 0, inflight, nullptr, detections);
+    }
+
+    rknn::LatencyStats::reset();
+    std::vector<double> latencies;
+    latencies.reserve(opt.duration > 0 ? 4096 : opt.iterations);
+    detections = 0;
+    double seconds = run_frames(pool, frames, opt.iterations, opt.duration, inflight, &latencies, detections);
+
+    out.config = c;
+    out.inflight = inflight;
+    out.frames = latencies.size();
+    out.seconds = seconds;
+    out.fps = seconds > 0 ? latencies.size() / seconds : 0;
+    out.detections = latencies.empty() ? 0 : (double)detections / latencies.size();
+    if (!latencies.empty()) {
+        double sum = 0;
+        for (double v : latencies) {
+            sum += v;
+        }
+        out.meanMs = sum / latencies.size();
+        std::sort(latencies.begin(), latencies.end());
+        out.p50Ms = percentile(latencies, 50);
+        out.p95Ms = percentile(latencies, 95);
+        out.p99Ms = percentile(latencies, 99);
+        out.maxMs = latencies.back();
+    }
+    for (int s = 0; s < (int)rknn::Stage::COUNT; s++) {
+        out.stages[s] = rknn::LatencyStats::summary((rknn::Stage)s);
+    }
+    return true;
+}
+
+static std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static bool write_json(const std::string& path, const BenchOptions& opt, size_t image_num,
+                       const std::vector<BenchResult>& results) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    fprintf(fp, "{\n  \"backend\": \"%s\",\n  \"images\": %s,\n  \"image_count\": %zu,\n", opt.backend.c_str(),
+            json_string(opt.images).c_str(), image_num);
+    fprintf(fp, "  \"warmup\": %d,\n  \"iterations\": %d,\n  \"duration_s\": %.3f,\n  \"cases\": [", opt.warmup,
+            opt.duration > 0 ? 0 : opt.iterations, opt.duration);
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        fprintf(fp, "%s\n    {\"model\": \"%s\", \"model_path\": %s, \"threads\": %d, \"core_mask\": %d, "
+                    "\"batch\": %d, \"resolution\": \"%s\", \"inflight\": %d,\n",
+                i == 0 ? "" : ",", r.config.model.kind.c_str(), json_string(r.config.model.path).c_str(),
+                r.config.threads, r.config.coreMask, r.config.batch, r.config.resolution.c_str(), r.inflight);
+        fprintf(fp, "     \"frames\": %zu, \"seconds\": %.4f, \"fps\": %.2f, \"detections_per_frame\": %.2f,\n",
+                r.frames, r.seconds, r.fps, r.detections);
+        fprintf(fp, "     \"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+                r.meanMs, r.p50Ms, r.p95Ms, r.p99Ms, r.maxMs);
+        fprintf(fp, "     \"stages_us\": {");
+        bool first = true;
+        for (int s = 0; s < (int)rknn::Stage::COUNT; s++) {
+            const rknn::LatencySummary& st = r.stages[s];
+            if (st.count == 0) {
+                continue;
+            }
+            fprintf(fp, "%s\"%s\": {\"count\": %llu, \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                        "\"max\": %.1f}",
+                    first ? "" : ", ", rknn::stage_name((rknn::Stage)s), (unsigned long long)st.count, st.mean_us,
+                    st.p50_us, st.p90_us, st.p99_us, st.max_us);
+            first = false;
+        }
+        fprintf(fp, "}}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+static bool write_csv(const std::string& path, const BenchOptions& opt, const std::vector<BenchResult>& results) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    fprintf(fp, "backend,model,model_path,threads,core_mask,batch,resolution,inflight,frames,seconds,fps,"
+                "mean_ms,p50_ms,p95_ms,p99_ms,max_ms,detections_per_frame");
+    for (int s = 0; s < (int)rknn::Stage::COUNT; s++) {
+        fprintf(fp, ",%s_p50_us,%s_p99_us", rknn::stage_name((rknn::Stage)s), rknn::stage_name((rknn::Stage)s));
+    }
+    fprintf(fp, "\n");
+    for (auto& r : results) {
+        fprintf(fp, "%s,%s,%s,%d,%d,%d,%s,%d,%zu,%.4f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.2f", opt.backend.c_str(),
+                r.config.model.kind.c_str(), r.config.model.path.c_str(), r.config.threads, r.config.coreMask,
+                r.config.batch, r.config.resolution.c_str(), r.inflight, r.frames, r.seconds, r.fps, r.meanMs,
+                r.p50Ms, r.p95Ms, r.p99Ms, r.maxMs, r.detections);
+        for (int s = 0; s < (int)rknn::Stage::COUNT; s++) {
+            fprintf(fp, ",%.1f,%.1f", r.stages[s].p50_us, r.stages[s].p99_us);
+        }
+        fprintf(fp, "\n");
+    }
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opt;
+    if (!parse_args(argc, argv, opt)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    // 单项测量的结果以INFO日志输出, 保持默认级别
+    if (!opt.micro.empty()) {
+        return run_micro_bench(opt.micro, opt.image, opt.sources);
+    }
+
+    // 模型实例按构造时的级别过滤, 线程池/后端等实例外的日志按全局级别
+    logger::Logger::set_global_level(opt.verbose ? logger::Level::INFO : logger::Level::WARN);
+
+    std::vector<cv::Mat> images = load_images(opt.images);
+    if (images.empty()) {
+        return 1;
+    }
+    printf("rknn_bench: backend=%s, %zu images from %s, warmup=%d, %s\n", opt.backend.c_str(), images.size(),
+           opt.images.c_str(), opt.warmup,
+           opt.duration > 0 ? (std::to_string(opt.duration) + " s per case").c_str()
+                            : (std::to_string(opt.iterations) + " frames per case").c_str());
+
+    rknn::LatencyStats::set_enabled(true);
+    std::vector<BenchResult> results;
+    printf("%-7s %3s %4s %5s %-10s %7s %8s %8s %8s %8s %8s\n", "model", "thr", "mask", "batch", "resolution",
+           "frames", "fps", "p50(ms)", "p95(ms)", "p99(ms)", "max(ms)");
+    for (auto& model : opt.models) {
+        for (auto& resolution : opt.resolutions) {
+            std::vector<cv::Mat> frames;
+            if (!resize_frames(images, resolution, frames)) {
+                return 1;
+            }
+            for (int threads : opt.threads) {
+                for (int mask : opt.coreMasks) {
+                    for (int batch : opt.batches) {
+                        BenchCase c = {model, threads, mask, batch, resolution};
+                        BenchResult r;
+                        bool ok = model.kind == "yolov5" ? run_case<detector::YOLO5>(opt, c, frames, r)
+                                                         : run_case<detector::YOLO11>(opt, c, frames, r);
+                        if (!ok) {
+                            return 1;
+                        }
+                        // 本组合的日志先于结果行输出
+                        logger::Logger::flush();
+                        printf("%-7s %3d %4d %5d %-10s %7zu %8.1f %8.2f %8.2f %8.2f %8.2f\n", model.kind.c_str(),
+                               threads, mask, batch, resolution.c_str(), r.frames, r.fps, r.p50Ms, r.p95Ms, r.p99Ms,
+                               r.maxMs);
+                        fflush(stdout);
+                        results.push_back(r);
+                    }
+                }
+            }
+        }
+    }
+
+    if (!opt.jsonPath.empty() && !write_json(opt.jsonPath, opt, images.size(), results)) {
+        return 1;
+    }
+    if (!opt.csvPath.empty() && !write_csv(opt.csvPath, opt, results)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef BLOCKINGQUEUE_H
+#define BLOCKINGQUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace dpool
+{
+
+    // 多生产者多消费者阻塞队列, 用于流水线各阶段之间传递任务.
+    // close()之后push失败, pop取完剩余元素后返回false
+    template <typename T>
+    class BlockingQueue
+    {
+    public:
+        using MutexGuard = std::lock_guard<std::mutex>;
+        using UniqueLock = std::unique_lock<std::mutex>;
+
+        BlockingQueue() : closed_(false) {}
+
+        BlockingQueue(const BlockingQueue &) = delete;
+        BlockingQueue &operator=(const BlockingQueue &) = delete;
+
+        bool push(T item)
+        {
+            {
+                MutexGuard guard(mutex_);
+                if (closed_)
+                {
+                    return false;
+                }
+                items_.push_back(std::move(item));
+            }
+            cv_.notify_one();
+            return true;
+        }
+
+        bool pop(T &item)
+        {
+            UniqueLock uniqueLock(mutex_);
+            cv_.wait(uniqueLock, [this]()
+                     { return closed_ || !items_.empty(); });
+            if (items_.empty())
+            {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            return true;
+        }
+
+        // 最多等到deadline, 超时或已关闭且为空时返回false
+        template <typename Clock, typename Duration>
+        bool popUntil(T &item, const std::chrono::time_point<Clock, Duration> &deadline)
+        {
+            UniqueLock uniqueLock(mutex_);
+            cv_.wait_until(uniqueLock, deadline, [this]()
+                           { return closed_ || !items_.empty(); });
+            if (items_.empty())
+            {
+                return false;
+            }
+            item = std::move(items_.front());
+            items_.pop_front();
+            return true;
+        }
+
+        void close()
+        {
+            {
+                MutexGuard guard(mutex_);
+                closed_ = true;
+            }
+            cv_.notify_all();
+        }
+
+        size_t size() const
+        {
+            MutexGuard guard(mutex_);
+            return items_.size();
+        }
+
+    private:
+        bool closed_;
+        mutable std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<T> items_;
+    };
+
+} // namespace dpool
+
+#endif /* BLOCKINGQUEUE_H */
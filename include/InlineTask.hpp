@@ -0,0 +1,134 @@
+#ifndef INLINETASK_H
+#define INLINETASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dpool
+{
+
+    // 只可移动的 void() 任务, 可调用对象不超过INLINE_SIZE时直接存放在对象内部(小缓冲优化),
+    // 提交和执行都不需要堆分配; 超过时退化为堆上存放.
+    // 与std::function不同, 可以保存std::packaged_task这类只可移动的对象
+    class InlineTask
+    {
+    public:
+        static constexpr size_t INLINE_SIZE = 48;
+
+        InlineTask() noexcept : ops_(nullptr) {}
+
+        template <typename Func,
+                  typename = typename std::enable_if<
+                      !std::is_same<typename std::decay<Func>::type, InlineTask>::value>::type>
+        InlineTask(Func &&func)
+        {
+            using Callable = typename std::decay<Func>::type;
+            if constexpr (fitsInline<Callable>())
+            {
+                new (storage_) Callable(std::forward<Func>(func));
+                ops_ = &inlineOps<Callable>;
+            }
+            else
+            {
+                *reinterpret_cast<Callable **>(storage_) = new Callable(std::forward<Func>(func));
+                ops_ = &heapOps<Callable>;
+            }
+        }
+
+        InlineTask(InlineTask &&other) noexcept : ops_(other.ops_)
+        {
+            if (ops_ != nullptr)
+            {
+                ops_->move(storage_, other.storage_);
+                other.ops_ = nullptr;
+            }
+        }
+
+        InlineTask &operator=(InlineTask &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                if (other.ops_ != nullptr)
+                {
+                    other.ops_->move(storage_, other.storage_);
+                    ops_ = other.ops_;
+                    other.ops_ = nullptr;
+                }
+            }
+            return *this;
+        }
+
+        InlineTask(const InlineTask &) = delete;
+        InlineTask &operator=(const InlineTask &) = delete;
+
+        ~InlineTask() { reset(); }
+
+        void operator()() { ops_->invoke(storage_); }
+
+        explicit operator bool() const { return ops_ != nullptr; }
+
+        // 销毁保存的可调用对象 (及其捕获的资源)
+        void reset()
+        {
+            if (ops_ != nullptr)
+            {
+                ops_->destroy(storage_);
+                ops_ = nullptr;
+            }
+        }
+
+        // 该类型能否不经堆分配直接存放
+        template <typename Callable>
+        static constexpr bool fitsInline()
+        {
+            return sizeof(Callable) <= INLINE_SIZE &&
+                   alignof(Callable) <= alignof(std::max_align_t) &&
+                   std::is_nothrow_move_constructible<Callable>::value;
+        }
+
+    private:
+        struct Ops
+        {
+            void (*invoke)(void *storage);
+            void (*move)(void *dst, void *src);   // 移动到dst并销毁src
+            void (*destroy)(void *storage);
+        };
+
+        template <typename Callable>
+        static void invokeInline(void *storage) { (*static_cast<Callable *>(storage))(); }
+
+        template <typename Callable>
+        static void moveInline(void *dst, void *src)
+        {
+            Callable *from = static_cast<Callable *>(src);
+            new (dst) Callable(std::move(*from));
+            from->~Callable();
+        }
+
+        template <typename Callable>
+        static void destroyInline(void *storage) { static_cast<Callable *>(storage)->~Callable(); }
+
+        template <typename Callable>
+        static void invokeHeap(void *storage) { (**static_cast<Callable **>(storage))(); }
+
+        static void moveHeap(void *dst, void *src) { *static_cast<void **>(dst) = *static_cast<void **>(src); }
+
+        template <typename Callable>
+        static void destroyHeap(void *storage) { delete *static_cast<Callable **>(storage); }
+
+        template <typename Callable>
+        static constexpr Ops inlineOps = {&invokeInline<Callable>, &moveInline<Callable>, &destroyInline<Callable>};
+
+        template <typename Callable>
+        static constexpr Ops heapOps = {&invokeHeap<Callable>, &moveHeap, &destroyHeap<Callable>};
+
+        alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+        const Ops *ops_;
+    };
+
+} // namespace dpool
+
+#endif /* INLINETASK_H */
@@ -0,0 +1,142 @@
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dpool
+{
+
+    // 有界无锁多生产者多消费者环形队列 (Vyukov算法).
+    // 每个槽位带一个序号: 序号等于入队位置时可写, 等于入队位置+1时可读,
+    // 生产者和消费者各自只通过CAS争抢自己的位置计数, 不需要互斥锁.
+    // 容量向上取整为2的幂; 队满时tryPush返回false且不移动参数, 由调用方决定等待策略
+    template <typename T>
+    class MpmcQueue
+    {
+    public:
+        explicit MpmcQueue(size_t capacity)
+            : enqueuePos_(0),
+              dequeuePos_(0)
+        {
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            mask_ = size - 1;
+            cells_.reset(new Cell[size]);
+            for (size_t i = 0; i < size; ++i)
+            {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+        ~MpmcQueue()
+        {
+            T item;
+            while (tryPop(item))
+            {
+            }
+        }
+
+        bool tryPush(T &&item)
+        {
+            Cell *cell;
+            size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0)
+                {
+                    if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;   // 队满: 该槽位上一轮的元素还没被取走
+                }
+                else
+                {
+                    pos = enqueuePos_.load(std::memory_order_relaxed);
+                }
+            }
+            new (&cell->storage) T(std::move(item));
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool tryPop(T &item)
+        {
+            Cell *cell;
+            size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;   // 队空
+                }
+                else
+                {
+                    pos = dequeuePos_.load(std::memory_order_relaxed);
+                }
+            }
+            T *stored = reinterpret_cast<T *>(&cell->storage);
+            item = std::move(*stored);
+            stored->~T();
+            cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 近似元素数, 包括正在写入/读取中的槽位, 只用于等待判断和统计
+        size_t sizeApprox() const
+        {
+            size_t enqueue = enqueuePos_.load(std::memory_order_seq_cst);
+            size_t dequeue = dequeuePos_.load(std::memory_order_seq_cst);
+            return enqueue > dequeue ? enqueue - dequeue : 0;
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_;
+        // 入队/出队位置分别独占缓存行, 避免生产者和消费者之间的伪共享
+        alignas(CACHE_LINE) std::atomic<size_t> enqueuePos_;
+        alignas(CACHE_LINE) std::atomic<size_t> dequeuePos_;
+        char padding_[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    };
+
+} // namespace dpool
+
+#endif /* MPMCQUEUE_H */
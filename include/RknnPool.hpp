@@ -2,20 +2,125 @@
 #define RKNNPOOL_H
 
 #include "ThreadPool.hpp"
+#include "WorkStealingPool.hpp"
+#include "BlockingQueue.hpp"
 #include <vector>
+#include <thread>
+#include <future>
 #include <iostream>
 #include <mutex>
-#include <queue>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <set>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "rknn_model.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 
 namespace rknn {
 
+// 结果的交付顺序
+enum class ResultOrder
+{
+    GLOBAL,         // 严格按提交顺序
+    PER_STREAM,     // 同一路流内按提交顺序, 不同流之间互不等待
+    AS_COMPLETED    // 完成即交付
+};
+
+// 未交付的帧达到PoolConfig::capacity时put的处理方式
+enum class OverflowPolicy
+{
+    BLOCK,          // put阻塞到有帧交付. 结果由get取走时, 同一个线程既put又get会死锁:
+                    // 该线程阻塞在put里, 没有线程再调用get. 这种用法应改用DROP_*, 或设置结果回调
+    DROP_OLDEST,    // 丢弃最早的未交付帧(还没开始推理, 或已完成未取走), 接收新帧; 都没有时拒绝新帧
+    DROP_NEWEST     // 拒绝新帧, put返回1
+};
+
+// 帧的序号信息, 随结果一起交付
+struct FrameInfo
+{
+    uint64_t seq = 0;           // 全局提交序号
+    int stream = 0;             // put时指定的流
+    uint64_t streamSeq = 0;     // 流内提交序号
+    bool failed = false;        // 推理失败(某个阶段返回失败或抛出异常), 结果为默认值
+};
+
+// 模型实例的创建方式. 第一个实例(rknn_init加载权重)总是在init中同步创建, 以下只影响其余的rknn_dup_context实例
+enum class InitMode
+{
+    SYNC,       // 依次创建全部实例后init返回
+    PARALLEL,   // 其余实例各用一个线程并行创建, init等待全部完成
+    ASYNC,      // 同PARALLEL, 但init在第一个实例就绪后立即返回, 其余实例就绪后陆续开始接收任务
+    LAZY        // init只创建第一个实例, 未完成的帧数达到已有实例数时再在后台增加实例, 直到threadNum个
+};
+
+// 模型实例的初始化状态
+struct ModelStatus
+{
+    bool ready = false;
+    bool failed = false;
+    int coreId = -1;            // 绑定的NPU核心, 就绪前为-1
+    int64_t initUs = 0;         // 创建耗时
+};
+
+// 线程池配置, 在init之前通过setConfig设置
+struct PoolConfig
+{
+    // 流水线模式: 预处理(含rknn_inputs_set)、NPU执行、后处理由各自的线程阶段完成.
+    // 共创建 threadNum * depth 个模型实例 (rknn_dup_context共享权重, 轮询绑定NPU核心),
+    // 每个实例有自己的输入/输出tensor, NPU执行当前帧时下一帧已在预处理, 上一帧在后处理
+    bool pipeline = false;
+    int depth = 2;                  // 每个NPU线程的实例数, 2为双缓冲
+    int preprocessThreads = 2;
+    int postprocessThreads = 1;
+
+    // 核心绑定模式: 每个模型实例(绑定一个NPU核心)有自己的专用工作线程和任务队列,
+    // put把任务交给在途任务最少的实例 (优先空闲实例), 而不是按轮询序号分配.
+    // 与pipeline同时设置时以pipeline为准
+    bool coreAffine = false;
+    // 核心绑定模式下非空时, 第i个专用线程绑定到CPU cpuAffinity[i % size] (如RK3588大核4~7).
+    // 编号须小于系统配置的CPU数, 否则setConfig拒绝该配置
+    std::vector<int> cpuAffinity;
+
+    // 结果交付顺序. 各模式的结果都在完成时进入重排缓冲区, 一帧慢不会拖住其他流或(AS_COMPLETED时)其他帧
+    ResultOrder order = ResultOrder::GLOBAL;
+
+    // 未交付帧(已提交, 还未被get/回调取走)的上限, 0为不限制; 达到上限时按overflow处理.
+    // 实时视频应使用DROP_OLDEST丢弃过时的帧, 而不是积压延迟.
+    // 流水线模式下实例全部占用时put仍会等待空闲实例
+    size_t capacity = 0;
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+
+    // 动态批处理: maxBatch > 0 时put进入共享队列, 每个模型实例的工作线程取到第一帧后
+    // 最多再等batchDeadlineUs凑满maxBatch帧, 以一次infer_batch推理 (batch>1的模型每batch只调用一次rknn_run).
+    // 与pipeline/coreAffine同时设置时以它们为准
+    int maxBatch = 0;
+    int batchDeadlineUs = 2000;
+
+    // 任务模式下线程池任务队列的容量. 队列满时put阻塞到有任务被取走;
+    // 需要在更长的积压下不阻塞时调大, 需要丢帧而不是阻塞时使用capacity/overflow
+    size_t taskCapacity = dpool::ThreadPool::DEFAULT_CAPACITY;
+
+    // 缩短首帧时间: 第一个实例就绪就可以put, 任务只分配给已就绪的实例.
+    // 流水线模式需要全部实例才能建立各阶段, ASYNC/LAZY按PARALLEL处理
+    InitMode initMode = InitMode::SYNC;
+};
+
 // rknnModel: 模型类型 (如 detector::YOLO11, detector::YOLO5)
 // inputType: 输入类型 (如 cv::Mat)
 // outputType: 输出类型 (如 object_detect_result_list)
-template <typename rknnModel, typename inputType, typename outputType>
+// Executor: 任务模式的执行器 (dpool::ThreadPool, 或需要工作窃取时用 dpool::WorkStealingPool)
+template <typename rknnModel, typename inputType, typename outputType, typename Executor = dpool::ThreadPool>
 class RknnPool
 {
 private:
@@ -23,15 +128,136 @@ private:
     std::string m_modelPath;
     logger::Level m_logLevel;
 
+public:
+    // 交付结果的回调, 按PoolConfig::order的顺序在完成推理的线程上调用
+    using ResultCallback = std::function<void(const FrameInfo&, outputType&)>;
+    // 实例就绪的回调 (modelId, NPU核心), 在创建该实例的线程上调用, 并行创建时可能同时调用
+    using ReadyCallback = std::function<void(int, int)>;
+
+private:
     long long m_id;
-    std::mutex m_idMtx, m_queueMtx;
-    std::unique_ptr<dpool::ThreadPool> m_pool;
-    std::queue<std::future<outputType>> m_futures;
+    std::mutex m_idMtx;
+    std::unique_ptr<Executor> m_pool;
     std::vector<std::shared_ptr<rknnModel>> m_models;
 
+    // 结果重排: 完成的帧按排序键(排序流, 流内序号)放入m_reorder, 轮到它时移入m_ready或交给回调
+    struct Completed
+    {
+        FrameInfo info;
+        outputType result;
+        bool dropped;   // 开始推理前被DROP_OLDEST丢弃, 只占位不交付
+    };
+    using OrderKey = std::pair<int, uint64_t>;
+
+    std::mutex m_resultMtx;             // 保护以下结果状态
+    std::mutex m_deliverMtx;            // 回调按交付顺序依次调用
+    std::condition_variable m_resultCv;
+    std::condition_variable m_spaceCv;                  // BLOCK策略下等待未交付帧减少
+    uint64_t m_nextSeq;
+    std::unordered_map<int, uint64_t> m_streamPut;      // 每路流下一个提交序号
+    std::unordered_map<int, uint64_t> m_nextDeliver;    // 每个排序流下一个应交付的序号
+    std::map<OrderKey, Completed> m_reorder;            // 已完成, 等待前面的帧
+    std::deque<Completed> m_ready;                      // 可交付, 等待get
+    size_t m_unfinished;                // 已提交未完成
+    size_t m_undelivered;               // 已提交未交付 (不含被丢弃的帧)
+    size_t m_dropped;                   // 被丢弃/拒绝的帧数
+    size_t m_completed;                 // 完成推理的帧数 (不含被丢弃和失败的帧)
+    size_t m_failed;                    // 推理失败的帧数
+    std::set<uint64_t> m_waiting;       // 已提交还没开始推理的帧, DROP_OLDEST可以取消它们
+    ResultCallback m_callback;
+
+    // 流水线模式
+    struct PipelineJob
+    {
+        inputType input;
+        FrameInfo info;
+        int slot;       // 使用的模型实例
+        bool ok;
+    };
+    using JobPtr = std::unique_ptr<PipelineJob>;
+
+    // 任务模式: 帧的输入放在复用的PipelineJob中, 提交的任务只捕获this和job指针, 放得进InlineTask不做堆分配
+    std::mutex m_jobMtx;
+    std::vector<JobPtr> m_freeJobs;
+
+    PoolConfig m_config;
+    dpool::BlockingQueue<int> m_freeSlots;      // 空闲的模型实例, 全部占用时put阻塞(背压)
+    dpool::BlockingQueue<JobPtr> m_preQueue;
+    dpool::BlockingQueue<JobPtr> m_postQueue;
+    std::vector<std::unique_ptr<dpool::BlockingQueue<JobPtr>>> m_npuQueues;  // 每个NPU核心一个
+    std::vector<int> m_slotQueue;               // 模型实例 -> NPU队列
+    std::vector<std::thread> m_stageThreads;
+
+    // 核心绑定模式: 每个实例一个任务队列(复用m_npuQueues)和专用线程(复用m_stageThreads)
+    std::unique_ptr<std::atomic<int>[]> m_inflight;   // 每个实例已分配未完成的任务数
+
+    // 动态批处理模式: 所有实例的工作线程(复用m_stageThreads)共享一个任务队列
+    dpool::BlockingQueue<JobPtr> m_batchQueue;
+
+    // MetricsRegistry中的collector, 导出时读取上面的结果状态
+    int m_metricsId;
+    int m_poolIndex;
+
+    // 实例的初始化状态. m_models在init中按实例数预留, 后台线程写入实例后以release发布SLOT_READY,
+    // 分配任务前以acquire检查, 之后才读取m_models[i]
+    enum SlotState
+    {
+        SLOT_EMPTY = 0,
+        SLOT_CREATING,
+        SLOT_READY,
+        SLOT_FAILED
+    };
+    std::unique_ptr<std::atomic<int>[]> m_slotState;
+    std::vector<int64_t> m_slotInitUs;
+    std::function<std::shared_ptr<rknnModel>(rknn_context*)> m_factory;
+    std::mutex m_initMtx;               // 保护以下状态, 以及实例就绪时追加的m_stageThreads
+    std::condition_variable m_readyCv;
+    std::vector<std::thread> m_initThreads;
+    int m_readyNum;
+    int m_creatingNum;
+    ReadyCallback m_readyCallback;
+
 protected:
     int getModelId();
 
+    JobPtr acquireJob();
+    void releaseJob(JobPtr job);
+
+    int beginFrame(int stream, FrameInfo& info);
+    bool dropOldest();
+    bool startFrame(const FrameInfo& info);
+    OrderKey orderKey(const FrameInfo& info) const;
+    template <typename Func>
+    bool runGuarded(const char* stage, FrameInfo& info, Func&& func);
+    void complete(const FrameInfo& info, outputType& result, bool dropped = false);
+    int waitResult(outputType& outputData, FrameInfo& info, int64_t timeoutMs);
+
+    int putPipeline(inputType inputData, int stream);
+    void startPipeline();
+    void stopPipeline();
+    void preprocessWorker();
+    void npuWorker(int queueId);
+    void postprocessWorker();
+
+    int putAffine(inputType inputData, int stream);
+    int pickAffineModel();
+    void startAffine();
+    void affineWorker(int modelId);
+
+    int putBatch(inputType inputData, int stream);
+    void startBatcher();
+    void batchWorker(int modelId);
+
+    void collectMetrics(MetricsWriter& writer);
+
+    void claimSlot(int modelId);
+    void launchModel(int modelId);
+    void createModel(int modelId);
+    void activateModel(int modelId);
+    void growOnDemand();
+    bool isReady(int modelId) const { return m_slotState[modelId].load(std::memory_order_acquire) == SLOT_READY; }
+    bool waitReadyImpl(int count, int64_t timeoutMs);
+
 public:
     // modelPath: 模型路径
     // threadNum: 线程数 (建议设置为NPU核心数，RK3588为3)
@@ -41,57 +267,203 @@ public:
 
     ~RknnPool();
 
+    // 设置线程池配置, 需在init之前调用. 配置无效时保留原配置并返回-1
+    int setConfig(const PoolConfig& config);
+
+    // 设置后结果不再进入get, 而是完成时按交付顺序回调; 需在put之前调用
+    void setResultCallback(ResultCallback callback) { m_callback = std::move(callback); }
+
+    // 需在init之前调用, 第一个实例也会回调
+    void setReadyCallback(ReadyCallback callback) { m_readyCallback = std::move(callback); }
+
     // 初始化模型池
     // 第一个模型使用rknn_init加载完整权重
     // 后续模型使用rknn_dup_context复用权重，绑定不同核心
     template <typename... Args>
     int init(Args&&... args);
 
-    // 提交推理任务
-    int put(inputType inputData);
+    // 提交推理任务, stream为该帧所属的流 (PER_STREAM顺序下按流排序)
+    // 返回0表示已接收, 1表示按溢出策略被拒绝
+    int put(inputType inputData, int stream = 0);
 
-    // 获取推理结果 (阻塞等待)
+    // 按交付顺序获取推理结果 (阻塞等待), 没有未交付的帧时返回1
     int get(outputType& outputData);
+    int get(outputType& outputData, FrameInfo& info);
 
-    // 获取队列中待处理的任务数
+    // 不等待: 没有可交付的结果时返回1
+    int tryGet(outputType& outputData);
+    int tryGet(outputType& outputData, FrameInfo& info);
+
+    // 最多等待timeout: 超时或没有未交付的帧时返回1
+    int getFor(outputType& outputData, std::chrono::milliseconds timeout);
+    int getFor(outputType& outputData, FrameInfo& info, std::chrono::milliseconds timeout);
+
+    // 已提交但还未交付的帧数
     size_t getPendingCount();
+
+    // 按溢出策略丢弃或拒绝的帧数
+    size_t getDroppedCount();
+
+    // 推理失败的帧数, 这些帧仍按顺序交付, FrameInfo::failed为true
+    size_t getFailedCount();
+
+    // 各实例的初始化状态, 按modelId排列
+    std::vector<ModelStatus> modelStatus();
+    int readyCount();
+
+    // 等待至少count个实例就绪, count <= 0 时为全部实例.
+    // 已创建失败或(LAZY模式下)还没有开始创建的实例不会就绪, 这时不等待直接返回false
+    bool waitReady(int count = 0) { return waitReadyImpl(count, -1); }
+    bool waitReadyFor(int count, std::chrono::milliseconds timeout) { return waitReadyImpl(count, timeout.count()); }
 };
 
 // 构造函数实现
-template <typename rknnModel, typename inputType, typename outputType>
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
 template <typename... Args>
-RknnPool<rknnModel, inputType, outputType>::RknnPool(
+RknnPool<rknnModel, inputType, outputType, Executor>::RknnPool(
     const std::string& modelPath, int threadNum, logger::Level level, Args&&... args)
-    : m_modelPath(modelPath), m_threadNum(threadNum), m_logLevel(level), m_id(0)
+    : m_threadNum(threadNum), m_modelPath(modelPath), m_logLevel(level), m_id(0),
+      m_nextSeq(0), m_unfinished(0), m_undelivered(0), m_dropped(0), m_completed(0), m_failed(0), m_metricsId(-1),
+      m_readyNum(0), m_creatingNum(0)
 {
+    static std::atomic<int> poolNum(0);
+    m_poolIndex = poolNum++;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::setConfig(const PoolConfig& config)
+{
+    // 不存在的CPU编号会使CPU_SET越界或绑定失败
+    long cpuNum = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu : config.cpuAffinity)
+    {
+        if (cpu < 0 || cpu >= CPU_SETSIZE || (cpuNum > 0 && cpu >= cpuNum))
+        {
+            std::cerr << "[RknnPool] Invalid CPU " << cpu << " in cpuAffinity (" << cpuNum << " CPUs configured)"
+                      << std::endl;
+            return -1;
+        }
+    }
+    m_config = config;
+    return 0;
 }
 
 // 初始化实现
-template <typename rknnModel, typename inputType, typename outputType>
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
 template <typename... Args>
-int RknnPool<rknnModel, inputType, outputType>::init(Args&&... args)
+int RknnPool<rknnModel, inputType, outputType, Executor>::init(Args&&... args)
 {
     try
     {
-        // 创建线程池
-        m_pool = std::make_unique<dpool::ThreadPool>(m_threadNum);
+        // 流水线模式每个NPU线程有depth个实例, 否则每个线程一个实例
+        int modelNum = m_threadNum;
+        if (m_config.pipeline)
+        {
+            modelNum = m_threadNum * std::max(1, m_config.depth);
+        }
+        else if (!m_config.coreAffine && m_config.maxBatch <= 0)
+        {
+            // 创建线程池
+            m_pool = std::make_unique<Executor>(m_threadNum, m_config.taskCapacity);
+        }
+
+        m_models.assign(modelNum, nullptr);
+        m_slotState.reset(new std::atomic<int>[modelNum]);
+        for (int i = 0; i < modelNum; i++)
+        {
+            m_slotState[i] = SLOT_EMPTY;
+        }
+        m_slotInitUs.assign(modelNum, 0);
+        // 后台创建的实例使用参数的副本
+        m_factory = [this, args...](rknn_context* ctx)
+        {
+            return std::make_shared<rknnModel>(m_modelPath, m_logLevel, ctx, args...);
+        };
 
         // 创建第一个模型实例 (加载完整权重)
         std::cout << "[RknnPool] Creating primary model instance (loads full weights)..." << std::endl;
-        m_models.push_back(std::make_shared<rknnModel>(
-            m_modelPath, m_logLevel, std::forward<Args>(args)...));
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            m_models[0] = std::make_shared<rknnModel>(m_modelPath, m_logLevel, args...);
+        }
+        catch (...)
+        {
+            // 模型构造失败 (如模型文件不存在) 时modelStatus报告第一个实例失败, init返回-1
+            m_slotInitUs[0] = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - start).count();
+            m_slotState[0].store(SLOT_FAILED, std::memory_order_release);
+            throw;
+        }
+        m_slotInitUs[0] = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start).count();
+
+        if (m_config.coreAffine && !m_config.pipeline)
+        {
+            startAffine();
+        }
+        else if (m_config.maxBatch > 0 && !m_config.pipeline)
+        {
+            startBatcher();
+        }
+        activateModel(0);
 
         // 创建后续模型实例 (使用rknn_dup_context复用权重)
-        for (int i = 1; i < m_threadNum; i++)
+        InitMode mode = m_config.initMode;
+        if (m_config.pipeline && (mode == InitMode::ASYNC || mode == InitMode::LAZY))
+        {
+            mode = InitMode::PARALLEL;
+        }
+        for (int i = 1; i < modelNum; i++)
         {
-            std::cout << "[RknnPool] Creating shared model instance " << i
-                      << " (sharing weights via rknn_dup_context)..." << std::endl;
-            m_models.push_back(std::make_shared<rknnModel>(
-                m_modelPath, m_logLevel, m_models[0]->get_context(),
-                std::forward<Args>(args)...));
+            if (mode == InitMode::SYNC)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_initMtx);
+                    claimSlot(i);
+                }
+                createModel(i);
+            }
+            else if (mode != InitMode::LAZY)
+            {
+                std::lock_guard<std::mutex> lock(m_initMtx);
+                claimSlot(i);
+                launchModel(i);
+            }
         }
 
-        std::cout << "[RknnPool] Initialized " << m_threadNum << " models successfully" << std::endl;
+        if (mode == InitMode::SYNC || mode == InitMode::PARALLEL)
+        {
+            // 等全部实例创建结束 (就绪或失败): 有实例失败时不能提前返回, 否则后台线程仍在创建其余实例
+            {
+                std::unique_lock<std::mutex> lock(m_initMtx);
+                m_readyCv.wait(lock, [this]() { return m_creatingNum == 0; });
+            }
+            if (readyCount() < modelNum)
+            {
+                std::cerr << "[RknnPool] Initialization failed: " << modelNum - readyCount()
+                          << " model instances could not be created" << std::endl;
+                return -1;
+            }
+            std::cout << "[RknnPool] Initialized " << modelNum << " models successfully" << std::endl;
+        }
+        else if (mode == InitMode::ASYNC)
+        {
+            std::cout << "[RknnPool] Primary model ready, " << modelNum - 1
+                      << " shared instances initializing in background" << std::endl;
+        }
+        else
+        {
+            std::cout << "[RknnPool] Primary model ready, up to " << modelNum - 1
+                      << " shared instances will be created on demand" << std::endl;
+        }
+
+        if (m_config.pipeline)
+        {
+            startPipeline();
+        }
+        m_metricsId = MetricsRegistry::instance().add_collector(
+            [this](MetricsWriter& writer) { collectMetrics(writer); });
     }
     catch (const std::bad_alloc& e)
     {
@@ -108,68 +480,931 @@ int RknnPool<rknnModel, inputType, outputType>::init(Args&&... args)
 }
 
 // 获取模型ID (轮询分配)
-template <typename rknnModel, typename inputType, typename outputType>
-int RknnPool<rknnModel, inputType, outputType>::getModelId()
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::getModelId()
 {
+    // 轮询已就绪的实例; 第一个实例在init中同步创建, 总是就绪
     std::lock_guard<std::mutex> lock(m_idMtx);
-    int modelId = m_id % m_threadNum;
-    m_id++;
-    return modelId;
+    for (size_t n = 0; n < m_models.size(); n++)
+    {
+        int modelId = (int)(m_id++ % (long long)m_models.size());
+        if (isReady(modelId))
+        {
+            return modelId;
+        }
+    }
+    return 0;
 }
 
 // 提交推理任务
-template <typename rknnModel, typename inputType, typename outputType>
-int RknnPool<rknnModel, inputType, outputType>::put(inputType inputData)
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::put(inputType inputData, int stream)
 {
+    if (m_config.pipeline)
+    {
+        return putPipeline(inputData, stream);
+    }
+    if (m_config.initMode == InitMode::LAZY)
+    {
+        growOnDemand();
+    }
+    if (m_config.coreAffine)
+    {
+        return putAffine(inputData, stream);
+    }
+    if (m_config.maxBatch > 0)
+    {
+        return putBatch(inputData, stream);
+    }
+
     int modelId = getModelId();
-    std::lock_guard<std::mutex> lock(m_queueMtx);
-    // 提交到线程池，调用模型的infer方法
-    m_futures.push(m_pool->submit(&rknnModel::infer, m_models[modelId], inputData));
+    // 提交到线程池，调用模型的infer方法 (按inputType选择infer的重载), 完成时进入结果重排
+    JobPtr job = acquireJob();
+    if (beginFrame(stream, job->info) != 0)
+    {
+        releaseJob(std::move(job));
+        return 1;
+    }
+    job->input = inputData;
+    job->slot = modelId;
+    auto task = [this, job = std::move(job)]() mutable
+    {
+        TraceScope trace("pool_task", "pool", (int64_t)job->info.seq);
+        outputType result = outputType();
+        bool run = startFrame(job->info);
+        if (run)
+        {
+            runGuarded("infer", job->info, [&]()
+                       {
+                           result = m_models[job->slot]->infer(job->input);
+                           return true;
+                       });
+        }
+        // complete之后析构函数可能返回, 先归还job
+        FrameInfo info = job->info;
+        job->input = inputType();
+        releaseJob(std::move(job));
+        complete(info, result, !run);
+    };
+    static_assert(sizeof(task) <= dpool::InlineTask::INLINE_SIZE, "put() task must fit in InlineTask");
+    m_pool->post(std::move(task));
+    return 0;
+}
+
+// 取一个空闲的PipelineJob, 没有时新建; 稳态下任务模式的put不做堆分配
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+typename RknnPool<rknnModel, inputType, outputType, Executor>::JobPtr
+RknnPool<rknnModel, inputType, outputType, Executor>::acquireJob()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobMtx);
+        if (!m_freeJobs.empty())
+        {
+            JobPtr job = std::move(m_freeJobs.back());
+            m_freeJobs.pop_back();
+            job->info = FrameInfo();
+            return job;
+        }
+    }
+    return JobPtr(new PipelineJob());
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::releaseJob(JobPtr job)
+{
+    std::lock_guard<std::mutex> lock(m_jobMtx);
+    m_freeJobs.push_back(std::move(job));
+}
+
+// 按容量和溢出策略接收一帧并分配帧序号, 被拒绝时返回1
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::beginFrame(int stream, FrameInfo& info)
+{
+    std::unique_lock<std::mutex> lock(m_resultMtx);
+    if (m_config.capacity > 0 && m_undelivered >= m_config.capacity)
+    {
+        if (m_config.overflow == OverflowPolicy::BLOCK)
+        {
+            m_spaceCv.wait(lock, [this]() { return m_undelivered < m_config.capacity; });
+        }
+        else if (m_config.overflow == OverflowPolicy::DROP_NEWEST || !dropOldest())
+        {
+            m_dropped++;
+            return 1;
+        }
+    }
+
+    info.seq = m_nextSeq++;
+    info.stream = stream;
+    info.streamSeq = m_streamPut[stream]++;
+    m_unfinished++;
+    m_undelivered++;
+    m_waiting.insert(info.seq);
     return 0;
 }
 
+// 丢弃最早的未交付帧: 优先取消还没开始推理的帧 (执行时跳过, 省下NPU时间),
+// 其次丢弃已完成等待取走的结果. 正在推理的帧无法丢弃, 没有可丢弃的帧时返回false. 调用时持有m_resultMtx
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+bool RknnPool<rknnModel, inputType, outputType, Executor>::dropOldest()
+{
+    if (!m_waiting.empty())
+    {
+        m_waiting.erase(m_waiting.begin());
+    }
+    else if (!m_ready.empty())
+    {
+        m_ready.pop_front();
+    }
+    else
+    {
+        return false;
+    }
+    m_undelivered--;
+    m_dropped++;
+    return true;
+}
+
+// 帧开始推理前调用, 返回false表示已被丢弃
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+bool RknnPool<rknnModel, inputType, outputType, Executor>::startFrame(const FrameInfo& info)
+{
+    std::lock_guard<std::mutex> lock(m_resultMtx);
+    return m_waiting.erase(info.seq) > 0;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+typename RknnPool<rknnModel, inputType, outputType, Executor>::OrderKey RknnPool<rknnModel, inputType, outputType, Executor>::orderKey(const FrameInfo& info) const
+{
+    if (m_config.order == ResultOrder::PER_STREAM)
+    {
+        return OrderKey(info.stream, info.streamSeq);
+    }
+    return OrderKey(0, info.seq);
+}
+
+// 执行一帧的一个阶段, func返回false或抛出异常时记录并把帧标记为失败, 返回false.
+// 异常不能离开工作线程: 帧必须仍然完成, 否则get和析构函数会一直等它
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+template <typename Func>
+bool RknnPool<rknnModel, inputType, outputType, Executor>::runGuarded(const char* stage, FrameInfo& info, Func&& func)
+{
+    try
+    {
+        if (func())
+        {
+            return true;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "[RknnPool] Frame " << info.seq << " failed in " << stage << ": " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "[RknnPool] Frame " << info.seq << " failed in " << stage << ": unknown exception" << std::endl;
+    }
+    info.failed = true;
+    return false;
+}
+
+// 一帧完成: 放入重排缓冲区, 把已经轮到的结果交给get或回调
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::complete(const FrameInfo& info, outputType& result, bool dropped)
+{
+    std::vector<Completed> released;
+    std::unique_lock<std::mutex> lock(m_resultMtx);
+    m_unfinished--;
+    if (info.failed)
+    {
+        m_failed++;
+    }
+    else if (!dropped)
+    {
+        m_completed++;
+    }
+    if (m_config.order == ResultOrder::AS_COMPLETED)
+    {
+        if (!dropped)
+        {
+            released.push_back(Completed{info, std::move(result), false});
+        }
+    }
+    else
+    {
+        // 被丢弃的帧也要占位, 否则后面的帧会一直等它
+        OrderKey key = orderKey(info);
+        m_reorder.emplace(key, Completed{info, std::move(result), dropped});
+        uint64_t& next = m_nextDeliver[key.first];
+        auto iter = m_reorder.find(OrderKey(key.first, next));
+        while (iter != m_reorder.end())
+        {
+            if (!iter->second.dropped)
+            {
+                released.push_back(std::move(iter->second));
+            }
+            m_reorder.erase(iter);
+            next++;
+            iter = m_reorder.find(OrderKey(key.first, next));
+        }
+    }
+
+    if (m_callback)
+    {
+        // 在释放m_resultMtx之前取得m_deliverMtx, 后完成的线程不会抢先回调
+        std::unique_lock<std::mutex> deliver(m_deliverMtx);
+        m_undelivered -= released.size();
+        // 持锁通知: 析构函数被唤醒后还要等m_deliverMtx, 回调返回前不会销毁本对象
+        m_resultCv.notify_all();
+        m_spaceCv.notify_all();
+        lock.unlock();
+        for (auto& item : released)
+        {
+            m_callback(item.info, item.result);
+        }
+        return;
+    }
+
+    for (auto& item : released)
+    {
+        m_ready.push_back(std::move(item));
+    }
+    m_resultCv.notify_all();
+}
+
 // 获取推理结果
-template <typename rknnModel, typename inputType, typename outputType>
-int RknnPool<rknnModel, inputType, outputType>::get(outputType& outputData)
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::get(outputType& outputData)
 {
-    std::unique_lock<std::mutex> lock(m_queueMtx);
-    if (m_futures.empty())
-        return 1; // 队列为空
+    FrameInfo info;
+    return get(outputData, info);
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::get(outputType& outputData, FrameInfo& info)
+{
+    return waitResult(outputData, info, -1);
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::tryGet(outputType& outputData)
+{
+    FrameInfo info;
+    return waitResult(outputData, info, 0);
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::tryGet(outputType& outputData, FrameInfo& info)
+{
+    return waitResult(outputData, info, 0);
+}
 
-    auto fut = std::move(m_futures.front());
-    m_futures.pop();
-    lock.unlock();  // 在等待future时释放锁
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::getFor(outputType& outputData, std::chrono::milliseconds timeout)
+{
+    FrameInfo info;
+    return waitResult(outputData, info, timeout.count());
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::getFor(outputType& outputData, FrameInfo& info, std::chrono::milliseconds timeout)
+{
+    return waitResult(outputData, info, timeout.count());
+}
+
+// timeoutMs < 0 时一直等待, 0 时不等待
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::waitResult(outputType& outputData, FrameInfo& info, int64_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_resultMtx);
+    if (m_callback)
+        return 1; // 结果由回调交付
+
+    // 未交付的帧都被丢弃时也要返回
+    auto ready = [this]() { return !m_ready.empty() || m_undelivered == 0; };
+    if (timeoutMs < 0)
+    {
+        m_resultCv.wait(lock, ready);
+    }
+    else if (timeoutMs > 0)
+    {
+        m_resultCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+    }
+    if (m_ready.empty())
+        return 1; // 没有可交付的帧
 
-    outputData = fut.get();
+    Completed& item = m_ready.front();
+    outputData = std::move(item.result);
+    info = item.info;
+    m_ready.pop_front();
+    m_undelivered--;
+    m_spaceCv.notify_all();
     return 0;
 }
 
 // 获取待处理任务数
-template <typename rknnModel, typename inputType, typename outputType>
-size_t RknnPool<rknnModel, inputType, outputType>::getPendingCount()
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+size_t RknnPool<rknnModel, inputType, outputType, Executor>::getPendingCount()
 {
-    std::lock_guard<std::mutex> lock(m_queueMtx);
-    return m_futures.size();
+    std::lock_guard<std::mutex> lock(m_resultMtx);
+    return m_undelivered;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+size_t RknnPool<rknnModel, inputType, outputType, Executor>::getDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(m_resultMtx);
+    return m_dropped;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+size_t RknnPool<rknnModel, inputType, outputType, Executor>::getFailedCount()
+{
+    std::lock_guard<std::mutex> lock(m_resultMtx);
+    return m_failed;
 }
 
 // 析构函数
-template <typename rknnModel, typename inputType, typename outputType>
-RknnPool<rknnModel, inputType, outputType>::~RknnPool()
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+RknnPool<rknnModel, inputType, outputType, Executor>::~RknnPool()
 {
-    // 等待所有任务完成
-    while (true)
+    // 正在创建的实例无法中断, 等它们完成 (就绪的实例可能已追加了专用线程)
+    std::vector<std::thread> initThreads;
     {
-        std::unique_lock<std::mutex> lock(m_queueMtx);
-        if (m_futures.empty())
-            break;
-        auto fut = std::move(m_futures.front());
-        m_futures.pop();
-        lock.unlock();
-        fut.get();  // 等待任务完成
+        std::lock_guard<std::mutex> lock(m_initMtx);
+        initThreads.swap(m_initThreads);
+    }
+    for (auto& thread : initThreads)
+    {
+        thread.join();
+    }
+    if (m_metricsId >= 0)
+    {
+        MetricsRegistry::instance().remove_collector(m_metricsId);
+    }
+    // 等待所有任务完成, 并等待进行中的回调返回
+    {
+        std::unique_lock<std::mutex> lock(m_resultMtx);
+        m_resultCv.wait(lock, [this]() { return m_unfinished == 0; });
+    }
+    {
+        std::lock_guard<std::mutex> deliver(m_deliverMtx);
     }
+    stopPipeline();
     std::cout << "[RknnPool] Pool destroyed" << std::endl;
 }
 
+// 流水线模式: 取得空闲实例后把任务交给预处理阶段
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::putPipeline(inputType inputData, int stream)
+{
+    JobPtr job(new PipelineJob());
+    if (beginFrame(stream, job->info) != 0)
+        return 1;
+
+    int slot;
+    if (!m_freeSlots.pop(slot))
+    {
+        // 正在析构, 按丢弃处理以免析构函数等待这一帧
+        {
+            std::lock_guard<std::mutex> lock(m_resultMtx);
+            if (m_waiting.erase(job->info.seq) > 0)
+                m_undelivered--;
+        }
+        outputType none = outputType();
+        complete(job->info, none, true);
+        return -1;
+    }
+
+    job->input = inputData;
+    job->slot = slot;
+    job->ok = true;
+    m_preQueue.push(std::move(job));
+    return 0;
+}
+
+// 按实例绑定的NPU核心分组, 每个核心一个NPU线程, 同一核心上的rknn_run依次执行
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::startPipeline()
+{
+    std::vector<int> cores;
+    m_slotQueue.resize(m_models.size());
+    for (size_t i = 0; i < m_models.size(); i++)
+    {
+        int core = m_models[i]->core_id();
+        auto iter = std::find(cores.begin(), cores.end(), core);
+        if (iter == cores.end())
+        {
+            cores.push_back(core);
+            iter = cores.end() - 1;
+        }
+        m_slotQueue[i] = (int)(iter - cores.begin());
+        m_freeSlots.push((int)i);
+    }
+
+    for (size_t q = 0; q < cores.size(); q++)
+    {
+        m_npuQueues.push_back(std::make_unique<dpool::BlockingQueue<JobPtr>>());
+    }
+    for (int i = 0; i < std::max(1, m_config.preprocessThreads); i++)
+    {
+        m_stageThreads.emplace_back(&RknnPool::preprocessWorker, this);
+    }
+    for (size_t q = 0; q < cores.size(); q++)
+    {
+        m_stageThreads.emplace_back(&RknnPool::npuWorker, this, (int)q);
+    }
+    for (int i = 0; i < std::max(1, m_config.postprocessThreads); i++)
+    {
+        m_stageThreads.emplace_back(&RknnPool::postprocessWorker, this);
+    }
+    std::cout << "[RknnPool] Pipeline started: " << m_models.size() << " instances on " << cores.size()
+              << " NPU cores" << std::endl;
+}
+
+// 关闭流水线/核心绑定/动态批处理模式的所有队列并等待阶段线程退出
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::stopPipeline()
+{
+    m_freeSlots.close();
+    m_preQueue.close();
+    for (auto& queue : m_npuQueues)
+    {
+        queue->close();
+    }
+    m_postQueue.close();
+    m_batchQueue.close();
+    for (auto& thread : m_stageThreads)
+    {
+        thread.join();
+    }
+    m_stageThreads.clear();
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::preprocessWorker()
+{
+    Tracer::set_thread_name("rknn preprocess");
+    JobPtr job;
+    while (m_preQueue.pop(job))
+    {
+        TraceScope trace("pipeline_preprocess", "pool", (int64_t)job->info.seq);
+        if (!startFrame(job->info))
+        {
+            // 等待期间被DROP_OLDEST丢弃: 归还实例, 只在重排缓冲区占位
+            m_freeSlots.push(job->slot);
+            outputType none = outputType();
+            complete(job->info, none, true);
+            continue;
+        }
+        job->ok = runGuarded("preprocess", job->info,
+                             [&]() { return m_models[job->slot]->stage_preprocess(job->input); });
+        // 输入已写入实例的输入tensor, 尽早释放调用方的帧
+        job->input = inputType();
+        int queueId = m_slotQueue[job->slot];
+        m_npuQueues[queueId]->push(std::move(job));
+    }
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::npuWorker(int queueId)
+{
+    int core = -1;
+    for (size_t i = 0; i < m_slotQueue.size(); i++)
+    {
+        if (m_slotQueue[i] == queueId)
+        {
+            core = m_models[i]->core_id();
+            break;
+        }
+    }
+    Tracer::set_thread_name("rknn npu core " + std::to_string(core));
+
+    JobPtr job;
+    while (m_npuQueues[queueId]->pop(job))
+    {
+        TraceScope trace("pipeline_npu", "pool", (int64_t)job->info.seq);
+        if (job->ok)
+        {
+            job->ok = runGuarded("npu", job->info, [&]() { return m_models[job->slot]->stage_run(); });
+        }
+        m_postQueue.push(std::move(job));
+    }
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::postprocessWorker()
+{
+    Tracer::set_thread_name("rknn postprocess");
+    JobPtr job;
+    while (m_postQueue.pop(job))
+    {
+        TraceScope trace("pipeline_postprocess", "pool", (int64_t)job->info.seq);
+        outputType result = outputType();
+        if (job->ok)
+        {
+            runGuarded("postprocess", job->info, [&]()
+                       {
+                           result = std::get<outputType>(m_models[job->slot]->stage_postprocess());
+                           return true;
+                       });
+        }
+        // 结果已拷出, 先归还实例再交付
+        m_freeSlots.push(job->slot);
+        complete(job->info, result);
+    }
+}
+
+// 核心绑定模式: 选择实例并计入在途任务
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::putAffine(inputType inputData, int stream)
+{
+    JobPtr job(new PipelineJob());
+    if (beginFrame(stream, job->info) != 0)
+        return 1;
+
+    job->input = inputData;
+    job->slot = pickAffineModel();
+    job->ok = true;
+    m_npuQueues[job->slot]->push(std::move(job));
+    return 0;
+}
+
+// 第一个空闲的实例, 都不空闲时取在途任务最少的实例
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::pickAffineModel()
+{
+    std::lock_guard<std::mutex> lock(m_idMtx);
+    int best = 0;
+    int bestLoad = m_inflight[0].load();
+    for (int i = 1; i < (int)m_models.size() && bestLoad > 0; i++)
+    {
+        if (!isReady(i))
+        {
+            continue;
+        }
+        int load = m_inflight[i].load();
+        if (load < bestLoad)
+        {
+            best = i;
+            bestLoad = load;
+        }
+    }
+    m_inflight[best]++;
+    return best;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::startAffine()
+{
+    m_inflight.reset(new std::atomic<int>[m_models.size()]);
+    for (size_t i = 0; i < m_models.size(); i++)
+    {
+        m_inflight[i] = 0;
+        m_npuQueues.push_back(std::make_unique<dpool::BlockingQueue<JobPtr>>());
+    }
+    // 专用线程在实例就绪时(activateModel)启动
+    std::cout << "[RknnPool] Core-affine dispatch started: " << m_models.size() << " dedicated workers"
+              << std::endl;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::affineWorker(int modelId)
+{
+    Tracer::set_thread_name("rknn affine " + std::to_string(modelId) + " (core " +
+                            std::to_string(m_models[modelId]->core_id()) + ")");
+    const std::vector<int>& cpus = m_config.cpuAffinity;
+    if (!cpus.empty())
+    {
+        int cpu = cpus[modelId % cpus.size()];
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        {
+            std::cerr << "[RknnPool] Failed to pin worker " << modelId << " to CPU " << cpu << std::endl;
+        }
+    }
+
+    JobPtr job;
+    while (m_npuQueues[modelId]->pop(job))
+    {
+        TraceScope trace("affine_task", "pool", (int64_t)job->info.seq);
+        outputType result = outputType();
+        bool run = startFrame(job->info);
+        if (run)
+        {
+            runGuarded("infer", job->info, [&]()
+                       {
+                           result = m_models[modelId]->infer(job->input);
+                           return true;
+                       });
+        }
+        job->input = inputType();
+        m_inflight[modelId]--;
+        complete(job->info, result, !run);
+    }
+}
+
+// 动态批处理模式: 帧进入共享队列, 由空闲实例的工作线程成批取走
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::putBatch(inputType inputData, int stream)
+{
+    JobPtr job(new PipelineJob());
+    if (beginFrame(stream, job->info) != 0)
+        return 1;
+
+    job->input = inputData;
+    job->slot = -1;
+    job->ok = true;
+    m_batchQueue.push(std::move(job));
+    return 0;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::startBatcher()
+{
+    // 工作线程在实例就绪时(activateModel)启动
+    std::cout << "[RknnPool] Dynamic batching started: " << m_models.size() << " workers, maxBatch="
+              << m_config.maxBatch << ", model batch=" << m_models[0]->batch_size()
+              << ", deadline=" << m_config.batchDeadlineUs << "us" << std::endl;
+}
+
+// 阻塞取第一帧, 然后在截止时间前尽量凑满maxBatch帧; 截止时间从第一帧取到时开始计算, 低负载时单帧延迟最多增加batchDeadlineUs
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::batchWorker(int modelId)
+{
+    Tracer::set_thread_name("rknn batch " + std::to_string(modelId) + " (core " +
+                            std::to_string(m_models[modelId]->core_id()) + ")");
+    std::vector<JobPtr> jobs;
+    std::vector<inputType> inputs;
+    jobs.reserve(m_config.maxBatch);
+    inputs.reserve(m_config.maxBatch);
+
+    JobPtr job;
+    while (m_batchQueue.pop(job))
+    {
+        jobs.push_back(std::move(job));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(m_config.batchDeadlineUs);
+        while ((int)jobs.size() < m_config.maxBatch && m_batchQueue.popUntil(job, deadline))
+        {
+            jobs.push_back(std::move(job));
+        }
+
+        // 等待期间被DROP_OLDEST丢弃的帧不进入batch
+        for (auto& item : jobs)
+        {
+            item->ok = startFrame(item->info);
+            if (item->ok)
+            {
+                inputs.push_back(std::move(item->input));
+            }
+        }
+
+        std::vector<outputType> results;
+        bool batchOk = true;
+        if (!inputs.empty())
+        {
+            // 区间参数为本批的帧数
+            TraceScope trace("batch_task", "pool", (int64_t)inputs.size());
+            // 以本批第一帧记录失败, 整批的帧都按失败交付
+            auto first = std::find_if(jobs.begin(), jobs.end(), [](const JobPtr& item) { return item->ok; });
+            FrameInfo batchInfo = (*first)->info;
+            batchOk = runGuarded("batch inference", batchInfo, [&]()
+                                 {
+                                     results = m_models[modelId]->infer_batch(inputs);
+                                     return true;
+                                 });
+        }
+        // 结果少于帧数时, 没有对应结果的帧按失败交付, 不与"没有检测结果"混淆
+        if (batchOk && results.size() < inputs.size())
+        {
+            std::cerr << "[RknnPool] Batch inference returned " << results.size() << " results for "
+                      << inputs.size() << " frames" << std::endl;
+        }
+        size_t next = 0;
+        for (auto& item : jobs)
+        {
+            outputType result = outputType();
+            if (item->ok && (!batchOk || next >= results.size()))
+            {
+                item->info.failed = true;
+            }
+            else if (item->ok)
+            {
+                result = std::move(results[next]);
+            }
+            if (item->ok)
+            {
+                next++;
+            }
+            complete(item->info, result, !item->ok);
+        }
+        jobs.clear();
+        inputs.clear();
+    }
+}
+
+// 导出池的帧计数和队列状态; 帧率由抓取方按frames_completed_total的变化率计算
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::collectMetrics(MetricsWriter& writer)
+{
+    uint64_t submitted, completed, dropped, failed, pending, queued, inflight;
+    {
+        std::lock_guard<std::mutex> lock(m_resultMtx);
+        submitted = m_nextSeq;
+        completed = m_completed;
+        dropped = m_dropped;
+        failed = m_failed;
+        pending = m_undelivered;
+        queued = m_waiting.size();
+        inflight = m_unfinished - std::min(m_unfinished, m_waiting.size());
+    }
+    std::string pool = "pool=\"" + std::to_string(m_poolIndex) + "\"";
+    writer.family("rknn_pool_frames_submitted_total", "counter", "Frames accepted by put");
+    writer.sample("rknn_pool_frames_submitted_total", pool, submitted);
+    writer.family("rknn_pool_frames_completed_total", "counter", "Frames that finished inference");
+    writer.sample("rknn_pool_frames_completed_total", pool, completed);
+    writer.family("rknn_pool_frames_dropped_total", "counter", "Frames dropped or refused by the overflow policy");
+    writer.sample("rknn_pool_frames_dropped_total", pool, dropped);
+    writer.family("rknn_pool_frames_failed_total", "counter", "Frames whose inference failed or threw");
+    writer.sample("rknn_pool_frames_failed_total", pool, failed);
+    writer.family("rknn_pool_pending", "gauge", "Frames submitted but not yet delivered");
+    writer.sample("rknn_pool_pending", pool, pending);
+    writer.family("rknn_pool_queue_depth", "gauge", "Frames waiting for a model instance");
+    writer.sample("rknn_pool_queue_depth", pool, queued);
+    writer.family("rknn_pool_inflight", "gauge", "Frames being inferred");
+    writer.sample("rknn_pool_inflight", pool, inflight);
+    writer.family("rknn_pool_models", "gauge", "Model instances in the pool");
+    writer.sample("rknn_pool_models", pool, m_models.size());
+    writer.family("rknn_pool_models_ready", "gauge", "Model instances ready to serve");
+    writer.sample("rknn_pool_models_ready", pool, readyCount());
+}
+
+// 持m_initMtx时调用: 把空的实例槽标记为创建中. 与选出该槽在同一临界区内, 其它线程不会再选中它
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::claimSlot(int modelId)
+{
+    m_slotState[modelId] = SLOT_CREATING;
+    m_creatingNum++;
+}
+
+// 持m_initMtx且已claimSlot时调用: 在后台线程中创建实例
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::launchModel(int modelId)
+{
+    m_initThreads.emplace_back([this, modelId]()
+                               {
+                                   Tracer::set_thread_name("rknn init " + std::to_string(modelId));
+                                   createModel(modelId);
+                               });
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::createModel(int modelId)
+{
+    std::cout << "[RknnPool] Creating shared model instance " << modelId
+              << " (sharing weights via rknn_dup_context)..." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<rknnModel> model;
+    try
+    {
+        TraceScope trace("create_model", "pool", modelId);
+        model = m_factory(m_models[0]->get_context());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "[RknnPool] Failed to create model instance " << modelId << ": " << e.what() << std::endl;
+    }
+    m_slotInitUs[modelId] = std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+    if (!model)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_initMtx);
+            m_creatingNum--;
+            m_slotState[modelId].store(SLOT_FAILED, std::memory_order_release);
+        }
+        m_readyCv.notify_all();
+        return;
+    }
+    m_models[modelId] = model;
+    activateModel(modelId);
+}
+
+// 实例开始接收任务: 启动该实例的专用线程(核心绑定/动态批处理模式)并发布就绪状态
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::activateModel(int modelId)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_initMtx);
+        if (!m_config.pipeline && m_config.coreAffine)
+        {
+            m_stageThreads.emplace_back(&RknnPool::affineWorker, this, modelId);
+        }
+        else if (!m_config.pipeline && m_config.maxBatch > 0)
+        {
+            m_stageThreads.emplace_back(&RknnPool::batchWorker, this, modelId);
+        }
+        if (m_slotState[modelId].load() == SLOT_CREATING)
+        {
+            m_creatingNum--;
+        }
+        m_readyNum++;
+        m_slotState[modelId].store(SLOT_READY, std::memory_order_release);
+    }
+    m_readyCv.notify_all();
+
+    int core = m_models[modelId]->core_id();
+    std::cout << "[RknnPool] Model instance " << modelId << " ready on NPU core " << core << " ("
+              << m_slotInitUs[modelId] / 1000.0 << " ms)" << std::endl;
+    if (m_readyCallback)
+    {
+        m_readyCallback(modelId, core);
+    }
+}
+
+// LAZY模式: 每个已有(含创建中)的实例都有未完成的帧时再增加一个实例
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+void RknnPool<rknnModel, inputType, outputType, Executor>::growOnDemand()
+{
+    size_t unfinished;
+    {
+        std::lock_guard<std::mutex> lock(m_resultMtx);
+        unfinished = m_unfinished;
+    }
+    int next = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_initMtx);
+        if (unfinished < (size_t)(m_readyNum + m_creatingNum))
+        {
+            return;
+        }
+        for (size_t i = 0; i < m_models.size(); i++)
+        {
+            if (m_slotState[i].load() == SLOT_EMPTY)
+            {
+                next = (int)i;
+                claimSlot(next);
+                launchModel(next);
+                break;
+            }
+        }
+    }
+    if (next > 0)
+    {
+        std::cout << "[RknnPool] " << unfinished << " frames in flight, adding model instance " << next << std::endl;
+    }
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+bool RknnPool<rknnModel, inputType, outputType, Executor>::waitReadyImpl(int count, int64_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_initMtx);
+    int target = (count <= 0 || count > (int)m_models.size()) ? (int)m_models.size() : count;
+    auto reachable = [this, target]()
+    {
+        return m_readyNum >= target || m_readyNum + m_creatingNum < target;
+    };
+    if (timeoutMs < 0)
+    {
+        m_readyCv.wait(lock, reachable);
+    }
+    else
+    {
+        m_readyCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), reachable);
+    }
+    return m_readyNum >= target;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+std::vector<ModelStatus> RknnPool<rknnModel, inputType, outputType, Executor>::modelStatus()
+{
+    std::vector<ModelStatus> status(m_models.size());
+    for (size_t i = 0; i < m_models.size(); i++)
+    {
+        int state = m_slotState[i].load(std::memory_order_acquire);
+        status[i].ready = state == SLOT_READY;
+        status[i].failed = state == SLOT_FAILED;
+        if (status[i].ready)
+        {
+            status[i].coreId = m_models[i]->core_id();
+        }
+        if (status[i].ready || status[i].failed)
+        {
+            status[i].initUs = m_slotInitUs[i];
+        }
+    }
+    return status;
+}
+
+template <typename rknnModel, typename inputType, typename outputType, typename Executor>
+int RknnPool<rknnModel, inputType, outputType, Executor>::readyCount()
+{
+    std::lock_guard<std::mutex> lock(m_initMtx);
+    return m_readyNum;
+}
+
 } // namespace rknn
 
 #endif // RKNNPOOL_H
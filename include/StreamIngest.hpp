@@ -0,0 +1,447 @@
+#ifndef STREAMINGEST_H
+#define STREAMINGEST_H
+
+#include "RknnPool.hpp"
+#include "frame_source.hpp"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+
+namespace rknn {
+
+// 单路流的接入参数
+struct StreamOptions
+{
+    // 解码节奏: <0 按来源帧率(未知时不限速), 0 尽快解码, >0 按指定帧率.
+    // 文件来源按帧率解码可以模拟摄像头; 网络流本身按摄像头节奏到达
+    double fps = -1;
+    bool loop = false;          // 读完后从头循环 (来源支持rewind时)
+    int maxInflight = 1;        // 该流同时在推理中的帧数上限, 超过时新帧只更新最新帧槽位
+};
+
+// 单路流的统计, 由StreamIngest::stats取得快照
+struct StreamStats
+{
+    std::string uri;
+    uint64_t decoded = 0;       // 解码的帧数
+    uint64_t dropped = 0;       // 还没送去推理就被更新的帧覆盖的帧数
+    uint64_t inferred = 0;      // 完成推理的帧数
+    double decodeFps = 0;
+    double inferFps = 0;
+    double meanLatencyMs = 0;   // 解码完成到结果交付
+    double maxLatencyMs = 0;
+    bool finished = false;      // 来源已读完且在途帧都已完成
+};
+
+// 多路视频流接入: 每路流一个解码线程, 共享一个RknnPool.
+//
+// 每路流有一个"最新帧"槽位, 解码线程总是覆盖它; 调度线程在该流在途帧数低于maxInflight时取走槽位中的帧提交推理.
+// 推理跟不上时被覆盖的是过时的帧, 延迟不会随积压增长, 一路慢流也不会占满其他流的推理资源.
+// 结果按PER_STREAM顺序交付, 回调在完成推理的线程上调用, 同一路流的回调按解码顺序
+template <typename rknnModel, typename outputType = object_detect_result_list>
+class StreamIngest
+{
+public:
+    using Pool = RknnPool<rknnModel, cv::Mat, outputType>;
+    using ResultCallback = std::function<void(int stream, const cv::Mat& frame, outputType& result)>;
+
+    // modelPath/threadNum/level: 同RknnPool
+    StreamIngest(const std::string& modelPath, int threadNum, logger::Level level);
+    ~StreamIngest();
+
+    StreamIngest(const StreamIngest&) = delete;
+    StreamIngest& operator=(const StreamIngest&) = delete;
+
+    // 推理池配置, 需在init之前调用. order固定为PER_STREAM, capacity由各流的maxInflight代替
+    void setConfig(const PoolConfig& config);
+
+    // 需在start之前调用
+    void setResultCallback(ResultCallback callback) { m_callback = std::move(callback); }
+
+    // 添加一路流, 返回流编号; 需在start之前调用. uri的格式见create_frame_source, 无法打开时返回-1
+    int addStream(std::unique_ptr<FrameSource> source, const StreamOptions& options = StreamOptions());
+    int addStream(const std::string& uri, const StreamOptions& options = StreamOptions());
+
+    // 初始化推理池, 参数转发给RknnPool::init
+    template <typename... Args>
+    int init(Args&&... args);
+
+    // 启动解码线程和调度线程
+    void start();
+
+    // 等待所有流读完并完成推理 (循环播放的流不会结束, 用stop)
+    void wait();
+
+    // 停止解码, 等待在途帧完成; 槽位中未提交的帧计入dropped
+    void stop();
+
+    int streamNum() const { return (int)m_streams.size(); }
+    StreamStats stats(int stream);
+
+private:
+    struct Pending
+    {
+        cv::Mat frame;
+        int64_t decodedUs;
+    };
+
+    struct Stream
+    {
+        std::unique_ptr<FrameSource> source;
+        StreamOptions options;
+        std::thread decoder;
+
+        // 以下由m_mtx保护
+        Pending latest;                 // 最新帧槽位
+        bool hasLatest = false;
+        std::deque<Pending> inflight;   // 已提交未交付, 按提交顺序
+        bool eof = false;
+        StreamStats stats;
+        int64_t lastDecodeUs = 0;
+        int64_t lastResultUs = 0;
+        int64_t latencySumUs = 0;
+    };
+
+    static int64_t nowUs();
+    bool dispatchable(const Stream& stream) const;
+    void updateFinished(Stream& stream);
+    void decodeWorker(int id);
+    void dispatchWorker();
+    void onResult(const FrameInfo& info, outputType& result);
+
+    std::vector<std::unique_ptr<Stream>> m_streams;
+    ResultCallback m_callback;
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::atomic<bool> m_stop;
+    bool m_started;
+    int64_t m_startUs;
+    std::thread m_dispatcher;
+
+    // 最后声明, 最先析构: 析构时等待在途帧的回调, 回调会访问上面的状态
+    Pool m_pool;
+};
+
+template <typename rknnModel, typename outputType>
+StreamIngest<rknnModel, outputType>::StreamIngest(const std::string& modelPath, int threadNum, logger::Level level)
+    : m_stop(false), m_started(false), m_startUs(0), m_pool(modelPath, threadNum, level)
+{
+    setConfig(PoolConfig());
+}
+
+template <typename rknnModel, typename outputType>
+StreamIngest<rknnModel, outputType>::~StreamIngest()
+{
+    stop();
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::setConfig(const PoolConfig& config)
+{
+    PoolConfig poolConfig = config;
+    poolConfig.order = ResultOrder::PER_STREAM;
+    poolConfig.capacity = 0;
+    m_pool.setConfig(poolConfig);
+}
+
+template <typename rknnModel, typename outputType>
+int StreamIngest<rknnModel, outputType>::addStream(std::unique_ptr<FrameSource> source, const StreamOptions& options)
+{
+    if (!source)
+    {
+        return -1;
+    }
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->stats.uri = source->uri();
+    stream->source = std::move(source);
+    stream->options = options;
+    stream->options.maxInflight = std::max(1, options.maxInflight);
+    m_streams.push_back(std::move(stream));
+    return (int)m_streams.size() - 1;
+}
+
+template <typename rknnModel, typename outputType>
+int StreamIngest<rknnModel, outputType>::addStream(const std::string& uri, const StreamOptions& options)
+{
+    return addStream(create_frame_source(uri), options);
+}
+
+template <typename rknnModel, typename outputType>
+template <typename... Args>
+int StreamIngest<rknnModel, outputType>::init(Args&&... args)
+{
+    m_pool.setResultCallback([this](const FrameInfo& info, outputType& result) { onResult(info, result); });
+    return m_pool.init(std::forward<Args>(args)...);
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::start()
+{
+    m_started = true;
+    m_startUs = nowUs();
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        m_streams[i]->decoder = std::thread(&StreamIngest::decodeWorker, this, (int)i);
+    }
+    m_dispatcher = std::thread(&StreamIngest::dispatchWorker, this);
+    std::cout << "[StreamIngest] Started " << m_streams.size() << " streams" << std::endl;
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_cv.wait(lock, [this]()
+              {
+                  for (auto& stream : m_streams)
+                  {
+                      if (!stream->stats.finished)
+                          return false;
+                  }
+                  return true;
+              });
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::stop()
+{
+    if (!m_started)
+    {
+        return;
+    }
+    m_started = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& stream : m_streams)
+    {
+        stream->decoder.join();
+    }
+    m_dispatcher.join();
+
+    // 调度线程已退出, 槽位中剩下的帧不会再提交
+    std::unique_lock<std::mutex> lock(m_mtx);
+    for (auto& stream : m_streams)
+    {
+        if (stream->hasLatest)
+        {
+            stream->hasLatest = false;
+            stream->latest.frame.release();
+            stream->stats.dropped++;
+        }
+        stream->eof = true;
+        updateFinished(*stream);
+    }
+    m_cv.wait(lock, [this]()
+              {
+                  for (auto& stream : m_streams)
+                  {
+                      if (!stream->inflight.empty())
+                          return false;
+                  }
+                  return true;
+              });
+}
+
+template <typename rknnModel, typename outputType>
+StreamStats StreamIngest<rknnModel, outputType>::stats(int stream)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Stream& s = *m_streams[stream];
+    StreamStats result = s.stats;
+    if (s.lastDecodeUs > m_startUs)
+    {
+        result.decodeFps = s.stats.decoded * 1e6 / (s.lastDecodeUs - m_startUs);
+    }
+    if (s.lastResultUs > m_startUs)
+    {
+        result.inferFps = s.stats.inferred * 1e6 / (s.lastResultUs - m_startUs);
+    }
+    if (s.stats.inferred > 0)
+    {
+        result.meanLatencyMs = s.latencySumUs / 1000.0 / s.stats.inferred;
+    }
+    return result;
+}
+
+template <typename rknnModel, typename outputType>
+int64_t StreamIngest<rknnModel, outputType>::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+template <typename rknnModel, typename outputType>
+bool StreamIngest<rknnModel, outputType>::dispatchable(const Stream& stream) const
+{
+    return stream.hasLatest && (int)stream.inflight.size() < stream.options.maxInflight;
+}
+
+// 读完、槽位为空且在途帧都已交付时该流结束. 调用时持有m_mtx
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::updateFinished(Stream& stream)
+{
+    if (stream.eof && !stream.hasLatest && stream.inflight.empty() && !stream.stats.finished)
+    {
+        stream.stats.finished = true;
+        m_cv.notify_all();
+    }
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::decodeWorker(int id)
+{
+    Stream& stream = *m_streams[id];
+    Tracer::set_thread_name("decode " + std::to_string(id) + " " + stream.source->uri());
+    double fps = stream.options.fps < 0 ? stream.source->fps() : stream.options.fps;
+    auto interval = std::chrono::microseconds(fps > 0 ? (int64_t)(1e6 / fps) : 0);
+    auto next = std::chrono::steady_clock::now();
+
+    cv::Mat frame;
+    while (!m_stop)
+    {
+        // 槽位持有上一帧的引用, 每次解码到新的Mat, 不覆盖正在等待或推理中的帧
+        frame = cv::Mat();
+        {
+            TraceScope trace("decode", "ingest", id);
+            if (!stream.source->read(frame))
+            {
+                if (!stream.options.loop || !stream.source->rewind() || !stream.source->read(frame))
+                {
+                    break;
+                }
+            }
+        }
+        int64_t decodedUs = nowUs();
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (stream.hasLatest)
+            {
+                stream.stats.dropped++;
+            }
+            stream.latest.frame = frame;
+            stream.latest.decodedUs = decodedUs;
+            stream.hasLatest = true;
+            stream.stats.decoded++;
+            stream.lastDecodeUs = decodedUs;
+        }
+        m_cv.notify_all();
+
+        if (interval.count() > 0)
+        {
+            // 落后超过一帧时不追赶, 从当前时间重新计时
+            next += interval;
+            auto now = std::chrono::steady_clock::now();
+            if (next < now)
+            {
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    stream.eof = true;
+    updateFinished(stream);
+}
+
+// 轮询各流, 把可以提交的最新帧交给推理池; put在锁外调用 (流水线模式下可能等待空闲实例)
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::dispatchWorker()
+{
+    Tracer::set_thread_name("stream dispatcher");
+    size_t first = 0;
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (true)
+    {
+        m_cv.wait(lock, [this]()
+                  {
+                      if (m_stop)
+                          return true;
+                      for (auto& stream : m_streams)
+                      {
+                          if (dispatchable(*stream))
+                              return true;
+                      }
+                      return false;
+                  });
+        if (m_stop)
+        {
+            return;
+        }
+
+        // 每轮从不同的流开始, 推理池忙时各流轮流得到空闲实例
+        for (size_t n = 0; n < m_streams.size(); n++)
+        {
+            int id = (int)((first + n) % m_streams.size());
+            Stream& stream = *m_streams[id];
+            if (!dispatchable(stream))
+            {
+                continue;
+            }
+            // 先登记在途, 结果可能在put返回前就交付
+            stream.inflight.push_back(std::move(stream.latest));
+            stream.hasLatest = false;
+            cv::Mat frame = stream.inflight.back().frame;
+            lock.unlock();
+            int ret = m_pool.put(frame, id);
+            lock.lock();
+            if (ret != 0)
+            {
+                // 只有本线程提交该流的帧, 被拒绝的帧仍在队尾
+                stream.inflight.pop_back();
+                stream.stats.dropped++;
+                updateFinished(stream);
+            }
+        }
+        first++;
+    }
+}
+
+template <typename rknnModel, typename outputType>
+void StreamIngest<rknnModel, outputType>::onResult(const FrameInfo& info, outputType& result)
+{
+    Stream& stream = *m_streams[info.stream];
+    cv::Mat frame;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        // PER_STREAM顺序: 交付顺序与该流的提交顺序一致
+        const Pending& done = stream.inflight.front();
+        frame = done.frame;
+
+        int64_t now = nowUs();
+        int64_t latency = now - done.decodedUs;
+        stream.stats.inferred++;
+        stream.latencySumUs += latency;
+        stream.stats.maxLatencyMs = std::max(stream.stats.maxLatencyMs, latency / 1000.0);
+        stream.lastResultUs = now;
+    }
+
+    if (m_callback)
+    {
+        m_callback(info.stream, frame, result);
+    }
+
+    // 回调返回后才让出在途名额: 回调慢时该流的新帧在槽位中被覆盖, stop也会等回调返回
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        stream.inflight.pop_front();
+        updateFinished(stream);
+    }
+    m_cv.notify_all();
+}
+
+} // namespace rknn
+
+#endif // STREAMINGEST_H
@@ -1,57 +1,79 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <atomic>
 #include <cassert>
 #include <condition_variable>
 #include <functional>
 #include <future>
-#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
-#include <unordered_map>
+#include <vector>
+#include "InlineTask.hpp"
+#include "MpmcQueue.hpp"
+#include "trace.hpp"
 
 namespace dpool
 {
 
+    // 固定线程数的线程池, 任务队列为有界无锁MPMC环形队列.
+    //
+    // 任务以InlineTask保存在队列槽位里: post()提交的小任务不做堆分配,
+    // submit()只剩std::packaged_task共享状态的分配.
+    // 队列满时提交线程先自旋再阻塞等待空位(背压), 不会无限增长.
+    // 注意这与基于std::queue的旧实现(见MutexThreadPool)不同: 旧实现的submit从不阻塞.
+    // 容量由构造参数capacity设置(向上取整为2的幂, 默认DEFAULT_CAPACITY), RknnPool通过PoolConfig::taskCapacity设置.
+    // 在任务内部提交子任务时, 队列满会使工作线程也阻塞, 全部阻塞就会死锁: 这种用法需要按最大积压设置容量.
+    // 空闲线程短暂自旋后在条件变量上休眠, 只有存在休眠线程时提交方才会加锁唤醒
     class ThreadPool
     {
     public:
         using MutexGuard = std::lock_guard<std::mutex>;
         using UniqueLock = std::unique_lock<std::mutex>;
         using Thread = std::thread;
-        using ThreadID = std::thread::id;
-        using Task = std::function<void()>;
+        using Task = InlineTask;
+
+        static constexpr size_t DEFAULT_CAPACITY = 1024;
 
         ThreadPool()
             : ThreadPool(Thread::hardware_concurrency())
         {
         }
 
-        explicit ThreadPool(size_t maxThreads)
+        explicit ThreadPool(size_t maxThreads, size_t capacity = DEFAULT_CAPACITY)
             : quit_(false),
-              currentThreads_(0),
-              idleThreads_(0),
-              maxThreads_(maxThreads)
+              sleepingWorkers_(0),
+              blockedProducers_(0),
+              tasks_(capacity)
         {
+            if (maxThreads == 0)
+            {
+                maxThreads = 1;
+            }
+            threads_.reserve(maxThreads);
+            for (size_t i = 0; i < maxThreads; ++i)
+            {
+                threads_.emplace_back(&ThreadPool::worker, this);
+            }
         }
 
         // disable the copy operations
         ThreadPool(const ThreadPool &) = delete;
         ThreadPool &operator=(const ThreadPool &) = delete;
 
+        // 已提交的任务全部执行完后线程才退出
         ~ThreadPool()
         {
             {
                 MutexGuard guard(mutex_);
-                quit_ = true;
+                quit_.store(true);
             }
-            cv_.notify_all();
+            workerCv_.notify_all();
 
             for (auto &elem : threads_)
             {
-                assert(elem.second.joinable());
-                elem.second.join();
+                assert(elem.joinable());
+                elem.join();
             }
         }
 
@@ -59,109 +81,156 @@ namespace dpool
         auto submit(Func &&func, Ts &&...params)
             -> std::future<typename std::result_of<Func(Ts...)>::type>
         {
-            auto execute = std::bind(std::forward<Func>(func), std::forward<Ts>(params)...);
-
             using ReturnType = typename std::result_of<Func(Ts...)>::type;
             using PackagedTask = std::packaged_task<ReturnType()>;
 
-            auto task = std::make_shared<PackagedTask>(std::move(execute));
-            auto result = task->get_future();
+            PackagedTask task(std::bind(std::forward<Func>(func), std::forward<Ts>(params)...));
+            auto result = task.get_future();
+            post(std::move(task));
+            return result;
+        }
 
-            MutexGuard guard(mutex_);
-            assert(!quit_);
+        // 提交不需要返回值的任务, 可调用对象不超过InlineTask::INLINE_SIZE时没有堆分配
+        template <typename Func>
+        void post(Func &&func)
+        {
+            assert(!quit_.load(std::memory_order_relaxed));
+            push(Task(std::forward<Func>(func)));
+        }
+
+        size_t threadsNum() const
+        {
+            return threads_.size();
+        }
 
-            tasks_.emplace([task]()
-                           { (*task)(); });
-            if (idleThreads_ > 0)
+        size_t capacity() const
+        {
+            return tasks_.capacity();
+        }
+
+        // 队列中等待执行的任务数 (近似值)
+        size_t pendingNum() const
+        {
+            return tasks_.sizeApprox();
+        }
+
+    private:
+        void push(Task &&task)
+        {
+            if (!tasks_.tryPush(std::move(task)))
             {
-                cv_.notify_one();
+                waitPush(std::move(task));
             }
-            else if (currentThreads_ < maxThreads_)
+
+            // 与worker中++sleepingWorkers_之后的fence配对: 要么这里看到休眠线程, 要么它看到新任务
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepingWorkers_.load(std::memory_order_relaxed) > 0)
             {
-                Thread t(&ThreadPool::worker, this);
-                assert(threads_.find(t.get_id()) == threads_.end());
-                threads_[t.get_id()] = std::move(t);
-                ++currentThreads_;
+                {
+                    MutexGuard guard(mutex_);
+                }
+                workerCv_.notify_one();
             }
-
-             return result;
         }
 
-        size_t threadsNum() const
+        // 队列满: 先让出CPU重试, 仍然满则阻塞到有线程取走任务
+        void waitPush(Task &&task)
         {
-            MutexGuard guard(mutex_);
-            return currentThreads_;
+            for (int i = 0; i < SPIN_COUNT; ++i)
+            {
+                std::this_thread::yield();
+                if (tasks_.tryPush(std::move(task)))
+                {
+                    return;
+                }
+            }
+
+            UniqueLock uniqueLock(mutex_);
+            blockedProducers_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            producerCv_.wait(uniqueLock, [this, &task]()
+                             { return tasks_.tryPush(std::move(task)); });
+            blockedProducers_.fetch_sub(1);
         }
 
-    private:
-        void worker()
+        bool pop(Task &task)
         {
-            while (true)
+            if (!tasks_.tryPop(task))
+            {
+                return false;
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (blockedProducers_.load(std::memory_order_relaxed) > 0)
             {
-                Task task;
                 {
-                    UniqueLock uniqueLock(mutex_);
-                    ++idleThreads_;
-                    auto hasTimedout = !cv_.wait_for(uniqueLock,
-                                                     std::chrono::seconds(WAIT_SECONDS),
-                                                     [this]()
-                                                     {
-                                                         return quit_ || !tasks_.empty();
-                                                     });
-                    --idleThreads_;
-                    if (tasks_.empty())
-                    {
-                        if (quit_)
-                        {
-                            --currentThreads_;
-                            return;
-                        }
-                        if (hasTimedout)
-                        {
-                            --currentThreads_;
-                            joinFinishedThreads();
-                            finishedThreadIDs_.emplace(std::this_thread::get_id());
-                            return;
-                        }
-                    }
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
+                    MutexGuard guard(mutex_);
                 }
-                task();
+                producerCv_.notify_one();
             }
+            return true;
         }
 
-        void joinFinishedThreads()
+        // 记录时间线时每个任务是工作线程上的一个区间
+        void runTask(Task &task)
         {
-            while (!finishedThreadIDs_.empty())
+            rknn::TraceScope trace("task", "dpool");
+            task();
+            task.reset();
+        }
+
+        void worker()
+        {
+            rknn::Tracer::set_thread_name("thread pool worker");
+            Task task;
+            while (true)
             {
-                auto id = std::move(finishedThreadIDs_.front());
-                finishedThreadIDs_.pop();
-                auto iter = threads_.find(id);
+                if (pop(task))
+                {
+                    runTask(task);
+                    continue;
+                }
 
-                assert(iter != threads_.end());
-                assert(iter->second.joinable());
+                bool found = false;
+                for (int i = 0; i < SPIN_COUNT && !found; ++i)
+                {
+                    std::this_thread::yield();
+                    found = pop(task);
+                }
+                if (found)
+                {
+                    runTask(task);
+                    continue;
+                }
 
-                iter->second.join();
-                threads_.erase(iter);
+                UniqueLock uniqueLock(mutex_);
+                sleepingWorkers_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                workerCv_.wait(uniqueLock, [this]()
+                               { return quit_.load() || tasks_.sizeApprox() > 0; });
+                sleepingWorkers_.fetch_sub(1);
+                if (quit_.load() && tasks_.sizeApprox() == 0)
+                {
+                    return;
+                }
             }
         }
 
-        static constexpr size_t WAIT_SECONDS = 2;
+        static constexpr int SPIN_COUNT = 64;
 
-        bool quit_;
-        size_t currentThreads_;
-        size_t idleThreads_;
-        size_t maxThreads_;
+        std::atomic<bool> quit_;
+        std::atomic<int> sleepingWorkers_;
+        std::atomic<int> blockedProducers_;
 
-        mutable std::mutex mutex_;
-        std::condition_variable cv_;
-        std::queue<Task> tasks_;
-        std::queue<ThreadID> finishedThreadIDs_;
-        std::unordered_map<ThreadID, Thread> threads_;
+        std::mutex mutex_;
+        std::condition_variable workerCv_;
+        std::condition_variable producerCv_;
+        MpmcQueue<Task> tasks_;
+        std::vector<Thread> threads_;
     };
 
-    constexpr size_t ThreadPool::WAIT_SECONDS;
+    constexpr size_t ThreadPool::DEFAULT_CAPACITY;
+    constexpr int ThreadPool::SPIN_COUNT;
 
 } // namespace dpool
 
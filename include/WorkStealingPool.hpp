@@ -0,0 +1,450 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "InlineTask.hpp"
+#include "MpmcQueue.hpp"
+#include "trace.hpp"
+
+namespace dpool
+{
+
+    // Chase-Lev工作窃取双端队列 (固定容量, 元素为指针).
+    // 只有所属线程调用push/pop (在bottom端, 后进先出), 其他线程调用steal (在top端, 先进先出),
+    // 只有争抢最后一个元素时才需要CAS
+    template <typename T>
+    class ChaseLevDeque
+    {
+    public:
+        explicit ChaseLevDeque(size_t capacity)
+            : top_(0),
+              bottom_(0)
+        {
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+            mask_ = size - 1;
+            buffer_.reset(new std::atomic<T *>[size]);
+        }
+
+        ChaseLevDeque(const ChaseLevDeque &) = delete;
+        ChaseLevDeque &operator=(const ChaseLevDeque &) = delete;
+
+        // 仅所属线程调用, 队满返回false
+        bool push(T *item)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            if (b - t > (int64_t)mask_)
+            {
+                return false;
+            }
+            buffer_[b & mask_].store(item, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // 仅所属线程调用, 取最近push的元素, 为空返回nullptr
+        T *pop()
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T *item = buffer_[b & mask_].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                // 最后一个元素, 与steal争抢
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed))
+                {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        // 任意线程调用, 取最早push的元素, 为空或争抢失败返回nullptr
+        T *steal()
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b)
+            {
+                return nullptr;
+            }
+            T *item = buffer_[t & mask_].load(std::memory_order_relaxed);
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return item;
+        }
+
+        bool empty() const
+        {
+            int64_t b = bottom_.load(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_seq_cst);
+            return t >= b;
+        }
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        alignas(CACHE_LINE) std::atomic<int64_t> top_;
+        alignas(CACHE_LINE) std::atomic<int64_t> bottom_;
+        std::unique_ptr<std::atomic<T *>[]> buffer_;
+        size_t mask_;
+    };
+
+    // 工作窃取线程池, submit/post接口与ThreadPool相同, 可直接作为RknnPool的执行器.
+    //
+    // 每个工作线程有自己的Chase-Lev双端队列: 在任务内部提交的子任务放入当前线程的队列(本地优先,
+    // 不与其他线程竞争), 外部线程提交的任务进入共享的有界MPMC注入队列(满时背压, 同ThreadPool).
+    // 线程取任务的顺序: 本地队列(后进先出, 缓存友好) -> 注入队列 -> 随机选择其他线程窃取(先进先出).
+    // 本地队列的元素是InlineTask节点指针, 节点由各工作线程缓存复用; 本地队列满时退回注入队列
+    class WorkStealingPool
+    {
+    public:
+        using MutexGuard = std::lock_guard<std::mutex>;
+        using UniqueLock = std::unique_lock<std::mutex>;
+        using Thread = std::thread;
+        using Task = InlineTask;
+
+        static constexpr size_t DEFAULT_CAPACITY = 1024;
+        static constexpr size_t LOCAL_CAPACITY = 256;
+
+        WorkStealingPool()
+            : WorkStealingPool(Thread::hardware_concurrency())
+        {
+        }
+
+        explicit WorkStealingPool(size_t maxThreads, size_t capacity = DEFAULT_CAPACITY)
+            : quit_(false),
+              sleepingWorkers_(0),
+              blockedProducers_(0),
+              injected_(capacity)
+        {
+            if (maxThreads == 0)
+            {
+                maxThreads = 1;
+            }
+            freeNodes_.resize(maxThreads);
+            for (size_t i = 0; i < maxThreads; ++i)
+            {
+                deques_.emplace_back(new ChaseLevDeque<Task>(LOCAL_CAPACITY));
+                freeNodes_[i].reserve(LOCAL_CAPACITY);
+            }
+            threads_.reserve(maxThreads);
+            for (size_t i = 0; i < maxThreads; ++i)
+            {
+                threads_.emplace_back(&WorkStealingPool::worker, this, i);
+            }
+        }
+
+        // disable the copy operations
+        WorkStealingPool(const WorkStealingPool &) = delete;
+        WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+        // 已提交的任务(包括执行中产生的子任务)全部执行完后线程才退出
+        ~WorkStealingPool()
+        {
+            {
+                MutexGuard guard(mutex_);
+                quit_.store(true);
+            }
+            workerCv_.notify_all();
+
+            for (auto &elem : threads_)
+            {
+                assert(elem.joinable());
+                elem.join();
+            }
+            for (auto &nodes : freeNodes_)
+            {
+                for (Task *node : nodes)
+                {
+                    delete node;
+                }
+            }
+        }
+
+        template <typename Func, typename... Ts>
+        auto submit(Func &&func, Ts &&...params)
+            -> std::future<typename std::result_of<Func(Ts...)>::type>
+        {
+            using ReturnType = typename std::result_of<Func(Ts...)>::type;
+            using PackagedTask = std::packaged_task<ReturnType()>;
+
+            PackagedTask task(std::bind(std::forward<Func>(func), std::forward<Ts>(params)...));
+            auto result = task.get_future();
+            post(std::move(task));
+            return result;
+        }
+
+        template <typename Func>
+        void post(Func &&func)
+        {
+            Task task(std::forward<Func>(func));
+            // 在本池的工作线程中提交: 放入该线程的本地队列
+            if (currentPool() == this)
+            {
+                size_t index = currentIndex();
+                Task *local = allocNode(index);
+                *local = std::move(task);
+                if (deques_[index]->push(local))
+                {
+                    wakeWorker();
+                    return;
+                }
+                task = std::move(*local);
+                freeNode(index, local);
+            }
+            assert(!quit_.load(std::memory_order_relaxed) || currentPool() == this);
+            pushInjected(std::move(task));
+            wakeWorker();
+        }
+
+        size_t threadsNum() const
+        {
+            return threads_.size();
+        }
+
+        size_t capacity() const
+        {
+            return injected_.capacity();
+        }
+
+    private:
+        static WorkStealingPool *&currentPool()
+        {
+            static thread_local WorkStealingPool *pool = nullptr;
+            return pool;
+        }
+
+        static size_t &currentIndex()
+        {
+            static thread_local size_t index = 0;
+            return index;
+        }
+
+        void wakeWorker()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepingWorkers_.load(std::memory_order_relaxed) > 0)
+            {
+                {
+                    MutexGuard guard(mutex_);
+                }
+                workerCv_.notify_one();
+            }
+        }
+
+        // 注入队列满: 先让出CPU重试, 仍然满则阻塞到有线程取走任务
+        void pushInjected(Task &&task)
+        {
+            if (injected_.tryPush(std::move(task)))
+            {
+                return;
+            }
+            // 工作线程不能阻塞等待自己消费的队列, 直接执行
+            if (currentPool() == this)
+            {
+                task();
+                return;
+            }
+            for (int i = 0; i < SPIN_COUNT; ++i)
+            {
+                std::this_thread::yield();
+                if (injected_.tryPush(std::move(task)))
+                {
+                    return;
+                }
+            }
+
+            UniqueLock uniqueLock(mutex_);
+            blockedProducers_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            producerCv_.wait(uniqueLock, [this, &task]()
+                             { return injected_.tryPush(std::move(task)); });
+            blockedProducers_.fetch_sub(1);
+        }
+
+        bool popInjected(Task &task)
+        {
+            if (!injected_.tryPop(task))
+            {
+                return false;
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (blockedProducers_.load(std::memory_order_relaxed) > 0)
+            {
+                {
+                    MutexGuard guard(mutex_);
+                }
+                producerCv_.notify_one();
+            }
+            return true;
+        }
+
+        // 按 本地队列 -> 注入队列 -> 窃取 的顺序找一个任务
+        bool findTask(size_t index, uint32_t &seed, Task &task)
+        {
+            Task *local = deques_[index]->pop();
+            if (local == nullptr && !popInjected(task))
+            {
+                size_t num = deques_.size();
+                // xorshift随机选择起始受害者, 依次尝试其他线程
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                size_t start = seed % num;
+                for (size_t i = 0; i < num && local == nullptr; ++i)
+                {
+                    size_t victim = (start + i) % num;
+                    if (victim != index)
+                    {
+                        local = deques_[victim]->steal();
+                    }
+                }
+                if (local == nullptr)
+                {
+                    return false;
+                }
+            }
+            if (local != nullptr)
+            {
+                task = std::move(*local);
+                freeNode(index, local);
+            }
+            return true;
+        }
+
+        // 本地队列节点的缓存, 每个工作线程只访问自己的缓存; 被窃取的节点归还到执行线程的缓存
+        Task *allocNode(size_t index)
+        {
+            std::vector<Task *> &nodes = freeNodes_[index];
+            if (nodes.empty())
+            {
+                return new Task();
+            }
+            Task *node = nodes.back();
+            nodes.pop_back();
+            return node;
+        }
+
+        void freeNode(size_t index, Task *node)
+        {
+            std::vector<Task *> &nodes = freeNodes_[index];
+            if (nodes.size() < nodes.capacity())
+            {
+                nodes.push_back(node);
+            }
+            else
+            {
+                delete node;
+            }
+        }
+
+        bool hasPendingTasks() const
+        {
+            if (injected_.sizeApprox() > 0)
+            {
+                return true;
+            }
+            for (auto &deque : deques_)
+            {
+                if (!deque->empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 记录时间线时每个任务是工作线程上的一个区间
+        void runTask(Task &task)
+        {
+            rknn::TraceScope trace("task", "dpool");
+            task();
+            task.reset();
+        }
+
+        void worker(size_t index)
+        {
+            currentPool() = this;
+            currentIndex() = index;
+            rknn::Tracer::set_thread_name("work-stealing worker " + std::to_string(index));
+            uint32_t seed = (uint32_t)index * 2654435761u + 1;
+
+            Task task;
+            while (true)
+            {
+                bool found = findTask(index, seed, task);
+                for (int i = 0; i < SPIN_COUNT && !found; ++i)
+                {
+                    std::this_thread::yield();
+                    found = findTask(index, seed, task);
+                }
+                if (found)
+                {
+                    runTask(task);
+                    continue;
+                }
+
+                UniqueLock uniqueLock(mutex_);
+                sleepingWorkers_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                workerCv_.wait(uniqueLock, [this]()
+                               { return quit_.load() || hasPendingTasks(); });
+                sleepingWorkers_.fetch_sub(1);
+                if (quit_.load() && !hasPendingTasks())
+                {
+                    return;
+                }
+            }
+        }
+
+        static constexpr int SPIN_COUNT = 64;
+
+        std::atomic<bool> quit_;
+        std::atomic<int> sleepingWorkers_;
+        std::atomic<int> blockedProducers_;
+
+        std::mutex mutex_;
+        std::condition_variable workerCv_;
+        std::condition_variable producerCv_;
+        MpmcQueue<Task> injected_;
+        std::vector<std::unique_ptr<ChaseLevDeque<Task>>> deques_;
+        std::vector<std::vector<Task *>> freeNodes_;
+        std::vector<Thread> threads_;
+    };
+
+    constexpr size_t WorkStealingPool::DEFAULT_CAPACITY;
+    constexpr size_t WorkStealingPool::LOCAL_CAPACITY;
+    constexpr int WorkStealingPool::SPIN_COUNT;
+
+} // namespace dpool
+
+#endif /* WORKSTEALINGPOOL_H */
@@ -0,0 +1,175 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rknn_api.h"
+#include "model_cache.hpp"
+
+namespace rknn {
+
+    // 推理后端类型, 在模型构造时通过ModelConfig选择
+    enum class BackendType{
+        NPU,        // librknnrt, RK3588 NPU
+        CPU         // CPU参考实现: 合成YOLO11/YOLOv5检测头或回放录制的输出张量, 不需要NPU
+    };
+
+    // Model调用的推理runtime接口, 与rknn_api一一对应, 返回值含义相同 (RKNN_SUCC / RKNN_ERR_*).
+    // 每个后端对象持有一个上下文, 析构时销毁
+    class Backend
+    {
+    public:
+        virtual ~Backend() = default;
+
+        // 从模型数据创建上下文 (rknn_init)
+        virtual int init(const ModelBlob& blob) = 0;
+        // 与ctx_in共享权重创建上下文 (rknn_dup_context); ctx_in必须来自同类后端的context(),
+        // CpuBackend拒绝不是活着的CpuBackend上下文的ctx_in (RKNN_ERR_CTX_INVALID)
+        virtual int dup(rknn_context* ctx_in) = 0;
+        virtual rknn_context* context() = 0;
+
+        virtual int set_core_mask(rknn_core_mask core_mask) = 0;
+        virtual int query(rknn_query_cmd cmd, void* info, uint32_t size) = 0;
+        virtual int inputs_set(uint32_t n_inputs, rknn_input inputs[]) = 0;
+        virtual int run() = 0;
+        virtual int outputs_get(uint32_t n_outputs, rknn_output outputs[]) = 0;
+        virtual int outputs_release(uint32_t n_outputs, rknn_output outputs[]) = 0;
+
+        // 零拷贝: 分配并绑定输入/输出内存
+        virtual rknn_tensor_mem* create_mem(uint32_t size) = 0;
+        virtual int destroy_mem(rknn_tensor_mem* mem) = 0;
+        virtual int set_io_mem(rknn_tensor_mem* mem, rknn_tensor_attr* attr) = 0;
+
+        virtual const char* name() const = 0;
+    };
+
+#ifndef RKNN_CPU_RUNTIME
+    // librknnrt. 以RKNN_CPU_RUNTIME构建(没有librknnrt)时不可用, create_backend回退到CpuBackend
+    class NpuBackend : public Backend
+    {
+    public:
+        ~NpuBackend() override;
+
+        int init(const ModelBlob& blob) override;
+        int dup(rknn_context* ctx_in) override;
+        rknn_context* context() override { return &m_ctx; }
+
+        int set_core_mask(rknn_core_mask core_mask) override;
+        int query(rknn_query_cmd cmd, void* info, uint32_t size) override;
+        int inputs_set(uint32_t n_inputs, rknn_input inputs[]) override;
+        int run() override;
+        int outputs_get(uint32_t n_outputs, rknn_output outputs[]) override;
+        int outputs_release(uint32_t n_outputs, rknn_output outputs[]) override;
+
+        rknn_tensor_mem* create_mem(uint32_t size) override;
+        int destroy_mem(rknn_tensor_mem* mem) override;
+        int set_io_mem(rknn_tensor_mem* mem, rknn_tensor_attr* attr) override;
+
+        const char* name() const override { return "npu"; }
+
+    private:
+        rknn_context m_ctx = 0;
+    };
+#endif
+
+    struct CpuModel;
+
+    // CPU参考实现, 用于没有NPU的环境(x86 CI、基准测试)运行完整的预处理/线程池/后处理链路.
+    //
+    // 模型数据是文本描述时按描述构造模型, 否则(真正的.rknn文件)按640x640 int8 YOLO11处理.
+    // 描述为 key=value 的行, #开头为注释:
+    //   model=yolo11|yolov5     检测头结构 (YOLO11: 每个stride一组box/score/score_sum, YOLOv5: 每个stride一个输出)
+    //   input=640x640 batch=1 classes=80 dfl=16 score_sum=1
+    //   dtype=int8|fp16|fp32    输出类型; int8可用box_zp/box_scale/score_zp/score_scale指定量化参数
+    //   objects=8 seed=1        每帧放置的目标数与随机种子, 同一描述每次生成相同的输出
+    //   replay=DIR              回放TensorRecorder录制的输出 (相对于描述文件所在目录), 忽略以上结构参数.
+    //                           dup出的各实例共用一个帧序号, 按run的先后依次取录制的帧, 与录制时的编号方式一致
+    //   frames=N                回放的帧数, 由TensorRecorder写入; 缺少时读到第一个不存在的帧文件为止
+    //   run_us=20000            每次run占用模拟NPU核心的时间
+    //   core_us=20000,21000,24000   各核心的run时间, 覆盖run_us
+    //   jitter_us=0             在run时间上增加[0, jitter_us)的确定性抖动
+    //
+    // 模拟3个NPU核心: run按core mask占用一个空闲核心, 都忙时等待, 多实例并发时的排队与NPU一致
+    class CpuBackend : public Backend
+    {
+    public:
+        ~CpuBackend() override;
+
+        int init(const ModelBlob& blob) override;
+        int dup(rknn_context* ctx_in) override;
+        rknn_context* context() override { return &m_ctx; }
+
+        int set_core_mask(rknn_core_mask core_mask) override;
+        int query(rknn_query_cmd cmd, void* info, uint32_t size) override;
+        int inputs_set(uint32_t n_inputs, rknn_input inputs[]) override;
+        int run() override;
+        int outputs_get(uint32_t n_outputs, rknn_output outputs[]) override;
+        int outputs_release(uint32_t n_outputs, rknn_output outputs[]) override;
+
+        rknn_tensor_mem* create_mem(uint32_t size) override;
+        int destroy_mem(rknn_tensor_mem* mem) override;
+        int set_io_mem(rknn_tensor_mem* mem, rknn_tensor_attr* attr) override;
+
+        const char* name() const override { return "cpu"; }
+
+        // 进程内析构时仍未destroy_mem的内存数: 零拷贝内存必须在销毁上下文之前释放, 否则计入这里
+        static uint64_t leaked_mems();
+
+    private:
+        void attach(std::shared_ptr<const CpuModel> model);
+        void write_output(uint32_t index, bool want_float, void* dst) const;
+
+        rknn_context m_ctx = 0;     // 指向本对象, dup时据此找到共享的模型
+        std::shared_ptr<const CpuModel> m_model;
+        int m_coreMask = RKNN_NPU_CORE_AUTO;
+        uint32_t m_rng = 1;
+        uint64_t m_frame = 0;       // 最近一次run在共享模型的所有run中的序号, 回放时选择帧
+        bool m_ran = false;
+        std::vector<std::vector<uint8_t>> m_inputs;     // inputs_set拷入的数据
+        std::vector<rknn_tensor_mem*> m_outputMems;     // set_io_mem绑定的输出内存
+        std::vector<bool> m_outputMemFloat;             // 绑定的输出内存要求float32
+        std::vector<rknn_tensor_mem*> m_mems;           // 本上下文create_mem分配且未销毁的内存
+    };
+
+    std::unique_ptr<Backend> create_backend(BackendType type);
+
+    // 录制每次推理的输出张量, 供CpuBackend回放 (在设备上录制, 在x86上复现后处理的真实输入).
+    //
+    // 目录下写出:
+    //   tensors.txt        输入/输出张量属性
+    //   frame_NNNNNN.bin   每次run的全部输出依次拼接 (量化模型为int8原始值, 否则为float32)
+    //   model.spec         回放该目录的模型描述, frames为帧数, run_us为录制时run的平均耗时
+    // 同一目录在进程内只有一个录制器, 线程池的各个实例共用, 帧号按写入顺序连续编号.
+    // 第一次打开时删除目录中上一次录制的帧文件和model.spec
+    class TensorRecorder
+    {
+    public:
+        ~TensorRecorder();
+
+        TensorRecorder(const TensorRecorder&) = delete;
+        TensorRecorder& operator=(const TensorRecorder&) = delete;
+
+        // 取得dir的录制器, 第一次打开时写出张量属性; 属性与已有录制器不一致或目录不可写时返回nullptr.
+        // max_frames <= 0 时不限制帧数
+        static std::shared_ptr<TensorRecorder> open(const std::string& dir, const rknn_tensor_attr* inputs,
+                                                    uint32_t n_inputs, const rknn_tensor_attr* outputs,
+                                                    uint32_t n_outputs, bool want_float, int max_frames);
+
+        void write(const rknn_output* outputs, uint32_t n_outputs, int64_t run_us);
+        int frames();
+
+    private:
+        TensorRecorder() = default;
+
+        std::mutex m_mtx;
+        std::string m_dir;
+        std::string m_layout;           // tensors.txt的内容, 用于检查各实例的属性一致
+        std::vector<uint32_t> m_sizes;  // 每个输出写出的字节数
+        int m_maxFrames = 0;
+        int m_frames = 0;
+        int64_t m_runUs = 0;
+    };
+
+} // namespace rknn
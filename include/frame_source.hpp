@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/videoio.hpp"
+
+namespace rknn {
+
+    // 视频流接入的帧来源, 每路流由一个解码线程独占调用read
+    class FrameSource
+    {
+    public:
+        virtual ~FrameSource() = default;
+
+        // 读取下一帧BGR图像 (CV_8UC3), 读完或出错时返回false
+        virtual bool read(cv::Mat& frame) = 0;
+        // 回到第一帧, 用于循环播放; 不支持时返回false (如RTSP)
+        virtual bool rewind() = 0;
+        // 来源自带的帧率, 未知时为0
+        virtual double fps() const { return 0; }
+        virtual const std::string& uri() const = 0;
+    };
+
+    // cv::VideoCapture: 视频文件或 rtsp:// 等网络流
+    class VideoSource : public FrameSource
+    {
+    public:
+        explicit VideoSource(const std::string& uri);
+
+        bool read(cv::Mat& frame) override;
+        bool rewind() override;
+        double fps() const override;
+        const std::string& uri() const override { return m_uri; }
+        bool is_opened() const { return m_capture.isOpened(); }
+
+    private:
+        std::string m_uri;
+        cv::VideoCapture m_capture;
+    };
+
+    // 目录下的图片按文件名顺序作为帧, 无法解码的文件跳过
+    class ImageDirSource : public FrameSource
+    {
+    public:
+        explicit ImageDirSource(const std::string& dir);
+
+        bool read(cv::Mat& frame) override;
+        bool rewind() override;
+        const std::string& uri() const override { return m_dir; }
+
+    private:
+        std::string m_dir;
+        std::vector<std::string> m_files;
+        size_t m_next = 0;
+    };
+
+    // 裸帧文件: 连续存放的width*height的BGR888帧, 没有文件头 (如 ffmpeg -pix_fmt bgr24 -f rawvideo 的输出)
+    class RawFrameSource : public FrameSource
+    {
+    public:
+        RawFrameSource(const std::string& path, int width, int height);
+        ~RawFrameSource();
+
+        bool read(cv::Mat& frame) override;
+        bool rewind() override;
+        const std::string& uri() const override { return m_path; }
+
+    private:
+        std::string m_path;
+        int m_width;
+        int m_height;
+        FILE* m_file = nullptr;
+    };
+
+    // 按uri创建帧来源:
+    //   dir:<目录>             ImageDirSource
+    //   raw:<宽>x<高>:<文件>   RawFrameSource
+    //   其他                   VideoSource (文件路径、rtsp://...)
+    // 无法打开时返回nullptr
+    std::unique_ptr<FrameSource> create_frame_source(const std::string& uri);
+
+} // namespace rknn
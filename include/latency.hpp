@@ -0,0 +1,86 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+#include "trace.hpp"
+
+namespace rknn {
+
+    // 推理过程中计时的阶段
+    enum class Stage : int {
+        PREPROCESS = 0,     // letterbox/颜色转换, 写入输入tensor
+        INPUTS_SET,         // rknn_inputs_set (零拷贝模式下没有)
+        RUN,                // rknn_run, NPU执行
+        OUTPUTS_GET,        // rknn_outputs_get (零拷贝模式下没有)
+        POSTPROCESS,        // 解码候选框 + NMS
+        NMS,                // 后处理中的NMS部分
+        TOTAL,              // 一次inference/inference_batch调用
+        COUNT
+    };
+
+    const char* stage_name(Stage stage);
+
+    // 某阶段耗时分布的快照, 单位微秒
+    struct LatencySummary {
+        uint64_t count = 0;
+        double mean_us = 0;
+        double p50_us = 0;
+        double p90_us = 0;
+        double p99_us = 0;
+        double max_us = 0;
+    };
+
+    // 各阶段的耗时直方图, 进程内全局.
+    //
+    // 直方图为HDR式的对数-线性分桶: 每个2的幂区间分为32个线性子桶, 相对误差不超过约3%, 覆盖1ns到约18分钟.
+    // 每个记录线程有自己的分片, record只做无竞争的relaxed读写, 没有锁和原子RMW; summary时合并所有分片.
+    // 关闭时(默认)StageTimer只读relaxed原子量 (LatencyStats和Tracer各一次), 不读时钟
+    class LatencyStats {
+    public:
+        static void set_enabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        static void record(Stage stage, uint64_t ns);
+        static LatencySummary summary(Stage stage);
+        // 清空所有分片; 与record并发时个别计数可能不被清掉
+        static void reset();
+        // 按阶段打印count/mean/p50/p90/p99/max
+        static void report();
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+    // 作用域计时: 构造时开始, 析构时记入对应阶段; Tracer开启时同时记录为时间线上的区间
+    class StageTimer {
+    public:
+        explicit StageTimer(Stage stage)
+            : m_stage(stage), m_latency(LatencyStats::enabled()), m_trace(Tracer::enabled()) {
+            if(m_latency || m_trace){
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+        ~StageTimer() {
+            if(m_latency || m_trace){
+                auto end = std::chrono::steady_clock::now();
+                if(m_latency){
+                    LatencyStats::record(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_start).count());
+                }
+                if(m_trace){
+                    Tracer::record(stage_name(m_stage), "model", m_start, end);
+                }
+            }
+        }
+
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+
+    private:
+        Stage m_stage;
+        bool m_latency;
+        bool m_trace;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+} // namespace rknn
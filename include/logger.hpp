@@ -2,14 +2,47 @@
 #define __LOGGER_HPP__
 #include <string>
 #include <stdarg.h>
+#include <stdint.h>
+#include <atomic>
 #include <memory>
 
-#define LOGF(...) logger::Logger::__log_info(logger::Level::FATAL, __VA_ARGS__)
-#define LOGE(...) logger::Logger::__log_info(logger::Level::ERROR, __VA_ARGS__)
-#define LOGW(...) logger::Logger::__log_info(logger::Level::WARN,  __VA_ARGS__)
-#define LOG(...)  logger::Logger::__log_info(logger::Level::INFO,  __VA_ARGS__)
-#define LOGV(...) logger::Logger::__log_info(logger::Level::VERB,  __VA_ARGS__)
-#define LOGD(...) logger::Logger::__log_info(logger::Level::DEBUG, __VA_ARGS__)
+// 编译期日志级别上限 (0=FATAL ... 5=DEBUG), 高于它的LOG*调用连同参数求值一起被编译器删除.
+// 由CMake的LOGGER_COMPILE_LEVEL设置; ERROR/FATAL总会编译 (会结束进程)
+#ifndef LOGGER_COMPILE_LEVEL
+#define LOGGER_COMPILE_LEVEL 5
+#endif
+
+// 运行期未启用的级别在调用处判断, 不做格式化.
+// log_instance()是调用处可见的Logger: 类外为全局的nullptr(使用全局级别),
+// 持有Logger的类(如rknn::Model)定义同名成员函数后, 其成员函数中的LOG*使用实例的级别
+#define LOGGER_LOG(level, ...) \
+    do { \
+        if ((int)(level) <= LOGGER_COMPILE_LEVEL && logger::Logger::enabled(log_instance(), level)) \
+            logger::Logger::__log(log_instance(), level, 0, __VA_ARGS__); \
+    } while (0)
+
+// 限速: 同一调用处每interval_ms毫秒最多输出一条, 下一条输出时附带期间被抑制的条数
+#define LOGGER_LOG_EVERY(level, interval_ms, ...) \
+    do { \
+        if ((int)(level) <= LOGGER_COMPILE_LEVEL && logger::Logger::enabled(log_instance(), level)) { \
+            static logger::RateLimiter __logger_limiter(interval_ms); \
+            uint32_t __logger_suppressed = 0; \
+            if (__logger_limiter.allow(__logger_suppressed)) \
+                logger::Logger::__log(log_instance(), level, __logger_suppressed, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOGF(...) logger::Logger::__log(log_instance(), logger::Level::FATAL, 0, __VA_ARGS__)
+#define LOGE(...) logger::Logger::__log(log_instance(), logger::Level::ERROR, 0, __VA_ARGS__)
+#define LOGW(...) LOGGER_LOG(logger::Level::WARN,  __VA_ARGS__)
+#define LOG(...)  LOGGER_LOG(logger::Level::INFO,  __VA_ARGS__)
+#define LOGV(...) LOGGER_LOG(logger::Level::VERB,  __VA_ARGS__)
+#define LOGD(...) LOGGER_LOG(logger::Level::DEBUG, __VA_ARGS__)
+
+#define LOGW_EVERY(interval_ms, ...) LOGGER_LOG_EVERY(logger::Level::WARN,  interval_ms, __VA_ARGS__)
+#define LOG_EVERY(interval_ms, ...)  LOGGER_LOG_EVERY(logger::Level::INFO,  interval_ms, __VA_ARGS__)
+#define LOGV_EVERY(interval_ms, ...) LOGGER_LOG_EVERY(logger::Level::VERB,  interval_ms, __VA_ARGS__)
+#define LOGD_EVERY(interval_ms, ...) LOGGER_LOG_EVERY(logger::Level::DEBUG, interval_ms, __VA_ARGS__)
 
 #define DGREEN    "\033[1;36m"
 #define BLUE      "\033[1;34m"
@@ -31,19 +64,65 @@ enum class Level : int32_t{
     DEBUG = 5
 };
 
+// 日志默认异步输出: 调用线程把格式化后的消息写入本线程的无锁环形缓冲区后立即返回,
+// 后台线程定期取出各线程已写入的消息写到stdout. 同一线程的消息保持调用顺序; 不同线程的消息只在同一批内按序号排序,
+// 晚一批取出的消息可能排在另一线程更晚调用的消息之后. 缓冲区写满时丢弃新消息并在输出中报告丢弃条数.
+// 单条消息超过1KB时截断并以...结尾
+// ERROR/FATAL先同步输出全部待写消息再结束进程; 进程正常退出时也会写完
 class Logger {
 
 public:
+    // 默认使用全局级别
     Logger();
     Logger(Level level);
+
+    Level level() const { return (Level)m_level.load(std::memory_order_relaxed); }
+    void set_level(Level level) { m_level.store((int32_t)level, std::memory_order_relaxed); }
+
+    // instance为nullptr时按全局级别判断
+    static bool enabled(const Logger* instance, Level level) {
+        int32_t max = instance != nullptr ? instance->m_level.load(std::memory_order_relaxed)
+                                          : s_level.load(std::memory_order_relaxed);
+        return (int32_t)level <= max;
+    }
+
+    // 全局级别, 用于不属于任何实例的日志
+    static Level global_level() { return (Level)s_level.load(std::memory_order_relaxed); }
+    static void set_global_level(Level level) { s_level.store((int32_t)level, std::memory_order_relaxed); }
+
+    // 关闭异步时在调用线程同步写stdout (与printf混用需要严格顺序时)
+    static void set_async(bool async);
+    // 等待此前各线程写入的消息全部输出
+    static void flush();
+
     static void __log_info(Level level, const char* format, ...);
+    // suppressed > 0 时在消息后附带被限速抑制的条数
+    static void __log(const Logger* instance, Level level, uint32_t suppressed, const char* format, ...);
+
+private:
+    std::atomic<int32_t> m_level;
+    static std::atomic<int32_t> s_level;
+};
+
+// LOG*_EVERY的调用处状态
+class RateLimiter {
+
+public:
+    explicit RateLimiter(int interval_ms);
+    // 距上次放行不少于间隔时返回true, 并取出期间被抑制的条数
+    bool allow(uint32_t& suppressed);
 
 private:
-    static Level m_level;
+    int64_t m_intervalNs;
+    std::atomic<int64_t> m_nextNs;
+    std::atomic<uint32_t> m_suppressed;
 };
 
 std::shared_ptr<Logger> create_logger(Level level);
 
 } // namespace logger
 
+// 类外的LOG*使用全局级别, 见LOGGER_LOG
+inline const logger::Logger* log_instance() { return nullptr; }
+
 #endif //__LOGGER_HPP__
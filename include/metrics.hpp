@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rknn {
+
+    // 单调递增计数
+    class Counter {
+    public:
+        void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    // 可增可减的当前值
+    class Gauge {
+    public:
+        void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+        void add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value{0};
+    };
+
+    // 固定上界的分桶计数 (Prometheus histogram), observe无锁
+    class Histogram {
+    public:
+        explicit Histogram(const std::vector<double>& bounds);
+
+        void observe(double value);
+
+        const std::vector<double>& bounds() const { return m_bounds; }
+        // 第i个桶(值<=bounds[i])的计数, i==bounds.size()为+Inf桶; 不累计
+        uint64_t bucket(size_t i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+        uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+        double sum() const { return m_sum.load(std::memory_order_relaxed); }
+
+    private:
+        std::vector<double> m_bounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<double> m_sum{0};
+    };
+
+    // 按指标族收集样本并输出Prometheus文本格式 (0.0.4).
+    // labels为不带花括号的标签列表, 如 core="0",stage="rknn_run"
+    class MetricsWriter {
+    public:
+        // 声明指标族; 同名的族只保留第一次的说明, 各来源的样本合并到一起
+        void family(const std::string& name, const char* type, const std::string& help);
+        // name为族名加后缀 (如 _bucket/_sum/_count), 不加后缀时与族名相同
+        void sample(const std::string& family, const std::string& name, const std::string& labels, double value);
+        void sample(const std::string& family, const std::string& labels, double value) {
+            sample(family, family, labels, value);
+        }
+
+        std::string text() const;
+
+    private:
+        struct Family {
+            std::string type;
+            std::string help;
+            std::string samples;
+        };
+        std::map<std::string, Family> m_families;
+    };
+
+    // 进程内的指标注册表.
+    //
+    // 热路径上的指标(Counter/Gauge/Histogram)在构造时注册一次并保存指针, 更新只是relaxed原子操作;
+    // 同名同标签重复注册返回同一个对象, 注册后不会销毁.
+    // 生命周期不固定的对象(如RknnPool)注册collector, 在导出时读取自身状态, 析构时注销
+    class MetricsRegistry {
+    public:
+        using Collector = std::function<void(MetricsWriter&)>;
+
+        static MetricsRegistry& instance();
+
+        Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+        Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+        Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                             const std::string& labels = "");
+
+        // 返回的编号用于remove_collector
+        int add_collector(Collector collector);
+        void remove_collector(int id);
+
+        // 文本格式的全部指标, 包括LatencyStats的各阶段耗时 (开启时)
+        std::string expose();
+        // 先写临时文件再rename, 读取方不会看到写了一半的内容 (如node_exporter的textfile目录)
+        bool write_file(const std::string& path);
+
+    private:
+        MetricsRegistry() = default;
+
+        template <typename Metric>
+        struct Entry {
+            std::string name;
+            std::string help;
+            std::string labels;
+            std::unique_ptr<Metric> metric;
+        };
+
+        std::mutex m_mtx;
+        std::vector<Entry<Counter>> m_counters;
+        std::vector<Entry<Gauge>> m_gauges;
+        std::vector<Entry<Histogram>> m_histograms;
+        std::map<int, Collector> m_collectors;
+        int m_nextCollector = 0;
+    };
+
+    // 内嵌的HTTP监听, GET /metrics 返回MetricsRegistry::expose(). 单线程依次处理连接, 只用于抓取
+    class MetricsServer {
+    public:
+        MetricsServer() = default;
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        // 默认只监听回环地址; port为0时由系统分配, 用port()取得. 失败返回false
+        bool start(int port, const std::string& address = "127.0.0.1");
+        void stop();
+        int port() const { return m_port; }
+
+    private:
+        void serve();
+        void handle(int fd);
+
+        int m_listenFd = -1;
+        int m_port = 0;
+        std::atomic<bool> m_running{false};
+        std::thread m_thread;
+    };
+
+} // namespace rknn
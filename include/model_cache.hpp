@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <sys/types.h>
+#include <memory>
+#include <string>
+
+namespace rknn {
+
+    // 只读的.rknn模型文件内容. 优先mmap (MAP_PRIVATE, 写入不会回到文件), 失败时读入堆内存
+    class ModelBlob {
+    public:
+        ~ModelBlob();
+
+        ModelBlob(const ModelBlob&) = delete;
+        ModelBlob& operator=(const ModelBlob&) = delete;
+
+        // rknn_init的参数不是const, 映射为可写的私有页, 运行时即使写入也只复制该页
+        void* data() const { return m_data; }
+        uint32_t size() const { return (uint32_t)m_size; }
+        const std::string& path() const { return m_path; }
+        bool mapped() const { return m_mapped; }
+
+    private:
+        friend class ModelCache;
+        ModelBlob() = default;
+
+        void* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_mapped = false;
+        std::string m_path;
+
+        // 打开时的文件标识, 用于判断文件是否被替换或修改
+        dev_t m_dev = 0;
+        ino_t m_ino = 0;
+        int64_t m_mtimeNs = 0;
+    };
+
+    // 按文件缓存模型数据, 同时存在的持有者共享同一份映射.
+    //
+    // 缓存只保存弱引用: 持有者(用rknn_init创建上下文的Model)全部销毁后映射随之释放,
+    // 之后再acquire会重新读取文件. 反复创建/销毁线程池时每次都会重新映射; 需要常驻时,
+    // 调用方自己保留一个acquire返回的shared_ptr.
+    // 每次acquire都会stat文件, 大小/修改时间/inode变化时重新映射, 已发出的旧数据仍对其持有者有效.
+    // 更新模型文件应写新文件后rename覆盖; 原地改写已映射的文件会改变旧映射的内容
+    class ModelCache {
+    public:
+        struct Stats {
+            uint64_t loads = 0;     // 实际打开并映射/读取文件的次数
+            uint64_t hits = 0;      // 复用已映射数据的次数
+        };
+
+        // 失败时返回nullptr
+        static std::shared_ptr<const ModelBlob> acquire(const std::string& path);
+        static Stats stats();
+    };
+
+} // namespace rknn
@@ -0,0 +1,46 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace detector {
+
+    // 类别相关的NMS方式
+    enum class NmsMode{
+        PER_CLASS,      // 按类别分桶, 只在同类框之间计算IoU
+        CLASS_OFFSET    // 每个类别的框平移到互不重叠的区域, 所有框一起做一次NMS
+    };
+
+    // 批量NMS: 按分数只排序一次, 按类别分桶(计数排序, 保持分数顺序),
+    // 框坐标和面积按桶顺序以SoA存放, IoU测试一次处理4个框 (aarch64为NEON, x86为SSE).
+    // 按全局分数顺序贪心保留, 达到max_output个时提前结束.
+    // IoU与CalculateOverlap()相同, 采用像素坐标 +1 的约定.
+    class NmsEngine
+    {
+    public:
+        // 按最大候选数和类别数预留空间, 之后run不再分配内存
+        void reserve(int max_candidates, int class_num);
+
+        // boxes:      每个候选4个float: left, top, width, height
+        // scores:     候选分数 (不会被修改)
+        // class_ids:  候选类别, 取值[0, class_num)
+        // max_output: 最多保留的框数, <=0 时不限制
+        // 返回保留的框数, 保留的候选下标按分数从高到低由keep()取得
+        int run(const float* boxes, const float* scores, const int* class_ids, int count,
+                float iou_threshold, int max_output = 0, NmsMode mode = NmsMode::PER_CLASS);
+
+        int keep(int k) const { return m_keep[k]; }
+
+    private:
+        // 用桶内第p个框抑制[begin, end)中与它IoU超过阈值的框
+        void suppress(int p, int begin, int end, float iou_threshold);
+
+    private:
+        std::vector<int>   m_order;       // 按分数从高到低的候选下标
+        std::vector<int>   m_classEnd;    // 分桶后为每个类别的桶在桶数组中的结束位置
+        std::vector<int>   m_bucketPos;   // 候选在桶数组中的位置
+        std::vector<float> m_x1, m_y1, m_x2, m_y2, m_area;  // 按桶顺序的SoA坐标
+        std::vector<int>   m_removed;     // 按桶顺序, 非0表示已被抑制
+        std::vector<int>   m_keep;
+    };
+
+} // namespace detector
@@ -0,0 +1,106 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace detector {
+
+    // 量化DFL解码: YOLO11的box分支每条边输出dfl_len个bin, 结果为softmax后的期望值.
+    //
+    // softmax对平移不变, 先减去同一条边的最大量化值, 权重即为 exp(-(q_max - q) * scale),
+    // 与zp无关且差值只有256种取值, 初始化时按输出tensor的scale建表, 解码时无需反量化和exp().
+    // 4条边的累加使用SIMD (aarch64为NEON, x86为SSE), 每个lane对应一条边.
+    class DflDecoder
+    {
+    public:
+        static constexpr int DFL_LEN_MAX = 64;
+
+        DflDecoder() = default;
+
+        // scale: box输出tensor的量化scale; dfl_len超过DFL_LEN_MAX时返回false
+        bool init(float scale, int dfl_len);
+
+        // tensor:   该grid cell在第0个DFL通道的位置, 相邻通道间隔grid_len个元素
+        // box:      输出4条边到中心的距离 (以stride为单位)
+        void decode(const int8_t* tensor, int grid_len, float box[4]) const;
+        void decode(const uint8_t* tensor, int grid_len, float box[4]) const;
+
+        int dfl_len() const { return m_dflLen; }
+
+    private:
+        template <typename T>
+        void decode_impl(const T* tensor, int grid_len, float box[4]) const;
+
+    private:
+        float m_expLut[256] = {0};
+        int   m_dflLen = 0;
+    };
+
+    // 类别分数扫描: 输出tensor按通道存放(CHW), 同一类别通道内相邻元素是相邻的grid cell.
+    //
+    // 以一组cell为SIMD lane (int8/uint8每次16个, fp32每次4个), 逐类别通道取最大值并记录类别号,
+    // 只输出最大分数超过阈值的cell. 同分时取较小的类别号, 与逐cell标量循环的结果一致.
+    // 提供了gate通道(YOLO11的score_sum, YOLOv5的objectness)时, 整组cell都低于gate阈值就跳过全部类别通道.
+    template <typename T>
+    class ClassScoreScanner
+    {
+    public:
+        // 按最大grid_len预留输出空间, 之后scan不再分配内存
+        void reserve(int grid_len);
+
+        // scores:         第0个类别通道, 相邻类别通道间隔grid_len个元素
+        // threshold:      只输出最大分数 > threshold 的cell
+        // gate:           可选的快速过滤通道, gate[cell] < gate_threshold的cell跳过, 为nullptr时不过滤
+        // 返回输出的cell数, 按cell序号递增排列
+        int scan(const T* scores, int class_num, int grid_len, T threshold,
+                 const T* gate = nullptr, T gate_threshold = T());
+
+        // scan输出的第k个cell
+        int cell(int k) const { return m_cells[k]; }
+        int class_id(int k) const { return m_classIds[k]; }
+        T score(int k) const { return m_scores[k]; }
+
+    private:
+        void push(int cell, int class_id, T score);
+
+    private:
+        std::vector<int> m_cells;
+        std::vector<int> m_classIds;
+        std::vector<T>   m_scores;
+        int m_count = 0;
+    };
+
+    // 有界候选收集: 只保留分数最高的top_k个候选 (最小堆, 堆顶为当前第top_k高的分数).
+    // 候选满了以后, accept()可在解码box之前判断新候选能否进入, 让后处理的工作量与场景密度无关.
+    // 候选按SoA存放, 可直接交给NmsEngine
+    class CandidateCollector
+    {
+    public:
+        // 按最大候选数预留空间, 之后不再分配内存
+        void reserve(int capacity);
+
+        // 开始新的一帧, top_k<=0 或超过预留容量时按预留容量处理
+        void reset(int top_k);
+
+        // 分数为score的候选能否进入top_k
+        bool accept(float score) const {
+            return m_count < m_topK || (m_topK > 0 && score > m_scores[m_heap[0]]);
+        }
+
+        // box: left, top, width, height; 不能进入top_k的候选被忽略, 返回是否保留
+        bool push(float left, float top, float width, float height, float score, int class_id);
+
+        int size() const { return m_count; }
+        const float* boxes() const { return m_boxes.data(); }
+        const float* scores() const { return m_scores.data(); }
+        const int* class_ids() const { return m_classIds.data(); }
+
+    private:
+        std::vector<float> m_boxes;
+        std::vector<float> m_scores;
+        std::vector<int>   m_classIds;
+        std::vector<int>   m_heap;   // 候选槽位组成的最小堆
+        int m_topK = 0;
+        int m_count = 0;
+    };
+
+} // namespace detector
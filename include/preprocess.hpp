@@ -0,0 +1,144 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include "opencv2/core/core.hpp"
+
+#include "type.hpp"
+
+namespace rknn {
+
+    // 融合的letterbox预处理: 一次读取源图像, 同时完成双线性缩放、边缘填充和BGR->RGB通道交换,
+    // 直接写入NHWC目标缓冲区(可以是预分配内存或零拷贝绑定的输入tensor)
+    //
+    // 缩放按OpenCV通用INTER_LINEAR实现的定点运算(Q11系数)进行, 与该路径的 letterbox() + cv::cvtColor(BGR2RGB) 结果一致.
+    // OpenCV构建启用Carotene/IPP等HAL时resize可能走其他实现, 舍入不同, 个别像素可能相差1.
+    // aarch64上垂直插值、2倍缩小和通道交换使用NEON, 其他平台使用可被编译器自动向量化的标量实现.
+    // 插值表按源尺寸缓存, 尺寸不变时每帧不产生堆分配.
+    class LetterboxKernel
+    {
+    public:
+        LetterboxKernel() = default;
+
+        // src:        BGR888源图像 (CV_8UC3)
+        // dst:        目标缓冲区, 大小至少为 dst_stride * dst_h
+        // dst_stride: 目标每行字节数 (零拷贝时为 w_stride * 3)
+        // scale:      缩放比例, 与letterbox()的scale含义相同
+        // pads:       输出的四周填充像素数
+        // swap_rb:    是否交换R/B通道 (模型输入为RGB时为true)
+        // 源图像不是CV_8UC3时返回false
+        bool run(const cv::Mat& src, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                 float scale, image_rect_t& pads, uint8_t pad_value = 128, bool swap_rb = true);
+
+        // YUV420SP (NV12/NV21) 源图像: YUV->RGB(BT.601, 与cv::cvtColor一致)与缩放在同一遍中完成,
+        // 只转换被采样到的源像素, 不产生整帧的BGR中间图像. width_stride/height_stride为0时按width/height处理
+        bool run_yuv420sp(const image_buffer_t& src, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                          float scale, image_rect_t& pads, uint8_t pad_value = 128);
+
+    private:
+        // 计算填充量并填充边缘, 返回缩放后的尺寸
+        bool fill_pads(int src_w, int src_h, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                       float scale, image_rect_t& pads, uint8_t pad_value, int& resized_w, int& resized_h);
+
+        // 按源尺寸、缩放后的尺寸和缩放比例预计算插值表, 参数不变时复用
+        void build_tables(int src_w, int src_h, int resized_w, int resized_h, float scale);
+
+        // 对一行源图像做水平插值, 结果为放大了2048倍的定点值, 通道顺序已按需交换
+        void hresize_row(const uint8_t* src_row, int* dst_row, bool swap_rb) const;
+        void hresize_row_yuv(const uint8_t* y_row, const uint8_t* uv_row, int* dst_row, bool nv21) const;
+
+        // 垂直插值主循环, fetch_row(源行号, 输出行)负责生成一行水平插值结果
+        template <typename FetchRow>
+        void resize_linear(FetchRow fetch_row, uint8_t* dst, int dst_stride);
+
+        void resize_area_2x(const cv::Mat& src, uint8_t* dst, int dst_stride, bool swap_rb, int resized_w, int resized_h);
+        void copy_swap(const cv::Mat& src, uint8_t* dst, int dst_stride, bool swap_rb);
+
+    private:
+        int m_srcW = 0;
+        int m_srcH = 0;
+        int m_resizedW = 0;
+        int m_resizedH = 0;
+        float m_scale = 0;
+
+        std::vector<int>   m_xofs;   // 每个目标像素对应的两个源像素列号
+        std::vector<short> m_alpha;  // 水平插值系数 (Q11)
+        std::vector<int>   m_yofs;   // 每个目标行对应的源行
+        std::vector<short> m_beta;   // 垂直插值系数 (Q11)
+        std::vector<int>   m_rowBuf; // 两行水平插值结果
+    };
+
+    // 预处理后端类型, 在模型构造时通过ModelConfig选择
+    enum class PreprocessType{
+        OPENCV,     // letterbox() + cv::cvtColor, CPU参考实现 (cv::resize每帧在内部分配临时缓冲区)
+        FUSED,      // LetterboxKernel, CPU单次遍历
+        RGA         // RGA硬件完成缩放、填充与颜色转换
+    };
+
+    // 预处理接口: 将源图像按scale缩放并居中填充到模型输入尺寸的RGB888图像
+    class Preprocessor
+    {
+    public:
+        virtual ~Preprocessor() = default;
+
+        // src:    BGR888源图像
+        // dst:    模型输入尺寸的目标图像 (CV_8UC3, 允许行跨度, 可映射零拷贝绑定的输入内存)
+        // pads:   输出的四周填充像素数
+        // dst_fd: dst对应的dma-buf fd, 没有时为-1 (RGA可据此避免虚拟地址映射)
+        virtual bool run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                         uint8_t pad_value, int dst_fd = -1) = 0;
+
+        // 相机/解码器输出的image_buffer_t (RGB888, NV12, NV21), 含行跨度和dma-buf fd
+        virtual bool run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                uint8_t pad_value, int dst_fd = -1) = 0;
+
+        virtual const char* name() const = 0;
+    };
+
+    class CvPreprocessor : public Preprocessor
+    {
+    public:
+        bool run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                 uint8_t pad_value, int dst_fd = -1) override;
+        bool run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                        uint8_t pad_value, int dst_fd = -1) override;
+        const char* name() const override { return "opencv"; }
+
+    private:
+        cv::Mat m_bgr;
+        cv::Mat m_srcBgr;
+    };
+
+    class FusedPreprocessor : public Preprocessor
+    {
+    public:
+        bool run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                 uint8_t pad_value, int dst_fd = -1) override;
+        bool run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                        uint8_t pad_value, int dst_fd = -1) override;
+        const char* name() const override { return "fused"; }
+
+    private:
+        LetterboxKernel m_kernel;
+    };
+
+    // RGA实现: imfill填充边缘, improcess完成缩放和BGR/YUV->RGB.
+    // RGA不支持的输入(如跨度未对齐)或未启用ENABLE_RGA编译时回退到FusedPreprocessor
+    class RgaPreprocessor : public Preprocessor
+    {
+    public:
+        bool run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                 uint8_t pad_value, int dst_fd = -1) override;
+        bool run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                        uint8_t pad_value, int dst_fd = -1) override;
+        const char* name() const override { return "rga"; }
+
+    private:
+        FusedPreprocessor m_fallback;
+        bool m_fallbackWarned = false;
+    };
+
+    std::unique_ptr<Preprocessor> create_preprocessor(PreprocessType type);
+
+} // namespace rknn
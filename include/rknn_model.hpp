@@ -3,6 +3,7 @@
 #include <variant>
 #include <string>
 #include <mutex>
+#include <vector>
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgcodecs.hpp"
@@ -11,6 +12,10 @@
 #include "rknn_api.h"
 #include "logger.hpp"
 #include "type.hpp"
+#include "preprocess.hpp"
+#include "metrics.hpp"
+#include "model_cache.hpp"
+#include "backend.hpp"
 
 namespace rknn{
 
@@ -18,13 +23,21 @@ namespace rknn{
     constexpr int RK3588_NPU_CORE_NUM = 3;
 
     // Get NPU core number for round-robin assignment
-    inline int get_core_num() {
+    // core_mask: 允许使用的核心 (bit i 对应核心i), 0为全部核心
+    inline int get_core_num(int core_mask = 0) {
         static int core_num = 0;
         static std::mutex mtx;
 
         std::lock_guard<std::mutex> lock(mtx);
+        if((core_mask & ((1 << RK3588_NPU_CORE_NUM) - 1)) == 0){
+            core_mask = (1 << RK3588_NPU_CORE_NUM) - 1;
+        }
         int temp = core_num % RK3588_NPU_CORE_NUM;
         core_num++;
+        while(!(core_mask & (1 << temp))){
+            temp = core_num % RK3588_NPU_CORE_NUM;
+            core_num++;
+        }
         return temp;
     }
 
@@ -50,6 +63,23 @@ namespace rknn{
         bool is_quant;
     };
 
+    //模型构造时的可选配置
+    struct ModelConfig{
+        // 零拷贝模式: init_model时通过rknn_create_mem预分配输入/输出tensor并用rknn_set_io_mem绑定,
+        // 预处理直接写入绑定的输入内存, 省去rknn_inputs_set/rknn_outputs_get的拷贝
+        bool zero_copy = false;
+        // 预处理后端: OpenCV参考实现 / CPU融合内核 / RGA硬件
+        PreprocessType preprocess = PreprocessType::FUSED;
+        // 实例轮询绑定的NPU核心范围 (bit i 对应核心i, 如0b011只用核心0和1), 0为全部核心
+        int core_mask = 0;
+        // 推理后端: librknnrt / CPU参考实现 (见backend.hpp); 没有librknnrt的构建总是使用CPU参考实现
+        BackendType backend = BackendType::NPU;
+        // 非空时把每次推理的输出张量录制到该目录, 用BackendType::CPU加载其中的model.spec即可回放.
+        // 最多录制record_frames帧, <= 0 不限制
+        std::string record_dir;
+        int record_frames = 100;
+    };
+
     using ModelResult = std::variant<object_detect_result_list>;
 
     class Model
@@ -57,43 +87,132 @@ namespace rknn{
 
     public:
         // Standard constructor - creates new rknn context
-        Model(std::string model_path, logger::Level level);
+        // 模型加载/上下文创建/张量查询等初始化失败时抛出std::runtime_error (RknnPool据此把实例标记为失败)
+        Model(std::string model_path, logger::Level level, ModelConfig config = ModelConfig());
         // Constructor with context sharing - reuses weights from existing context
-        Model(std::string model_path, logger::Level level, rknn_context* ctx_in);
+        Model(std::string model_path, logger::Level level, rknn_context* ctx_in, ModelConfig config = ModelConfig());
         virtual ~Model();
         int init_model(rknn_context* ctx_in = nullptr);
-        ModelResult inference(cv::Mat img);
+        ModelResult inference(const cv::Mat& img);
+        // 直接输入相机/解码器帧 (RGB888/NV12/NV21, 含行跨度和dma-buf fd)
+        ModelResult inference(const image_buffer_t& img);
+        // 批量推理: 每batch_size()帧letterbox到同一个输入tensor, rknn_run一次, 输出按帧拆分后处理.
+        // 帧数超过batch_size()时分多次执行, batch为1的模型逐帧执行; 结果与输入一一对应
+        std::vector<ModelResult> inference_batch(const std::vector<cv::Mat>& imgs);
+        std::vector<ModelResult> inference_batch(const std::vector<image_buffer_t>& imgs);
         virtual void draw(cv::Mat img) = 0;
 
-        // Get pointer to rknn context for sharing with other instances
-        rknn_context* get_context() { return &m_rknnCtx; }
+        // Get pointer to rknn context for sharing with other instances (同一后端类型的实例之间)
+        rknn_context* get_context() { return m_backend->context(); }
+        const char* backend_name() const { return m_backend->name(); }
+
+        bool is_zero_copy() const { return m_config.zero_copy; }
+        // 模型输入的batch维 (输入tensor的dims[0])
+        int batch_size() const { return m_batchSize; }
+        // 绑定的NPU核心号
+        int core_id() const { return m_coreId; }
+        // 本实例的日志级别, 不影响其它实例和全局级别
+        void set_log_level(logger::Level level) { m_logger->set_level(level); }
+
+        // 流水线接口: 把inference拆成 预处理(含rknn_inputs_set) / NPU执行 / 后处理 三个阶段,
+        // 可由不同线程依次调用, 一个实例同一时刻只能有一帧处于这三个阶段之间.
+        // stage_preprocess返回后不再引用img
+        bool stage_preprocess(const cv::Mat& img);
+        bool stage_preprocess(const image_buffer_t& img);
+        bool stage_run();
+        ModelResult stage_postprocess();
 
     protected:
          virtual bool preprocess() = 0;
          virtual bool postprocess() = 0;
 
+         // 成员函数(含派生类)中的LOG*按本实例的级别过滤, 见logger.hpp
+         const logger::Logger* log_instance() const { return m_logger.get(); }
+
+         // 预处理的目标图像: 零拷贝模式下直接映射到绑定的输入tensor内存
+         cv::Mat input_image();
+         // 零拷贝输入内存的dma-buf fd, 非零拷贝模式为-1
+         int input_fd() const;
+
+         // 当前输入帧的尺寸, 与输入是cv::Mat还是image_buffer_t无关
+         int src_width() const;
+         int src_height() const;
+         // 用所选的预处理后端把当前输入帧letterbox到dst, 并记录当前batch位置的缩放和填充
+         bool letterbox_input(cv::Mat& dst, float scale, image_rect_t& pads, uint8_t pad_value);
+         // 当前batch位置的帧letterbox时的缩放和填充, 供后处理把框映射回原图
+         float letterbox_scale() const { return m_letterboxScale[m_batchIndex]; }
+         const image_rect_t& letterbox_pads() const { return m_letterboxPads[m_batchIndex]; }
+         // 第i个输出tensor中当前batch位置那一帧的数据
+         void* output_buf(int i) const;
+
     private:
         void dump_tensor_attr(rknn_tensor_attr *attr);
+        ModelResult run_inference();
+        template <typename Frame>
+        std::vector<ModelResult> run_batch(const std::vector<Frame>& imgs);
+        void set_source(const cv::Mat& img);
+        void set_source(const image_buffer_t& img);
+        bool set_inputs();
+        ModelResult postprocess_slot();
+        bool prepare_input();
+        bool run_npu();
+        ModelResult finish_output();
+        void init_io_buffers();
+        int init_zero_copy();
+        void release_zero_copy();
+        void release();
+        void init_metrics();
+        void set_frame_active(bool active);
+        // 取得m_inferenceMtx; 记录时间线时等锁的时间单独显示, 共用实例时的串行化一目了然
+        std::unique_lock<std::mutex> lock_inference();
 
     protected:
         std::unique_ptr<Params> m_params;
+        ModelConfig m_config;
 
         std::string m_rknnPath;
-
-        rknn_context m_rknnCtx;
+        // rknn_init创建上下文时使用的模型数据; dup出的实例为空
+        std::shared_ptr<const ModelBlob> m_modelBlob;
+
+        // 持有推理上下文, 所有rknn_api调用经由它完成
+        std::unique_ptr<Backend> m_backend;
+        std::shared_ptr<TensorRecorder> m_recorder;
+        int m_coreId = -1;
+        // batch维大小, 以及预处理/后处理当前处理的batch位置
+        int m_batchSize = 1;
+        int m_batchIndex = 0;
+        std::vector<float> m_letterboxScale;
+        std::vector<image_rect_t> m_letterboxPads;
         rknn_input_output_num m_ioNum;
         rknn_tensor_attr* m_inputAttrs;
         rknn_tensor_attr* m_outputAttrs;
 
         std::shared_ptr<logger::Logger>         m_logger;
+        std::unique_ptr<Preprocessor>           m_preprocessor;
         std::unique_ptr<rknn_input[]>           m_rknnInputPtr;
         std::unique_ptr<rknn_output[]>          m_rknnOutputPtr;
 
-        //source image
+        // 非零拷贝模式下预分配的预处理目标图像与输出缓冲区
+        cv::Mat                                 m_inputImg;
+        std::vector<std::vector<uint8_t>>       m_outputBufs;
+
+        // zero copy模式下由rknn_create_mem分配的输入/输出内存
+        std::vector<rknn_tensor_mem*>           m_inputMems;
+        std::vector<rknn_tensor_mem*>           m_outputMems;
+
+        //source image (只引用调用方的图像, 不做深拷贝)
         cv::Mat     m_img;
+        // image_buffer_t输入时指向调用方的帧, 仅在inference期间有效
+        const image_buffer_t* m_srcBuffer = nullptr;
 
         ModelResult m_result;
 
+        // 指标对象由MetricsRegistry持有, 同一NPU核心上的实例共享
+        Counter*    m_frameCounter = nullptr;
+        Gauge*      m_inflightGauge = nullptr;
+        Histogram*  m_detectionHist = nullptr;
+        bool        m_frameActive = false;     // 已开始预处理, 结果还没取走
+
         // Mutex for thread-safe inference
         std::mutex m_inferenceMtx;
 
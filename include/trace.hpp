@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace rknn {
+
+    // 推理时间线记录, 导出为Chrome trace-event JSON (chrome://tracing 或 ui.perfetto.dev 打开).
+    //
+    // 每个线程有自己的环形缓冲区, 只有所属线程写入, 记录不加锁; 写满后覆盖最早的事件, 只保留最近capacity个.
+    // 事件为带起止时间的区间 ("X"事件), name/cat必须是字符串常量 (只保存指针).
+    // 线程退出后其缓冲区保留到下一次start, 已销毁的线程池的时间线也能导出
+    class Tracer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // 开始记录并清空上一次的事件; capacity为每个线程保留的事件数 (只影响之后新登记的线程)
+        static void start(size_t capacity = DEFAULT_CAPACITY);
+        // 停止记录, 等正在进行的record写完后返回; 之后结束的TraceScope不再记录
+        static void stop();
+        static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // 记录一个区间, arg >= 0 时作为args.arg输出 (如帧序号)
+        static void record(const char* name, const char* cat, Clock::time_point begin, Clock::time_point end,
+                           int64_t arg = -1);
+
+        // 当前线程在时间线上显示的名字, 不记录时也可以调用
+        static void set_thread_name(const std::string& name);
+
+        // 写出所有线程的事件, 应在stop之后调用
+        static bool dump(const std::string& path);
+
+        static constexpr size_t DEFAULT_CAPACITY = 16384;
+
+    private:
+        static std::atomic<bool> s_enabled;
+    };
+
+    // 作用域区间: 构造时开始, 析构时记录; 不记录时只读一次relaxed原子量
+    class TraceScope {
+    public:
+        explicit TraceScope(const char* name, const char* cat = "rknn", int64_t arg = -1)
+            : m_name(name), m_cat(cat), m_arg(arg), m_running(Tracer::enabled()) {
+            if(m_running){
+                m_begin = Tracer::Clock::now();
+            }
+        }
+        ~TraceScope() {
+            if(m_running){
+                Tracer::record(m_name, m_cat, m_begin, Tracer::Clock::now(), m_arg);
+            }
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* m_name;
+        const char* m_cat;
+        int64_t m_arg;
+        bool m_running;
+        Tracer::Clock::time_point m_begin;
+    };
+
+} // namespace rknn
@@ -39,7 +39,7 @@ int quick_sort_indice_inverse(std::vector<float> &input, int left, int right, st
 
 float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1, float ymax1);
 
-int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> classIds, std::vector<int> &order, int filterId, float threshold);
+int nms(int validCount, std::vector<float> &outputLocations, const std::vector<int> &classIds, std::vector<int> &order, int filterId, float threshold);
 
 char *readLine(FILE *fp, char *buffer, int *len);
 
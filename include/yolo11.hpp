@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "rknn_model.hpp"
+#include "postprocess.hpp"
+#include "nms.hpp"
 
 #define LABEL_NALE_TXT_PATH "./model/coco_80_labels_list.txt"
 
@@ -18,44 +20,46 @@ namespace detector
         float nms_threshold;
         int bf_color = 114;
         int class_num = 80;
+        NmsMode nms_mode = NmsMode::PER_CLASS;
+        int pre_nms_top_k = 1000;                   // NMS前最多保留的候选数, <=0 不限制
+        int max_detections = OBJ_NUMB_MAX_SIZE;     // NMS后最多输出的框数, 不超过OBJ_NUMB_MAX_SIZE
     };
     class YOLO11 : public rknn::Model{
     public:
         // Standard constructor - creates new rknn context
-        YOLO11(std::string model_path, logger::Level level, DetectParam detect_param);
+        YOLO11(std::string model_path, logger::Level level, DetectParam detect_param, rknn::ModelConfig config = rknn::ModelConfig());
         // Constructor with context sharing - reuses weights from existing context
-        YOLO11(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param);
+        YOLO11(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param, rknn::ModelConfig config = rknn::ModelConfig());
 
         ~YOLO11();
 
         // infer method for thread pool (returns object_detect_result_list directly)
         object_detect_result_list infer(cv::Mat img);
+        object_detect_result_list infer(image_buffer_t img);
+        // 多帧一次推理, 模型batch>1时每batch_size帧只调用一次rknn_run
+        std::vector<object_detect_result_list> infer_batch(const std::vector<cv::Mat> &imgs);
+        std::vector<object_detect_result_list> infer_batch(const std::vector<image_buffer_t> &imgs);
 
         virtual bool preprocess() override;
         virtual bool postprocess() override;
-        int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
+        // box_decoder: 该分支box输出tensor对应的DFL查表解码器
+        int process_i8(int8_t *box_tensor, const DflDecoder &box_decoder,
             int8_t *score_tensor, int32_t score_zp, float score_scale,
             int8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-            int grid_h, int grid_w, int stride, int dfl_len,
-            std::vector<float> &boxes, 
-            std::vector<float> &objProbs, 
-            std::vector<int> &classId, 
+            int grid_h, int grid_w, int stride,
+            CandidateCollector &candidates,
             float threshold);
 
-        int process_u8(uint8_t *box_tensor, int32_t box_zp, float box_scale,
+        int process_u8(uint8_t *box_tensor, const DflDecoder &box_decoder,
             uint8_t *score_tensor, int32_t score_zp, float score_scale,
             uint8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-            int grid_h, int grid_w, int stride, int dfl_len,
-            std::vector<float> &boxes,
-            std::vector<float> &objProbs,
-            std::vector<int> &classId,
+            int grid_h, int grid_w, int stride,
+            CandidateCollector &candidates,
             float threshold);
 
         int process_fp32(float *box_tensor, float *score_tensor, float *score_sum_tensor, 
             int grid_h, int grid_w, int stride, int dfl_len,
-            std::vector<float> &boxes, 
-            std::vector<float> &objProbs, 
-            std::vector<int> &classId, 
+            CandidateCollector &candidates,
             float threshold);
         
             int init_post_process();
@@ -63,14 +67,15 @@ namespace detector
         
     private:
         DetectParam m_detectParam;
-        image_rect_t m_pads;
-        float m_scale;
         cv::Mat m_resized_img;
 
         std::unique_ptr<object_detect_result_list> m_odReseultsPtr; 
-        std::vector<float> m_filterBoxes;
-        std::vector<float> m_objProbs;
-        std::vector<int> m_classId;
+        CandidateCollector m_candidates;
+        std::vector<DflDecoder> m_dflDecoders;  // 每个分支的box输出tensor一个
+        ClassScoreScanner<int8_t>  m_scoreScannerI8;
+        ClassScoreScanner<uint8_t> m_scoreScannerU8;
+        ClassScoreScanner<float>   m_scoreScannerF32;
+        NmsEngine m_nms;
  
 
         
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "rknn_model.hpp"
+#include "postprocess.hpp"
 #include "yolo11.hpp"  // For DetectParam
 
 #define LABEL_NALE_TXT_PATH_V5 "./model/coco_80_labels_list.txt"
@@ -16,13 +17,17 @@ namespace detector
     class YOLO5 : public rknn::Model {
     public:
         // Standard constructor - creates new rknn context
-        YOLO5(std::string model_path, logger::Level level, DetectParam detect_param);
+        YOLO5(std::string model_path, logger::Level level, DetectParam detect_param, rknn::ModelConfig config = rknn::ModelConfig());
         // Constructor with context sharing - reuses weights from existing context
-        YOLO5(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param);
+        YOLO5(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param, rknn::ModelConfig config = rknn::ModelConfig());
         ~YOLO5();
 
         // infer method for thread pool (returns object_detect_result_list directly)
         object_detect_result_list infer(cv::Mat img);
+        object_detect_result_list infer(image_buffer_t img);
+        // Multi-frame inference: one rknn_run per batch_size frames when the model has batch > 1
+        std::vector<object_detect_result_list> infer_batch(const std::vector<cv::Mat> &imgs);
+        std::vector<object_detect_result_list> infer_batch(const std::vector<image_buffer_t> &imgs);
 
         virtual bool preprocess() override;
         virtual bool postprocess() override;
@@ -31,37 +36,31 @@ namespace detector
         // YOLOv5 anchor-based processing functions
         int process_i8(int8_t *input, int *anchor, int grid_h, int grid_w,
                        int stride, int32_t zp, float scale,
-                       std::vector<float> &boxes,
-                       std::vector<float> &objProbs,
-                       std::vector<int> &classId,
+                       CandidateCollector &candidates,
                        float threshold);
 
         int process_u8(uint8_t *input, int *anchor, int grid_h, int grid_w,
                        int stride, int32_t zp, float scale,
-                       std::vector<float> &boxes,
-                       std::vector<float> &objProbs,
-                       std::vector<int> &classId,
+                       CandidateCollector &candidates,
                        float threshold);
 
         int process_fp32(float *input, int *anchor, int grid_h, int grid_w,
                          int stride,
-                         std::vector<float> &boxes,
-                         std::vector<float> &objProbs,
-                         std::vector<int> &classId,
+                         CandidateCollector &candidates,
                          float threshold);
 
         int init_post_process();
 
     private:
         DetectParam m_detectParam;
-        image_rect_t m_pads;
-        float m_scale;
         cv::Mat m_resized_img;
 
         std::unique_ptr<object_detect_result_list> m_odReseultsPtr;
-        std::vector<float> m_filterBoxes;
-        std::vector<float> m_objProbs;
-        std::vector<int> m_classId;
+        CandidateCollector m_candidates;
+        ClassScoreScanner<int8_t>  m_scoreScannerI8;
+        ClassScoreScanner<uint8_t> m_scoreScannerU8;
+        ClassScoreScanner<float>   m_scoreScannerF32;
+        NmsEngine m_nms;
     };
 
 }; // namespace detector
@@ -0,0 +1,73 @@
+#include "backend.hpp"
+#include "logger.hpp"
+
+#ifndef RKNN_CPU_RUNTIME
+
+rknn::NpuBackend::~NpuBackend() {
+    if(m_ctx != 0){
+        rknn_destroy(m_ctx);
+        m_ctx = 0;
+    }
+}
+
+int rknn::NpuBackend::init(const ModelBlob& blob) {
+    return rknn_init(&m_ctx, blob.data(), blob.size(), 0, NULL);
+}
+
+int rknn::NpuBackend::dup(rknn_context* ctx_in) {
+    return rknn_dup_context(ctx_in, &m_ctx);
+}
+
+int rknn::NpuBackend::set_core_mask(rknn_core_mask core_mask) {
+    return rknn_set_core_mask(m_ctx, core_mask);
+}
+
+int rknn::NpuBackend::query(rknn_query_cmd cmd, void* info, uint32_t size) {
+    return rknn_query(m_ctx, cmd, info, size);
+}
+
+int rknn::NpuBackend::inputs_set(uint32_t n_inputs, rknn_input inputs[]) {
+    return rknn_inputs_set(m_ctx, n_inputs, inputs);
+}
+
+int rknn::NpuBackend::run() {
+    return rknn_run(m_ctx, nullptr);
+}
+
+int rknn::NpuBackend::outputs_get(uint32_t n_outputs, rknn_output outputs[]) {
+    return rknn_outputs_get(m_ctx, n_outputs, outputs, NULL);
+}
+
+int rknn::NpuBackend::outputs_release(uint32_t n_outputs, rknn_output outputs[]) {
+    return rknn_outputs_release(m_ctx, n_outputs, outputs);
+}
+
+rknn_tensor_mem* rknn::NpuBackend::create_mem(uint32_t size) {
+    return rknn_create_mem(m_ctx, size);
+}
+
+int rknn::NpuBackend::destroy_mem(rknn_tensor_mem* mem) {
+    return rknn_destroy_mem(m_ctx, mem);
+}
+
+int rknn::NpuBackend::set_io_mem(rknn_tensor_mem* mem, rknn_tensor_attr* attr) {
+    return rknn_set_io_mem(m_ctx, mem, attr);
+}
+
+#endif
+
+std::unique_ptr<rknn::Backend> rknn::create_backend(BackendType type) {
+    switch(type){
+        case BackendType::CPU:
+            return std::make_unique<CpuBackend>();
+        case BackendType::NPU:
+        default:
+#ifdef RKNN_CPU_RUNTIME
+            static std::once_flag warn_once;
+            std::call_once(warn_once, [] { LOGW("built without librknnrt (RKNN_CPU_RUNTIME), falling back to cpu backend"); });
+            return std::make_unique<CpuBackend>();
+#else
+            return std::make_unique<NpuBackend>();
+#endif
+    }
+}
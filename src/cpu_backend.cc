@@ -0,0 +1,958 @@
+#include "backend.hpp"
+#include "logger.hpp"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rknn {
+
+    // CpuBackend的模型: 张量属性和每帧各输出的数据 (按属性的type存放), dup出的实例共享
+    struct CpuModel {
+        std::vector<rknn_tensor_attr> inputs;
+        std::vector<rknn_tensor_attr> outputs;
+        std::vector<std::vector<std::vector<uint8_t>>> frames;     // [帧][输出]
+        mutable std::atomic<uint64_t> runs{0};                      // 共享该模型的所有实例的run次数, 选择回放的帧
+        int run_us = 20000;
+        int core_us[3] = {-1, -1, -1};
+        int jitter_us = 0;
+        uint32_t seed = 1;
+    };
+
+} // namespace rknn
+
+namespace {
+
+    constexpr int CORE_NUM = 3;
+
+    // 模拟的NPU核心占用状态, 进程内所有CpuBackend共用
+    std::mutex g_coreMtx;
+    std::condition_variable g_coreCv;
+    bool g_coreBusy[CORE_NUM] = {false, false, false};
+    std::atomic<uint32_t> g_instanceNum(0);
+    std::atomic<uint64_t> g_leakedMems(0);
+
+    // 已初始化且未析构的CpuBackend, dup据此检查ctx_in
+    std::mutex g_contextMtx;
+    std::set<const rknn::CpuBackend*> g_contexts;
+
+    struct ModelSpec {
+        std::string model = "yolo11";
+        int width = 640;
+        int height = 640;
+        int batch = 1;
+        int classes = 80;
+        int dfl = 16;
+        bool score_sum = true;
+        rknn_tensor_type dtype = RKNN_TENSOR_INT8;
+        int32_t box_zp = 0;
+        float box_scale = 0.125f;
+        int32_t score_zp = -128;
+        float score_scale = 1.0f / 255;
+        int objects = 8;
+        std::string replay;
+        int frames = -1;        // 录制的帧数, 未知(旧的录制)时为-1
+    };
+
+    // 确定性的伪随机数
+    inline uint32_t lcg_next(uint32_t& state) {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    inline int lcg_uniform(uint32_t& state, int n) {
+        return (int)(lcg_next(state) % (uint32_t)n);
+    }
+
+    inline float lcg_uniform(uint32_t& state, float lo, float hi) {
+        return lo + (hi - lo) * (lcg_next(state) & 0xffff) / 65535.0f;
+    }
+
+    uint16_t float_to_half(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int32_t exp = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mant = bits & 0x7fffff;
+        if(exp <= 0){
+            return (uint16_t)sign;      // 非规格化数按0处理, 检测头的输出用不到
+        }
+        if(exp >= 31){
+            return (uint16_t)(sign | 0x7c00);
+        }
+        uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+        if(mant & 0x1000){
+            half++;                     // 舍入
+        }
+        return (uint16_t)half;
+    }
+
+    float half_to_float(uint16_t half) {
+        uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        uint32_t exp = (half >> 10) & 0x1f;
+        uint32_t mant = half & 0x3ff;
+        uint32_t bits;
+        if(exp == 0){
+            bits = sign;
+        }else if(exp == 31){
+            bits = sign | 0x7f800000 | (mant << 13);
+        }else{
+            bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+        }
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint32_t type_size(rknn_tensor_type type) {
+        switch(type){
+            case RKNN_TENSOR_INT8:
+            case RKNN_TENSOR_UINT8:
+                return 1;
+            case RKNN_TENSOR_FLOAT16:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+
+    // 文本才是spec: 允许UTF-8 (注释可以是中文), 出现其它控制字符时视为二进制模型
+    bool looks_like_spec(const uint8_t* data, uint32_t size) {
+        uint32_t n = std::min<uint32_t>(size, 4096);
+        for(uint32_t i = 0; i < n; i++){
+            if((data[i] < 0x20 && data[i] != '\n' && data[i] != '\r' && data[i] != '\t') || data[i] == 0x7f){
+                return false;
+            }
+        }
+        return n > 0;
+    }
+
+    bool parse_spec(const std::string& text, ModelSpec& spec, rknn::CpuModel& model) {
+        std::istringstream in(text);
+        std::string line;
+        while(std::getline(in, line)){
+            size_t hash = line.find('#');
+            if(hash != std::string::npos){
+                line.erase(hash);
+            }
+            line.erase(std::remove_if(line.begin(), line.end(), [](char c) { return isspace((unsigned char)c); }),
+                       line.end());
+            if(line.empty()){
+                continue;
+            }
+            size_t eq = line.find('=');
+            if(eq == std::string::npos){
+                LOGW("cpu backend: invalid model spec line: %s", line.c_str());
+                return false;
+            }
+            std::string key = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+            const char* v = value.c_str();
+            bool ok = true;
+            if(key == "model"){
+                ok = value == "yolo11" || value == "yolov5";
+                spec.model = value;
+            }else if(key == "input"){
+                ok = sscanf(v, "%dx%d", &spec.width, &spec.height) == 2 && spec.width > 0 && spec.height > 0;
+            }else if(key == "batch"){
+                spec.batch = atoi(v);
+                ok = spec.batch > 0;
+            }else if(key == "classes"){
+                spec.classes = atoi(v);
+                ok = spec.classes > 0;
+            }else if(key == "dfl"){
+                spec.dfl = atoi(v);
+                ok = spec.dfl > 1;
+            }else if(key == "score_sum"){
+                spec.score_sum = atoi(v) != 0;
+            }else if(key == "dtype"){
+                if(value == "int8"){
+                    spec.dtype = RKNN_TENSOR_INT8;
+                }else if(value == "fp16"){
+                    spec.dtype = RKNN_TENSOR_FLOAT16;
+                }else if(value == "fp32"){
+                    spec.dtype = RKNN_TENSOR_FLOAT32;
+                }else{
+                    ok = false;
+                }
+            }else if(key == "box_zp"){
+                spec.box_zp = atoi(v);
+            }else if(key == "box_scale"){
+                spec.box_scale = (float)atof(v);
+                ok = spec.box_scale > 0;
+            }else if(key == "score_zp"){
+                spec.score_zp = atoi(v);
+            }else if(key == "score_scale"){
+                spec.score_scale = (float)atof(v);
+                ok = spec.score_scale > 0;
+            }else if(key == "objects"){
+                spec.objects = atoi(v);
+                ok = spec.objects >= 0;
+            }else if(key == "seed"){
+                model.seed = (uint32_t)strtoul(v, NULL, 10);
+            }else if(key == "replay"){
+                spec.replay = value;
+            }else if(key == "frames"){
+                spec.frames = atoi(v);
+                ok = spec.frames >= 0;
+            }else if(key == "run_us"){
+                model.run_us = atoi(v);
+                ok = model.run_us >= 0;
+            }else if(key == "core_us"){
+                int n = sscanf(v, "%d,%d,%d", &model.core_us[0], &model.core_us[1], &model.core_us[2]);
+                ok = n > 0;
+            }else if(key == "jitter_us"){
+                model.jitter_us = atoi(v);
+                ok = model.jitter_us >= 0;
+            }else{
+                LOGW("cpu backend: unknown model spec key: %s", key.c_str());
+            }
+            if(!ok){
+                LOGW("cpu backend: invalid model spec value: %s=%s", key.c_str(), value.c_str());
+                return false;
+            }
+        }
+        // 各分支的grid由最大stride决定
+        if(spec.replay.empty() && (spec.width % 32 != 0 || spec.height % 32 != 0)){
+            LOGW("cpu backend: model input %dx%d is not a multiple of 32", spec.width, spec.height);
+            return false;
+        }
+        return true;
+    }
+
+    rknn_tensor_attr make_attr(uint32_t index, const std::string& name, const std::vector<uint32_t>& dims,
+                               rknn_tensor_format fmt, rknn_tensor_type type, int32_t zp, float scale) {
+        rknn_tensor_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.index = index;
+        attr.n_dims = (uint32_t)dims.size();
+        attr.n_elems = 1;
+        for(uint32_t d = 0; d < attr.n_dims; d++){
+            attr.dims[d] = dims[d];
+            attr.n_elems *= dims[d];
+        }
+        snprintf(attr.name, sizeof(attr.name), "%s", name.c_str());
+        attr.fmt = fmt;
+        attr.type = type;
+        attr.qnt_type = type == RKNN_TENSOR_INT8 ? RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC : RKNN_TENSOR_QNT_NONE;
+        attr.zp = type == RKNN_TENSOR_INT8 ? zp : 0;
+        attr.scale = type == RKNN_TENSOR_INT8 ? scale : 1.0f;
+        attr.size = attr.n_elems * type_size(type);
+        attr.size_with_stride = attr.size;
+        return attr;
+    }
+
+    // YOLO11 (rknn_model_zoo导出): 每个stride一组 box[b,4*dfl,h,w] / score[b,C,h,w] / score_sum[b,1,h,w].
+    // 背景: box全0(DFL均匀分布), 分数0. 目标: 四个方向各一个峰值bin, 分数0.6~0.95
+    void build_yolo11(const ModelSpec& spec, uint32_t seed, rknn::CpuModel& model,
+                      std::vector<std::vector<float>>& values) {
+        const uint32_t strides[3] = {8, 16, 32};
+        const uint32_t batch = spec.batch;
+        for(uint32_t stride : strides){
+            uint32_t gh = spec.height / stride;
+            uint32_t gw = spec.width / stride;
+            uint32_t index = (uint32_t)model.outputs.size();
+            std::string suffix = std::to_string(stride);
+            model.outputs.push_back(make_attr(index, "box_" + suffix, {batch, 4 * (uint32_t)spec.dfl, gh, gw},
+                                              RKNN_TENSOR_NCHW, spec.dtype, spec.box_zp, spec.box_scale));
+            model.outputs.push_back(make_attr(index + 1, "score_" + suffix, {batch, (uint32_t)spec.classes, gh, gw},
+                                              RKNN_TENSOR_NCHW, spec.dtype, spec.score_zp, spec.score_scale));
+            if(spec.score_sum){
+                model.outputs.push_back(make_attr(index + 2, "score_sum_" + suffix, {batch, 1, gh, gw},
+                                                  RKNN_TENSOR_NCHW, spec.dtype, spec.score_zp, spec.score_scale));
+            }
+        }
+        for(auto& attr : model.outputs){
+            values.emplace_back(attr.n_elems, 0.0f);
+        }
+
+        int per_branch = spec.score_sum ? 3 : 2;
+        uint32_t rng = seed;
+        for(int k = 0; k < spec.objects; k++){
+            int branch = k % 3;
+            const rknn_tensor_attr& box_attr = model.outputs[branch * per_branch];
+            int grid_len = box_attr.dims[2] * box_attr.dims[3];
+            int cell = lcg_uniform(rng, grid_len);
+            int cls = lcg_uniform(rng, spec.classes);
+            float score = lcg_uniform(rng, 0.6f, 0.95f);
+            int bins[4];
+            for(int side = 0; side < 4; side++){
+                bins[side] = 1 + lcg_uniform(rng, std::max(1, spec.dfl / 2));
+            }
+            for(int b = 0; b < spec.batch; b++){
+                float* box = values[branch * per_branch].data() + (size_t)b * 4 * spec.dfl * grid_len;
+                for(int side = 0; side < 4; side++){
+                    for(int n = 0; n < spec.dfl; n++){
+                        box[(side * spec.dfl + n) * grid_len + cell] = n == bins[side] ? 8.0f : 0.0f;
+                    }
+                }
+                float* scores = values[branch * per_branch + 1].data() + (size_t)b * spec.classes * grid_len;
+                scores[cls * grid_len + cell] = std::max(scores[cls * grid_len + cell], score);
+                if(spec.score_sum){
+                    float* sum = values[branch * per_branch + 2].data() + (size_t)b * grid_len;
+                    sum[cell] = std::min(1.0f, sum[cell] + score);
+                }
+            }
+        }
+    }
+
+    // YOLOv5: 每个stride一个输出 [b, 3*(5+C), h, w], 值已经过sigmoid
+    void build_yolov5(const ModelSpec& spec, uint32_t seed, rknn::CpuModel& model,
+                      std::vector<std::vector<float>>& values) {
+        const uint32_t strides[3] = {8, 16, 32};
+        int prop = 5 + spec.classes;
+        for(uint32_t stride : strides){
+            model.outputs.push_back(make_attr((uint32_t)model.outputs.size(), "output_" + std::to_string(stride),
+                                              {(uint32_t)spec.batch, (uint32_t)(3 * prop), spec.height / stride,
+                                               spec.width / stride},
+                                              RKNN_TENSOR_NCHW, spec.dtype, spec.score_zp, spec.score_scale));
+        }
+        for(auto& attr : model.outputs){
+            values.emplace_back(attr.n_elems, 0.0f);
+        }
+
+        uint32_t rng = seed;
+        for(int k = 0; k < spec.objects; k++){
+            int branch = k % 3;
+            const rknn_tensor_attr& attr = model.outputs[branch];
+            int grid_len = attr.dims[2] * attr.dims[3];
+            int anchor = lcg_uniform(rng, 3);
+            int cell = lcg_uniform(rng, grid_len);
+            int cls = lcg_uniform(rng, spec.classes);
+            float score = lcg_uniform(rng, 0.6f, 0.95f);
+            float wh = lcg_uniform(rng, 0.35f, 0.75f);
+            for(int b = 0; b < spec.batch; b++){
+                float* ptr = values[branch].data() + ((size_t)b * 3 + anchor) * prop * grid_len + cell;
+                ptr[0] = 0.5f;
+                ptr[grid_len] = 0.5f;
+                ptr[2 * grid_len] = wh;
+                ptr[3 * grid_len] = wh;
+                ptr[4 * grid_len] = score;
+                ptr[(5 + cls) * grid_len] = 1.0f;
+            }
+        }
+    }
+
+    // 浮点值按输出属性的type转换为一帧数据
+    std::vector<std::vector<uint8_t>> encode_frame(const rknn::CpuModel& model,
+                                                   const std::vector<std::vector<float>>& values) {
+        std::vector<std::vector<uint8_t>> frame;
+        for(size_t i = 0; i < model.outputs.size(); i++){
+            const rknn_tensor_attr& attr = model.outputs[i];
+            std::vector<uint8_t> data(attr.size);
+            for(uint32_t n = 0; n < attr.n_elems; n++){
+                float v = values[i][n];
+                if(attr.type == RKNN_TENSOR_INT8){
+                    float q = roundf(v / attr.scale) + attr.zp;
+                    ((int8_t*)data.data())[n] = (int8_t)std::max(-128.0f, std::min(127.0f, q));
+                }else if(attr.type == RKNN_TENSOR_FLOAT16){
+                    ((uint16_t*)data.data())[n] = float_to_half(v);
+                }else{
+                    ((float*)data.data())[n] = v;
+                }
+            }
+            frame.push_back(std::move(data));
+        }
+        return frame;
+    }
+
+    // tensors.txt的一行: kind index name fmt type qnt dims zp scale
+    std::string format_attr(const char* kind, const rknn_tensor_attr& attr) {
+        std::ostringstream out;
+        out << kind << " " << attr.index << " " << attr.name << " " << get_format_string(attr.fmt) << " "
+            << get_type_string(attr.type) << " " << get_qnt_type_string(attr.qnt_type) << " ";
+        for(uint32_t d = 0; d < attr.n_dims; d++){
+            out << (d == 0 ? "" : ",") << attr.dims[d];
+        }
+        char scale[32];
+        snprintf(scale, sizeof(scale), "%.9g", attr.scale);
+        out << " " << attr.zp << " " << scale << "\n";
+        return out.str();
+    }
+
+    bool parse_attr(const std::string& line, std::string& kind, rknn_tensor_attr& attr) {
+        std::istringstream in(line);
+        std::string name, fmt, type, qnt, dims;
+        uint32_t index;
+        int32_t zp;
+        float scale;
+        if(!(in >> kind >> index >> name >> fmt >> type >> qnt >> dims >> zp >> scale)){
+            return false;
+        }
+        std::vector<uint32_t> dim_values;
+        std::istringstream dim_in(dims);
+        std::string dim;
+        while(std::getline(dim_in, dim, ',')){
+            dim_values.push_back((uint32_t)strtoul(dim.c_str(), NULL, 10));
+        }
+        if(dim_values.empty() || dim_values.size() > RKNN_MAX_DIMS){
+            return false;
+        }
+        rknn_tensor_format fmt_value = RKNN_TENSOR_FORMAT_MAX;
+        for(int f = 0; f < RKNN_TENSOR_FORMAT_MAX; f++){
+            if(fmt == get_format_string((rknn_tensor_format)f)){
+                fmt_value = (rknn_tensor_format)f;
+            }
+        }
+        rknn_tensor_type type_value = RKNN_TENSOR_TYPE_MAX;
+        for(int t = 0; t < RKNN_TENSOR_TYPE_MAX; t++){
+            if(type == get_type_string((rknn_tensor_type)t)){
+                type_value = (rknn_tensor_type)t;
+            }
+        }
+        if(fmt_value == RKNN_TENSOR_FORMAT_MAX || type_value == RKNN_TENSOR_TYPE_MAX){
+            return false;
+        }
+        attr = make_attr(index, name, dim_values, fmt_value, type_value, zp, scale);
+        if(fmt_value == RKNN_TENSOR_NHWC && attr.n_dims == 4){
+            attr.w_stride = attr.dims[2];
+        }
+        return true;
+    }
+
+    // frames >= 0 时读取恰好frames帧, 否则读到第一个不存在的帧文件为止
+    bool load_replay(const std::string& dir, int frames, rknn::CpuModel& model) {
+        std::ifstream layout(dir + "/tensors.txt");
+        if(!layout){
+            LOGW("cpu backend: cannot open %s/tensors.txt", dir.c_str());
+            return false;
+        }
+        std::string line;
+        while(std::getline(layout, line)){
+            if(line.empty() || line[0] == '#'){
+                continue;
+            }
+            std::string kind;
+            rknn_tensor_attr attr;
+            if(!parse_attr(line, kind, attr)){
+                LOGW("cpu backend: invalid tensor line in %s/tensors.txt: %s", dir.c_str(), line.c_str());
+                return false;
+            }
+            (kind == "input" ? model.inputs : model.outputs).push_back(attr);
+        }
+        if(model.inputs.empty() || model.outputs.empty()){
+            LOGW("cpu backend: no tensors in %s/tensors.txt", dir.c_str());
+            return false;
+        }
+
+        size_t frame_size = 0;
+        for(auto& attr : model.outputs){
+            frame_size += attr.size;
+        }
+        for(int f = 0; frames < 0 || f < frames; f++){
+            char path[64];
+            snprintf(path, sizeof(path), "/frame_%06d.bin", f);
+            std::ifstream in(dir + path, std::ios::binary);
+            if(!in){
+                if(frames >= 0){
+                    LOGW("cpu backend: cannot open %s%s (%d frames recorded)", dir.c_str(), path, frames);
+                    return false;
+                }
+                break;
+            }
+            std::vector<std::vector<uint8_t>> frame;
+            for(auto& attr : model.outputs){
+                std::vector<uint8_t> data(attr.size);
+                in.read((char*)data.data(), data.size());
+                frame.push_back(std::move(data));
+            }
+            if(!in){
+                LOGW("cpu backend: %s%s is shorter than %zu bytes", dir.c_str(), path, frame_size);
+                return false;
+            }
+            model.frames.push_back(std::move(frame));
+        }
+        if(model.frames.empty()){
+            LOGW("cpu backend: no recorded frames in %s", dir.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<rknn::CpuModel> build_model(const rknn::ModelBlob& blob) {
+        std::shared_ptr<rknn::CpuModel> model = std::make_shared<rknn::CpuModel>();
+        ModelSpec spec;
+        const uint8_t* data = (const uint8_t*)blob.data();
+        if(looks_like_spec(data, blob.size())){
+            if(!parse_spec(std::string((const char*)data, blob.size()), spec, *model)){
+                return nullptr;
+            }
+        }else{
+            LOGW("cpu backend: %s is not a model spec, simulating 640x640 int8 yolo11", blob.path().c_str());
+        }
+
+        if(!spec.replay.empty()){
+            std::string dir = spec.replay;
+            if(dir[0] != '/'){
+                size_t slash = blob.path().rfind('/');
+                dir = (slash == std::string::npos ? "." : blob.path().substr(0, slash)) + "/" + dir;
+            }
+            if(!load_replay(dir, spec.frames, *model)){
+                return nullptr;
+            }
+            LOG("cpu backend: replaying %zu frames from %s", model->frames.size(), dir.c_str());
+            return model;
+        }
+
+        model->inputs.push_back(make_attr(0, "images", {(uint32_t)spec.batch, (uint32_t)spec.height,
+                                                        (uint32_t)spec.width, 3},
+                                          RKNN_TENSOR_NHWC, RKNN_TENSOR_UINT8, 0, 1.0f));
+        model->inputs[0].w_stride = spec.width;
+
+        std::vector<std::vector<float>> values;
+        if(spec.model == "yolov5"){
+            build_yolov5(spec, model->seed, *model, values);
+        }else{
+            build_yolo11(spec, model->seed, *model, values);
+        }
+        model->frames.push_back(encode_frame(*model, values));
+        LOG("cpu backend: %s %dx%d batch=%d classes=%d dtype=%s run_us=%d", spec.model.c_str(), spec.width,
+            spec.height, spec.batch, spec.classes, get_type_string(spec.dtype), model->run_us);
+        return model;
+    }
+
+    // 占用一个允许的核心, 都忙时等任一允许的核心空闲 (AUTO即全部核心)
+    int acquire_core(int core_mask) {
+        int allowed = (core_mask & ((1 << CORE_NUM) - 1)) != 0 ? core_mask : (1 << CORE_NUM) - 1;
+        std::unique_lock<std::mutex> lock(g_coreMtx);
+        for(;;){
+            for(int c = 0; c < CORE_NUM; c++){
+                if((allowed & (1 << c)) && !g_coreBusy[c]){
+                    g_coreBusy[c] = true;
+                    return c;
+                }
+            }
+            g_coreCv.wait(lock);
+        }
+    }
+
+    void release_core(int core) {
+        {
+            std::lock_guard<std::mutex> lock(g_coreMtx);
+            g_coreBusy[core] = false;
+        }
+        g_coreCv.notify_all();
+    }
+
+    uint32_t output_size(const rknn_tensor_attr& attr, bool want_float) {
+        return want_float ? attr.n_elems * sizeof(float) : attr.size;
+    }
+
+} // namespace
+
+rknn::CpuBackend::~CpuBackend() {
+    {
+        std::lock_guard<std::mutex> lock(g_contextMtx);
+        g_contexts.erase(this);
+    }
+    // librknnrt在rknn_destroy之后不能再释放零拷贝内存, 这里代为释放并记录调用方的销毁顺序错误
+    if(!m_mems.empty()){
+        LOGW("cpu backend: %zu tensor mems still alive when the context is destroyed", m_mems.size());
+        g_leakedMems.fetch_add(m_mems.size(), std::memory_order_relaxed);
+        for(rknn_tensor_mem* mem : m_mems){
+            free(mem->virt_addr);
+            free(mem);
+        }
+    }
+}
+
+uint64_t rknn::CpuBackend::leaked_mems() {
+    return g_leakedMems.load(std::memory_order_relaxed);
+}
+
+void rknn::CpuBackend::attach(std::shared_ptr<const CpuModel> model) {
+    m_model = std::move(model);
+    m_ctx = (rknn_context)(uintptr_t)this;
+    {
+        std::lock_guard<std::mutex> lock(g_contextMtx);
+        g_contexts.insert(this);
+    }
+    // 每个实例的抖动序列不同, 但每次运行相同
+    m_rng = m_model->seed + g_instanceNum.fetch_add(1, std::memory_order_relaxed) * 7919u;
+    m_inputs.assign(m_model->inputs.size(), std::vector<uint8_t>());
+    m_outputMems.assign(m_model->outputs.size(), nullptr);
+    m_outputMemFloat.assign(m_model->outputs.size(), false);
+}
+
+int rknn::CpuBackend::init(const ModelBlob& blob) {
+    std::shared_ptr<CpuModel> model = build_model(blob);
+    if(model == nullptr){
+        return RKNN_ERR_MODEL_INVALID;
+    }
+    attach(model);
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::dup(rknn_context* ctx_in) {
+    if(ctx_in == nullptr || *ctx_in == 0){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    // ctx_in只是整数, 不是本进程中活着的CpuBackend (已销毁, 或来自NpuBackend) 时拒绝
+    std::shared_ptr<const CpuModel> model;
+    {
+        std::lock_guard<std::mutex> lock(g_contextMtx);
+        auto iter = g_contexts.find(reinterpret_cast<const CpuBackend*>((uintptr_t)*ctx_in));
+        if(iter == g_contexts.end()){
+            LOGW("cpu backend: dup from a context that is not a live cpu backend context");
+            return RKNN_ERR_CTX_INVALID;
+        }
+        model = (*iter)->m_model;
+    }
+    attach(model);
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::set_core_mask(rknn_core_mask core_mask) {
+    if((int)core_mask < 0 || (int)core_mask > RKNN_NPU_CORE_0_1_2){
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    m_coreMask = core_mask;
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::query(rknn_query_cmd cmd, void* info, uint32_t size) {
+    if(m_model == nullptr){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    if(info == nullptr){
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    switch(cmd){
+        case RKNN_QUERY_IN_OUT_NUM: {
+            if(size < sizeof(rknn_input_output_num)){
+                return RKNN_ERR_PARAM_INVALID;
+            }
+            rknn_input_output_num* num = (rknn_input_output_num*)info;
+            num->n_input = (uint32_t)m_model->inputs.size();
+            num->n_output = (uint32_t)m_model->outputs.size();
+            return RKNN_SUCC;
+        }
+        case RKNN_QUERY_INPUT_ATTR:
+        case RKNN_QUERY_OUTPUT_ATTR: {
+            if(size < sizeof(rknn_tensor_attr)){
+                return RKNN_ERR_PARAM_INVALID;
+            }
+            rknn_tensor_attr* attr = (rknn_tensor_attr*)info;
+            const std::vector<rknn_tensor_attr>& attrs = cmd == RKNN_QUERY_INPUT_ATTR ? m_model->inputs
+                                                                                       : m_model->outputs;
+            if(attr->index >= attrs.size()){
+                return RKNN_ERR_PARAM_INVALID;
+            }
+            *attr = attrs[attr->index];
+            return RKNN_SUCC;
+        }
+        default:
+            return RKNN_ERR_PARAM_INVALID;
+    }
+}
+
+int rknn::CpuBackend::inputs_set(uint32_t n_inputs, rknn_input inputs[]) {
+    if(m_model == nullptr){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    for(uint32_t i = 0; i < n_inputs; i++){
+        uint32_t index = inputs[i].index;
+        if(index >= m_model->inputs.size() || inputs[i].buf == nullptr || inputs[i].size > m_model->inputs[index].size){
+            return RKNN_ERR_INPUT_INVALID;
+        }
+        // 与librknnrt一样把输入拷入后端自己的内存
+        m_inputs[index].resize(m_model->inputs[index].size);
+        memcpy(m_inputs[index].data(), inputs[i].buf, inputs[i].size);
+    }
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::run() {
+    if(m_model == nullptr){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    int core = acquire_core(m_coreMask);
+    int run_us = m_model->core_us[core] >= 0 ? m_model->core_us[core] : m_model->run_us;
+    if(m_model->jitter_us > 0){
+        run_us += (int)(lcg_next(m_rng) % (uint32_t)m_model->jitter_us);
+    }
+    if(run_us > 0){
+        std::this_thread::sleep_for(std::chrono::microseconds(run_us));
+    }
+    m_frame = m_model->runs.fetch_add(1, std::memory_order_relaxed);
+    // 绑定了输出内存时, 结果在run结束时已经写入
+    for(uint32_t i = 0; i < m_outputMems.size(); i++){
+        if(m_outputMems[i] != nullptr){
+            write_output(i, m_outputMemFloat[i], m_outputMems[i]->virt_addr);
+        }
+    }
+    release_core(core);
+    m_ran = true;
+    return RKNN_SUCC;
+}
+
+void rknn::CpuBackend::write_output(uint32_t index, bool want_float, void* dst) const {
+    const rknn_tensor_attr& attr = m_model->outputs[index];
+    // 回放时依次循环录制的帧, 合成的模型只有一帧
+    const std::vector<uint8_t>& data = m_model->frames[m_frame % m_model->frames.size()][index];
+    if(!want_float || attr.type == RKNN_TENSOR_FLOAT32){
+        memcpy(dst, data.data(), attr.size);
+        return;
+    }
+    float* out = (float*)dst;
+    if(attr.type == RKNN_TENSOR_FLOAT16){
+        const uint16_t* half = (const uint16_t*)data.data();
+        for(uint32_t n = 0; n < attr.n_elems; n++){
+            out[n] = half_to_float(half[n]);
+        }
+    }else if(attr.type == RKNN_TENSOR_UINT8){
+        for(uint32_t n = 0; n < attr.n_elems; n++){
+            out[n] = (data[n] - attr.zp) * attr.scale;
+        }
+    }else{
+        const int8_t* q = (const int8_t*)data.data();
+        for(uint32_t n = 0; n < attr.n_elems; n++){
+            out[n] = (q[n] - attr.zp) * attr.scale;
+        }
+    }
+}
+
+int rknn::CpuBackend::outputs_get(uint32_t n_outputs, rknn_output outputs[]) {
+    if(m_model == nullptr){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    if(!m_ran){
+        return RKNN_ERR_FAIL;
+    }
+    for(uint32_t i = 0; i < n_outputs; i++){
+        uint32_t index = outputs[i].index;
+        if(index >= m_model->outputs.size()){
+            return RKNN_ERR_OUTPUT_INVALID;
+        }
+        bool want_float = outputs[i].want_float != 0;
+        uint32_t size = output_size(m_model->outputs[index], want_float);
+        if(outputs[i].is_prealloc){
+            if(outputs[i].buf == nullptr || outputs[i].size < size){
+                return RKNN_ERR_OUTPUT_INVALID;
+            }
+        }else{
+            outputs[i].buf = malloc(size);
+            if(outputs[i].buf == nullptr){
+                return RKNN_ERR_MALLOC_FAIL;
+            }
+            outputs[i].size = size;
+        }
+        write_output(index, want_float, outputs[i].buf);
+    }
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::outputs_release(uint32_t n_outputs, rknn_output outputs[]) {
+    for(uint32_t i = 0; i < n_outputs; i++){
+        if(!outputs[i].is_prealloc && outputs[i].buf != nullptr){
+            free(outputs[i].buf);
+            outputs[i].buf = nullptr;
+        }
+    }
+    return RKNN_SUCC;
+}
+
+rknn_tensor_mem* rknn::CpuBackend::create_mem(uint32_t size) {
+    if(size == 0){
+        return nullptr;
+    }
+    rknn_tensor_mem* mem = (rknn_tensor_mem*)calloc(1, sizeof(rknn_tensor_mem));
+    if(mem == nullptr){
+        return nullptr;
+    }
+    mem->virt_addr = calloc(1, size);
+    if(mem->virt_addr == nullptr){
+        free(mem);
+        return nullptr;
+    }
+    // 没有dma-buf, fd为-1时调用方按虚拟地址访问
+    mem->fd = -1;
+    mem->size = size;
+    m_mems.push_back(mem);
+    return mem;
+}
+
+int rknn::CpuBackend::destroy_mem(rknn_tensor_mem* mem) {
+    // 只接受本上下文分配且未销毁的内存 (重复销毁或来自其它上下文时报错)
+    auto iter = std::find(m_mems.begin(), m_mems.end(), mem);
+    if(mem == nullptr || iter == m_mems.end()){
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    m_mems.erase(iter);
+    std::replace(m_outputMems.begin(), m_outputMems.end(), mem, (rknn_tensor_mem*)nullptr);
+    free(mem->virt_addr);
+    free(mem);
+    return RKNN_SUCC;
+}
+
+int rknn::CpuBackend::set_io_mem(rknn_tensor_mem* mem, rknn_tensor_attr* attr) {
+    if(m_model == nullptr){
+        return RKNN_ERR_CTX_INVALID;
+    }
+    if(mem == nullptr || attr == nullptr || std::find(m_mems.begin(), m_mems.end(), mem) == m_mems.end()){
+        return RKNN_ERR_PARAM_INVALID;
+    }
+    // 与librknnrt一样按张量名区分输入和输出
+    for(const rknn_tensor_attr& input : m_model->inputs){
+        if(strcmp(input.name, attr->name) == 0){
+            return mem->size >= input.size ? RKNN_SUCC : RKNN_ERR_PARAM_INVALID;
+        }
+    }
+    for(uint32_t i = 0; i < m_model->outputs.size(); i++){
+        if(strcmp(m_model->outputs[i].name, attr->name) == 0){
+            bool want_float = attr->type == RKNN_TENSOR_FLOAT32;
+            if(mem->size < output_size(m_model->outputs[i], want_float)){
+                return RKNN_ERR_PARAM_INVALID;
+            }
+            m_outputMems[i] = mem;
+            m_outputMemFloat[i] = want_float;
+            return RKNN_SUCC;
+        }
+    }
+    return RKNN_ERR_PARAM_INVALID;
+}
+
+namespace {
+
+    std::mutex g_recorderMtx;
+    std::map<std::string, std::weak_ptr<rknn::TensorRecorder>> g_recorders;
+
+    // 删除目录中上一次录制的帧文件和回放描述, 帧数少于上一次时不会混入旧的帧
+    void remove_recording(const std::string& dir) {
+        DIR* dp = opendir(dir.c_str());
+        if(dp == NULL){
+            return;
+        }
+        int removed = 0;
+        while(dirent* entry = readdir(dp)){
+            std::string name = entry->d_name;
+            bool frame = name.size() > 10 && name.compare(0, 6, "frame_") == 0 &&
+                         name.compare(name.size() - 4, 4, ".bin") == 0;
+            if(frame || name == "model.spec"){
+                removed += unlink((dir + "/" + name).c_str()) == 0 ? 1 : 0;
+            }
+        }
+        closedir(dp);
+        if(removed > 0){
+            LOG("removed %d files of an earlier recording from %s", removed, dir.c_str());
+        }
+    }
+
+} // namespace
+
+std::shared_ptr<rknn::TensorRecorder> rknn::TensorRecorder::open(const std::string& dir, const rknn_tensor_attr* inputs,
+                                                                 uint32_t n_inputs, const rknn_tensor_attr* outputs,
+                                                                 uint32_t n_outputs, bool want_float, int max_frames) {
+    // 录制的是Model实际取得的数据: 非量化模型以float32取输出
+    std::string layout = "# kind index name fmt type qnt dims zp scale\n";
+    std::vector<uint32_t> sizes;
+    for(uint32_t i = 0; i < n_inputs; i++){
+        layout += format_attr("input", inputs[i]);
+    }
+    for(uint32_t i = 0; i < n_outputs; i++){
+        rknn_tensor_attr attr = outputs[i];
+        if(want_float){
+            attr.type = RKNN_TENSOR_FLOAT32;
+            attr.qnt_type = RKNN_TENSOR_QNT_NONE;
+            attr.zp = 0;
+            attr.scale = 1.0f;
+        }
+        layout += format_attr("output", attr);
+        sizes.push_back(attr.n_elems * type_size(attr.type));
+    }
+
+    std::lock_guard<std::mutex> lock(g_recorderMtx);
+    auto iter = g_recorders.find(dir);
+    if(iter != g_recorders.end()){
+        std::shared_ptr<TensorRecorder> recorder = iter->second.lock();
+        if(recorder){
+            if(recorder->m_layout != layout){
+                LOGW("%s is already recording a model with different tensors", dir.c_str());
+                return nullptr;
+            }
+            return recorder;
+        }
+    }
+
+    if(mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST){
+        LOGW("cannot create %s: %s", dir.c_str(), strerror(errno));
+        return nullptr;
+    }
+    remove_recording(dir);
+    FILE* fp = fopen((dir + "/tensors.txt").c_str(), "w");
+    if(fp == NULL){
+        LOGW("cannot write %s/tensors.txt", dir.c_str());
+        return nullptr;
+    }
+    fputs(layout.c_str(), fp);
+    fclose(fp);
+
+    std::shared_ptr<TensorRecorder> recorder(new TensorRecorder());
+    recorder->m_dir = dir;
+    recorder->m_layout = layout;
+    recorder->m_sizes = sizes;
+    recorder->m_maxFrames = max_frames;
+    g_recorders[dir] = recorder;
+    LOG("recording output tensors to %s", dir.c_str());
+    return recorder;
+}
+
+void rknn::TensorRecorder::write(const rknn_output* outputs, uint32_t n_outputs, int64_t run_us) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if((m_maxFrames > 0 && m_frames >= m_maxFrames) || n_outputs != m_sizes.size()){
+        return;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/frame_%06d.bin", m_frames);
+    FILE* fp = fopen((m_dir + name).c_str(), "wb");
+    if(fp == NULL){
+        LOGW("cannot write %s%s", m_dir.c_str(), name);
+        return;
+    }
+    bool ok = true;
+    for(uint32_t i = 0; i < n_outputs; i++){
+        ok = ok && fwrite(outputs[i].buf, 1, m_sizes[i], fp) == m_sizes[i];
+    }
+    if(fclose(fp) != 0 || !ok){
+        LOGW("cannot write %s%s", m_dir.c_str(), name);
+        return;
+    }
+    m_frames++;
+    m_runUs += run_us;
+}
+
+int rknn::TensorRecorder::frames() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_frames;
+}
+
+rknn::TensorRecorder::~TensorRecorder() {
+    // 最后一个使用者释放时写出回放描述
+    FILE* fp = fopen((m_dir + "/model.spec").c_str(), "w");
+    if(fp == NULL){
+        LOGW("cannot write %s/model.spec", m_dir.c_str());
+        return;
+    }
+    fprintf(fp, "# %d frames recorded by rknn::TensorRecorder, replay with BackendType::CPU\n", m_frames);
+    fprintf(fp, "replay=.\n");
+    fprintf(fp, "frames=%d\n", m_frames);
+    fprintf(fp, "run_us=%lld\n", (long long)(m_frames > 0 ? m_runUs / m_frames : 0));
+    fclose(fp);
+    LOG("recorded %d frames to %s", m_frames, m_dir.c_str());
+}
@@ -0,0 +1,103 @@
+#include "frame_source.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+
+#include "opencv2/imgcodecs.hpp"
+
+rknn::VideoSource::VideoSource(const std::string& uri) : m_uri(uri), m_capture(uri) {
+}
+
+bool rknn::VideoSource::read(cv::Mat& frame) {
+    return m_capture.isOpened() && m_capture.read(frame) && !frame.empty();
+}
+
+bool rknn::VideoSource::rewind() {
+    // 网络流无法定位, 重新打开文件比设置帧位置在各后端上都可靠
+    m_capture.release();
+    return m_capture.open(m_uri) && m_capture.isOpened();
+}
+
+double rknn::VideoSource::fps() const {
+    return m_capture.isOpened() ? m_capture.get(cv::CAP_PROP_FPS) : 0;
+}
+
+rknn::ImageDirSource::ImageDirSource(const std::string& dir) : m_dir(dir) {
+    cv::glob(dir + "/*", m_files, false);
+    std::sort(m_files.begin(), m_files.end());
+}
+
+bool rknn::ImageDirSource::read(cv::Mat& frame) {
+    while(m_next < m_files.size()){
+        frame = cv::imread(m_files[m_next++]);
+        if(!frame.empty()){
+            return true;
+        }
+    }
+    return false;
+}
+
+bool rknn::ImageDirSource::rewind() {
+    m_next = 0;
+    return !m_files.empty();
+}
+
+rknn::RawFrameSource::RawFrameSource(const std::string& path, int width, int height)
+    : m_path(path), m_width(width), m_height(height) {
+    m_file = fopen(path.c_str(), "rb");
+}
+
+rknn::RawFrameSource::~RawFrameSource() {
+    if(m_file != nullptr){
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+bool rknn::RawFrameSource::read(cv::Mat& frame) {
+    if(m_file == nullptr || m_width <= 0 || m_height <= 0){
+        return false;
+    }
+    // 每帧新建Mat: 上一帧可能还在推理队列中被引用
+    frame.create(m_height, m_width, CV_8UC3);
+    size_t frame_size = (size_t)m_width * m_height * 3;
+    return fread(frame.data, 1, frame_size, m_file) == frame_size;
+}
+
+bool rknn::RawFrameSource::rewind() {
+    return m_file != nullptr && fseek(m_file, 0, SEEK_SET) == 0;
+}
+
+std::unique_ptr<rknn::FrameSource> rknn::create_frame_source(const std::string& uri) {
+    std::unique_ptr<FrameSource> source;
+    if(uri.compare(0, 4, "dir:") == 0){
+        auto dir_source = std::make_unique<ImageDirSource>(uri.substr(4));
+        if(!dir_source->rewind()){
+            LOGW("no image found in %s", uri.c_str());
+            return nullptr;
+        }
+        source = std::move(dir_source);
+    }else if(uri.compare(0, 4, "raw:") == 0){
+        int width = 0;
+        int height = 0;
+        int consumed = 0;
+        if(sscanf(uri.c_str() + 4, "%dx%d:%n", &width, &height, &consumed) != 2 || consumed == 0){
+            LOGW("bad raw source %s, expected raw:<width>x<height>:<file>", uri.c_str());
+            return nullptr;
+        }
+        auto raw_source = std::make_unique<RawFrameSource>(uri.substr(4 + consumed), width, height);
+        if(!raw_source->rewind()){
+            LOGW("cannot open raw frame file %s", uri.c_str());
+            return nullptr;
+        }
+        source = std::move(raw_source);
+    }else{
+        auto video_source = std::make_unique<VideoSource>(uri);
+        if(!video_source->is_opened()){
+            LOGW("cannot open video source %s", uri.c_str());
+            return nullptr;
+        }
+        source = std::move(video_source);
+    }
+    return source;
+}
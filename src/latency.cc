@@ -0,0 +1,185 @@
+#include "latency.hpp"
+#include "logger.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> rknn::LatencyStats::s_enabled(false);
+
+namespace {
+
+    constexpr int STAGE_NUM = (int)rknn::Stage::COUNT;
+    constexpr int SUB_BITS = 5;                         // 每个2的幂区间32个子桶
+    constexpr int SUB_COUNT = 1 << SUB_BITS;
+    constexpr int MAX_MSB = 40;                         // 2^40ns约18分钟, 更大的值记入最后一个桶
+    constexpr int BUCKET_NUM = (MAX_MSB - SUB_BITS + 1) * SUB_COUNT + SUB_COUNT;
+
+    // 小于32的值各占一个桶; 其余值取最高的6位: 桶号 = shift * 32 + (v >> shift), shift = msb - 5
+    inline int bucket_index(uint64_t v) {
+        if(v < SUB_COUNT){
+            return (int)v;
+        }
+        int msb = 63 - __builtin_clzll(v);
+        if(msb > MAX_MSB){
+            return BUCKET_NUM - 1;
+        }
+        int shift = msb - SUB_BITS;
+        return (shift << SUB_BITS) + (int)(v >> shift);
+    }
+
+    // 桶内取中点作为代表值
+    inline double bucket_value(int index) {
+        if(index < SUB_COUNT){
+            return index;
+        }
+        int shift = (index >> SUB_BITS) - 1;
+        uint64_t low = (uint64_t)((index & (SUB_COUNT - 1)) + SUB_COUNT) << shift;
+        return low + ((1ull << shift) - 1) / 2.0;
+    }
+
+    // 一个线程独占写入的计数; 只有所属线程写, 用relaxed的load+store代替fetch_add
+    struct Shard {
+        std::atomic<uint64_t> buckets[STAGE_NUM][BUCKET_NUM];
+        std::atomic<uint64_t> count[STAGE_NUM];
+        std::atomic<uint64_t> sum[STAGE_NUM];
+        std::atomic<uint64_t> max[STAGE_NUM];
+    };
+
+    inline void bump(std::atomic<uint64_t>& value, uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    // 分片只增不删: 线程退出时分片连同计数一起留给之后新建的线程复用
+    std::mutex g_shardMtx;
+    std::vector<std::unique_ptr<Shard>> g_shards;
+    std::vector<Shard*> g_freeShards;
+
+    struct ShardHolder {
+        Shard* shard = nullptr;
+        ~ShardHolder() {
+            if(shard != nullptr){
+                std::lock_guard<std::mutex> lock(g_shardMtx);
+                g_freeShards.push_back(shard);
+            }
+        }
+    };
+
+    Shard* local_shard() {
+        static thread_local ShardHolder holder;
+        if(holder.shard == nullptr){
+            std::lock_guard<std::mutex> lock(g_shardMtx);
+            if(!g_freeShards.empty()){
+                holder.shard = g_freeShards.back();
+                g_freeShards.pop_back();
+            }else{
+                g_shards.emplace_back(new Shard());
+                holder.shard = g_shards.back().get();
+            }
+        }
+        return holder.shard;
+    }
+
+} // namespace
+
+const char* rknn::stage_name(Stage stage) {
+    switch (stage) {
+        case Stage::PREPROCESS:  return "preprocess";
+        case Stage::INPUTS_SET:  return "inputs_set";
+        case Stage::RUN:         return "rknn_run";
+        case Stage::OUTPUTS_GET: return "outputs_get";
+        case Stage::POSTPROCESS: return "postprocess";
+        case Stage::NMS:         return "nms";
+        case Stage::TOTAL:       return "total";
+        default:                 return "unknown";
+    }
+}
+
+void rknn::LatencyStats::record(Stage stage, uint64_t ns) {
+    Shard* shard = local_shard();
+    int s = (int)stage;
+    bump(shard->buckets[s][bucket_index(ns)], 1);
+    bump(shard->count[s], 1);
+    bump(shard->sum[s], ns);
+    if(ns > shard->max[s].load(std::memory_order_relaxed)){
+        shard->max[s].store(ns, std::memory_order_relaxed);
+    }
+}
+
+rknn::LatencySummary rknn::LatencyStats::summary(Stage stage) {
+    int s = (int)stage;
+    std::vector<uint64_t> buckets(BUCKET_NUM, 0);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_shardMtx);
+        for(auto& shard : g_shards){
+            for(int i = 0; i < BUCKET_NUM; i++){
+                buckets[i] += shard->buckets[s][i].load(std::memory_order_relaxed);
+            }
+            count += shard->count[s].load(std::memory_order_relaxed);
+            sum += shard->sum[s].load(std::memory_order_relaxed);
+            max = std::max(max, shard->max[s].load(std::memory_order_relaxed));
+        }
+    }
+
+    LatencySummary result;
+    // 分片之间不是同一时刻的快照, 以桶计数之和为准
+    uint64_t total = 0;
+    for(int i = 0; i < BUCKET_NUM; i++){
+        total += buckets[i];
+    }
+    if(total == 0){
+        return result;
+    }
+    result.count = total;
+    result.mean_us = count > 0 ? sum / 1000.0 / count : 0;
+    result.max_us = max / 1000.0;
+
+    const double quantiles[3] = {0.50, 0.90, 0.99};
+    double* outputs[3] = {&result.p50_us, &result.p90_us, &result.p99_us};
+    uint64_t ranks[3];
+    for(int q = 0; q < 3; q++){
+        ranks[q] = std::max<uint64_t>(1, (uint64_t)ceil(quantiles[q] * total));
+    }
+    uint64_t seen = 0;
+    int q = 0;
+    for(int i = 0; i < BUCKET_NUM && q < 3; i++){
+        seen += buckets[i];
+        while(q < 3 && seen >= ranks[q]){
+            // 分位数不超过记录到的最大值 (最后一个桶的中点可能大于max)
+            *outputs[q] = std::min(bucket_value(i), (double)max) / 1000.0;
+            q++;
+        }
+    }
+    return result;
+}
+
+void rknn::LatencyStats::reset() {
+    std::lock_guard<std::mutex> lock(g_shardMtx);
+    for(auto& shard : g_shards){
+        for(int s = 0; s < STAGE_NUM; s++){
+            for(int i = 0; i < BUCKET_NUM; i++){
+                shard->buckets[s][i].store(0, std::memory_order_relaxed);
+            }
+            shard->count[s].store(0, std::memory_order_relaxed);
+            shard->sum[s].store(0, std::memory_order_relaxed);
+            shard->max[s].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void rknn::LatencyStats::report() {
+    LOG("%-12s %8s %9s %9s %9s %9s %9s", "stage", "count", "mean(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+    for(int s = 0; s < STAGE_NUM; s++){
+        LatencySummary stats = summary((Stage)s);
+        if(stats.count == 0){
+            continue;
+        }
+        LOG("%-12s %8llu %9.1f %9.1f %9.1f %9.1f %9.1f", stage_name((Stage)s), (unsigned long long)stats.count,
+            stats.mean_us, stats.p50_us, stats.p90_us, stats.p99_us, stats.max_us);
+    }
+}
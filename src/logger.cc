@@ -1,42 +1,327 @@
 #include "logger.hpp"
 #include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace std;
 
 namespace logger {
 
-Level Logger::m_level = Level::INFO;
+namespace {
 
-Logger::Logger(Level level) {
-    m_level = level;
+constexpr size_t RECORD_SIZE = 1024;    // 单条消息 (含级别前缀) 的上限, 超出部分截断并以...结尾
+constexpr uint64_t RING_SIZE = 128;     // 每个线程缓冲的消息条数 (每线程128KB)
+constexpr auto FLUSH_INTERVAL = chrono::milliseconds(20);
+
+struct Record {
+    uint64_t seq;
+    uint32_t len;
+    char text[RECORD_SIZE];
+};
+
+// 一个线程的环形缓冲区: 所属线程写head, 后台线程写tail, 各自单写, 不加锁
+struct Buffer {
+    vector<Record> records = vector<Record>(RING_SIZE);
+    atomic<uint64_t> head{0};
+    atomic<uint64_t> tail{0};
+    atomic<uint64_t> dropped{0};
+    bool exited = false;        // 由State::bufferMtx保护, 线程退出后不再写入
+};
+
+// 全局状态不析构: 进程退出时仍在运行的线程可能还在写日志
+struct State {
+    mutex bufferMtx;
+    vector<unique_ptr<Buffer>> buffers;
+    atomic<uint64_t> seq{0};
+
+    mutex drainMtx;             // 后台线程与flush()不同时输出
+    // drain()的临时容器, 由drainMtx保护; 保留容量, 稳态下后台线程每次输出不再分配内存
+    vector<Buffer*> drainBuffers;
+    vector<const Record*> drainRecords;
+    vector<uint64_t> drainHeads;
+    string drainOut;
+
+    mutex flushMtx;
+    condition_variable flushCv;
+    bool wake = false;
+    bool stop = false;
+    thread flusher;
+    once_flag startOnce;
+    atomic<bool> running{false};
+    atomic<bool> async{true};
+};
+
+State& state() {
+    static State* s = new State();
+    return *s;
 }
 
-void Logger::__log_info(Level level, const char* format, ...) {
-    char msg[1000];
-    va_list args;
-    va_start(args, format);
-    int n = 0;
+struct BufferHolder {
+    Buffer* buffer = nullptr;
+    ~BufferHolder() {
+        if (buffer != nullptr) {
+            State& s = state();
+            lock_guard<mutex> lock(s.bufferMtx);
+            buffer->exited = true;
+        }
+    }
+};
+
+Buffer* local_buffer() {
+    static thread_local BufferHolder holder;
+    if (holder.buffer == nullptr) {
+        State& s = state();
+        unique_ptr<Buffer> buffer(new Buffer());
+        lock_guard<mutex> lock(s.bufferMtx);
+        holder.buffer = buffer.get();
+        s.buffers.push_back(move(buffer));
+    }
+    return holder.buffer;
+}
+
+// 截断的消息以...结尾; 不切断UTF-8多字节字符
+void mark_truncated(char* msg, size_t& len, size_t begin) {
+    size_t pos = len - 3;
+    while (pos > begin && ((unsigned char)msg[pos] & 0xC0) == 0x80) {
+        pos--;
+    }
+    memcpy(msg + pos, "...", 3);
+    len = pos + 3;
+}
 
+// 级别前缀 + 消息 + 换行, 返回写入的长度
+size_t format_record(char* msg, size_t size, Level level, uint32_t suppressed, const char* format, va_list args) {
+    int n = 0;
     switch (level) {
-        case Level::DEBUG: n += snprintf(msg + n, sizeof(msg) - n, DGREEN "[debug]" CLEAR); break;
-        case Level::VERB:  n += snprintf(msg + n, sizeof(msg) - n, PURPLE "[verb]" CLEAR); break;
-        case Level::INFO:  n += snprintf(msg + n, sizeof(msg) - n, YELLOW "[info]" CLEAR); break;
-        case Level::WARN:  n += snprintf(msg + n, sizeof(msg) - n, BLUE "[warn]" CLEAR); break;
-        case Level::ERROR: n += snprintf(msg + n, sizeof(msg) - n, RED "[error]" CLEAR); break;
-        default:           n += snprintf(msg + n, sizeof(msg) - n, RED "[fatal]" CLEAR); break;
+        case Level::DEBUG: n = snprintf(msg, size, DGREEN "[debug]" CLEAR); break;
+        case Level::VERB:  n = snprintf(msg, size, PURPLE "[verb]" CLEAR); break;
+        case Level::INFO:  n = snprintf(msg, size, YELLOW "[info]" CLEAR); break;
+        case Level::WARN:  n = snprintf(msg, size, BLUE "[warn]" CLEAR); break;
+        case Level::ERROR: n = snprintf(msg, size, RED "[error]" CLEAR); break;
+        default:           n = snprintf(msg, size, RED "[fatal]" CLEAR); break;
+    }
+
+    // 留一个字节给换行
+    size_t cap = size - 1;
+    int m = vsnprintf(msg + n, cap - n, format, args);
+    size_t full = (size_t)n + (m > 0 ? (size_t)m : 0);
+    if (suppressed > 0 && full < cap - 1) {
+        m = snprintf(msg + full, cap - full, " (%u similar messages suppressed)", suppressed);
+        full += m > 0 ? (size_t)m : 0;
     }
+    size_t len = min(cap - 1, full);
+    if (full > len) {
+        mark_truncated(msg, len, (size_t)n);
+    }
+    msg[len++] = '\n';
+    msg[len] = '\0';
+    return len;
+}
 
-    n += vsnprintf(msg + n, sizeof(msg) - n, format, args);
+// 按序号合并各线程已写入的消息并输出; 已退出线程的缓冲区写完后释放
+void drain() {
+    State& s = state();
+    lock_guard<mutex> drain_lock(s.drainMtx);
 
-    va_end(args);
+    vector<Buffer*>& buffers = s.drainBuffers;
+    buffers.clear();
+    {
+        lock_guard<mutex> lock(s.bufferMtx);
+        for (auto& buffer : s.buffers) {
+            buffers.push_back(buffer.get());
+        }
+    }
+
+    vector<const Record*>& records = s.drainRecords;
+    vector<uint64_t>& heads = s.drainHeads;
+    records.clear();
+    heads.assign(buffers.size(), 0);
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        Buffer* buffer = buffers[i];
+        uint64_t tail = buffer->tail.load(memory_order_relaxed);
+        heads[i] = buffer->head.load(memory_order_acquire);
+        for (uint64_t n = tail; n < heads[i]; n++) {
+            records.push_back(&buffer->records[n % RING_SIZE]);
+        }
+        dropped += buffer->dropped.exchange(0, memory_order_relaxed);
+    }
+    sort(records.begin(), records.end(), [](const Record* a, const Record* b) { return a->seq < b->seq; });
+
+    string& out = s.drainOut;
+    out.clear();
+    for (const Record* record : records) {
+        out.append(record->text, record->len);
+    }
+    if (dropped > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), BLUE "[warn]" CLEAR "logger: %llu messages dropped, log buffer full\n",
+                 (unsigned long long)dropped);
+        out += msg;
+    }
+    if (!out.empty()) {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+
+    // 输出之后才归还槽位
+    for (size_t i = 0; i < buffers.size(); i++) {
+        buffers[i]->tail.store(heads[i], memory_order_release);
+    }
+    lock_guard<mutex> lock(s.bufferMtx);
+    s.buffers.erase(remove_if(s.buffers.begin(), s.buffers.end(),
+                              [](const unique_ptr<Buffer>& buffer) {
+                                  return buffer->exited &&
+                                         buffer->tail.load(memory_order_relaxed) ==
+                                             buffer->head.load(memory_order_relaxed);
+                              }),
+                    s.buffers.end());
+}
+
+void wake_flusher() {
+    State& s = state();
+    {
+        lock_guard<mutex> lock(s.flushMtx);
+        s.wake = true;
+    }
+    s.flushCv.notify_one();
+}
 
-    if (level <= m_level)
-        fprintf(stdout, "%s\n", msg);
+void flush_loop() {
+    State& s = state();
+    unique_lock<mutex> lock(s.flushMtx);
+    while (!s.stop) {
+        s.flushCv.wait_for(lock, FLUSH_INTERVAL, [&s] { return s.stop || s.wake; });
+        s.wake = false;
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
 
+// 进程退出时停止后台线程并写完剩余消息, 之后的日志同步输出
+void stop_flusher() {
+    State& s = state();
+    {
+        lock_guard<mutex> lock(s.flushMtx);
+        s.stop = true;
+    }
+    s.flushCv.notify_one();
+    s.running.store(false);
+    if (s.flusher.joinable() && s.flusher.get_id() != this_thread::get_id()) {
+        s.flusher.join();
+    }
+    drain();
+}
+
+bool start_flusher() {
+    State& s = state();
+    call_once(s.startOnce, [&s] {
+        s.flusher = thread(flush_loop);
+        s.running.store(true);
+        atexit(stop_flusher);
+    });
+    return s.running.load(memory_order_relaxed);
+}
+
+void write_sync(Level level, uint32_t suppressed, const char* format, va_list args) {
+    char msg[RECORD_SIZE];
+    size_t len = format_record(msg, sizeof(msg), level, suppressed, format, args);
+    fwrite(msg, 1, len, stdout);
+}
+
+void vlog(const Logger* instance, Level level, uint32_t suppressed, const char* format, va_list args) {
+    State& s = state();
     if (level <= Level::ERROR) {
+        // 先输出其它线程已写入的消息, 保证结束前的日志完整
+        if (Logger::enabled(instance, level)) {
+            Logger::flush();
+            write_sync(level, suppressed, format, args);
+        }
         fflush(stdout);
         exit(0);
     }
+    if (!Logger::enabled(instance, level)) {
+        return;
+    }
+    if (!s.async.load(memory_order_relaxed) || !start_flusher()) {
+        write_sync(level, suppressed, format, args);
+        return;
+    }
+
+    Buffer* buffer = local_buffer();
+    uint64_t head = buffer->head.load(memory_order_relaxed);
+    uint64_t used = head - buffer->tail.load(memory_order_acquire);
+    if (used >= RING_SIZE) {
+        buffer->dropped.fetch_add(1, memory_order_relaxed);
+        wake_flusher();
+        return;
+    }
+    Record& record = buffer->records[head % RING_SIZE];
+    record.seq = s.seq.fetch_add(1, memory_order_relaxed);
+    record.len = (uint32_t)format_record(record.text, sizeof(record.text), level, suppressed, format, args);
+    buffer->head.store(head + 1, memory_order_release);
+    // 快写满时提前输出, 否则等后台线程定期输出
+    if (used + 1 >= RING_SIZE * 3 / 4) {
+        wake_flusher();
+    }
+}
+
+} // namespace
+
+atomic<int32_t> Logger::s_level((int32_t)Level::INFO);
+
+Logger::Logger() : m_level(s_level.load(memory_order_relaxed)) {
+}
+
+Logger::Logger(Level level) : m_level((int32_t)level) {
+}
+
+void Logger::set_async(bool async) {
+    if (!async) {
+        flush();
+    }
+    state().async.store(async);
+}
+
+void Logger::flush() {
+    drain();
+}
+
+void Logger::__log_info(Level level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vlog(nullptr, level, 0, format, args);
+    va_end(args);
+}
+
+void Logger::__log(const Logger* instance, Level level, uint32_t suppressed, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vlog(instance, level, suppressed, format, args);
+    va_end(args);
+}
+
+RateLimiter::RateLimiter(int interval_ms)
+    : m_intervalNs((int64_t)interval_ms * 1000000), m_nextNs(0), m_suppressed(0) {
+}
+
+bool RateLimiter::allow(uint32_t& suppressed) {
+    int64_t now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t next = m_nextNs.load(memory_order_relaxed);
+    // 多个线程同时到期时只放行一个
+    if (now < next || !m_nextNs.compare_exchange_strong(next, now + m_intervalNs, memory_order_relaxed)) {
+        m_suppressed.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    suppressed = m_suppressed.exchange(0, memory_order_relaxed);
+    return true;
 }
 
 shared_ptr<Logger> create_logger(Level level) {
@@ -82,6 +82,10 @@ void test_multi_core(const std::string& img_path) {
         LOG("Creating model instance %d...", i);
         models.push_back(std::make_unique<detector::YOLO11>(model_path, logger::Level::INFO, detect_param));
     }
+    // 3个独立上下文共用一次文件映射
+    rknn::ModelCache::Stats cache_stats = rknn::ModelCache::stats();
+    LOG("Model file loads: %llu, cache hits: %llu", (unsigned long long)cache_stats.loads,
+        (unsigned long long)cache_stats.hits);
 
     cv::Mat img = cv::imread(img_path);
 
@@ -131,6 +135,10 @@ void test_share_weight(const std::string& img_path) {
         shared_models.push_back(std::make_unique<detector::YOLO11>(
             model_path, logger::Level::INFO, primary_model->get_context(), detect_param));
     }
+    // 共享权重的实例不读模型文件
+    rknn::ModelCache::Stats cache_stats = rknn::ModelCache::stats();
+    LOG("Model file loads: %llu, cache hits: %llu", (unsigned long long)cache_stats.loads,
+        (unsigned long long)cache_stats.hits);
 
     cv::Mat img = cv::imread(img_path);
 
@@ -353,6 +361,7 @@ void print_usage(const char* program_name) {
     LOG("    pool5      - Test thread pool YOLOv5 (RknnPool)");
     LOG("    video      - Test thread pool video mode (producer-consumer)");
     LOG("  image_path: path to test image (default: ./model/car.jpg)");
+    LOG("Benchmarks and focused measurements (preprocess, nms, pipeline, batch, ...) are in rknn_bench, see --micro");
 }
 
 int main(int argc, char* argv[]){
@@ -0,0 +1,341 @@
+#include "metrics.hpp"
+#include "latency.hpp"
+#include "logger.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+    // 整数值按整数输出, 计数超过百万时不丢精度
+    std::string format_value(double value) {
+        char buf[64];
+        if(std::isinf(value)){
+            return value > 0 ? "+Inf" : "-Inf";
+        }
+        if(value == floor(value) && fabs(value) < 9007199254740992.0){
+            snprintf(buf, sizeof(buf), "%lld", (long long)value);
+        }else{
+            snprintf(buf, sizeof(buf), "%.9g", value);
+        }
+        return buf;
+    }
+
+    std::string join_labels(const std::string& labels, const std::string& extra) {
+        if(labels.empty()){
+            return extra;
+        }
+        if(extra.empty()){
+            return labels;
+        }
+        return labels + "," + extra;
+    }
+
+    template <typename Entry>
+    Entry* find_entry(std::vector<Entry>& entries, const std::string& name, const std::string& labels) {
+        for(auto& entry : entries){
+            if(entry.name == name && entry.labels == labels){
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // LatencyStats的各阶段耗时以summary导出, 没有记录的阶段跳过
+    void collect_latency(rknn::MetricsWriter& writer) {
+        const char* name = "rknn_stage_latency_microseconds";
+        const char* max_name = "rknn_stage_latency_max_microseconds";
+        writer.family(name, "summary", "Per-stage inference latency");
+        writer.family(max_name, "gauge", "Largest recorded latency per stage");
+        const std::pair<const char*, double rknn::LatencySummary::*> quantiles[3] = {
+            {"0.5", &rknn::LatencySummary::p50_us},
+            {"0.9", &rknn::LatencySummary::p90_us},
+            {"0.99", &rknn::LatencySummary::p99_us},
+        };
+        for(int s = 0; s < (int)rknn::Stage::COUNT; s++){
+            rknn::LatencySummary stats = rknn::LatencyStats::summary((rknn::Stage)s);
+            if(stats.count == 0){
+                continue;
+            }
+            std::string stage = std::string("stage=\"") + rknn::stage_name((rknn::Stage)s) + "\"";
+            for(auto& q : quantiles){
+                writer.sample(name, name, join_labels(stage, std::string("quantile=\"") + q.first + "\""), stats.*q.second);
+            }
+            writer.sample(name, std::string(name) + "_sum", stage, stats.mean_us * stats.count);
+            writer.sample(name, std::string(name) + "_count", stage, stats.count);
+            writer.sample(max_name, stage, stats.max_us);
+        }
+    }
+
+} // namespace
+
+rknn::Histogram::Histogram(const std::vector<double>& bounds) : m_bounds(bounds) {
+    std::sort(m_bounds.begin(), m_bounds.end());
+    m_buckets.reset(new std::atomic<uint64_t>[m_bounds.size() + 1]);
+    for(size_t i = 0; i <= m_bounds.size(); i++){
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void rknn::Histogram::observe(double value) {
+    size_t i = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) - m_bounds.begin();
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    double sum = m_sum.load(std::memory_order_relaxed);
+    while(!m_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)){
+    }
+}
+
+void rknn::MetricsWriter::family(const std::string& name, const char* type, const std::string& help) {
+    Family& family = m_families[name];
+    if(family.type.empty()){
+        family.type = type;
+        family.help = help;
+    }
+}
+
+void rknn::MetricsWriter::sample(const std::string& family, const std::string& name, const std::string& labels, double value) {
+    std::string& samples = m_families[family].samples;
+    samples += name;
+    if(!labels.empty()){
+        samples += "{" + labels + "}";
+    }
+    samples += " " + format_value(value) + "\n";
+}
+
+std::string rknn::MetricsWriter::text() const {
+    std::string out;
+    for(auto& item : m_families){
+        if(item.second.samples.empty()){
+            continue;
+        }
+        if(!item.second.help.empty()){
+            out += "# HELP " + item.first + " " + item.second.help + "\n";
+        }
+        if(!item.second.type.empty()){
+            out += "# TYPE " + item.first + " " + item.second.type + "\n";
+        }
+        out += item.second.samples;
+    }
+    return out;
+}
+
+rknn::MetricsRegistry& rknn::MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+rknn::Counter& rknn::MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto* entry = find_entry(m_counters, name, labels);
+    if(entry == nullptr){
+        m_counters.push_back(Entry<Counter>{name, help, labels, std::make_unique<Counter>()});
+        entry = &m_counters.back();
+    }
+    return *entry->metric;
+}
+
+rknn::Gauge& rknn::MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto* entry = find_entry(m_gauges, name, labels);
+    if(entry == nullptr){
+        m_gauges.push_back(Entry<Gauge>{name, help, labels, std::make_unique<Gauge>()});
+        entry = &m_gauges.back();
+    }
+    return *entry->metric;
+}
+
+rknn::Histogram& rknn::MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                                  const std::vector<double>& bounds, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto* entry = find_entry(m_histograms, name, labels);
+    if(entry == nullptr){
+        m_histograms.push_back(Entry<Histogram>{name, help, labels, std::make_unique<Histogram>(bounds)});
+        entry = &m_histograms.back();
+    }
+    return *entry->metric;
+}
+
+int rknn::MetricsRegistry::add_collector(Collector collector) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    int id = m_nextCollector++;
+    m_collectors[id] = std::move(collector);
+    return id;
+}
+
+void rknn::MetricsRegistry::remove_collector(int id) {
+    // 持锁删除: 返回后expose不会再调用该collector
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_collectors.erase(id);
+}
+
+std::string rknn::MetricsRegistry::expose() {
+    MetricsWriter writer;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        for(auto& entry : m_counters){
+            writer.family(entry.name, "counter", entry.help);
+            writer.sample(entry.name, entry.labels, entry.metric->value());
+        }
+        for(auto& entry : m_gauges){
+            writer.family(entry.name, "gauge", entry.help);
+            writer.sample(entry.name, entry.labels, entry.metric->value());
+        }
+        for(auto& entry : m_histograms){
+            const Histogram& histogram = *entry.metric;
+            writer.family(entry.name, "histogram", entry.help);
+            uint64_t cumulative = 0;
+            for(size_t i = 0; i <= histogram.bounds().size(); i++){
+                cumulative += histogram.bucket(i);
+                std::string le = i < histogram.bounds().size() ? format_value(histogram.bounds()[i]) : "+Inf";
+                writer.sample(entry.name, entry.name + "_bucket", join_labels(entry.labels, "le=\"" + le + "\""), cumulative);
+            }
+            writer.sample(entry.name, entry.name + "_sum", entry.labels, histogram.sum());
+            writer.sample(entry.name, entry.name + "_count", entry.labels, histogram.count());
+        }
+        for(auto& item : m_collectors){
+            item.second(writer);
+        }
+    }
+    collect_latency(writer);
+    return writer.text();
+}
+
+bool rknn::MetricsRegistry::write_file(const std::string& path) {
+    std::string text = expose();
+    std::string tmp_path = path + ".tmp";
+    FILE* fp = fopen(tmp_path.c_str(), "w");
+    if(fp == NULL){
+        LOGW("cannot open %s", tmp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+    ok = (fclose(fp) == 0) && ok;
+    if(!ok || rename(tmp_path.c_str(), path.c_str()) != 0){
+        LOGW("cannot write metrics to %s", path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+rknn::MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool rknn::MetricsServer::start(int port, const std::string& address) {
+    if(m_running){
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0){
+        LOGW("metrics server: socket fail: %s", strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if(inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1){
+        LOGW("metrics server: bad address %s", address.c_str());
+        close(fd);
+        return false;
+    }
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0){
+        LOGW("metrics server: cannot listen on %s:%d: %s", address.c_str(), port, strerror(errno));
+        close(fd);
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+
+    m_listenFd = fd;
+    m_port = ntohs(addr.sin_port);
+    m_running = true;
+    m_thread = std::thread(&MetricsServer::serve, this);
+    LOG("metrics server listening on http://%s:%d/metrics", address.c_str(), m_port);
+    return true;
+}
+
+void rknn::MetricsServer::stop() {
+    if(!m_running){
+        return;
+    }
+    m_running = false;
+    m_thread.join();
+    close(m_listenFd);
+    m_listenFd = -1;
+}
+
+void rknn::MetricsServer::serve() {
+    pollfd pfd;
+    pfd.fd = m_listenFd;
+    pfd.events = POLLIN;
+    while(m_running){
+        // 定期醒来检查m_running, stop不需要额外的唤醒机制
+        if(poll(&pfd, 1, 100) <= 0){
+            continue;
+        }
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if(fd < 0){
+            continue;
+        }
+        handle(fd);
+        close(fd);
+    }
+}
+
+void rknn::MetricsServer::handle(int fd) {
+    // 慢客户端不能卡住监听线程
+    timeval timeout = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[2048];
+    size_t received = 0;
+    while(received < sizeof(request) - 1){
+        ssize_t n = recv(fd, request + received, sizeof(request) - 1 - received, 0);
+        if(n <= 0){
+            break;
+        }
+        received += n;
+        request[received] = '\0';
+        if(strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr){
+            break;
+        }
+    }
+    request[received] = '\0';
+
+    std::string status = "404 Not Found";
+    std::string type = "text/plain";
+    std::string body = "not found\n";
+    if(strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET /metrics?", 13) == 0){
+        status = "200 OK";
+        type = "text/plain; version=0.0.4";
+        body = MetricsRegistry::instance().expose();
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                           "\r\nContent-Length: " + std::to_string(body.size()) +
+                           "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while(sent < response.size()){
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0){
+            break;
+        }
+        sent += n;
+    }
+}
@@ -0,0 +1,127 @@
+#include "model_cache.hpp"
+#include "logger.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    std::mutex g_cacheMtx;
+    std::map<std::string, std::weak_ptr<const rknn::ModelBlob>> g_blobs;
+    rknn::ModelCache::Stats g_stats;
+
+    inline int64_t mtime_ns(const struct stat& st) {
+        return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    // 同一文件的不同写法 (./model/a.rknn 与 model/a.rknn) 共用一个条目
+    std::string cache_key(const std::string& path) {
+        char resolved[PATH_MAX];
+        if(realpath(path.c_str(), resolved) != NULL){
+            return resolved;
+        }
+        return path;
+    }
+
+    bool read_all(int fd, void* buf, size_t size) {
+        size_t done = 0;
+        while(done < size){
+            ssize_t n = read(fd, (uint8_t*)buf + done, size - done);
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n <= 0){
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+} // namespace
+
+rknn::ModelBlob::~ModelBlob() {
+    if(m_data == nullptr){
+        return;
+    }
+    if(m_mapped){
+        munmap(m_data, m_size);
+    }else{
+        free(m_data);
+    }
+}
+
+std::shared_ptr<const rknn::ModelBlob> rknn::ModelCache::acquire(const std::string& path) {
+    std::string key = cache_key(path);
+    // 映射本身不读盘, 持锁完成; 并行初始化的多个实例只会映射一次
+    std::lock_guard<std::mutex> lock(g_cacheMtx);
+
+    int fd = open(key.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        LOGW("open %s fail: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0){
+        LOGW("invalid model file %s", path.c_str());
+        close(fd);
+        return nullptr;
+    }
+
+    auto iter = g_blobs.find(key);
+    if(iter != g_blobs.end()){
+        std::shared_ptr<const ModelBlob> cached = iter->second.lock();
+        if(cached && cached->m_dev == st.st_dev && cached->m_ino == st.st_ino &&
+           cached->m_size == (size_t)st.st_size && cached->m_mtimeNs == mtime_ns(st)){
+            close(fd);
+            g_stats.hits++;
+            return cached;
+        }
+        if(cached){
+            LOG("model file %s changed, reloading", path.c_str());
+        }
+    }
+
+    std::shared_ptr<ModelBlob> blob(new ModelBlob());
+    blob->m_path = key;
+    blob->m_size = st.st_size;
+    blob->m_dev = st.st_dev;
+    blob->m_ino = st.st_ino;
+    blob->m_mtimeNs = mtime_ns(st);
+
+    void* addr = mmap(NULL, blob->m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(addr != MAP_FAILED){
+        blob->m_data = addr;
+        blob->m_mapped = true;
+    }else{
+        // 不支持mmap的文件系统: 退回到整体读入
+        LOGW("mmap %s fail: %s, reading into memory", path.c_str(), strerror(errno));
+        blob->m_data = malloc(blob->m_size);
+        if(blob->m_data == nullptr || !read_all(fd, blob->m_data, blob->m_size)){
+            LOGW("read %s fail", path.c_str());
+            close(fd);
+            return nullptr;
+        }
+    }
+    close(fd);
+
+    g_blobs[key] = blob;
+    g_stats.loads++;
+    LOG("model %s loaded (%zu bytes, %s)", path.c_str(), blob->m_size, blob->m_mapped ? "mmap" : "read");
+    return blob;
+}
+
+rknn::ModelCache::Stats rknn::ModelCache::stats() {
+    std::lock_guard<std::mutex> lock(g_cacheMtx);
+    return g_stats;
+}
@@ -0,0 +1,175 @@
+#include "nms.hpp"
+
+#include <algorithm>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define NMS_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NMS_USE_SSE 1
+#endif
+
+void detector::NmsEngine::reserve(int max_candidates, int class_num) {
+    if ((int)m_order.size() < max_candidates) {
+        m_order.resize(max_candidates);
+        m_bucketPos.resize(max_candidates);
+        m_x1.resize(max_candidates);
+        m_y1.resize(max_candidates);
+        m_x2.resize(max_candidates);
+        m_y2.resize(max_candidates);
+        m_area.resize(max_candidates);
+        m_removed.resize(max_candidates);
+        m_keep.resize(max_candidates);
+    }
+    if ((int)m_classEnd.size() < class_num + 1) {
+        m_classEnd.resize(class_num + 1);
+    }
+}
+
+int detector::NmsEngine::run(const float* boxes, const float* scores, const int* class_ids, int count,
+                             float iou_threshold, int max_output, NmsMode mode) {
+    if (count <= 0) {
+        return 0;
+    }
+    int class_num = 1;
+    for (int i = 0; i < count; i++) {
+        class_num = std::max(class_num, class_ids[i] + 1);
+    }
+    reserve(count, class_num);
+
+    // 只排序一次; 同分时按下标排序, 结果与输入顺序无关且确定
+    for (int i = 0; i < count; i++) {
+        m_order[i] = i;
+    }
+    std::sort(m_order.begin(), m_order.begin() + count, [scores](int a, int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    });
+
+    if (mode == NmsMode::PER_CLASS) {
+        // 计数排序分桶: 按分数顺序放入, 桶内仍是分数从高到低
+        std::fill(m_classEnd.begin(), m_classEnd.begin() + class_num + 1, 0);
+        for (int i = 0; i < count; i++) {
+            m_classEnd[class_ids[i] + 1]++;
+        }
+        for (int c = 0; c < class_num; c++) {
+            m_classEnd[c + 1] += m_classEnd[c];
+        }
+        // 放入后m_classEnd[c]从类别c的起始位置移动到结束位置
+        for (int r = 0; r < count; r++) {
+            int n = m_order[r];
+            m_bucketPos[n] = m_classEnd[class_ids[n]]++;
+        }
+    } else {
+        for (int r = 0; r < count; r++) {
+            m_bucketPos[m_order[r]] = r;
+        }
+    }
+
+    // 类别平移量大于所有框的坐标范围, 不同类别的框IoU恒为0
+    float offset = 0.f;
+    if (mode == NmsMode::CLASS_OFFSET) {
+        float min_coord = boxes[0];
+        float max_coord = boxes[0];
+        for (int i = 0; i < count; i++) {
+            const float* b = boxes + i * 4;
+            min_coord = std::min(min_coord, std::min(b[0], b[1]));
+            max_coord = std::max(max_coord, std::max(b[0] + b[2], b[1] + b[3]));
+        }
+        offset = max_coord - min_coord + 2.f;
+    }
+
+    for (int n = 0; n < count; n++) {
+        const float* b = boxes + n * 4;
+        int p = m_bucketPos[n];
+        float shift = offset * class_ids[n];
+        float xmin = b[0];
+        float ymin = b[1];
+        float xmax = b[0] + b[2];
+        float ymax = b[1] + b[3];
+        m_x1[p] = xmin + shift;
+        m_y1[p] = ymin + shift;
+        m_x2[p] = xmax + shift;
+        m_y2[p] = ymax + shift;
+        m_area[p] = (xmax - xmin + 1.f) * (ymax - ymin + 1.f);
+        m_removed[p] = 0;
+    }
+
+    // 按全局分数顺序贪心: 同一个桶内位置靠后的框分数更低, 只需向后抑制
+    int kept = 0;
+    for (int r = 0; r < count; r++) {
+        int n = m_order[r];
+        int p = m_bucketPos[n];
+        if (m_removed[p]) {
+            continue;
+        }
+        m_keep[kept++] = n;
+        if (max_output > 0 && kept >= max_output) {
+            break;
+        }
+        int end = mode == NmsMode::PER_CLASS ? m_classEnd[class_ids[n]] : count;
+        suppress(p, p + 1, end, iou_threshold);
+    }
+    return kept;
+}
+
+void detector::NmsEngine::suppress(int p, int begin, int end, float iou_threshold) {
+    const float ax1 = m_x1[p];
+    const float ay1 = m_y1[p];
+    const float ax2 = m_x2[p];
+    const float ay2 = m_y2[p];
+    const float area = m_area[p];
+    int j = begin;
+#ifdef NMS_USE_NEON
+    const float32x4_t vx1 = vdupq_n_f32(ax1);
+    const float32x4_t vy1 = vdupq_n_f32(ay1);
+    const float32x4_t vx2 = vdupq_n_f32(ax2);
+    const float32x4_t vy2 = vdupq_n_f32(ay2);
+    const float32x4_t varea = vdupq_n_f32(area);
+    const float32x4_t vthr = vdupq_n_f32(iou_threshold);
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t one = vdupq_n_f32(1.f);
+    for (; j <= end - 4; j += 4) {
+        float32x4_t w = vmaxq_f32(zero, vaddq_f32(vsubq_f32(vminq_f32(vx2, vld1q_f32(&m_x2[j])),
+                                                            vmaxq_f32(vx1, vld1q_f32(&m_x1[j]))), one));
+        float32x4_t h = vmaxq_f32(zero, vaddq_f32(vsubq_f32(vminq_f32(vy2, vld1q_f32(&m_y2[j])),
+                                                            vmaxq_f32(vy1, vld1q_f32(&m_y1[j]))), one));
+        float32x4_t inter = vmulq_f32(w, h);
+        float32x4_t uni = vsubq_f32(vaddq_f32(varea, vld1q_f32(&m_area[j])), inter);
+        float32x4_t iou = vbslq_f32(vcgtq_f32(uni, zero), vdivq_f32(inter, uni), zero);
+        int32x4_t over = vreinterpretq_s32_u32(vcgtq_f32(iou, vthr));
+        vst1q_s32(&m_removed[j], vorrq_s32(vld1q_s32(&m_removed[j]), over));
+    }
+#elif defined(NMS_USE_SSE)
+    const __m128 vx1 = _mm_set1_ps(ax1);
+    const __m128 vy1 = _mm_set1_ps(ay1);
+    const __m128 vx2 = _mm_set1_ps(ax2);
+    const __m128 vy2 = _mm_set1_ps(ay2);
+    const __m128 varea = _mm_set1_ps(area);
+    const __m128 vthr = _mm_set1_ps(iou_threshold);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    for (; j <= end - 4; j += 4) {
+        __m128 w = _mm_max_ps(zero, _mm_add_ps(_mm_sub_ps(_mm_min_ps(vx2, _mm_loadu_ps(&m_x2[j])),
+                                                         _mm_max_ps(vx1, _mm_loadu_ps(&m_x1[j]))), one));
+        __m128 h = _mm_max_ps(zero, _mm_add_ps(_mm_sub_ps(_mm_min_ps(vy2, _mm_loadu_ps(&m_y2[j])),
+                                                         _mm_max_ps(vy1, _mm_loadu_ps(&m_y1[j]))), one));
+        __m128 inter = _mm_mul_ps(w, h);
+        __m128 uni = _mm_sub_ps(_mm_add_ps(varea, _mm_loadu_ps(&m_area[j])), inter);
+        __m128 iou = _mm_and_ps(_mm_cmpgt_ps(uni, zero), _mm_div_ps(inter, uni));
+        __m128i over = _mm_castps_si128(_mm_cmpgt_ps(iou, vthr));
+        __m128i* dst = (__m128i*)&m_removed[j];
+        _mm_storeu_si128(dst, _mm_or_si128(_mm_loadu_si128(dst), over));
+    }
+#endif
+    for (; j < end; j++) {
+        float w = std::max(0.f, std::min(ax2, m_x2[j]) - std::max(ax1, m_x1[j]) + 1.f);
+        float h = std::max(0.f, std::min(ay2, m_y2[j]) - std::max(ay1, m_y1[j]) + 1.f);
+        float inter = w * h;
+        float uni = area + m_area[j] - inter;
+        float iou = uni <= 0.f ? 0.f : inter / uni;
+        if (iou > iou_threshold) {
+            m_removed[j] = 1;
+        }
+    }
+}
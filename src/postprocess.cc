@@ -0,0 +1,382 @@
+#include "postprocess.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define POSTPROCESS_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define POSTPROCESS_USE_SSE 1
+#endif
+
+bool detector::DflDecoder::init(float scale, int dfl_len) {
+    if (dfl_len <= 0 || dfl_len > DFL_LEN_MAX) {
+        return false;
+    }
+    m_dflLen = dfl_len;
+    for (int d = 0; d < 256; d++) {
+        m_expLut[d] = expf(-(float)d * scale);
+    }
+    return true;
+}
+
+void detector::DflDecoder::decode(const int8_t* tensor, int grid_len, float box[4]) const {
+    decode_impl(tensor, grid_len, box);
+}
+
+void detector::DflDecoder::decode(const uint8_t* tensor, int grid_len, float box[4]) const {
+    decode_impl(tensor, grid_len, box);
+}
+
+template <typename T>
+void detector::DflDecoder::decode_impl(const T* tensor, int grid_len, float box[4]) const {
+    // 按 [bin][边] 交错存放, 每个bin的4条边正好是一个4 lane向量
+    int q[DFL_LEN_MAX * 4];
+    int q_max[4];
+    for (int b = 0; b < 4; b++) {
+        const T* src = tensor + (size_t)b * m_dflLen * grid_len;
+        int max_val = src[0];
+        for (int i = 0; i < m_dflLen; i++) {
+            int val = src[(size_t)i * grid_len];
+            q[i * 4 + b] = val;
+            max_val = val > max_val ? val : max_val;
+        }
+        q_max[b] = max_val;
+    }
+
+    // 最大的bin权重为1, exp_sum >= 1, 不会出现除零
+#ifdef POSTPROCESS_USE_NEON
+    float32x4_t exp_sum = vdupq_n_f32(0.f);
+    float32x4_t acc_sum = vdupq_n_f32(0.f);
+    for (int i = 0; i < m_dflLen; i++) {
+        const int* qi = q + i * 4;
+        float w[4] = {m_expLut[q_max[0] - qi[0]], m_expLut[q_max[1] - qi[1]],
+                      m_expLut[q_max[2] - qi[2]], m_expLut[q_max[3] - qi[3]]};
+        float32x4_t vw = vld1q_f32(w);
+        exp_sum = vaddq_f32(exp_sum, vw);
+        acc_sum = vmlaq_n_f32(acc_sum, vw, (float)i);
+    }
+    vst1q_f32(box, vdivq_f32(acc_sum, exp_sum));
+#elif defined(POSTPROCESS_USE_SSE)
+    __m128 exp_sum = _mm_setzero_ps();
+    __m128 acc_sum = _mm_setzero_ps();
+    for (int i = 0; i < m_dflLen; i++) {
+        const int* qi = q + i * 4;
+        __m128 vw = _mm_setr_ps(m_expLut[q_max[0] - qi[0]], m_expLut[q_max[1] - qi[1]],
+                                m_expLut[q_max[2] - qi[2]], m_expLut[q_max[3] - qi[3]]);
+        exp_sum = _mm_add_ps(exp_sum, vw);
+        acc_sum = _mm_add_ps(acc_sum, _mm_mul_ps(vw, _mm_set1_ps((float)i)));
+    }
+    _mm_storeu_ps(box, _mm_div_ps(acc_sum, exp_sum));
+#else
+    float exp_sum[4] = {0.f, 0.f, 0.f, 0.f};
+    float acc_sum[4] = {0.f, 0.f, 0.f, 0.f};
+    for (int i = 0; i < m_dflLen; i++) {
+        const int* qi = q + i * 4;
+        for (int b = 0; b < 4; b++) {
+            float w = m_expLut[q_max[b] - qi[b]];
+            exp_sum[b] += w;
+            acc_sum[b] += w * i;
+        }
+    }
+    for (int b = 0; b < 4; b++) {
+        box[b] = acc_sum[b] / exp_sum[b];
+    }
+#endif
+}
+
+namespace {
+
+#if defined(POSTPROCESS_USE_NEON) || defined(POSTPROCESS_USE_SSE)
+// 8位分数: uint8异或0x80后按有符号数比较, int8与uint8共用一份实现.
+// 类别号用8位lane记录, class_num超过256时返回0, 全部交给标量循环.
+// 返回已处理的cell数, 剩余不足一组的cell由调用方按标量处理
+template <bool IS_UNSIGNED, typename Push>
+int scan_blocks_8bit(const uint8_t* scores, int class_num, int grid_len, uint8_t threshold,
+                     const uint8_t* gate, uint8_t gate_threshold, Push push) {
+    if (class_num > 256) {
+        return 0;
+    }
+    const uint8_t bias = IS_UNSIGNED ? 0x80 : 0;
+    uint8_t lane_idx[16];
+    uint8_t lane_max[16];
+    int x = 0;
+#ifdef POSTPROCESS_USE_NEON
+    const uint8x16_t vbias = vdupq_n_u8(bias);
+    const int8x16_t vthr = vdupq_n_s8((int8_t)(threshold ^ bias));
+    const int8x16_t vgate_thr = vdupq_n_s8((int8_t)(gate_threshold ^ bias));
+    uint8_t lane_valid[16];
+    for (; x <= grid_len - 16; x += 16) {
+        uint8x16_t valid = vdupq_n_u8(0xff);
+        if (gate != nullptr) {
+            int8x16_t g = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(gate + x), vbias));
+            valid = vcgeq_s8(g, vgate_thr);
+            if (vmaxvq_u8(valid) == 0) {
+                continue;
+            }
+        }
+        const uint8_t* p = scores + x;
+        int8x16_t vmax = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(p), vbias));
+        uint8x16_t vidx = vdupq_n_u8(0);
+        for (int c = 1; c < class_num; c++) {
+            p += grid_len;
+            int8x16_t v = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(p), vbias));
+            uint8x16_t gt = vcgtq_s8(v, vmax);
+            vmax = vmaxq_s8(vmax, v);
+            vidx = vbslq_u8(gt, vdupq_n_u8((uint8_t)c), vidx);
+        }
+        valid = vandq_u8(valid, vcgtq_s8(vmax, vthr));
+        if (vmaxvq_u8(valid) == 0) {
+            continue;
+        }
+        vst1q_u8(lane_valid, valid);
+        vst1q_u8(lane_idx, vidx);
+        vst1q_u8(lane_max, veorq_u8(vreinterpretq_u8_s8(vmax), vbias));
+        for (int l = 0; l < 16; l++) {
+            if (lane_valid[l]) {
+                push(x + l, lane_idx[l], lane_max[l]);
+            }
+        }
+    }
+#else
+    const __m128i vbias = _mm_set1_epi8((char)bias);
+    const __m128i vthr = _mm_set1_epi8((char)(threshold ^ bias));
+    const __m128i vgate_thr = _mm_set1_epi8((char)(gate_threshold ^ bias));
+    for (; x <= grid_len - 16; x += 16) {
+        int valid_bits = 0xffff;
+        if (gate != nullptr) {
+            __m128i g = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(gate + x)), vbias);
+            valid_bits = ~_mm_movemask_epi8(_mm_cmpgt_epi8(vgate_thr, g)) & 0xffff;
+            if (valid_bits == 0) {
+                continue;
+            }
+        }
+        const uint8_t* p = scores + x;
+        __m128i vmax = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), vbias);
+        __m128i vidx = _mm_setzero_si128();
+        for (int c = 1; c < class_num; c++) {
+            p += grid_len;
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), vbias);
+            __m128i gt = _mm_cmpgt_epi8(v, vmax);
+            vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+            vidx = _mm_or_si128(_mm_and_si128(gt, _mm_set1_epi8((char)c)), _mm_andnot_si128(gt, vidx));
+        }
+        valid_bits &= _mm_movemask_epi8(_mm_cmpgt_epi8(vmax, vthr));
+        if (valid_bits == 0) {
+            continue;
+        }
+        _mm_storeu_si128((__m128i*)lane_idx, vidx);
+        _mm_storeu_si128((__m128i*)lane_max, _mm_xor_si128(vmax, vbias));
+        for (int l = 0; l < 16; l++) {
+            if (valid_bits & (1 << l)) {
+                push(x + l, lane_idx[l], lane_max[l]);
+            }
+        }
+    }
+#endif
+    return x;
+}
+
+// fp32分数: 用比较+选择代替max指令, NaN的处理与标量循环相同
+template <typename Push>
+int scan_blocks_f32(const float* scores, int class_num, int grid_len, float threshold,
+                    const float* gate, float gate_threshold, Push push) {
+    uint32_t lane_idx[4];
+    float lane_max[4];
+    int x = 0;
+#ifdef POSTPROCESS_USE_NEON
+    const float32x4_t vthr = vdupq_n_f32(threshold);
+    const float32x4_t vgate_thr = vdupq_n_f32(gate_threshold);
+    uint32_t lane_valid[4];
+    for (; x <= grid_len - 4; x += 4) {
+        uint32x4_t valid = vdupq_n_u32(0xffffffff);
+        if (gate != nullptr) {
+            valid = vmvnq_u32(vcltq_f32(vld1q_f32(gate + x), vgate_thr));
+            if (vmaxvq_u32(valid) == 0) {
+                continue;
+            }
+        }
+        const float* p = scores + x;
+        float32x4_t vmax = vld1q_f32(p);
+        uint32x4_t vidx = vdupq_n_u32(0);
+        for (int c = 1; c < class_num; c++) {
+            p += grid_len;
+            float32x4_t v = vld1q_f32(p);
+            uint32x4_t gt = vcgtq_f32(v, vmax);
+            vmax = vbslq_f32(gt, v, vmax);
+            vidx = vbslq_u32(gt, vdupq_n_u32((uint32_t)c), vidx);
+        }
+        valid = vandq_u32(valid, vcgtq_f32(vmax, vthr));
+        if (vmaxvq_u32(valid) == 0) {
+            continue;
+        }
+        vst1q_u32(lane_valid, valid);
+        vst1q_u32(lane_idx, vidx);
+        vst1q_f32(lane_max, vmax);
+        for (int l = 0; l < 4; l++) {
+            if (lane_valid[l]) {
+                push(x + l, (int)lane_idx[l], lane_max[l]);
+            }
+        }
+    }
+#else
+    const __m128 vthr = _mm_set1_ps(threshold);
+    const __m128 vgate_thr = _mm_set1_ps(gate_threshold);
+    for (; x <= grid_len - 4; x += 4) {
+        int valid_bits = 0xf;
+        if (gate != nullptr) {
+            valid_bits = ~_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(gate + x), vgate_thr)) & 0xf;
+            if (valid_bits == 0) {
+                continue;
+            }
+        }
+        const float* p = scores + x;
+        __m128 vmax = _mm_loadu_ps(p);
+        __m128i vidx = _mm_setzero_si128();
+        for (int c = 1; c < class_num; c++) {
+            p += grid_len;
+            __m128 v = _mm_loadu_ps(p);
+            __m128 gt = _mm_cmpgt_ps(v, vmax);
+            vmax = _mm_or_ps(_mm_and_ps(gt, v), _mm_andnot_ps(gt, vmax));
+            __m128i gti = _mm_castps_si128(gt);
+            vidx = _mm_or_si128(_mm_and_si128(gti, _mm_set1_epi32(c)), _mm_andnot_si128(gti, vidx));
+        }
+        valid_bits &= _mm_movemask_ps(_mm_cmpgt_ps(vmax, vthr));
+        if (valid_bits == 0) {
+            continue;
+        }
+        _mm_storeu_si128((__m128i*)lane_idx, vidx);
+        _mm_storeu_ps(lane_max, vmax);
+        for (int l = 0; l < 4; l++) {
+            if (valid_bits & (1 << l)) {
+                push(x + l, (int)lane_idx[l], lane_max[l]);
+            }
+        }
+    }
+#endif
+    return x;
+}
+
+template <typename Push>
+int scan_blocks(const int8_t* scores, int class_num, int grid_len, int8_t threshold,
+                const int8_t* gate, int8_t gate_threshold, Push push) {
+    return scan_blocks_8bit<false>((const uint8_t*)scores, class_num, grid_len, (uint8_t)threshold,
+                                   (const uint8_t*)gate, (uint8_t)gate_threshold,
+                                   [&push](int cell, int class_id, uint8_t score) { push(cell, class_id, (int8_t)score); });
+}
+
+template <typename Push>
+int scan_blocks(const uint8_t* scores, int class_num, int grid_len, uint8_t threshold,
+                const uint8_t* gate, uint8_t gate_threshold, Push push) {
+    return scan_blocks_8bit<true>(scores, class_num, grid_len, threshold, gate, gate_threshold, push);
+}
+
+template <typename Push>
+int scan_blocks(const float* scores, int class_num, int grid_len, float threshold,
+                const float* gate, float gate_threshold, Push push) {
+    return scan_blocks_f32(scores, class_num, grid_len, threshold, gate, gate_threshold, push);
+}
+#else
+// 没有SIMD时全部由标量循环处理
+template <typename T, typename Push>
+int scan_blocks(const T*, int, int, T, const T*, T, Push) {
+    return 0;
+}
+#endif
+
+} // namespace
+
+template <typename T>
+void detector::ClassScoreScanner<T>::reserve(int grid_len) {
+    if ((int)m_cells.size() < grid_len) {
+        m_cells.resize(grid_len);
+        m_classIds.resize(grid_len);
+        m_scores.resize(grid_len);
+    }
+}
+
+template <typename T>
+void detector::ClassScoreScanner<T>::push(int cell, int class_id, T score) {
+    m_cells[m_count] = cell;
+    m_classIds[m_count] = class_id;
+    m_scores[m_count] = score;
+    m_count++;
+}
+
+template <typename T>
+int detector::ClassScoreScanner<T>::scan(const T* scores, int class_num, int grid_len, T threshold,
+                                         const T* gate, T gate_threshold) {
+    reserve(grid_len);
+    m_count = 0;
+    if (class_num <= 0) {
+        return 0;
+    }
+
+    int x = scan_blocks(scores, class_num, grid_len, threshold, gate, gate_threshold,
+                        [this](int cell, int class_id, T score) { push(cell, class_id, score); });
+    for (; x < grid_len; x++) {
+        if (gate != nullptr && gate[x] < gate_threshold) {
+            continue;
+        }
+        const T* p = scores + x;
+        T max_score = *p;
+        int max_class_id = 0;
+        for (int c = 1; c < class_num; c++) {
+            p += grid_len;
+            if (*p > max_score) {
+                max_score = *p;
+                max_class_id = c;
+            }
+        }
+        if (max_score > threshold) {
+            push(x, max_class_id, max_score);
+        }
+    }
+    return m_count;
+}
+
+template class detector::ClassScoreScanner<int8_t>;
+template class detector::ClassScoreScanner<uint8_t>;
+template class detector::ClassScoreScanner<float>;
+
+void detector::CandidateCollector::reserve(int capacity) {
+    if ((int)m_scores.size() < capacity) {
+        m_boxes.resize(capacity * 4);
+        m_scores.resize(capacity);
+        m_classIds.resize(capacity);
+        m_heap.resize(capacity);
+    }
+}
+
+void detector::CandidateCollector::reset(int top_k) {
+    int capacity = (int)m_scores.size();
+    m_topK = (top_k <= 0 || top_k > capacity) ? capacity : top_k;
+    m_count = 0;
+}
+
+bool detector::CandidateCollector::push(float left, float top, float width, float height, float score, int class_id) {
+    if (!accept(score)) {
+        return false;
+    }
+    const float* scores = m_scores.data();
+    auto min_heap = [scores](int a, int b) { return scores[a] > scores[b]; };
+    int slot;
+    if (m_count < m_topK) {
+        slot = m_count++;
+    } else {
+        // 替换当前最低分的候选
+        std::pop_heap(m_heap.begin(), m_heap.begin() + m_count, min_heap);
+        slot = m_heap[m_count - 1];
+    }
+    m_boxes[slot * 4 + 0] = left;
+    m_boxes[slot * 4 + 1] = top;
+    m_boxes[slot * 4 + 2] = width;
+    m_boxes[slot * 4 + 3] = height;
+    m_scores[slot] = score;
+    m_classIds[slot] = class_id;
+    m_heap[m_count - 1] = slot;
+    std::push_heap(m_heap.begin(), m_heap.begin() + m_count, min_heap);
+    return true;
+}
@@ -0,0 +1,436 @@
+#include "preprocess.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PREPROCESS_USE_NEON 1
+#endif
+
+namespace {
+
+// 与OpenCV INTER_LINEAR的定点实现保持一致: 插值系数放大2048倍
+constexpr int INTER_RESIZE_COEF_BITS = 11;
+constexpr int INTER_RESIZE_COEF_SCALE = 1 << INTER_RESIZE_COEF_BITS;
+
+inline short coef_to_fixed(float coef) {
+    return cv::saturate_cast<short>(coef * INTER_RESIZE_COEF_SCALE);
+}
+
+inline uint8_t clip_u8(int val) {
+    return (uint8_t)(val < 0 ? 0 : (val > 255 ? 255 : val));
+}
+
+// 垂直插值: 两行Q11水平插值结果按beta混合, 舍入方式与OpenCV的SIMD实现相同
+void vresize_row(const int* S0, const int* S1, short b0, short b1, uint8_t* D, int width) {
+    int x = 0;
+#ifdef PREPROCESS_USE_NEON
+    int16x4_t vb0 = vdup_n_s16(b0);
+    int16x4_t vb1 = vdup_n_s16(b1);
+    for (; x <= width - 8; x += 8) {
+        int16x8_t s0 = vcombine_s16(vshrn_n_s32(vld1q_s32(S0 + x), 4), vshrn_n_s32(vld1q_s32(S0 + x + 4), 4));
+        int16x8_t s1 = vcombine_s16(vshrn_n_s32(vld1q_s32(S1 + x), 4), vshrn_n_s32(vld1q_s32(S1 + x + 4), 4));
+        int16x8_t m0 = vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(s0), vb0), 16),
+                                    vshrn_n_s32(vmull_s16(vget_high_s16(s0), vb0), 16));
+        int16x8_t m1 = vcombine_s16(vshrn_n_s32(vmull_s16(vget_low_s16(s1), vb1), 16),
+                                    vshrn_n_s32(vmull_s16(vget_high_s16(s1), vb1), 16));
+        vst1_u8(D + x, vqrshrun_n_s16(vaddq_s16(m0, m1), 2));
+    }
+#endif
+    for (; x < width; x++) {
+        int val = (((b0 * (S0[x] >> 4)) >> 16) + ((b1 * (S1[x] >> 4)) >> 16) + 2) >> 2;
+        D[x] = clip_u8(val);
+    }
+}
+
+// YUV->RGB, BT.601有限范围, 定点系数与cv::cvtColor(COLOR_YUV2RGB_NV12)相同
+constexpr int ITUR_BT_601_CY = 1220542;
+constexpr int ITUR_BT_601_CUB = 2116026;
+constexpr int ITUR_BT_601_CUG = -409993;
+constexpr int ITUR_BT_601_CVG = -852492;
+constexpr int ITUR_BT_601_CVR = 1673527;
+constexpr int ITUR_BT_601_SHIFT = 20;
+
+inline void yuv_to_rgb(int y, int u, int v, uint8_t* rgb) {
+    u -= 128;
+    v -= 128;
+    int yy = std::max(0, y - 16) * ITUR_BT_601_CY;
+    int half = 1 << (ITUR_BT_601_SHIFT - 1);
+    rgb[0] = clip_u8((yy + half + ITUR_BT_601_CVR * v) >> ITUR_BT_601_SHIFT);
+    rgb[1] = clip_u8((yy + half + ITUR_BT_601_CVG * v + ITUR_BT_601_CUG * u) >> ITUR_BT_601_SHIFT);
+    rgb[2] = clip_u8((yy + half + ITUR_BT_601_CUB * u) >> ITUR_BT_601_SHIFT);
+}
+
+} // namespace
+
+bool rknn::LetterboxKernel::fill_pads(int src_w, int src_h, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                      float scale, image_rect_t& pads, uint8_t pad_value,
+                                      int& resized_w, int& resized_h) {
+    // 缩放后的尺寸与cv::resize按scale计算的方式一致
+    resized_w = std::min(cv::saturate_cast<int>(src_w * (double)scale), dst_w);
+    resized_h = std::min(cv::saturate_cast<int>(src_h * (double)scale), dst_h);
+    if (resized_w <= 0 || resized_h <= 0) {
+        LOGW_EVERY(1000, "LetterboxKernel: invalid resized size %dx%d", resized_w, resized_h);
+        return false;
+    }
+
+    int pad_width = dst_w - resized_w;
+    int pad_height = dst_h - resized_h;
+    pads.left = pad_width / 2;
+    pads.right = pad_width - pads.left;
+    pads.top = pad_height / 2;
+    pads.bottom = pad_height - pads.top;
+
+    // 填充区域只写一次, 不再先整体填充再覆盖
+    for (int y = 0; y < pads.top; y++) {
+        memset(dst + (size_t)y * dst_stride, pad_value, (size_t)dst_w * 3);
+    }
+    for (int y = dst_h - pads.bottom; y < dst_h; y++) {
+        memset(dst + (size_t)y * dst_stride, pad_value, (size_t)dst_w * 3);
+    }
+    for (int y = pads.top; y < pads.top + resized_h; y++) {
+        uint8_t* row = dst + (size_t)y * dst_stride;
+        memset(row, pad_value, (size_t)pads.left * 3);
+        memset(row + (size_t)(pads.left + resized_w) * 3, pad_value, (size_t)pads.right * 3);
+    }
+    return true;
+}
+
+bool rknn::LetterboxKernel::run(const cv::Mat& src, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                float scale, image_rect_t& pads, uint8_t pad_value, bool swap_rb) {
+    if (src.empty() || src.type() != CV_8UC3 || dst == nullptr) {
+        LOGW_EVERY(1000, "LetterboxKernel: unsupported source image, only BGR888 (CV_8UC3) is supported");
+        return false;
+    }
+
+    int resized_w, resized_h;
+    if (!fill_pads(src.cols, src.rows, dst, dst_w, dst_h, dst_stride, scale, pads, pad_value, resized_w, resized_h)) {
+        return false;
+    }
+
+    uint8_t* content = dst + (size_t)pads.top * dst_stride + (size_t)pads.left * 3;
+    if (resized_w == src.cols && resized_h == src.rows) {
+        // 尺寸不变时cv::resize退化为拷贝
+        copy_swap(src, content, dst_stride, swap_rb);
+    } else if (scale == 0.5f) {
+        // 比例正好为2时OpenCV的INTER_LINEAR改用快速INTER_AREA
+        resize_area_2x(src, content, dst_stride, swap_rb, resized_w, resized_h);
+    } else {
+        build_tables(src.cols, src.rows, resized_w, resized_h, scale);
+        resize_linear([&](int sy, int* row) { hresize_row(src.ptr<uint8_t>(sy), row, swap_rb); },
+                      content, dst_stride);
+    }
+    return true;
+}
+
+bool rknn::LetterboxKernel::run_yuv420sp(const image_buffer_t& src, uint8_t* dst, int dst_w, int dst_h, int dst_stride,
+                                         float scale, image_rect_t& pads, uint8_t pad_value) {
+    if (src.virt_addr == nullptr || dst == nullptr ||
+        (src.format != IMAGE_FORMAT_YUV420SP_NV12 && src.format != IMAGE_FORMAT_YUV420SP_NV21)) {
+        LOGW_EVERY(1000, "LetterboxKernel: unsupported source buffer, only NV12/NV21 with virt_addr is supported");
+        return false;
+    }
+
+    int resized_w, resized_h;
+    if (!fill_pads(src.width, src.height, dst, dst_w, dst_h, dst_stride, scale, pads, pad_value, resized_w, resized_h)) {
+        return false;
+    }
+
+    // UV平面紧跟在按height_stride对齐的Y平面之后, 行跨度与Y平面相同
+    int y_stride = src.width_stride > 0 ? src.width_stride : src.width;
+    int h_stride = src.height_stride > 0 ? src.height_stride : src.height;
+    const uint8_t* y_plane = src.virt_addr;
+    const uint8_t* uv_plane = src.virt_addr + (size_t)y_stride * h_stride;
+    bool nv21 = src.format == IMAGE_FORMAT_YUV420SP_NV21;
+
+    uint8_t* content = dst + (size_t)pads.top * dst_stride + (size_t)pads.left * 3;
+    build_tables(src.width, src.height, resized_w, resized_h, scale);
+    resize_linear([&](int sy, int* row) {
+                      hresize_row_yuv(y_plane + (size_t)sy * y_stride, uv_plane + (size_t)(sy / 2) * y_stride, row, nv21);
+                  },
+                  content, dst_stride);
+    return true;
+}
+
+void rknn::LetterboxKernel::build_tables(int src_w, int src_h, int resized_w, int resized_h, float scale) {
+    if (src_w == m_srcW && src_h == m_srcH && resized_w == m_resizedW && resized_h == m_resizedH && scale == m_scale) {
+        return;
+    }
+    m_srcW = src_w;
+    m_srcH = src_h;
+    m_resizedW = resized_w;
+    m_resizedH = resized_h;
+    m_scale = scale;
+
+    m_xofs.resize(resized_w * 2);
+    m_alpha.resize(resized_w * 2);
+    m_yofs.resize(resized_h);
+    m_beta.resize(resized_h * 2);
+    m_rowBuf.resize(resized_w * 3 * 2);
+
+    // 与letterbox()中cv::resize(fx = fy = scale)相同, 比例直接取scale而不是 缩放后尺寸/源尺寸;
+    // 缩放后的尺寸被目标尺寸截断时按截断后的尺寸计算
+    double scale_x = resized_w == cv::saturate_cast<int>(src_w * (double)scale) ? 1. / (double)scale
+                                                                                : (double)src_w / resized_w;
+    double scale_y = resized_h == cv::saturate_cast<int>(src_h * (double)scale) ? 1. / (double)scale
+                                                                                : (double)src_h / resized_h;
+
+    for (int dx = 0; dx < resized_w; dx++) {
+        float fx = (float)((dx + 0.5) * scale_x - 0.5);
+        int sx = cvFloor(fx);
+        fx -= sx;
+        if (sx < 0) {
+            fx = 0;
+            sx = 0;
+        }
+        if (sx >= src_w - 1) {
+            fx = 0;
+            sx = src_w - 1;
+        }
+        m_xofs[dx * 2] = sx;
+        m_xofs[dx * 2 + 1] = std::min(sx + 1, src_w - 1);
+        m_alpha[dx * 2] = coef_to_fixed(1.f - fx);
+        m_alpha[dx * 2 + 1] = coef_to_fixed(fx);
+    }
+
+    for (int dy = 0; dy < resized_h; dy++) {
+        float fy = (float)((dy + 0.5) * scale_y - 0.5);
+        int sy = cvFloor(fy);
+        fy -= sy;
+        m_yofs[dy] = sy;
+        m_beta[dy * 2] = coef_to_fixed(1.f - fy);
+        m_beta[dy * 2 + 1] = coef_to_fixed(fy);
+    }
+}
+
+void rknn::LetterboxKernel::hresize_row(const uint8_t* S, int* D, bool swap_rb) const {
+    // 通道交换在水平插值时完成, 垂直插值即可按连续内存处理
+    const int c0 = swap_rb ? 2 : 0;
+    const int c2 = 2 - c0;
+    for (int dx = 0; dx < m_resizedW; dx++) {
+        const uint8_t* p0 = S + m_xofs[dx * 2] * 3;
+        const uint8_t* p1 = S + m_xofs[dx * 2 + 1] * 3;
+        int a0 = m_alpha[dx * 2];
+        int a1 = m_alpha[dx * 2 + 1];
+        int* d = D + dx * 3;
+        d[0] = p0[c0] * a0 + p1[c0] * a1;
+        d[1] = p0[1] * a0 + p1[1] * a1;
+        d[2] = p0[c2] * a0 + p1[c2] * a1;
+    }
+}
+
+void rknn::LetterboxKernel::hresize_row_yuv(const uint8_t* y_row, const uint8_t* uv_row, int* D, bool nv21) const {
+    const int u_idx = nv21 ? 1 : 0;
+    const int v_idx = 1 - u_idx;
+    for (int dx = 0; dx < m_resizedW; dx++) {
+        int sx0 = m_xofs[dx * 2];
+        int sx1 = m_xofs[dx * 2 + 1];
+        uint8_t rgb0[3], rgb1[3];
+        const uint8_t* uv0 = uv_row + (sx0 & ~1);
+        const uint8_t* uv1 = uv_row + (sx1 & ~1);
+        yuv_to_rgb(y_row[sx0], uv0[u_idx], uv0[v_idx], rgb0);
+        yuv_to_rgb(y_row[sx1], uv1[u_idx], uv1[v_idx], rgb1);
+
+        int a0 = m_alpha[dx * 2];
+        int a1 = m_alpha[dx * 2 + 1];
+        int* d = D + dx * 3;
+        d[0] = rgb0[0] * a0 + rgb1[0] * a1;
+        d[1] = rgb0[1] * a0 + rgb1[1] * a1;
+        d[2] = rgb0[2] * a0 + rgb1[2] * a1;
+    }
+}
+
+template <typename FetchRow>
+void rknn::LetterboxKernel::resize_linear(FetchRow fetch_row, uint8_t* dst, int dst_stride) {
+    int row_len = m_resizedW * 3;
+    int* rows[2] = {m_rowBuf.data(), m_rowBuf.data() + row_len};
+    int cached[2] = {-1, -1};
+
+    for (int dy = 0; dy < m_resizedH; dy++) {
+        int sy = m_yofs[dy];
+        int need[2] = {std::min(std::max(sy, 0), m_srcH - 1), std::min(std::max(sy + 1, 0), m_srcH - 1)};
+
+        // 相邻目标行通常共享源行, 只对新出现的源行做水平插值
+        for (int k = 0; k < 2; k++) {
+            if (cached[k] == need[k]) {
+                continue;
+            }
+            if (k == 0 && cached[1] == need[0]) {
+                std::swap(rows[0], rows[1]);
+                std::swap(cached[0], cached[1]);
+                continue;
+            }
+            fetch_row(need[k], rows[k]);
+            cached[k] = need[k];
+        }
+
+        vresize_row(rows[0], rows[1], m_beta[dy * 2], m_beta[dy * 2 + 1], dst + (size_t)dy * dst_stride, row_len);
+    }
+}
+
+void rknn::LetterboxKernel::resize_area_2x(const cv::Mat& src, uint8_t* dst, int dst_stride, bool swap_rb,
+                                           int resized_w, int resized_h) {
+    // 源尺寸为奇数时缩放后的尺寸可能向上取整, 最后一列/行只覆盖源图像的半个2x2块
+    int full_w = src.cols / 2;
+    int full_h = src.rows / 2;
+    const int c0 = swap_rb ? 2 : 0;
+    const int c2 = 2 - c0;
+    const int order[3] = {c0, 1, c2};
+
+    // 不完整的块与OpenCV一致: 对存在的像素求平均, 按(float)sum / count舍入 (四舍六入五取偶)
+    auto average = [](int sum, int count) {
+        if (count == 1) {
+            return (uint8_t)sum;
+        }
+        int half = sum >> 1;
+        return (uint8_t)(half + ((sum & 1) & (half & 1)));
+    };
+
+    for (int dy = 0; dy < full_h; dy++) {
+        const uint8_t* S0 = src.ptr<uint8_t>(dy * 2);
+        const uint8_t* S1 = src.ptr<uint8_t>(dy * 2 + 1);
+        uint8_t* D = dst + (size_t)dy * dst_stride;
+        int dx = 0;
+#ifdef PREPROCESS_USE_NEON
+        for (; dx <= resized_w - 8; dx += 8) {
+            uint8x16x3_t r0 = vld3q_u8(S0 + dx * 6);
+            uint8x16x3_t r1 = vld3q_u8(S1 + dx * 6);
+            uint8x8x3_t out;
+            for (int c = 0; c < 3; c++) {
+                uint16x8_t sum = vaddq_u16(vpaddlq_u8(r0.val[c]), vpaddlq_u8(r1.val[c]));
+                out.val[c] = vrshrn_n_u16(sum, 2);
+            }
+            if (swap_rb) {
+                uint8x8_t tmp = out.val[0];
+                out.val[0] = out.val[2];
+                out.val[2] = tmp;
+            }
+            vst3_u8(D + dx * 3, out);
+        }
+#endif
+        for (; dx < full_w; dx++) {
+            const uint8_t* p0 = S0 + dx * 6;
+            const uint8_t* p1 = S1 + dx * 6;
+            D[dx * 3 + 0] = (uint8_t)((p0[c0] + p0[c0 + 3] + p1[c0] + p1[c0 + 3] + 2) >> 2);
+            D[dx * 3 + 1] = (uint8_t)((p0[1] + p0[4] + p1[1] + p1[4] + 2) >> 2);
+            D[dx * 3 + 2] = (uint8_t)((p0[c2] + p0[c2 + 3] + p1[c2] + p1[c2 + 3] + 2) >> 2);
+        }
+        if (resized_w > full_w) {
+            const uint8_t* p0 = S0 + full_w * 6;
+            const uint8_t* p1 = S1 + full_w * 6;
+            for (int c = 0; c < 3; c++) {
+                D[full_w * 3 + c] = average(p0[order[c]] + p1[order[c]], 2);
+            }
+        }
+    }
+
+    if (resized_h > full_h) {
+        const uint8_t* S = src.ptr<uint8_t>(src.rows - 1);
+        uint8_t* D = dst + (size_t)full_h * dst_stride;
+        for (int dx = 0; dx < resized_w; dx++) {
+            const uint8_t* p = S + dx * 6;
+            bool pair = dx < full_w;
+            for (int c = 0; c < 3; c++) {
+                D[dx * 3 + c] = pair ? average(p[order[c]] + p[order[c] + 3], 2) : p[order[c]];
+            }
+        }
+    }
+}
+
+void rknn::LetterboxKernel::copy_swap(const cv::Mat& src, uint8_t* dst, int dst_stride, bool swap_rb) {
+    for (int y = 0; y < src.rows; y++) {
+        const uint8_t* S = src.ptr<uint8_t>(y);
+        uint8_t* D = dst + (size_t)y * dst_stride;
+        if (!swap_rb) {
+            memcpy(D, S, (size_t)src.cols * 3);
+            continue;
+        }
+        int x = 0;
+#ifdef PREPROCESS_USE_NEON
+        for (; x <= src.cols - 16; x += 16) {
+            uint8x16x3_t px = vld3q_u8(S + x * 3);
+            uint8x16_t tmp = px.val[0];
+            px.val[0] = px.val[2];
+            px.val[2] = tmp;
+            vst3q_u8(D + x * 3, px);
+        }
+#endif
+        for (; x < src.cols; x++) {
+            D[x * 3 + 0] = S[x * 3 + 2];
+            D[x * 3 + 1] = S[x * 3 + 1];
+            D[x * 3 + 2] = S[x * 3 + 0];
+        }
+    }
+}
+
+bool rknn::CvPreprocessor::run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                               uint8_t pad_value, int /* dst_fd */) {
+    // 参考实现: OpenCV letterbox后再做BGR->RGB, cvtColor直接写入dst
+    letterbox(src, m_bgr, pads, scale, dst.size(), cv::Scalar(pad_value, pad_value, pad_value));
+    cv::cvtColor(m_bgr, dst, cv::COLOR_BGR2RGB);
+    return true;
+}
+
+bool rknn::FusedPreprocessor::run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                  uint8_t pad_value, int /* dst_fd */) {
+    return m_kernel.run(src, dst.data, dst.cols, dst.rows, (int)dst.step[0], scale, pads, pad_value);
+}
+
+bool rknn::CvPreprocessor::run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                      uint8_t pad_value, int dst_fd) {
+    // 参考实现: 先整帧转换为BGR, 再走与cv::Mat输入相同的路径
+    int w_stride = src.width_stride > 0 ? src.width_stride : src.width;
+    int h_stride = src.height_stride > 0 ? src.height_stride : src.height;
+    switch (src.format) {
+        case IMAGE_FORMAT_RGB888: {
+            cv::Mat rgb(src.height, src.width, CV_8UC3, src.virt_addr, (size_t)w_stride * 3);
+            cv::cvtColor(rgb, m_srcBgr, cv::COLOR_RGB2BGR);
+            break;
+        }
+        case IMAGE_FORMAT_YUV420SP_NV12:
+        case IMAGE_FORMAT_YUV420SP_NV21: {
+            cv::Mat y(src.height, src.width, CV_8UC1, src.virt_addr, w_stride);
+            cv::Mat uv(src.height / 2, src.width / 2, CV_8UC2, src.virt_addr + (size_t)w_stride * h_stride, w_stride);
+            int code = src.format == IMAGE_FORMAT_YUV420SP_NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_NV21;
+            cv::cvtColorTwoPlane(y, uv, m_srcBgr, code);
+            break;
+        }
+        default:
+            LOGW_EVERY(1000, "CvPreprocessor: unsupported image format %d", src.format);
+            return false;
+    }
+    return run(m_srcBgr, dst, scale, pads, pad_value, dst_fd);
+}
+
+bool rknn::FusedPreprocessor::run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                         uint8_t pad_value, int /* dst_fd */) {
+    switch (src.format) {
+        case IMAGE_FORMAT_RGB888: {
+            // 源已经是RGB, 只缩放不交换通道
+            int w_stride = src.width_stride > 0 ? src.width_stride : src.width;
+            cv::Mat rgb(src.height, src.width, CV_8UC3, src.virt_addr, (size_t)w_stride * 3);
+            return m_kernel.run(rgb, dst.data, dst.cols, dst.rows, (int)dst.step[0], scale, pads, pad_value, false);
+        }
+        case IMAGE_FORMAT_YUV420SP_NV12:
+        case IMAGE_FORMAT_YUV420SP_NV21:
+            return m_kernel.run_yuv420sp(src, dst.data, dst.cols, dst.rows, (int)dst.step[0], scale, pads, pad_value);
+        default:
+            LOGW_EVERY(1000, "FusedPreprocessor: unsupported image format %d", src.format);
+            return false;
+    }
+}
+
+std::unique_ptr<rknn::Preprocessor> rknn::create_preprocessor(PreprocessType type) {
+    switch (type) {
+        case PreprocessType::OPENCV:
+            return std::make_unique<CvPreprocessor>();
+        case PreprocessType::RGA:
+            return std::make_unique<RgaPreprocessor>();
+        case PreprocessType::FUSED:
+        default:
+            return std::make_unique<FusedPreprocessor>();
+    }
+}
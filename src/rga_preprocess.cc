@@ -0,0 +1,125 @@
+#include "preprocess.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef ENABLE_RGA
+#include "im2d.hpp"
+#include "RgaUtils.h"
+
+// 用RGA把src缩放、颜色转换后写入dst中间区域, 四周填充pad_value
+static IM_STATUS rga_letterbox(rga_buffer_t rga_src, int src_w, int src_h, cv::Mat& dst, float scale,
+                               image_rect_t& pads, uint8_t pad_value, int dst_fd) {
+    int resized_w = std::min(cv::saturate_cast<int>(src_w * (double)scale), dst.cols);
+    int resized_h = std::min(cv::saturate_cast<int>(src_h * (double)scale), dst.rows);
+    if (resized_w <= 0 || resized_h <= 0 || dst.step[0] % 3 != 0) {
+        return IM_STATUS_NOT_SUPPORTED;
+    }
+
+    int pad_width = dst.cols - resized_w;
+    int pad_height = dst.rows - resized_h;
+    pads.left = pad_width / 2;
+    pads.right = pad_width - pads.left;
+    pads.top = pad_height / 2;
+    pads.bottom = pad_height - pads.top;
+
+    rga_buffer_t rga_dst;
+    if (dst_fd >= 0) {
+        // 零拷贝输入内存有dma-buf fd, 避免RGA每帧映射虚拟地址
+        rga_dst = wrapbuffer_fd(dst_fd, dst.cols, dst.rows, RK_FORMAT_RGB_888, (int)(dst.step[0] / 3), dst.rows);
+    } else {
+        rga_dst = wrapbuffer_virtualaddr((void*)dst.data, dst.cols, dst.rows, RK_FORMAT_RGB_888,
+                                         (int)(dst.step[0] / 3), dst.rows);
+    }
+    rga_buffer_t rga_pat;
+    memset(&rga_pat, 0, sizeof(rga_pat));
+
+    im_rect src_rect = {0, 0, src_w, src_h};
+    im_rect dst_rect = {pads.left, pads.top, resized_w, resized_h};
+    im_rect pat_rect = {0, 0, 0, 0};
+
+    IM_STATUS ret = imcheck(rga_src, rga_dst, src_rect, dst_rect);
+    if (ret != IM_STATUS_NOERROR) {
+        return ret;
+    }
+
+    // 先整体填充背景色, 再把缩放并转换为RGB的图像写入中间区域
+    if (pad_width > 0 || pad_height > 0) {
+        im_rect whole_rect = {0, 0, dst.cols, dst.rows};
+        int color = 0xff000000 | (pad_value << 16) | (pad_value << 8) | pad_value;
+        ret = imfill(rga_dst, whole_rect, color);
+        if (ret != IM_STATUS_SUCCESS && ret != IM_STATUS_NOERROR) {
+            return ret;
+        }
+    }
+    return improcess(rga_src, rga_dst, rga_pat, src_rect, dst_rect, pat_rect, IM_SYNC);
+}
+
+static bool rga_succeeded(IM_STATUS ret) {
+    return ret == IM_STATUS_SUCCESS || ret == IM_STATUS_NOERROR;
+}
+#endif
+
+bool rknn::RgaPreprocessor::run(const cv::Mat& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                uint8_t pad_value, int dst_fd) {
+#ifdef ENABLE_RGA
+    // RGA按像素描述行跨度, 行字节数必须是整像素
+    if (src.type() == CV_8UC3 && src.step[0] % 3 == 0) {
+        rga_buffer_t rga_src = wrapbuffer_virtualaddr((void*)src.data, src.cols, src.rows, RK_FORMAT_BGR_888,
+                                                      (int)(src.step[0] / 3), src.rows);
+        IM_STATUS ret = rga_letterbox(rga_src, src.cols, src.rows, dst, scale, pads, pad_value, dst_fd);
+        if (rga_succeeded(ret)) {
+            return true;
+        }
+        if (!m_fallbackWarned) {
+            LOGW("RGA letterbox fail (%s), fall back to CPU", imStrError(ret));
+            m_fallbackWarned = true;
+        }
+    }
+#else
+    if (!m_fallbackWarned) {
+        LOGW("built without ENABLE_RGA, RGA preprocessor falls back to CPU");
+        m_fallbackWarned = true;
+    }
+#endif
+    return m_fallback.run(src, dst, scale, pads, pad_value, dst_fd);
+}
+
+bool rknn::RgaPreprocessor::run_buffer(const image_buffer_t& src, cv::Mat& dst, float scale, image_rect_t& pads,
+                                       uint8_t pad_value, int dst_fd) {
+#ifdef ENABLE_RGA
+    int format = RK_FORMAT_UNKNOWN;
+    switch (src.format) {
+        case IMAGE_FORMAT_RGB888:        format = RK_FORMAT_RGB_888; break;
+        case IMAGE_FORMAT_YUV420SP_NV12: format = RK_FORMAT_YCbCr_420_SP; break;
+        case IMAGE_FORMAT_YUV420SP_NV21: format = RK_FORMAT_YCrCb_420_SP; break;
+        default: break;
+    }
+    if (format != RK_FORMAT_UNKNOWN) {
+        int w_stride = src.width_stride > 0 ? src.width_stride : src.width;
+        int h_stride = src.height_stride > 0 ? src.height_stride : src.height;
+        // 解码器/ISP输出一般带dma-buf fd, RGA直接读取, YUV->RGB在硬件中完成
+        rga_buffer_t rga_src;
+        if (src.fd > 0) {
+            rga_src = wrapbuffer_fd(src.fd, src.width, src.height, format, w_stride, h_stride);
+        } else {
+            rga_src = wrapbuffer_virtualaddr((void*)src.virt_addr, src.width, src.height, format, w_stride, h_stride);
+        }
+        IM_STATUS ret = rga_letterbox(rga_src, src.width, src.height, dst, scale, pads, pad_value, dst_fd);
+        if (rga_succeeded(ret)) {
+            return true;
+        }
+        if (!m_fallbackWarned) {
+            LOGW("RGA letterbox fail (%s), fall back to CPU", imStrError(ret));
+            m_fallbackWarned = true;
+        }
+    }
+#else
+    if (!m_fallbackWarned) {
+        LOGW("built without ENABLE_RGA, RGA preprocessor falls back to CPU");
+        m_fallbackWarned = true;
+    }
+#endif
+    return m_fallback.run_buffer(src, dst, scale, pads, pad_value, dst_fd);
+}
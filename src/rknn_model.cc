@@ -1,27 +1,48 @@
 #include "rknn_model.hpp"
 #include "utils.hpp"
+#include "latency.hpp"
 
-rknn::Model::Model(std::string model_path, logger::Level level) {
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+rknn::Model::Model(std::string model_path, logger::Level level, ModelConfig config) {
     m_rknnPath = model_path;
+    m_config = config;
     m_logger = std::make_shared<logger::Logger>(level);
     m_params = std::make_unique<Params>();
+    m_preprocessor = create_preprocessor(config.preprocess);
     m_inputAttrs = nullptr;
     m_outputAttrs = nullptr;
-    m_rknnCtx = 0;
-    init_model(nullptr);
+    m_backend = create_backend(config.backend);
+    if(init_model(nullptr) != 0){
+        release();
+        throw std::runtime_error("failed to initialize model " + model_path);
+    }
 }
 
-rknn::Model::Model(std::string model_path, logger::Level level, rknn_context* ctx_in) {
+rknn::Model::Model(std::string model_path, logger::Level level, rknn_context* ctx_in, ModelConfig config) {
     m_rknnPath = model_path;
+    m_config = config;
     m_logger = std::make_shared<logger::Logger>(level);
     m_params = std::make_unique<Params>();
+    m_preprocessor = create_preprocessor(config.preprocess);
     m_inputAttrs = nullptr;
     m_outputAttrs = nullptr;
-    m_rknnCtx = 0;
-    init_model(ctx_in);
+    m_backend = create_backend(config.backend);
+    if(init_model(ctx_in) != 0){
+        release();
+        throw std::runtime_error("failed to initialize shared model instance of " + model_path);
+    }
 }
 
 rknn::Model::~Model() {
+    release();
+}
+
+// 析构和构造失败时释放已初始化的部分
+void rknn::Model::release() {
+    release_zero_copy();
     if(m_inputAttrs != NULL){
         free(m_inputAttrs);
         m_inputAttrs = NULL;
@@ -30,41 +51,37 @@ rknn::Model::~Model() {
         free(m_outputAttrs);
         m_outputAttrs = NULL;
     }
-    if(m_rknnCtx != 0){
-        rknn_destroy(m_rknnCtx);
-        m_rknnCtx = 0;
-    }
+    // 先结束录制再销毁上下文; 最后一个实例释放录制器时写出回放描述
+    m_recorder.reset();
+    m_backend.reset();
 }
 
 int rknn::Model::init_model(rknn_context* ctx_in) {
     int ret;
-    int model_len = 0;
-    unsigned char* model;
-
-    //load RKNN Model
-    model  = load_model(m_rknnPath.c_str(), &model_len);
-    if(model == NULL){
-        LOGE("load model fail!");
-        return -1;
-    }
-    m_rknnCtx = 0;
 
     // Model parameter reuse: use rknn_dup_context if ctx_in is provided
+    // (权重来自ctx_in, 不需要读模型文件)
     if (ctx_in != nullptr) {
-        ret = rknn_dup_context(ctx_in, &m_rknnCtx);
+        ret = m_backend->dup(ctx_in);
         LOG("Using shared context (rknn_dup_context)");
     } else {
-        ret = rknn_init(&m_rknnCtx, model, model_len, 0, NULL);
+        // 同一文件只映射一次, 本实例存在期间保持映射, 之后创建的同模型实例直接复用
+        m_modelBlob = ModelCache::acquire(m_rknnPath);
+        if(m_modelBlob == nullptr){
+            LOGW("load model fail!");
+            return -1;
+        }
+        ret = m_backend->init(*m_modelBlob);
         LOG("Creating new context (rknn_init)");
     }
-    free(model);
     if(ret < 0){
-        LOGE("rknn_init/rknn_dup_context fail! ret = %d", ret);
+        LOGW("rknn_init/rknn_dup_context fail! ret = %d", ret);
         return -1;
     }
+    LOG("inference backend: %s", m_backend->name());
 
     // Set model to bind to specific NPU core (round-robin assignment)
-    int core_id = get_core_num();
+    int core_id = get_core_num(m_config.core_mask);
     rknn_core_mask core_mask;
     switch (core_id) {
         case 0:
@@ -80,18 +97,20 @@ int rknn::Model::init_model(rknn_context* ctx_in) {
             core_mask = RKNN_NPU_CORE_AUTO;
             break;
     }
-    ret = rknn_set_core_mask(m_rknnCtx, core_mask);
+    ret = m_backend->set_core_mask(core_mask);
     if (ret < 0) {
-        LOGE("rknn_set_core_mask fail! ret = %d, core_id = %d", ret, core_id);
+        LOGW("rknn_set_core_mask fail! ret = %d, core_id = %d", ret, core_id);
         return -1;
     }
+    m_coreId = core_id;
     LOG("Model bindied to NPU core %d", core_id);
+    init_metrics();
 
     //get model input info Output NUmber
     rknn_input_output_num io_num;
-    ret = rknn_query(m_rknnCtx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+    ret = m_backend->query(RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
     if(ret != RKNN_SUCC){
-        LOGF("rknn_querry fail! ret = %d", ret);
+        LOGW("rknn_querry fail! ret = %d", ret);
         return -1;
     }
 
@@ -103,9 +122,9 @@ int rknn::Model::init_model(rknn_context* ctx_in) {
     memset(input_attrs, 0, sizeof(input_attrs));
     for(int i = 0; i < io_num.n_input; i++){
         input_attrs[i].index = i;
-        ret = rknn_query(m_rknnCtx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
+        ret = m_backend->query(RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
         if(ret != RKNN_SUCC){
-            LOGF("rknn_query fail! ret = %d", ret);
+            LOGW("rknn_query fail! ret = %d", ret);
             return -1;
         }
         dump_tensor_attr(&(input_attrs[i]));
@@ -117,9 +136,9 @@ int rknn::Model::init_model(rknn_context* ctx_in) {
     memset(output_attrs, 0, sizeof(output_attrs));
     for(int i = 0; i < io_num.n_output; i++){
         output_attrs[i].index = i;
-        ret = rknn_query(m_rknnCtx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
+        ret = m_backend->query(RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
         if(ret != RKNN_SUCC){
-            LOGE("rknn_querry fail! ret=%d", ret);
+            LOGW("rknn_querry fail! ret=%d", ret);
             return -1;
         }
         dump_tensor_attr(&(output_attrs[i]));
@@ -150,56 +169,420 @@ int rknn::Model::init_model(rknn_context* ctx_in) {
 
     }
     
-    LOG("model input height=%d, width=%d, channel=%d",m_params->image_attrs.model_height, m_params->image_attrs.model_width, m_params->image_attrs.model_channels);
+    // NCHW/NHWC的dims[0]都是batch维
+    m_batchSize = input_attrs[0].dims[0] > 1 ? input_attrs[0].dims[0] : 1;
+    m_batchIndex = 0;
+    m_letterboxScale.assign(m_batchSize, 1.0f);
+    m_letterboxPads.assign(m_batchSize, image_rect_t());
+
+    LOG("model input height=%d, width=%d, channel=%d, batch=%d",m_params->image_attrs.model_height, m_params->image_attrs.model_width, m_params->image_attrs.model_channels, m_batchSize);
+    LOG("preprocess backend: %s", m_preprocessor->name());
+
+    if(!m_config.record_dir.empty()){
+        // 录制Model实际取得的输出: 量化模型为int8, 否则为float32
+        m_recorder = TensorRecorder::open(m_config.record_dir, input_attrs, io_num.n_input, output_attrs,
+                                          io_num.n_output, !m_params->is_quant, m_config.record_frames);
+        if(m_recorder == nullptr){
+            LOGW("tensor recording to %s disabled", m_config.record_dir.c_str());
+        }
+    }
+
+    // 每帧复用的rknn_input/rknn_output描述, 初始化时一次性分配
+    m_rknnInputPtr = std::make_unique<rknn_input[]>(m_ioNum.n_input);
+    m_rknnOutputPtr = std::make_unique<rknn_output[]>(m_ioNum.n_output);
+
+    if(m_config.zero_copy){
+        ret = init_zero_copy();
+        if(ret < 0){
+            LOGW("init zero copy io mem fail! ret = %d", ret);
+            return -1;
+        }
+    }else{
+        init_io_buffers();
+    }
 
     return 0; 
 }
 
-rknn::ModelResult rknn::Model::inference(cv::Mat img) {
-    // Lock to ensure thread-safe inference for this model instance
-    std::lock_guard<std::mutex> lock(m_inferenceMtx);
+void rknn::Model::init_io_buffers() {
+    // 预处理目标图像与输出缓冲区按tensor属性一次性分配, 推理时复用, 稳态下无堆分配
+    // 多batch模型的各帧在行方向上依次排列, 与NHWC输入tensor的内存布局一致
+    m_inputImg.create(m_params->image_attrs.model_height * m_batchSize, m_params->image_attrs.model_width, CV_8UC3);
+
+    m_outputBufs.resize(m_ioNum.n_output);
+    for(uint32_t i = 0; i < m_ioNum.n_output; i++){
+        size_t elem_size = m_params->is_quant ? sizeof(int8_t) : sizeof(float);
+        m_outputBufs[i].assign(m_outputAttrs[i].n_elems * elem_size, 0);
+    }
+}
 
+void rknn::Model::init_metrics() {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    std::string core = "core=\"" + std::to_string(m_coreId) + "\"";
+    m_frameCounter = &registry.counter("rknn_model_frames_total", "Frames inferred per NPU core", core);
+    m_inflightGauge = &registry.gauge("rknn_model_inflight", "Frames between preprocess and postprocess per NPU core", core);
+    m_detectionHist = &registry.histogram("rknn_detections_per_frame", "Detections kept after NMS per frame",
+                                          {0, 1, 2, 5, 10, 20, 50, 100});
+}
+
+void rknn::Model::set_frame_active(bool active) {
+    if(active != m_frameActive){
+        m_frameActive = active;
+        m_inflightGauge->add(active ? 1 : -1);
+    }
+}
+
+int rknn::Model::init_zero_copy() {
     int ret;
-    m_img = img.clone();
 
-    m_rknnInputPtr = std::make_unique<rknn_input[]>(m_ioNum.n_input);
+    // 输入统一以NHWC/UINT8绑定, 归一化与量化由runtime完成
+    m_inputMems.assign(m_ioNum.n_input, nullptr);
+    for(uint32_t i = 0; i < m_ioNum.n_input; i++){
+        m_inputAttrs[i].type = RKNN_TENSOR_UINT8;
+        m_inputAttrs[i].fmt = RKNN_TENSOR_NHWC;
+        m_inputAttrs[i].pass_through = 0;
+        uint32_t size = m_inputAttrs[i].size_with_stride > 0 ? m_inputAttrs[i].size_with_stride : m_inputAttrs[i].size;
+        m_inputMems[i] = m_backend->create_mem(size);
+        if(m_inputMems[i] == nullptr){
+            LOGW("rknn_create_mem for input %d fail! size = %u", i, size);
+            return -1;
+        }
+        ret = m_backend->set_io_mem(m_inputMems[i], &m_inputAttrs[i]);
+        if(ret < 0){
+            LOGW("rknn_set_io_mem for input %d fail! ret = %d", i, ret);
+            return -1;
+        }
+    }
+
+    // 输出: 量化模型保留int8输出, 浮点模型由runtime转换为float32
+    m_outputMems.assign(m_ioNum.n_output, nullptr);
+    for(uint32_t i = 0; i < m_ioNum.n_output; i++){
+        uint32_t size = m_outputAttrs[i].size;
+        if(!m_params->is_quant){
+            m_outputAttrs[i].type = RKNN_TENSOR_FLOAT32;
+            size = m_outputAttrs[i].n_elems * sizeof(float);
+        }
+        m_outputMems[i] = m_backend->create_mem(size);
+        if(m_outputMems[i] == nullptr){
+            LOGW("rknn_create_mem for output %d fail! size = %u", i, size);
+            return -1;
+        }
+        ret = m_backend->set_io_mem(m_outputMems[i], &m_outputAttrs[i]);
+        if(ret < 0){
+            LOGW("rknn_set_io_mem for output %d fail! ret = %d", i, ret);
+            return -1;
+        }
+    }
+
+    LOG("Zero copy io mem bound: input w_stride=%d, size_with_stride=%d", m_inputAttrs[0].w_stride, m_inputAttrs[0].size_with_stride);
+    return 0;
+}
+
+void rknn::Model::release_zero_copy() {
+    if(m_backend == nullptr){
+        return;
+    }
+    for(auto mem : m_inputMems){
+        if(mem != nullptr){
+            m_backend->destroy_mem(mem);
+        }
+    }
+    for(auto mem : m_outputMems){
+        if(mem != nullptr){
+            m_backend->destroy_mem(mem);
+        }
+    }
+    m_inputMems.clear();
+    m_outputMems.clear();
+}
+
+cv::Mat rknn::Model::input_image() {
+    int height = m_params->image_attrs.model_height;
+    int width = m_params->image_attrs.model_width;
+    int channels = m_params->image_attrs.model_channels;
+
+    if(m_config.zero_copy && !m_inputMems.empty()){
+        // NPU可能要求按w_stride对齐, 通过Mat的step体现行跨度
+        int w_stride = m_inputAttrs[0].w_stride > 0 ? m_inputAttrs[0].w_stride : width;
+        uint8_t* slot = (uint8_t*)m_inputMems[0]->virt_addr + (size_t)m_batchIndex * height * w_stride * channels;
+        return cv::Mat(height, width, CV_8UC3, slot, (size_t)w_stride * channels);
+    }
+    return m_inputImg.rowRange(m_batchIndex * height, (m_batchIndex + 1) * height);
+}
+
+int rknn::Model::input_fd() const {
+    // fd只能描述整块内存的起点, batch中后续位置的帧通过虚拟地址写入
+    if(m_config.zero_copy && !m_inputMems.empty() && m_batchIndex == 0){
+        return m_inputMems[0]->fd;
+    }
+    return -1;
+}
+
+int rknn::Model::src_width() const {
+    return m_srcBuffer != nullptr ? m_srcBuffer->width : m_img.cols;
+}
+
+int rknn::Model::src_height() const {
+    return m_srcBuffer != nullptr ? m_srcBuffer->height : m_img.rows;
+}
+
+bool rknn::Model::letterbox_input(cv::Mat& dst, float scale, image_rect_t& pads, uint8_t pad_value) {
+    bool ok;
+    if(m_srcBuffer != nullptr){
+        ok = m_preprocessor->run_buffer(*m_srcBuffer, dst, scale, pads, pad_value, input_fd());
+    }else{
+        ok = m_preprocessor->run(m_img, dst, scale, pads, pad_value, input_fd());
+    }
+    m_letterboxScale[m_batchIndex] = scale;
+    m_letterboxPads[m_batchIndex] = pads;
+    return ok;
+}
+
+void* rknn::Model::output_buf(int i) const {
+    // 输出tensor的batch维在最外层, 每帧占n_elems / batch个元素
+    size_t elem_size = m_params->is_quant ? sizeof(int8_t) : sizeof(float);
+    size_t slot_size = (size_t)(m_outputAttrs[i].n_elems / m_batchSize) * elem_size;
+    return (uint8_t*)m_rknnOutputPtr[i].buf + m_batchIndex * slot_size;
+}
+
+std::unique_lock<std::mutex> rknn::Model::lock_inference() {
+    TraceScope trace("wait_model_lock", "model", m_coreId);
+    return std::unique_lock<std::mutex>(m_inferenceMtx);
+}
+
+rknn::ModelResult rknn::Model::inference(const cv::Mat& img) {
+    // Lock to ensure thread-safe inference for this model instance
+    auto lock = lock_inference();
+
+    // 只引用输入图像, 预处理期间调用方不得修改该图像
+    m_img = img;
+    m_srcBuffer = nullptr;
+    return run_inference();
+}
+
+rknn::ModelResult rknn::Model::inference(const image_buffer_t& img) {
+    auto lock = lock_inference();
+
+    // 相机/解码器的原始帧直接交给预处理后端, 不经过整帧BGR转换
+    m_img.release();
+    m_srcBuffer = &img;
+    rknn::ModelResult result = run_inference();
+    m_srcBuffer = nullptr;
+    return result;
+}
+
+bool rknn::Model::stage_preprocess(const cv::Mat& img) {
+    auto lock = lock_inference();
+    m_img = img;
+    m_srcBuffer = nullptr;
+    bool ok = prepare_input();
+    // 预处理结果已在输入tensor中, 不再持有调用方的图像
+    m_img.release();
+    return ok;
+}
+
+bool rknn::Model::stage_preprocess(const image_buffer_t& img) {
+    auto lock = lock_inference();
+    m_img.release();
+    m_srcBuffer = &img;
+    bool ok = prepare_input();
+    m_srcBuffer = nullptr;
+    return ok;
+}
+
+bool rknn::Model::stage_run() {
+    auto lock = lock_inference();
+    return run_npu();
+}
+
+rknn::ModelResult rknn::Model::stage_postprocess() {
+    auto lock = lock_inference();
+    return finish_output();
+}
+
+std::vector<rknn::ModelResult> rknn::Model::inference_batch(const std::vector<cv::Mat>& imgs) {
+    auto lock = lock_inference();
+    std::vector<ModelResult> results = run_batch(imgs);
+    m_img.release();
+    return results;
+}
+
+std::vector<rknn::ModelResult> rknn::Model::inference_batch(const std::vector<image_buffer_t>& imgs) {
+    auto lock = lock_inference();
+    std::vector<ModelResult> results = run_batch(imgs);
+    m_srcBuffer = nullptr;
+    return results;
+}
+
+void rknn::Model::set_source(const cv::Mat& img) {
+    m_img = img;
+    m_srcBuffer = nullptr;
+}
+
+void rknn::Model::set_source(const image_buffer_t& img) {
+    m_img.release();
+    m_srcBuffer = &img;
+}
+
+template <typename Frame>
+std::vector<rknn::ModelResult> rknn::Model::run_batch(const std::vector<Frame>& imgs) {
+    StageTimer total_timer(Stage::TOTAL);
+    std::vector<ModelResult> results;
+    results.reserve(imgs.size());
+    for(size_t start = 0; start < imgs.size(); start += m_batchSize){
+        int count = std::min((int)(imgs.size() - start), m_batchSize);
+
+        // 逐帧letterbox到输入tensor的各个batch位置, 不足batch_size时其余位置保留旧数据, 其输出被忽略.
+        // 预处理失败的帧同样只占位, 结果为空
+        memset(m_rknnInputPtr.get(), 0, m_ioNum.n_input * sizeof(rknn_input));
+        set_frame_active(true);
+        std::vector<bool> prepared(count);
+        int prepared_num = 0;
+        for(int b = 0; b < count; b++){
+            m_batchIndex = b;
+            set_source(imgs[start + b]);
+            StageTimer timer(Stage::PREPROCESS);
+            prepared[b] = preprocess();
+            prepared_num += prepared[b] ? 1 : 0;
+        }
+        m_batchIndex = 0;
+
+        if(prepared_num == 0 || !set_inputs() || !run_npu()){
+            results.resize(start + count);
+            continue;
+        }
+        for(int b = 0; b < count; b++){
+            m_batchIndex = b;
+            results.push_back(prepared[b] ? postprocess_slot() : ModelResult());
+        }
+        m_batchIndex = 0;
+        if(!m_config.zero_copy){
+            m_backend->outputs_release(m_ioNum.n_output, m_rknnOutputPtr.get());
+        }
+    }
+    set_frame_active(false);
+    return results;
+}
+
+rknn::ModelResult rknn::Model::run_inference() {
+    StageTimer timer(Stage::TOTAL);
+    if(!prepare_input() || !run_npu()){
+        set_frame_active(false);
+        return rknn::ModelResult();
+    }
+    return finish_output();
+}
+
+bool rknn::Model::prepare_input() {
     memset(m_rknnInputPtr.get(), 0, m_ioNum.n_input * sizeof(rknn_input));
+    set_frame_active(true);
 
     // pre process
-    preprocess();
-    //set  rknn input
-    ret  = rknn_inputs_set(m_rknnCtx, m_ioNum.n_input, m_rknnInputPtr.get());
-    if(ret < 0){
-        LOGE("rknn_input_set fail! ret=%d", ret);
-        return rknn::ModelResult();
+    m_batchIndex = 0;
+    bool ok;
+    {
+        StageTimer timer(Stage::PREPROCESS);
+        ok = preprocess();
     }
+    if(!ok){
+        set_frame_active(false);
+        return false;
+    }
+    return set_inputs();
+}
+
+bool rknn::Model::set_inputs() {
+    int ret;
+
+    //set  rknn input (零拷贝模式下预处理已直接写入绑定的输入内存)
+    if(!m_config.zero_copy){
+        // 预处理按单帧填写输入描述, 多batch模型的输入是整个batch
+        if(m_batchSize > 1){
+            m_rknnInputPtr[0].buf = m_inputImg.data;
+            m_rknnInputPtr[0].size *= m_batchSize;
+        }
+        StageTimer timer(Stage::INPUTS_SET);
+        ret  = m_backend->inputs_set(m_ioNum.n_input, m_rknnInputPtr.get());
+        if(ret < 0){
+            LOGE("rknn_input_set fail! ret=%d", ret);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rknn::Model::run_npu() {
+    int ret;
 
     //Run
     LOGD("rknn_run!");
-    ret  = rknn_run(m_rknnCtx, nullptr);
+    auto run_start = std::chrono::steady_clock::now();
+    {
+        StageTimer timer(Stage::RUN);
+        ret  = m_backend->run();
+    }
+    int64_t run_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - run_start).count();
     if(ret < 0){
         LOGE("rknn_run fail! ret=%d", ret);
-        return rknn::ModelResult();
+        return false;
     }
 
     // Get output
-    m_rknnOutputPtr = std::make_unique<rknn_output[]>(m_ioNum.n_output);
     memset(m_rknnOutputPtr.get(), 0, m_ioNum.n_output * sizeof(rknn_output));
-    for(int i=0; i < m_ioNum.n_output; i++){
+    for(uint32_t i=0; i < m_ioNum.n_output; i++){
         m_rknnOutputPtr[i].index = i;
         m_rknnOutputPtr[i].want_float = (!m_params->is_quant);
+        if(!m_config.zero_copy){
+            // 使用预分配的输出缓冲区, 避免runtime每帧分配
+            m_rknnOutputPtr[i].is_prealloc = 1;
+            m_rknnOutputPtr[i].buf = m_outputBufs[i].data();
+            m_rknnOutputPtr[i].size = m_outputBufs[i].size();
+        }
     }
-    ret  = rknn_outputs_get(m_rknnCtx, m_ioNum.n_output, m_rknnOutputPtr.get(), NULL);
-    if(ret < 0){
-        LOGE("rknn_output_get fail! ret =%d",  ret);
-        return rknn::ModelResult();
+    if(m_config.zero_copy){
+        // 零拷贝: 输出已写入绑定的内存, 直接交给后处理
+        for(uint32_t i=0; i < m_ioNum.n_output; i++){
+            m_rknnOutputPtr[i].buf = m_outputMems[i]->virt_addr;
+            m_rknnOutputPtr[i].size = m_outputMems[i]->size;
+        }
+    }else{
+        StageTimer timer(Stage::OUTPUTS_GET);
+        ret  = m_backend->outputs_get(m_ioNum.n_output, m_rknnOutputPtr.get());
+        if(ret < 0){
+            LOGE("rknn_output_get fail! ret =%d",  ret);
+            return false;
+        }
+    }
+    if(m_recorder){
+        m_recorder->write(m_rknnOutputPtr.get(), m_ioNum.n_output, run_us);
+    }
+    return true;
+}
+
+rknn::ModelResult rknn::Model::postprocess_slot() {
+    // 没有检测结果时postprocess不会写m_result, 先清空以免返回上一帧的结果
+    m_result = ModelResult();
+    {
+        StageTimer timer(Stage::POSTPROCESS);
+        postprocess();
+    }
+    m_frameCounter->inc();
+    if(const object_detect_result_list* detections = std::get_if<object_detect_result_list>(&m_result)){
+        m_detectionHist->observe(detections->count);
     }
+    return m_result;
+}
 
+rknn::ModelResult rknn::Model::finish_output() {
     //post process
-    postprocess();
+    m_batchIndex = 0;
+    postprocess_slot();
     
     //Remeber to release rknn output
-    ret = rknn_outputs_release(m_rknnCtx, m_ioNum.n_output, m_rknnOutputPtr.get());
+    if(!m_config.zero_copy){
+        m_backend->outputs_release(m_ioNum.n_output, m_rknnOutputPtr.get());
+    }
+    set_frame_active(false);
     
      return m_result; }
 
@@ -0,0 +1,209 @@
+#include "trace.hpp"
+#include "logger.hpp"
+
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::atomic<bool> rknn::Tracer::s_enabled(false);
+
+namespace {
+
+    struct Event {
+        const char* name;
+        const char* cat;
+        int64_t begin_ns;
+        int64_t dur_ns;
+        int64_t arg;
+    };
+
+    // 一个线程的环形缓冲区; 只有所属线程写events, written用release发布, dump在stop之后读.
+    // writing在一次record期间为true, stop/start等它变回false, 之后所属线程不会再写
+    struct Buffer {
+        int tid = 0;
+        std::string name;
+        std::vector<Event> events;
+        std::atomic<uint64_t> written{0};
+        std::atomic<bool> writing{false};
+        bool exited = false;
+    };
+
+    std::mutex g_bufferMtx;
+    std::vector<std::unique_ptr<Buffer>> g_buffers;
+    size_t g_capacity = rknn::Tracer::DEFAULT_CAPACITY;
+    int64_t g_origin = 0;
+
+    inline int64_t to_ns(rknn::Tracer::Clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+
+    struct BufferHolder {
+        Buffer* buffer = nullptr;
+        std::string name;
+        ~BufferHolder() {
+            if(buffer != nullptr){
+                std::lock_guard<std::mutex> lock(g_bufferMtx);
+                buffer->exited = true;
+            }
+        }
+    };
+
+    // 调用前已关闭记录开关; 持g_bufferMtx, 等待正在record的线程写完 (一次record只有几十纳秒)
+    void wait_writers() {
+        for(auto& buffer : g_buffers){
+            while(buffer->writing.load(std::memory_order_acquire)){
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    BufferHolder& local_holder() {
+        static thread_local BufferHolder holder;
+        return holder;
+    }
+
+    Buffer* local_buffer() {
+        BufferHolder& holder = local_holder();
+        if(holder.buffer == nullptr){
+            std::unique_ptr<Buffer> buffer(new Buffer());
+            buffer->tid = (int)syscall(SYS_gettid);
+            buffer->name = holder.name;
+            std::lock_guard<std::mutex> lock(g_bufferMtx);
+            buffer->events.resize(g_capacity);
+            holder.buffer = buffer.get();
+            g_buffers.push_back(std::move(buffer));
+        }
+        return holder.buffer;
+    }
+
+    std::string json_escape(const char* text) {
+        std::string out;
+        for(const char* p = text; *p != '\0'; p++){
+            unsigned char c = (unsigned char)*p;
+            if(c == '"' || c == '\\'){
+                out += '\\';
+                out += (char)c;
+            }else if(c < 0x20){
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }else{
+                out += (char)c;
+            }
+        }
+        return out;
+    }
+
+} // namespace
+
+void rknn::Tracer::start(size_t capacity) {
+    // 没有stop就再次start时, 先让正在写的线程停下, 只清空不再被写的缓冲区
+    s_enabled.store(false, std::memory_order_seq_cst);
+    {
+        std::lock_guard<std::mutex> lock(g_bufferMtx);
+        wait_writers();
+        // 上一次记录中已退出线程的缓冲区在这里释放, 仍在运行的线程清空后继续使用
+        std::vector<std::unique_ptr<Buffer>> alive;
+        for(auto& buffer : g_buffers){
+            if(!buffer->exited){
+                buffer->written.store(0, std::memory_order_relaxed);
+                alive.push_back(std::move(buffer));
+            }
+        }
+        g_buffers.swap(alive);
+        g_capacity = capacity > 0 ? capacity : DEFAULT_CAPACITY;
+        g_origin = to_ns(Clock::now());
+    }
+    s_enabled.store(true, std::memory_order_seq_cst);
+}
+
+void rknn::Tracer::stop() {
+    s_enabled.store(false, std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(g_bufferMtx);
+    wait_writers();
+}
+
+void rknn::Tracer::record(const char* name, const char* cat, Clock::time_point begin, Clock::time_point end, int64_t arg) {
+    Buffer* buffer = local_buffer();
+    // 先标记writing再检查开关, 与stop的先关开关再等writing配对: TraceScope在stop前开始、stop后结束时不记录,
+    // stop返回后不会再有写入与dump竞争
+    buffer->writing.store(true, std::memory_order_seq_cst);
+    if(!s_enabled.load(std::memory_order_seq_cst)){
+        buffer->writing.store(false, std::memory_order_release);
+        return;
+    }
+    uint64_t n = buffer->written.load(std::memory_order_relaxed);
+    Event& event = buffer->events[n % buffer->events.size()];
+    event.name = name;
+    event.cat = cat;
+    event.begin_ns = to_ns(begin);
+    event.dur_ns = to_ns(end) - event.begin_ns;
+    event.arg = arg;
+    buffer->written.store(n + 1, std::memory_order_release);
+    buffer->writing.store(false, std::memory_order_release);
+}
+
+void rknn::Tracer::set_thread_name(const std::string& name) {
+    BufferHolder& holder = local_holder();
+    holder.name = name;
+    if(holder.buffer != nullptr){
+        std::lock_guard<std::mutex> lock(g_bufferMtx);
+        holder.buffer->name = name;
+    }
+}
+
+bool rknn::Tracer::dump(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if(fp == NULL){
+        LOGW("cannot open %s", path.c_str());
+        return false;
+    }
+    int pid = (int)getpid();
+    size_t total = 0;
+    size_t overwritten = 0;
+    size_t threads = 0;
+
+    std::lock_guard<std::mutex> lock(g_bufferMtx);
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"rknn\"}}", pid);
+    for(auto& buffer : g_buffers){
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        if(written == 0){
+            continue;
+        }
+        threads++;
+        std::string name = buffer->name.empty() ? "thread " + std::to_string(buffer->tid) : buffer->name;
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                pid, buffer->tid, json_escape(name.c_str()).c_str());
+
+        uint64_t capacity = buffer->events.size();
+        uint64_t first = written > capacity ? written - capacity : 0;
+        overwritten += first;
+        for(uint64_t i = first; i < written; i++){
+            const Event& event = buffer->events[i % capacity];
+            if(event.name == nullptr){
+                continue;
+            }
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                    json_escape(event.name).c_str(), json_escape(event.cat).c_str(),
+                    (event.begin_ns - g_origin) / 1000.0, event.dur_ns / 1000.0, pid, buffer->tid);
+            if(event.arg >= 0){
+                fprintf(fp, ",\"args\":{\"arg\":%lld}", (long long)event.arg);
+            }
+            fprintf(fp, "}");
+            total++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    if(fclose(fp) != 0){
+        LOGW("cannot write trace to %s", path.c_str());
+        return false;
+    }
+    LOG("trace: %zu events from %zu threads written to %s (%zu overwritten)", total, threads, path.c_str(), overwritten);
+    return true;
+}
@@ -1,6 +1,9 @@
 #include "utils.hpp"
 #include "logger.hpp"
 
+#include <mutex>
+#include <string>
+
 // 定义 labels 全局变量
 char *labels[OBJ_CLASS_NUM];
 
@@ -36,25 +39,49 @@ unsigned char* load_model(const char* filename, int* model_size) {
 void letterbox(const cv::Mat& image,  cv::Mat& padded_img,
                image_rect_t& pads, const float scale,
                const cv::Size& traget_size, const cv::Scalar& pad_color) {
-    
-                //adjust image size;
-                cv::Mat resized_img;
-                cv::resize(image, resized_img, cv::Size(), scale, scale);
-
-                //compute pad size
-                int pad_width = traget_size.width - resized_img.cols;
-                int pad_height = traget_size.height - resized_img.rows;
-
-                pads.left = pad_width / 2;
-                pads.right = pad_width - pads.left;
-                pads.top = pad_height / 2;
-                pads.bottom = pad_height - pads.top;
-                
-                //add pad surrunding image
-                cv::copyMakeBorder(resized_img, padded_img, pads.top, pads.bottom, pads.left, pads.right, cv::BORDER_CONSTANT, pad_color);
+    //adjust image size (与cv::resize按scale计算目标尺寸的方式一致)
+    int scaled_w = cv::saturate_cast<int>(image.cols * (double)scale);
+    int scaled_h = cv::saturate_cast<int>(image.rows * (double)scale);
+    int resized_w = std::min(scaled_w, traget_size.width);
+    int resized_h = std::min(scaled_h, traget_size.height);
+
+    //compute pad size
+    int pad_width = traget_size.width - resized_w;
+    int pad_height = traget_size.height - resized_h;
+
+    pads.left = pad_width / 2;
+    pads.right = pad_width - pads.left;
+    pads.top = pad_height / 2;
+    pads.bottom = pad_height - pads.top;
+
+    // padded_img尺寸/类型一致时create不会重新分配, 可直接写入预分配或零拷贝绑定的内存
+    padded_img.create(traget_size, image.type());
+
+    // 直接缩放到目标图像的ROI中, 省去中间图像和copyMakeBorder的拷贝.
+    // dsize传空: OpenCV按scale计算出的尺寸与ROI相同, 结果写入ROI, 插值比例仍直接取scale;
+    // 传roi.size()时OpenCV会改用 目标尺寸/源尺寸 作为比例, 插值系数与原来的resize不同
+    cv::Mat roi = padded_img(cv::Rect(pads.left, pads.top, resized_w, resized_h));
+    if(resized_w == scaled_w && resized_h == scaled_h){
+        cv::resize(image, roi, cv::Size(), scale, scale);
+    }else{
+        // scale超出目标尺寸时只能缩放到被截断的ROI
+        cv::resize(image, roi, roi.size());
+    }
 
-    
-               }
+    //add pad surrunding image
+    if(pads.top > 0){
+        padded_img.rowRange(0, pads.top).setTo(pad_color);
+    }
+    if(pads.bottom > 0){
+        padded_img.rowRange(traget_size.height - pads.bottom, traget_size.height).setTo(pad_color);
+    }
+    if(pads.left > 0){
+        padded_img(cv::Rect(0, pads.top, pads.left, resized_h)).setTo(pad_color);
+    }
+    if(pads.right > 0){
+        padded_img(cv::Rect(pads.left + resized_w, pads.top, pads.right, resized_h)).setTo(pad_color);
+    }
+}
 
 int8_t qnt_f32_to_affine(float f32, int32_t zp, float scale) {
     float dst_val = (f32 / scale) + zp;
@@ -136,7 +163,7 @@ float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0,
 }
 
 int nms(int validCount, std::vector<float>& outputLocations,
-        std::vector<int> classIds, std::vector<int>& order, int filterId,
+        const std::vector<int>& classIds, std::vector<int>& order, int filterId,
         float threshold) {
     for (int i = 0; i < validCount; ++i)
     {
@@ -234,8 +261,17 @@ int readLines(const char* fileName, char* lines[], int max_line) {
 }
 
 int loadLabelName(const char* locationFilename, char* label[]) { 
+    // 每个模型实例构造时都会调用; 同一文件只读一次, 并行创建实例时也不会同时改写标签表
+    static std::mutex mtx;
+    static std::string loaded;
+    std::lock_guard<std::mutex> lock(mtx);
+    if (loaded == locationFilename)
+    {
+        return 0;
+    }
     LOGD("load lable %s\n", locationFilename);
     readLines(locationFilename, label, OBJ_CLASS_NUM);
+    loaded = locationFilename;
     return 0;
 }
 
@@ -1,19 +1,20 @@
 #include "yolo11.hpp"
 #include "utils.hpp"
+#include "latency.hpp"
 
-#include <set>
+#include <algorithm>
 
 std::string detector::out_path = "./out.jpg";
 
-detector::YOLO11::YOLO11(std::string model_path, logger::Level level,  DetectParam detect_param):rknn::Model(model_path, level) {
+detector::YOLO11::YOLO11(std::string model_path, logger::Level level,  DetectParam detect_param, rknn::ModelConfig config):rknn::Model(model_path, level, config) {
     m_detectParam = detect_param;
     init_post_process();
     m_odReseultsPtr = std::make_unique<object_detect_result_list>();
 
 }
 
-detector::YOLO11::YOLO11(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param)
-    :rknn::Model(model_path, level, ctx_in) {
+detector::YOLO11::YOLO11(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param, rknn::ModelConfig config)
+    :rknn::Model(model_path, level, ctx_in, config) {
     m_detectParam = detect_param;
     init_post_process();
     m_odReseultsPtr = std::make_unique<object_detect_result_list>();
@@ -26,20 +27,46 @@ object_detect_result_list detector::YOLO11::infer(cv::Mat img) {
     return std::get<object_detect_result_list>(result);
 }
 
+object_detect_result_list detector::YOLO11::infer(image_buffer_t img) {
+    auto result = inference(img);
+    return std::get<object_detect_result_list>(result);
+}
+
+std::vector<object_detect_result_list> detector::YOLO11::infer_batch(const std::vector<cv::Mat> &imgs) {
+    std::vector<object_detect_result_list> out;
+    out.reserve(imgs.size());
+    for (auto &result : inference_batch(imgs)) {
+        out.push_back(std::get<object_detect_result_list>(result));
+    }
+    return out;
+}
+
+std::vector<object_detect_result_list> detector::YOLO11::infer_batch(const std::vector<image_buffer_t> &imgs) {
+    std::vector<object_detect_result_list> out;
+    out.reserve(imgs.size());
+    for (auto &result : inference_batch(imgs)) {
+        out.push_back(std::get<object_detect_result_list>(result));
+    }
+    return out;
+}
+
 bool detector::YOLO11::preprocess() {
   // 将原始图像处理成模型所需的大小
-  memset(&m_pads, 0, sizeof(image_rect_t));
+  image_rect_t pads;
+  memset(&pads, 0, sizeof(image_rect_t));
   cv::Size target_size(m_params->image_attrs.model_height,
                        m_params->image_attrs.model_width);
-  m_resized_img = cv::Mat(target_size.height, target_size.width, CV_8UC3);
+  m_resized_img = input_image();
 
   // compute scale
-  float scale_h = (float)target_size.height / m_img.rows;
-  float scale_w = (float)target_size.width / m_img.cols;
-  m_scale = std::min(scale_h, scale_w);
-
-  letterbox(m_img, m_resized_img, m_pads, m_scale, target_size,
-            cv::Scalar(128, 128, 128));
+  float scale_h = (float)target_size.height / src_height();
+  float scale_w = (float)target_size.width / src_width();
+  float scale = std::min(scale_h, scale_w);
+
+  // 缩放、填充与BGR->RGB由所选的预处理后端完成, 直接写入输入tensor
+  if(!letterbox_input(m_resized_img, scale, pads, 128)){
+      return false;
+  }
   m_rknnInputPtr[0].index = 0;
   m_rknnInputPtr[0].type = RKNN_TENSOR_UINT8;
   m_rknnInputPtr[0].size = m_params->image_attrs.model_height *
@@ -53,11 +80,8 @@ bool detector::YOLO11::preprocess() {
 }
 
 bool detector::YOLO11::postprocess() {
-    m_filterBoxes.clear();
-    m_objProbs.clear();
-    m_classId.clear();
-
-    rknn_output *_outputs = (rknn_output *)m_rknnOutputPtr.get();
+    // 每帧最多保留pre_nms_top_k个候选, 后处理耗时不随场景密度增长
+    m_candidates.reset(m_detectParam.pre_nms_top_k);
 
     int validCount = 0;
     int grid_h = 0;
@@ -65,6 +89,9 @@ bool detector::YOLO11::postprocess() {
     int stride = 0;
     int model_in_h = m_params->image_attrs.model_height;
     int model_in_w = m_params->image_attrs.model_width;
+    // letterbox参数按当前batch位置取, 单帧推理时即第0帧
+    float scale = letterbox_scale();
+    const image_rect_t &pads = letterbox_pads();
 
     memset(m_odReseultsPtr.get(), 0, sizeof(object_detect_result_list));
 
@@ -76,7 +103,7 @@ bool detector::YOLO11::postprocess() {
         int32_t score_sum_zp = 0;
         float score_sum_scale = 1.0;
         if(output_per_branch == 3){
-            score_sum = _outputs[i*output_per_branch + 2].buf;
+            score_sum = output_buf(i*output_per_branch + 2);
             score_sum_zp = m_outputAttrs[i*output_per_branch + 2].zp;
             score_sum_scale = m_outputAttrs[i*output_per_branch +2].scale;
         }
@@ -89,55 +116,53 @@ bool detector::YOLO11::postprocess() {
         stride = model_in_h / grid_h;
 
         if(m_params->is_quant){
-            validCount += process_i8((int8_t *)_outputs[box_idx].buf, m_outputAttrs[box_idx].zp, m_outputAttrs[box_idx].scale,
-                                     (int8_t *)_outputs[score_idx].buf, m_outputAttrs[score_idx].zp, m_outputAttrs[score_idx].scale,
+            validCount += process_i8((int8_t *)output_buf(box_idx), m_dflDecoders[i],
+                                     (int8_t *)output_buf(score_idx), m_outputAttrs[score_idx].zp, m_outputAttrs[score_idx].scale,
                                      (int8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                     grid_h, grid_w, stride, dfl_len, 
-                                     m_filterBoxes, m_objProbs, m_classId, m_detectParam.confidence);
+                                     grid_h, grid_w, stride, 
+                                     m_candidates, m_detectParam.confidence);
         }else{
-            validCount += process_fp32((float *)_outputs[box_idx].buf, (float *)_outputs[score_idx].buf, (float *)score_sum,
+            validCount += process_fp32((float *)output_buf(box_idx), (float *)output_buf(score_idx), (float *)score_sum,
                                        grid_h, grid_w, stride, dfl_len, 
-                                       m_filterBoxes, m_objProbs, m_classId, m_detectParam.confidence);
+                                       m_candidates, m_detectParam.confidence);
 
         }
     }
 
+    validCount = m_candidates.size();
     if(validCount <= 0){
         return false;
     }
 
-    std::vector<int> indexArray;
-    for(int i = 0; i < validCount; ++i){
-        indexArray.push_back(i);
+    // 排序一次, 按类别分桶做NMS, 最多保留max_detections个框
+    int max_detections = std::min(m_detectParam.max_detections, OBJ_NUMB_MAX_SIZE);
+    if(max_detections <= 0){
+        max_detections = OBJ_NUMB_MAX_SIZE;
     }
-    quick_sort_indice_inverse(m_objProbs, 0, validCount - 1, indexArray);
-
-    std::set<int> class_set(std::begin(m_classId), std::end(m_classId));
-
-    for(auto c : class_set){
-        nms(validCount, m_filterBoxes, m_classId, indexArray, c, m_detectParam.nms_threshold);
+    const float* boxes = m_candidates.boxes();
+    int keep_count;
+    {
+        rknn::StageTimer timer(rknn::Stage::NMS);
+        keep_count = m_nms.run(boxes, m_candidates.scores(), m_candidates.class_ids(), validCount,
+                               m_detectParam.nms_threshold, max_detections, m_detectParam.nms_mode);
     }
     int last_count = 0;
     m_odReseultsPtr->count = 0;
 
-    for(int i = 0; i < validCount; i++){
-        if (indexArray[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE)
-        {
-            continue;
-        }
-        int n = indexArray[i];
-
-        float x1 = m_filterBoxes[n * 4 + 0] - m_pads.left;
-        float y1 = m_filterBoxes[n * 4 + 1] - m_pads.top;
-        float x2 = x1 + m_filterBoxes[n * 4 + 2];
-        float y2 = y1 + m_filterBoxes[n * 4 + 3];
-        int id = m_classId[n];
-        float obj_conf = m_objProbs[i];
-
-        m_odReseultsPtr->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / m_scale);
-        m_odReseultsPtr->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / m_scale);
-        m_odReseultsPtr->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / m_scale);
-        m_odReseultsPtr->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / m_scale);
+    for(int i = 0; i < keep_count; i++){
+        int n = m_nms.keep(i);
+
+        float x1 = boxes[n * 4 + 0] - pads.left;
+        float y1 = boxes[n * 4 + 1] - pads.top;
+        float x2 = x1 + boxes[n * 4 + 2];
+        float y2 = y1 + boxes[n * 4 + 3];
+        int id = m_candidates.class_ids()[n];
+        float obj_conf = m_candidates.scores()[n];
+
+        m_odReseultsPtr->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / scale);
+        m_odReseultsPtr->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / scale);
+        m_odReseultsPtr->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / scale);
+        m_odReseultsPtr->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / scale);
         m_odReseultsPtr->results[last_count].prop = obj_conf;
         m_odReseultsPtr->results[last_count].cls_id = id;
         last_count++;
@@ -151,139 +176,90 @@ bool detector::YOLO11::postprocess() {
     return true; }
 
 int detector::YOLO11::process_i8(
-    int8_t* box_tensor, int32_t box_zp, float box_scale, int8_t* score_tensor,
+    int8_t* box_tensor, const DflDecoder& box_decoder, int8_t* score_tensor,
     int32_t score_zp, float score_scale, int8_t* score_sum_tensor,
     int32_t score_sum_zp, float score_sum_scale, int grid_h, int grid_w,
-    int stride, int dfl_len, std::vector<float>& boxes,
-    std::vector<float>& objProbs, std::vector<int>& classId, float threshold) {
+    int stride, CandidateCollector& candidates, float threshold) {
         int validCount = 0;
         int grid_len = grid_h * grid_w;
         int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
         int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
-    
-        for (int i = 0; i < grid_h; i++)
+        // 最大分数还需大于反量化为0的值 (-zp), 与原逐类别比较的初值一致
+        int8_t score_min_i8 = std::max(score_thres_i8, (int8_t)(-score_zp));
+
+        // 按类别通道向量化求每个cell的最大分数, score sum作为gate整组跳过
+        int count = m_scoreScannerI8.scan(score_tensor, m_detectParam.class_num, grid_len, score_min_i8,
+                                          score_sum_tensor, score_sum_thres_i8);
+        for (int k = 0; k < count; k++)
         {
-            for (int j = 0; j < grid_w; j++)
+            float score = deqnt_affine_to_f32(m_scoreScannerI8.score(k), score_zp, score_scale);
+            // top-K已满且分数不够时跳过box解码
+            if (!candidates.accept(score))
             {
-                int offset = i* grid_w + j;
-                int max_class_id = -1;
-    
-                // 通过 score sum 起到快速过滤的作用
-                if (score_sum_tensor != nullptr){
-                    if (score_sum_tensor[offset] < score_sum_thres_i8){
-                        continue;
-                    }
-                }
-    
-                int8_t max_score = -score_zp;
-                for (int c= 0; c< m_detectParam.class_num; c++){
-                    if ((score_tensor[offset] > score_thres_i8) && (score_tensor[offset] > max_score))
-                    {
-                        max_score = score_tensor[offset];
-                        max_class_id = c;
-                    }
-                    offset += grid_len;
-                }
-    
-                // compute box
-                if (max_score> score_thres_i8){
-                    offset = i* grid_w + j;
-                    float box[4];
-                    float before_dfl[dfl_len*4];
-                    for (int k=0; k< dfl_len*4; k++){
-                        before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
-                        offset += grid_len;
-                    }
-                    compute_dfl(before_dfl, dfl_len, box);
-    
-                    float x1,y1,x2,y2,w,h;
-                    x1 = (-box[0] + j + 0.5)*stride;
-                    y1 = (-box[1] + i + 0.5)*stride;
-                    x2 = (box[2] + j + 0.5)*stride;
-                    y2 = (box[3] + i + 0.5)*stride;
-                    w = x2 - x1;
-                    h = y2 - y1;
-                    boxes.push_back(x1);
-                    boxes.push_back(y1);
-                    boxes.push_back(w);
-                    boxes.push_back(h);
-    
-                    objProbs.push_back(deqnt_affine_to_f32(max_score, score_zp, score_scale));
-                    classId.push_back(max_class_id);
-                    validCount ++;
-                }
+                continue;
+            }
+            int offset = m_scoreScannerI8.cell(k);
+            int i = offset / grid_w;
+            int j = offset % grid_w;
+
+            // compute box
+            float box[4];
+            box_decoder.decode(box_tensor + offset, grid_len, box);
+
+            float x1,y1,x2,y2,w,h;
+            x1 = (-box[0] + j + 0.5)*stride;
+            y1 = (-box[1] + i + 0.5)*stride;
+            x2 = (box[2] + j + 0.5)*stride;
+            y2 = (box[3] + i + 0.5)*stride;
+            w = x2 - x1;
+            h = y2 - y1;
+            if (candidates.push(x1, y1, w, h, score, m_scoreScannerI8.class_id(k)))
+            {
+                validCount++;
             }
         }
         return validCount;
     }
 
 int detector::YOLO11::process_u8(
-    uint8_t* box_tensor, int32_t box_zp, float box_scale, uint8_t* score_tensor,
+    uint8_t* box_tensor, const DflDecoder& box_decoder, uint8_t* score_tensor,
     int32_t score_zp, float score_scale, uint8_t* score_sum_tensor,
     int32_t score_sum_zp, float score_sum_scale, int grid_h, int grid_w,
-    int stride, int dfl_len, std::vector<float>& boxes,
-    std::vector<float>& objProbs, std::vector<int>& classId, float threshold) {
+    int stride, CandidateCollector& candidates, float threshold) {
         int validCount = 0;
         int grid_len = grid_h * grid_w;
         uint8_t score_thres_u8 = qnt_f32_to_affine_u8(threshold, score_zp, score_scale);
         uint8_t score_sum_thres_u8 = qnt_f32_to_affine_u8(threshold, score_sum_zp, score_sum_scale);
-    
-        for (int i = 0; i < grid_h; i++)
+        uint8_t score_min_u8 = std::max(score_thres_u8, (uint8_t)(-score_zp));
+
+        int count = m_scoreScannerU8.scan(score_tensor, m_detectParam.class_num, grid_len, score_min_u8,
+                                          score_sum_tensor, score_sum_thres_u8);
+        for (int k = 0; k < count; k++)
         {
-            for (int j = 0; j < grid_w; j++)
+            float score = deqnt_affine_u8_to_f32(m_scoreScannerU8.score(k), score_zp, score_scale);
+            // top-K已满且分数不够时跳过box解码
+            if (!candidates.accept(score))
             {
-                int offset = i * grid_w + j;
-                int max_class_id = -1;
-    
-                // Use score sum to quickly filter
-                if (score_sum_tensor != nullptr)
-                {
-                    if (score_sum_tensor[offset] < score_sum_thres_u8)
-                    {
-                        continue;
-                    }
-                }
-    
-                uint8_t max_score = -score_zp;
-                for (int c = 0; c < m_detectParam.class_num; c++)
-                {
-                    if ((score_tensor[offset] > score_thres_u8) && (score_tensor[offset] > max_score))
-                    {
-                        max_score = score_tensor[offset];
-                        max_class_id = c;
-                    }
-                    offset += grid_len;
-                }
-    
-                // compute box
-                if (max_score > score_thres_u8)
-                {
-                    offset = i * grid_w + j;
-                    float box[4];
-                    float before_dfl[dfl_len * 4];
-                    for (int k = 0; k < dfl_len * 4; k++)
-                    {
-                        before_dfl[k] = deqnt_affine_u8_to_f32(box_tensor[offset], box_zp, box_scale);
-                        offset += grid_len;
-                    }
-                    compute_dfl(before_dfl, dfl_len, box);
-    
-                    float x1, y1, x2, y2, w, h;
-                    x1 = (-box[0] + j + 0.5) * stride;
-                    y1 = (-box[1] + i + 0.5) * stride;
-                    x2 = (box[2] + j + 0.5) * stride;
-                    y2 = (box[3] + i + 0.5) * stride;
-                    w = x2 - x1;
-                    h = y2 - y1;
-                    boxes.push_back(x1);
-                    boxes.push_back(y1);
-                    boxes.push_back(w);
-                    boxes.push_back(h);
-    
-                    objProbs.push_back(deqnt_affine_u8_to_f32(max_score, score_zp, score_scale));
-                    classId.push_back(max_class_id);
-                    validCount++;
-                }
+                continue;
+            }
+            int offset = m_scoreScannerU8.cell(k);
+            int i = offset / grid_w;
+            int j = offset % grid_w;
+
+            // compute box
+            float box[4];
+            box_decoder.decode(box_tensor + offset, grid_len, box);
+
+            float x1, y1, x2, y2, w, h;
+            x1 = (-box[0] + j + 0.5) * stride;
+            y1 = (-box[1] + i + 0.5) * stride;
+            x2 = (box[2] + j + 0.5) * stride;
+            y2 = (box[3] + i + 0.5) * stride;
+            w = x2 - x1;
+            h = y2 - y1;
+            if (candidates.push(x1, y1, w, h, score, m_scoreScannerU8.class_id(k)))
+            {
+                validCount++;
             }
         }
         return validCount;
@@ -292,62 +268,42 @@ int detector::YOLO11::process_u8(
 int detector::YOLO11::process_fp32(float* box_tensor, float* score_tensor,
                                    float* score_sum_tensor, int grid_h,
                                    int grid_w, int stride, int dfl_len,
-                                   std::vector<float>& boxes,
-                                   std::vector<float>& objProbs,
-                                   std::vector<int>& classId, float threshold) {
+                                   CandidateCollector& candidates, float threshold) {
     int validCount = 0;
     int grid_len = grid_h * grid_w;
-    for (int i = 0; i < grid_h; i++)
+    // 最大分数需为正且大于阈值, 与原逐类别比较的初值0一致
+    int count = m_scoreScannerF32.scan(score_tensor, m_detectParam.class_num, grid_len, std::max(threshold, 0.f),
+                                       score_sum_tensor, threshold);
+    for (int k = 0; k < count; k++)
     {
-        for (int j = 0; j < grid_w; j++)
+        float score = m_scoreScannerF32.score(k);
+        // top-K已满且分数不够时跳过box解码
+        if (!candidates.accept(score))
         {
-            int offset = i* grid_w + j;
-            int max_class_id = -1;
-
-            // 通过 score sum 起到快速过滤的作用
-            if (score_sum_tensor != nullptr){
-                if (score_sum_tensor[offset] < threshold){
-                    continue;
-                }
-            }
-
-            float max_score = 0;
-            for (int c= 0; c< m_detectParam.class_num; c++){
-                if ((score_tensor[offset] > threshold) && (score_tensor[offset] > max_score))
-                {
-                    max_score = score_tensor[offset];
-                    max_class_id = c;
-                }
-                offset += grid_len;
-            }
-
-            // compute box
-            if (max_score> threshold){
-                offset = i* grid_w + j;
-                float box[4];
-                float before_dfl[dfl_len*4];
-                for (int k=0; k< dfl_len*4; k++){
-                    before_dfl[k] = box_tensor[offset];
-                    offset += grid_len;
-                }
-                compute_dfl(before_dfl, dfl_len, box);
-
-                float x1,y1,x2,y2,w,h;
-                x1 = (-box[0] + j + 0.5)*stride;
-                y1 = (-box[1] + i + 0.5)*stride;
-                x2 = (box[2] + j + 0.5)*stride;
-                y2 = (box[3] + i + 0.5)*stride;
-                w = x2 - x1;
-                h = y2 - y1;
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(w);
-                boxes.push_back(h);
-
-                objProbs.push_back(max_score);
-                classId.push_back(max_class_id);
-                validCount ++;
-            }
+            continue;
+        }
+        int offset = m_scoreScannerF32.cell(k);
+        int i = offset / grid_w;
+        int j = offset % grid_w;
+
+        // compute box
+        float box[4];
+        float before_dfl[dfl_len*4];
+        for (int n=0; n< dfl_len*4; n++){
+            before_dfl[n] = box_tensor[offset + n*grid_len];
+        }
+        compute_dfl(before_dfl, dfl_len, box);
+
+        float x1,y1,x2,y2,w,h;
+        x1 = (-box[0] + j + 0.5)*stride;
+        y1 = (-box[1] + i + 0.5)*stride;
+        x2 = (box[2] + j + 0.5)*stride;
+        y2 = (box[3] + i + 0.5)*stride;
+        w = x2 - x1;
+        h = y2 - y1;
+        if (candidates.push(x1, y1, w, h, score, m_scoreScannerF32.class_id(k)))
+        {
+            validCount++;
         }
     }
     return validCount;
@@ -361,6 +317,31 @@ int detector::YOLO11::init_post_process() {
         LOGE("Load %s failed!\n", LABEL_NALE_TXT_PATH);
         return -1;
     }
+
+    // 按所有grid cell数预留候选框容量, 稳态推理时不再扩容
+    int output_per_branch = m_ioNum.n_output / 3;
+    int max_candidates = 0;
+    for(int i = 0; i < 3; i++){
+        max_candidates += m_outputAttrs[i*output_per_branch].dims[2] * m_outputAttrs[i*output_per_branch].dims[3];
+    }
+    m_candidates.reserve(max_candidates);
+    m_nms.reserve(max_candidates, m_detectParam.class_num);
+    int max_grid_len = m_outputAttrs[0].dims[2] * m_outputAttrs[0].dims[3];
+    m_scoreScannerI8.reserve(max_grid_len);
+    m_scoreScannerU8.reserve(max_grid_len);
+    m_scoreScannerF32.reserve(max_grid_len);
+
+    // 量化模型的DFL查表只依赖box输出tensor的scale, 在这里一次建好
+    m_dflDecoders.assign(3, DflDecoder());
+    if(m_params->is_quant){
+        for(int i = 0; i < 3; i++){
+            rknn_tensor_attr& box_attr = m_outputAttrs[i*output_per_branch];
+            if(!m_dflDecoders[i].init(box_attr.scale, box_attr.dims[1] / 4)){
+                LOGE("unsupported dfl_len %d (max %d)\n", box_attr.dims[1] / 4, DflDecoder::DFL_LEN_MAX);
+                return -1;
+            }
+        }
+    }
     return 0;
 }
 
@@ -1,22 +1,23 @@
 #include "yolov5.hpp"
 #include "utils.hpp"
+#include "latency.hpp"
 
-#include <set>
+#include <algorithm>
 
 // YOLOv5 anchors for 3 output layers
 static int anchor0[6] = {10, 13, 16, 30, 33, 23};      // stride 8
 static int anchor1[6] = {30, 61, 62, 45, 59, 119};     // stride 16
 static int anchor2[6] = {116, 90, 156, 198, 373, 326}; // stride 32
 
-detector::YOLO5::YOLO5(std::string model_path, logger::Level level, DetectParam detect_param)
-    : rknn::Model(model_path, level) {
+detector::YOLO5::YOLO5(std::string model_path, logger::Level level, DetectParam detect_param, rknn::ModelConfig config)
+    : rknn::Model(model_path, level, config) {
     m_detectParam = detect_param;
     init_post_process();
     m_odReseultsPtr = std::make_unique<object_detect_result_list>();
 }
 
-detector::YOLO5::YOLO5(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param)
-    : rknn::Model(model_path, level, ctx_in) {
+detector::YOLO5::YOLO5(std::string model_path, logger::Level level, rknn_context* ctx_in, DetectParam detect_param, rknn::ModelConfig config)
+    : rknn::Model(model_path, level, ctx_in, config) {
     m_detectParam = detect_param;
     init_post_process();
     m_odReseultsPtr = std::make_unique<object_detect_result_list>();
@@ -29,20 +30,46 @@ object_detect_result_list detector::YOLO5::infer(cv::Mat img) {
     return std::get<object_detect_result_list>(result);
 }
 
+object_detect_result_list detector::YOLO5::infer(image_buffer_t img) {
+    auto result = inference(img);
+    return std::get<object_detect_result_list>(result);
+}
+
+std::vector<object_detect_result_list> detector::YOLO5::infer_batch(const std::vector<cv::Mat> &imgs) {
+    std::vector<object_detect_result_list> out;
+    out.reserve(imgs.size());
+    for (auto &result : inference_batch(imgs)) {
+        out.push_back(std::get<object_detect_result_list>(result));
+    }
+    return out;
+}
+
+std::vector<object_detect_result_list> detector::YOLO5::infer_batch(const std::vector<image_buffer_t> &imgs) {
+    std::vector<object_detect_result_list> out;
+    out.reserve(imgs.size());
+    for (auto &result : inference_batch(imgs)) {
+        out.push_back(std::get<object_detect_result_list>(result));
+    }
+    return out;
+}
+
 bool detector::YOLO5::preprocess() {
     // Preprocess image to model input size with letterbox
-    memset(&m_pads, 0, sizeof(image_rect_t));
+    image_rect_t pads;
+    memset(&pads, 0, sizeof(image_rect_t));
     cv::Size target_size(m_params->image_attrs.model_width,
                          m_params->image_attrs.model_height);
-    m_resized_img = cv::Mat(target_size.height, target_size.width, CV_8UC3);
+    m_resized_img = input_image();
 
     // Compute scale factor
-    float scale_h = (float)target_size.height / m_img.rows;
-    float scale_w = (float)target_size.width / m_img.cols;
-    m_scale = std::min(scale_h, scale_w);
+    float scale_h = (float)target_size.height / src_height();
+    float scale_w = (float)target_size.width / src_width();
+    float scale = std::min(scale_h, scale_w);
 
-    letterbox(m_img, m_resized_img, m_pads, m_scale, target_size,
-              cv::Scalar(128, 128, 128));
+    // Resize + pad + BGR->RGB by the selected backend, straight into the input tensor
+    if(!letterbox_input(m_resized_img, scale, pads, 128)){
+        return false;
+    }
 
     // Setup RKNN input
     m_rknnInputPtr[0].index = 0;
@@ -58,15 +85,15 @@ bool detector::YOLO5::preprocess() {
 }
 
 bool detector::YOLO5::postprocess() {
-    m_filterBoxes.clear();
-    m_objProbs.clear();
-    m_classId.clear();
-
-    rknn_output *_outputs = (rknn_output *)m_rknnOutputPtr.get();
+    // Keep at most pre_nms_top_k candidates so the work is bounded regardless of scene density
+    m_candidates.reset(m_detectParam.pre_nms_top_k);
 
     int validCount = 0;
     int model_in_h = m_params->image_attrs.model_height;
     int model_in_w = m_params->image_attrs.model_width;
+    // Letterbox parameters of the frame in the current batch slot
+    float scale = letterbox_scale();
+    const image_rect_t &pads = letterbox_pads();
 
     memset(m_odReseultsPtr.get(), 0, sizeof(object_detect_result_list));
 
@@ -80,57 +107,53 @@ bool detector::YOLO5::postprocess() {
         int stride = strides[i];
 
         if (m_params->is_quant) {
-            validCount += process_i8((int8_t *)_outputs[i].buf,
+            validCount += process_i8((int8_t *)output_buf(i),
                                      anchors[i], grid_h, grid_w, stride,
                                      m_outputAttrs[i].zp, m_outputAttrs[i].scale,
-                                     m_filterBoxes, m_objProbs, m_classId,
-                                     m_detectParam.confidence);
+                                     m_candidates, m_detectParam.confidence);
         } else {
-            validCount += process_fp32((float *)_outputs[i].buf,
+            validCount += process_fp32((float *)output_buf(i),
                                        anchors[i], grid_h, grid_w, stride,
-                                       m_filterBoxes, m_objProbs, m_classId,
-                                       m_detectParam.confidence);
+                                       m_candidates, m_detectParam.confidence);
         }
     }
 
+    validCount = m_candidates.size();
     if (validCount <= 0) {
         return false;
     }
 
-    // Sort by confidence (descending)
-    std::vector<int> indexArray;
-    for (int i = 0; i < validCount; ++i) {
-        indexArray.push_back(i);
+    // Sort once and run class-bucketed NMS, keeping at most max_detections boxes
+    int max_detections = std::min(m_detectParam.max_detections, OBJ_NUMB_MAX_SIZE);
+    if (max_detections <= 0) {
+        max_detections = OBJ_NUMB_MAX_SIZE;
     }
-    quick_sort_indice_inverse(m_objProbs, 0, validCount - 1, indexArray);
-
-    // Apply NMS for each class
-    std::set<int> class_set(std::begin(m_classId), std::end(m_classId));
-    for (auto c : class_set) {
-        nms(validCount, m_filterBoxes, m_classId, indexArray, c, m_detectParam.nms_threshold);
+    const float *boxes = m_candidates.boxes();
+    int keep_count;
+    {
+        rknn::StageTimer timer(rknn::Stage::NMS);
+        keep_count = m_nms.run(boxes, m_candidates.scores(), m_candidates.class_ids(), validCount,
+                               m_detectParam.nms_threshold, max_detections, m_detectParam.nms_mode);
     }
 
     // Collect final results
     int last_count = 0;
     m_odReseultsPtr->count = 0;
 
-    for (int i = 0; i < validCount; i++) {
-        if (indexArray[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE) {
-            continue;
-        }
-        int n = indexArray[i];
-
-        float x1 = m_filterBoxes[n * 4 + 0] - m_pads.left;
-        float y1 = m_filterBoxes[n * 4 + 1] - m_pads.top;
-        float x2 = x1 + m_filterBoxes[n * 4 + 2];
-        float y2 = y1 + m_filterBoxes[n * 4 + 3];
-        int id = m_classId[n];
-        float obj_conf = m_objProbs[i];
-
-        m_odReseultsPtr->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / m_scale);
-        m_odReseultsPtr->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / m_scale);
-        m_odReseultsPtr->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / m_scale);
-        m_odReseultsPtr->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / m_scale);
+    for (int i = 0; i < keep_count; i++) {
+        int n = m_nms.keep(i);
+
+        float x1 = boxes[n * 4 + 0] - pads.left;
+        float y1 = boxes[n * 4 + 1] - pads.top;
+        float x2 = x1 + boxes[n * 4 + 2];
+        float y2 = y1 + boxes[n * 4 + 3];
+        int id = m_candidates.class_ids()[n];
+        float obj_conf = m_candidates.scores()[n];
+
+        m_odReseultsPtr->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / scale);
+        m_odReseultsPtr->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / scale);
+        m_odReseultsPtr->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / scale);
+        m_odReseultsPtr->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / scale);
         m_odReseultsPtr->results[last_count].prop = obj_conf;
         m_odReseultsPtr->results[last_count].cls_id = id;
         last_count++;
@@ -143,9 +166,7 @@ bool detector::YOLO5::postprocess() {
 
 int detector::YOLO5::process_i8(int8_t *input, int *anchor, int grid_h, int grid_w,
                                 int stride, int32_t zp, float scale,
-                                std::vector<float> &boxes,
-                                std::vector<float> &objProbs,
-                                std::vector<int> &classId,
+                                CandidateCollector &candidates,
                                 float threshold) {
     int validCount = 0;
     int grid_len = grid_h * grid_w;
@@ -155,59 +176,45 @@ int detector::YOLO5::process_i8(int8_t *input, int *anchor, int grid_h, int grid
     int8_t thres_i8 = qnt_f32_to_affine(threshold, zp, scale);
 
     for (int a = 0; a < anchor_num; a++) {
-        for (int i = 0; i < grid_h; i++) {
-            for (int j = 0; j < grid_w; j++) {
-                int8_t *in_ptr = input + a * grid_len * prop_box_size + i * grid_w + j;
-
-                // Get objectness confidence
-                int8_t box_confidence = in_ptr[4 * grid_len];
-                if (box_confidence < thres_i8) {
-                    continue;
-                }
-
-                // Find max class score
-                int max_class_id = -1;
-                int8_t max_score = -128;
-                for (int c = 0; c < m_detectParam.class_num; c++) {
-                    int8_t class_score = in_ptr[(5 + c) * grid_len];
-                    if (class_score > max_score) {
-                        max_score = class_score;
-                        max_class_id = c;
-                    }
-                }
-
-                // Compute final confidence: obj_conf * class_conf
-                float obj_conf_f32 = deqnt_affine_to_f32(box_confidence, zp, scale);
-                float class_conf_f32 = deqnt_affine_to_f32(max_score, zp, scale);
-                float final_conf = obj_conf_f32 * class_conf_f32;
-
-                if (final_conf < threshold) {
-                    continue;
-                }
-
-                // Decode box coordinates (YOLOv5 anchor-based decoding)
-                float box_x = deqnt_affine_to_f32(in_ptr[0], zp, scale) * 2.0 - 0.5;
-                float box_y = deqnt_affine_to_f32(in_ptr[grid_len], zp, scale) * 2.0 - 0.5;
-                float box_w = deqnt_affine_to_f32(in_ptr[2 * grid_len], zp, scale) * 2.0;
-                float box_h = deqnt_affine_to_f32(in_ptr[3 * grid_len], zp, scale) * 2.0;
-
-                // Apply grid and anchor transformations
-                box_x = (box_x + j) * stride;
-                box_y = (box_y + i) * stride;
-                box_w = box_w * box_w * anchor[a * 2];
-                box_h = box_h * box_h * anchor[a * 2 + 1];
-
-                // Convert from center to corner format (x, y, w, h)
-                float x1 = box_x - box_w / 2.0;
-                float y1 = box_y - box_h / 2.0;
-
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(box_w);
-                boxes.push_back(box_h);
-
-                objProbs.push_back(final_conf);
-                classId.push_back(max_class_id);
+        int8_t *anchor_ptr = input + a * grid_len * prop_box_size;
+
+        // Vectorized max class score over cells, objectness (channel 4) gates whole groups of cells
+        int count = m_scoreScannerI8.scan(anchor_ptr + 5 * grid_len, m_detectParam.class_num, grid_len, (int8_t)-128,
+                                          anchor_ptr + 4 * grid_len, thres_i8);
+        for (int k = 0; k < count; k++) {
+            int offset = m_scoreScannerI8.cell(k);
+            int i = offset / grid_w;
+            int j = offset % grid_w;
+            int8_t *in_ptr = anchor_ptr + offset;
+            int8_t box_confidence = in_ptr[4 * grid_len];
+
+            // Compute final confidence: obj_conf * class_conf
+            float obj_conf_f32 = deqnt_affine_to_f32(box_confidence, zp, scale);
+            float class_conf_f32 = deqnt_affine_to_f32(m_scoreScannerI8.score(k), zp, scale);
+            float final_conf = obj_conf_f32 * class_conf_f32;
+
+            // Skip box decoding when the candidate cannot enter the pre-NMS top-K
+            if (final_conf < threshold || !candidates.accept(final_conf)) {
+                continue;
+            }
+
+            // Decode box coordinates (YOLOv5 anchor-based decoding)
+            float box_x = deqnt_affine_to_f32(in_ptr[0], zp, scale) * 2.0 - 0.5;
+            float box_y = deqnt_affine_to_f32(in_ptr[grid_len], zp, scale) * 2.0 - 0.5;
+            float box_w = deqnt_affine_to_f32(in_ptr[2 * grid_len], zp, scale) * 2.0;
+            float box_h = deqnt_affine_to_f32(in_ptr[3 * grid_len], zp, scale) * 2.0;
+
+            // Apply grid and anchor transformations
+            box_x = (box_x + j) * stride;
+            box_y = (box_y + i) * stride;
+            box_w = box_w * box_w * anchor[a * 2];
+            box_h = box_h * box_h * anchor[a * 2 + 1];
+
+            // Convert from center to corner format (x, y, w, h)
+            float x1 = box_x - box_w / 2.0;
+            float y1 = box_y - box_h / 2.0;
+
+            if (candidates.push(x1, y1, box_w, box_h, final_conf, m_scoreScannerI8.class_id(k))) {
                 validCount++;
             }
         }
@@ -217,9 +224,7 @@ int detector::YOLO5::process_i8(int8_t *input, int *anchor, int grid_h, int grid
 
 int detector::YOLO5::process_u8(uint8_t *input, int *anchor, int grid_h, int grid_w,
                                 int stride, int32_t zp, float scale,
-                                std::vector<float> &boxes,
-                                std::vector<float> &objProbs,
-                                std::vector<int> &classId,
+                                CandidateCollector &candidates,
                                 float threshold) {
     int validCount = 0;
     int grid_len = grid_h * grid_w;
@@ -229,57 +234,42 @@ int detector::YOLO5::process_u8(uint8_t *input, int *anchor, int grid_h, int gri
     uint8_t thres_u8 = qnt_f32_to_affine_u8(threshold, zp, scale);
 
     for (int a = 0; a < anchor_num; a++) {
-        for (int i = 0; i < grid_h; i++) {
-            for (int j = 0; j < grid_w; j++) {
-                uint8_t *in_ptr = input + a * grid_len * prop_box_size + i * grid_w + j;
-
-                // Get objectness confidence
-                uint8_t box_confidence = in_ptr[4 * grid_len];
-                if (box_confidence < thres_u8) {
-                    continue;
-                }
-
-                // Find max class score
-                int max_class_id = -1;
-                uint8_t max_score = 0;
-                for (int c = 0; c < m_detectParam.class_num; c++) {
-                    uint8_t class_score = in_ptr[(5 + c) * grid_len];
-                    if (class_score > max_score) {
-                        max_score = class_score;
-                        max_class_id = c;
-                    }
-                }
-
-                // Compute final confidence
-                float obj_conf_f32 = deqnt_affine_u8_to_f32(box_confidence, zp, scale);
-                float class_conf_f32 = deqnt_affine_u8_to_f32(max_score, zp, scale);
-                float final_conf = obj_conf_f32 * class_conf_f32;
-
-                if (final_conf < threshold) {
-                    continue;
-                }
-
-                // Decode box coordinates
-                float box_x = deqnt_affine_u8_to_f32(in_ptr[0], zp, scale) * 2.0 - 0.5;
-                float box_y = deqnt_affine_u8_to_f32(in_ptr[grid_len], zp, scale) * 2.0 - 0.5;
-                float box_w = deqnt_affine_u8_to_f32(in_ptr[2 * grid_len], zp, scale) * 2.0;
-                float box_h = deqnt_affine_u8_to_f32(in_ptr[3 * grid_len], zp, scale) * 2.0;
-
-                box_x = (box_x + j) * stride;
-                box_y = (box_y + i) * stride;
-                box_w = box_w * box_w * anchor[a * 2];
-                box_h = box_h * box_h * anchor[a * 2 + 1];
-
-                float x1 = box_x - box_w / 2.0;
-                float y1 = box_y - box_h / 2.0;
-
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(box_w);
-                boxes.push_back(box_h);
-
-                objProbs.push_back(final_conf);
-                classId.push_back(max_class_id);
+        uint8_t *anchor_ptr = input + a * grid_len * prop_box_size;
+
+        int count = m_scoreScannerU8.scan(anchor_ptr + 5 * grid_len, m_detectParam.class_num, grid_len, (uint8_t)0,
+                                          anchor_ptr + 4 * grid_len, thres_u8);
+        for (int k = 0; k < count; k++) {
+            int offset = m_scoreScannerU8.cell(k);
+            int i = offset / grid_w;
+            int j = offset % grid_w;
+            uint8_t *in_ptr = anchor_ptr + offset;
+            uint8_t box_confidence = in_ptr[4 * grid_len];
+
+            // Compute final confidence
+            float obj_conf_f32 = deqnt_affine_u8_to_f32(box_confidence, zp, scale);
+            float class_conf_f32 = deqnt_affine_u8_to_f32(m_scoreScannerU8.score(k), zp, scale);
+            float final_conf = obj_conf_f32 * class_conf_f32;
+
+            // Skip box decoding when the candidate cannot enter the pre-NMS top-K
+            if (final_conf < threshold || !candidates.accept(final_conf)) {
+                continue;
+            }
+
+            // Decode box coordinates
+            float box_x = deqnt_affine_u8_to_f32(in_ptr[0], zp, scale) * 2.0 - 0.5;
+            float box_y = deqnt_affine_u8_to_f32(in_ptr[grid_len], zp, scale) * 2.0 - 0.5;
+            float box_w = deqnt_affine_u8_to_f32(in_ptr[2 * grid_len], zp, scale) * 2.0;
+            float box_h = deqnt_affine_u8_to_f32(in_ptr[3 * grid_len], zp, scale) * 2.0;
+
+            box_x = (box_x + j) * stride;
+            box_y = (box_y + i) * stride;
+            box_w = box_w * box_w * anchor[a * 2];
+            box_h = box_h * box_h * anchor[a * 2 + 1];
+
+            float x1 = box_x - box_w / 2.0;
+            float y1 = box_y - box_h / 2.0;
+
+            if (candidates.push(x1, y1, box_w, box_h, final_conf, m_scoreScannerU8.class_id(k))) {
                 validCount++;
             }
         }
@@ -289,9 +279,7 @@ int detector::YOLO5::process_u8(uint8_t *input, int *anchor, int grid_h, int gri
 
 int detector::YOLO5::process_fp32(float *input, int *anchor, int grid_h, int grid_w,
                                   int stride,
-                                  std::vector<float> &boxes,
-                                  std::vector<float> &objProbs,
-                                  std::vector<int> &classId,
+                                  CandidateCollector &candidates,
                                   float threshold) {
     int validCount = 0;
     int grid_len = grid_h * grid_w;
@@ -299,54 +287,40 @@ int detector::YOLO5::process_fp32(float *input, int *anchor, int grid_h, int gri
     int prop_box_size = 5 + m_detectParam.class_num;
 
     for (int a = 0; a < anchor_num; a++) {
-        for (int i = 0; i < grid_h; i++) {
-            for (int j = 0; j < grid_w; j++) {
-                float *in_ptr = input + a * grid_len * prop_box_size + i * grid_w + j;
-
-                // Get objectness confidence (already sigmoid applied in model)
-                float box_confidence = in_ptr[4 * grid_len];
-                if (box_confidence < threshold) {
-                    continue;
-                }
-
-                // Find max class score
-                int max_class_id = -1;
-                float max_score = 0;
-                for (int c = 0; c < m_detectParam.class_num; c++) {
-                    float class_score = in_ptr[(5 + c) * grid_len];
-                    if (class_score > max_score) {
-                        max_score = class_score;
-                        max_class_id = c;
-                    }
-                }
-
-                // Compute final confidence
-                float final_conf = box_confidence * max_score;
-                if (final_conf < threshold) {
-                    continue;
-                }
-
-                // Decode box coordinates
-                float box_x = in_ptr[0] * 2.0 - 0.5;
-                float box_y = in_ptr[grid_len] * 2.0 - 0.5;
-                float box_w = in_ptr[2 * grid_len] * 2.0;
-                float box_h = in_ptr[3 * grid_len] * 2.0;
-
-                box_x = (box_x + j) * stride;
-                box_y = (box_y + i) * stride;
-                box_w = box_w * box_w * anchor[a * 2];
-                box_h = box_h * box_h * anchor[a * 2 + 1];
-
-                float x1 = box_x - box_w / 2.0;
-                float y1 = box_y - box_h / 2.0;
-
-                boxes.push_back(x1);
-                boxes.push_back(y1);
-                boxes.push_back(box_w);
-                boxes.push_back(box_h);
-
-                objProbs.push_back(final_conf);
-                classId.push_back(max_class_id);
+        float *anchor_ptr = input + a * grid_len * prop_box_size;
+
+        // Class scores must be positive, matching the scalar search that started from 0
+        int count = m_scoreScannerF32.scan(anchor_ptr + 5 * grid_len, m_detectParam.class_num, grid_len, 0.f,
+                                           anchor_ptr + 4 * grid_len, threshold);
+        for (int k = 0; k < count; k++) {
+            int offset = m_scoreScannerF32.cell(k);
+            int i = offset / grid_w;
+            int j = offset % grid_w;
+            float *in_ptr = anchor_ptr + offset;
+
+            // Compute final confidence (objectness already sigmoid applied in model)
+            float box_confidence = in_ptr[4 * grid_len];
+            float final_conf = box_confidence * m_scoreScannerF32.score(k);
+            // Skip box decoding when the candidate cannot enter the pre-NMS top-K
+            if (final_conf < threshold || !candidates.accept(final_conf)) {
+                continue;
+            }
+
+            // Decode box coordinates
+            float box_x = in_ptr[0] * 2.0 - 0.5;
+            float box_y = in_ptr[grid_len] * 2.0 - 0.5;
+            float box_w = in_ptr[2 * grid_len] * 2.0;
+            float box_h = in_ptr[3 * grid_len] * 2.0;
+
+            box_x = (box_x + j) * stride;
+            box_y = (box_y + i) * stride;
+            box_w = box_w * box_w * anchor[a * 2];
+            box_h = box_h * box_h * anchor[a * 2 + 1];
+
+            float x1 = box_x - box_w / 2.0;
+            float y1 = box_y - box_h / 2.0;
+
+            if (candidates.push(x1, y1, box_w, box_h, final_conf, m_scoreScannerF32.class_id(k))) {
                 validCount++;
             }
         }
@@ -361,6 +335,18 @@ int detector::YOLO5::init_post_process() {
         LOGE("Load %s failed!\n", LABEL_NALE_TXT_PATH_V5);
         return -1;
     }
+
+    // Reserve candidate storage for every anchor of every grid cell
+    int max_candidates = 0;
+    for (int i = 0; i < 3; i++) {
+        max_candidates += 3 * m_outputAttrs[i].dims[2] * m_outputAttrs[i].dims[3];
+    }
+    m_candidates.reserve(max_candidates);
+    m_nms.reserve(max_candidates, m_detectParam.class_num);
+    int max_grid_len = m_outputAttrs[0].dims[2] * m_outputAttrs[0].dims[3];
+    m_scoreScannerI8.reserve(max_grid_len);
+    m_scoreScannerU8.reserve(max_grid_len);
+    m_scoreScannerF32.reserve(max_grid_len);
     return 0;
 }
 
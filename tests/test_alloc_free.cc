@@ -0,0 +1,93 @@
+// 推理稳态路径没有堆分配: 预热后每帧的operator new调用次数为0.
+//
+// 替换了全局operator new/delete, 因此是单独的可执行文件, 不链接进演示程序.
+// 使用默认的FUSED预处理; OPENCV参考预处理中的cv::resize会在内部分配临时行缓冲区, 是已知的例外, 不在此检查.
+// cv::Mat的数据由cv::fastMalloc分配, 也不经过operator new, 测试帧在计数开始前创建
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "yolo11.hpp"
+#include "yolov5.hpp"
+#include "test_common.hpp"
+
+static std::atomic<size_t> g_alloc_count{0};
+
+void* operator new(size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+    std::string g_dir;
+
+    void check_model(const char* name, rknn::Model& model) {
+        const int warmup_count = 5;
+        const int test_count = 50;
+        cv::Mat img(480, 640, CV_8UC3, cv::Scalar(64, 128, 192));
+        for(int i = 0; i < warmup_count; ++i){
+            model.inference(img);
+        }
+        // 构造时的日志由后台线程异步输出, 先写完, 不计入推理路径
+        logger::Logger::flush();
+
+        size_t before = g_alloc_count.load();
+        for(int i = 0; i < test_count; ++i){
+            model.inference(img);
+        }
+        size_t allocs = g_alloc_count.load() - before;
+        CHECK_MSG(allocs == 0, "%s: %zu heap allocations in %d frames after warm-up", name, allocs, test_count);
+    }
+
+    rknn::ModelConfig config(bool zero_copy) {
+        rknn::ModelConfig config;
+        config.backend = rknn::BackendType::CPU;
+        config.preprocess = rknn::PreprocessType::FUSED;
+        config.zero_copy = zero_copy;
+        return config;
+    }
+
+    void test_yolo11() {
+        detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+        for(bool zero_copy : {false, true}){
+            detector::YOLO11 model(g_dir + "/yolo11.spec", logger::Level::WARN, detect_param, config(zero_copy));
+            check_model(zero_copy ? "YOLO11 zero copy" : "YOLO11", model);
+        }
+    }
+
+    void test_yolov5() {
+        detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+        for(bool zero_copy : {false, true}){
+            detector::YOLO5 model(g_dir + "/yolov5.spec", logger::Level::WARN, detect_param, config(zero_copy));
+            check_model(zero_copy ? "YOLOv5 zero copy" : "YOLOv5", model);
+        }
+    }
+
+} // namespace
+
+int main() {
+    g_dir = test::temp_dir();
+    test::write_file(g_dir + "/yolo11.spec", "model=yolo11\ninput=640x640\nclasses=80\ndtype=int8\nrun_us=0\n");
+    test::write_file(g_dir + "/yolov5.spec", "model=yolov5\ninput=640x640\nclasses=80\ndtype=int8\nrun_us=0\n");
+
+    int ret = test::run_tests("test_alloc_free", test_yolo11, test_yolov5);
+
+    unlink((g_dir + "/yolo11.spec").c_str());
+    unlink((g_dir + "/yolov5.spec").c_str());
+    rmdir(g_dir.c_str());
+    return ret;
+}
@@ -0,0 +1,268 @@
+// rknn::CpuBackend: 零拷贝内存 create_mem/set_io_mem/destroy_mem 的生命周期, dup的上下文检查, 以及录制与回放
+#include <string.h>
+#include <sys/stat.h>
+#include <memory>
+#include <vector>
+
+#include "backend.hpp"
+#include "model_cache.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    std::string g_dir;
+    std::string g_spec;
+
+    std::unique_ptr<rknn::Backend> create_cpu_backend(const std::string& spec = g_spec) {
+        std::unique_ptr<rknn::Backend> backend = rknn::create_backend(rknn::BackendType::CPU);
+        std::shared_ptr<const rknn::ModelBlob> blob = rknn::ModelCache::acquire(spec);
+        CHECK(blob != nullptr);
+        if(blob == nullptr || backend->init(*blob) != RKNN_SUCC){
+            CHECK(!"cpu backend init failed");
+            return nullptr;
+        }
+        return backend;
+    }
+
+    std::vector<rknn_tensor_attr> query_attrs(rknn::Backend& backend, rknn_query_cmd cmd) {
+        rknn_input_output_num num;
+        CHECK(backend.query(RKNN_QUERY_IN_OUT_NUM, &num, sizeof(num)) == RKNN_SUCC);
+        uint32_t count = cmd == RKNN_QUERY_INPUT_ATTR ? num.n_input : num.n_output;
+        std::vector<rknn_tensor_attr> attrs(count);
+        for(uint32_t i = 0; i < count; i++){
+            memset(&attrs[i], 0, sizeof(rknn_tensor_attr));
+            attrs[i].index = i;
+            CHECK(backend.query(cmd, &attrs[i], sizeof(rknn_tensor_attr)) == RKNN_SUCC);
+        }
+        return attrs;
+    }
+
+    std::vector<rknn_tensor_attr> query_outputs(rknn::Backend& backend) {
+        return query_attrs(backend, RKNN_QUERY_OUTPUT_ATTR);
+    }
+
+    // run一次, 返回第一个输出的第一个字节
+    int run_first_byte(rknn::Backend& backend) {
+        CHECK(backend.run() == RKNN_SUCC);
+        rknn_output output;
+        memset(&output, 0, sizeof(output));
+        output.index = 0;
+        CHECK(backend.outputs_get(1, &output) == RKNN_SUCC);
+        int value = output.buf != nullptr ? ((const uint8_t*)output.buf)[0] : -1;
+        CHECK(backend.outputs_release(1, &output) == RKNN_SUCC);
+        return value;
+    }
+
+    bool file_exists(const std::string& path) {
+        return access(path.c_str(), F_OK) == 0;
+    }
+
+    // 绑定的输出内存在run结束时写入, 内容与rknn_outputs_get取得的相同
+    void test_bound_outputs() {
+        auto backend = create_cpu_backend();
+        if(backend == nullptr){
+            return;
+        }
+        std::vector<rknn_tensor_attr> attrs = query_outputs(*backend);
+        CHECK(!attrs.empty());
+
+        std::vector<rknn_tensor_mem*> mems;
+        for(auto& attr : attrs){
+            rknn_tensor_mem* mem = backend->create_mem(attr.size);
+            CHECK(mem != nullptr && mem->virt_addr != nullptr && mem->size >= attr.size);
+            CHECK(backend->set_io_mem(mem, &attr) == RKNN_SUCC);
+            mems.push_back(mem);
+        }
+        CHECK(backend->run() == RKNN_SUCC);
+
+        for(uint32_t i = 0; i < attrs.size(); i++){
+            std::vector<uint8_t> buf(attrs[i].size);
+            rknn_output output;
+            memset(&output, 0, sizeof(output));
+            output.index = i;
+            output.is_prealloc = 1;
+            output.buf = buf.data();
+            output.size = buf.size();
+            CHECK(backend->outputs_get(1, &output) == RKNN_SUCC);
+            CHECK_MSG(memcmp(buf.data(), mems[i]->virt_addr, buf.size()) == 0, "output %u differs from its bound mem", i);
+        }
+
+        uint64_t leaked = rknn::CpuBackend::leaked_mems();
+        for(auto mem : mems){
+            CHECK(backend->destroy_mem(mem) == RKNN_SUCC);
+        }
+        // 销毁后run不再写入已释放的内存
+        CHECK(backend->run() == RKNN_SUCC);
+        backend.reset();
+        CHECK(rknn::CpuBackend::leaked_mems() == leaked);
+    }
+
+    // 重复销毁、销毁或绑定其它上下文的内存都被拒绝
+    void test_foreign_mems() {
+        auto first = create_cpu_backend();
+        auto second = create_cpu_backend();
+        if(first == nullptr || second == nullptr){
+            return;
+        }
+        std::vector<rknn_tensor_attr> attrs = query_outputs(*first);
+        rknn_tensor_mem* mem = first->create_mem(attrs[0].size);
+        CHECK(mem != nullptr);
+
+        CHECK(second->set_io_mem(mem, &attrs[0]) == RKNN_ERR_PARAM_INVALID);
+        CHECK(second->destroy_mem(mem) == RKNN_ERR_PARAM_INVALID);
+        CHECK(first->destroy_mem(nullptr) == RKNN_ERR_PARAM_INVALID);
+        CHECK(first->create_mem(0) == nullptr);
+
+        CHECK(first->destroy_mem(mem) == RKNN_SUCC);
+        CHECK(first->destroy_mem(mem) == RKNN_ERR_PARAM_INVALID);
+    }
+
+    // 先销毁上下文再释放内存是调用方的错误: 上下文代为释放并计入leaked_mems
+    void test_teardown_order() {
+        uint64_t leaked = rknn::CpuBackend::leaked_mems();
+        auto backend = create_cpu_backend();
+        if(backend == nullptr){
+            return;
+        }
+        std::vector<rknn_tensor_attr> attrs = query_outputs(*backend);
+        rknn_tensor_mem* kept = backend->create_mem(attrs[0].size);
+        rknn_tensor_mem* freed = backend->create_mem(attrs[0].size);
+        CHECK(backend->set_io_mem(kept, &attrs[0]) == RKNN_SUCC);
+        CHECK(backend->destroy_mem(freed) == RKNN_SUCC);
+        backend.reset();
+        CHECK(rknn::CpuBackend::leaked_mems() == leaked + 1);
+    }
+
+    // dup只接受活着的CpuBackend上下文; 共享模型的实例与原实例输出相同
+    void test_dup_context() {
+        auto source = create_cpu_backend();
+        if(source == nullptr){
+            return;
+        }
+        auto copy = rknn::create_backend(rknn::BackendType::CPU);
+        CHECK(copy->dup(source->context()) == RKNN_SUCC);
+        CHECK(run_first_byte(*copy) == run_first_byte(*source));
+
+        auto other = rknn::create_backend(rknn::BackendType::CPU);
+        rknn_context bogus = 12345;
+        CHECK(other->dup(&bogus) == RKNN_ERR_CTX_INVALID);
+        CHECK(other->dup(nullptr) == RKNN_ERR_CTX_INVALID);
+        // 已销毁的上下文; other在销毁前创建, 不会复用source的地址
+        rknn_context destroyed = *source->context();
+        source.reset();
+        CHECK(other->dup(&destroyed) == RKNN_ERR_CTX_INVALID);
+        CHECK(other->query(RKNN_QUERY_IN_OUT_NUM, &bogus, sizeof(bogus)) == RKNN_ERR_CTX_INVALID);
+        // dup出的实例在原实例销毁后仍可使用和再dup
+        auto third = rknn::create_backend(rknn::BackendType::CPU);
+        CHECK(third->dup(copy->context()) == RKNN_SUCC);
+    }
+
+    // 录制3帧到有旧录制的目录: 旧的帧文件被删除, model.spec恰好回放3帧,
+    // dup出的实例共用帧序号, 按run的先后依次回放
+    void test_record_replay() {
+        std::string dir = g_dir + "/record";
+        CHECK(mkdir(dir.c_str(), 0755) == 0);
+        for(int f = 0; f < 5; f++){
+            char name[64];
+            snprintf(name, sizeof(name), "/frame_%06d.bin", f);
+            CHECK(test::write_file(dir + name, "stale"));
+        }
+
+        {
+            auto backend = create_cpu_backend();
+            if(backend == nullptr){
+                return;
+            }
+            std::vector<rknn_tensor_attr> inputs = query_attrs(*backend, RKNN_QUERY_INPUT_ATTR);
+            std::vector<rknn_tensor_attr> outputs = query_outputs(*backend);
+            auto recorder = rknn::TensorRecorder::open(dir, inputs.data(), inputs.size(), outputs.data(),
+                                                       outputs.size(), false, 0);
+            CHECK(recorder != nullptr);
+            if(recorder == nullptr){
+                return;
+            }
+            CHECK(!file_exists(dir + "/frame_000004.bin"));
+
+            // 第f帧的各输出全部为f+1
+            for(int f = 0; f < 3; f++){
+                std::vector<std::vector<uint8_t>> data;
+                std::vector<rknn_output> frame(outputs.size());
+                for(size_t i = 0; i < outputs.size(); i++){
+                    data.emplace_back(outputs[i].size, (uint8_t)(f + 1));
+                    memset(&frame[i], 0, sizeof(rknn_output));
+                    frame[i].buf = data[i].data();
+                    frame[i].size = outputs[i].size;
+                }
+                recorder->write(frame.data(), frame.size(), 1000);
+            }
+            CHECK(recorder->frames() == 3);
+        }
+        // 最后一个使用者释放录制器时写出model.spec
+        CHECK(!file_exists(dir + "/frame_000003.bin"));
+        std::string spec = dir + "/model.spec";
+        auto first = create_cpu_backend(spec);
+        if(first == nullptr){
+            return;
+        }
+        auto second = rknn::create_backend(rknn::BackendType::CPU);
+        CHECK(second->dup(first->context()) == RKNN_SUCC);
+        int expected[5] = {1, 2, 3, 1, 2};
+        for(int r = 0; r < 5; r++){
+            int value = run_first_byte(r % 2 == 0 ? *first : *second);
+            CHECK_MSG(value == expected[r], "run %d replayed frame value %d, expected %d", r, value, expected[r]);
+        }
+
+        // 记录的帧缺失时不能回放
+        first.reset();
+        second.reset();
+        unlink((dir + "/frame_000002.bin").c_str());
+        auto missing = rknn::create_backend(rknn::BackendType::CPU);
+        std::shared_ptr<const rknn::ModelBlob> blob = rknn::ModelCache::acquire(spec);
+        CHECK(blob != nullptr && missing->init(*blob) != RKNN_SUCC);
+
+        for(const char* name : {"/frame_000000.bin", "/frame_000001.bin", "/tensors.txt", "/model.spec"}){
+            unlink((dir + name).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+
+    // 带UTF-8注释的spec按spec解析 (bench/models下的spec都有中文注释); 含控制字符的二进制文件按默认模型模拟
+    void test_spec_detection() {
+        std::string spec = g_dir + "/commented.spec";
+        CHECK(test::write_file(spec, "# 中文注释\nmodel=yolo11\ninput=96x64  # 宽x高\nclasses=4\ndtype=int8\nrun_us=0\n"));
+        std::unique_ptr<rknn::Backend> backend = create_cpu_backend(spec);
+        if(backend != nullptr){
+            std::vector<rknn_tensor_attr> inputs = query_attrs(*backend, RKNN_QUERY_INPUT_ATTR);
+            CHECK(inputs.size() == 1);
+            if(inputs.size() == 1){
+                CHECK_MSG(inputs[0].dims[1] == 64 && inputs[0].dims[2] == 96, "input %ux%u",
+                          inputs[0].dims[2], inputs[0].dims[1]);
+            }
+        }
+        unlink(spec.c_str());
+
+        std::string binary = g_dir + "/binary.rknn";
+        const char header[] = "RKNN\0\x01model=yolo11\ninput=96x64\n";
+        CHECK(test::write_file(binary, std::string(header, sizeof(header) - 1)));
+        backend = create_cpu_backend(binary);
+        if(backend != nullptr){
+            std::vector<rknn_tensor_attr> inputs = query_attrs(*backend, RKNN_QUERY_INPUT_ATTR);
+            CHECK(inputs.size() == 1 && inputs[0].dims[1] == 640 && inputs[0].dims[2] == 640);
+        }
+        unlink(binary.c_str());
+    }
+
+} // namespace
+
+int main() {
+    g_dir = test::temp_dir();
+    g_spec = g_dir + "/model.spec";
+    test::write_file(g_spec, "model=yolo11\ninput=64x64\nclasses=4\ndtype=int8\nrun_us=0\nobjects=2\n");
+
+    int ret = test::run_tests("test_backend", test_bound_outputs, test_foreign_mems, test_teardown_order,
+                                 test_dup_context, test_record_replay, test_spec_detection);
+
+    unlink(g_spec.c_str());
+    rmdir(g_dir.c_str());
+    return ret;
+}
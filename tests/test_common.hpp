@@ -0,0 +1,71 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+// 单元测试的公共部分: 断言失败时打印位置并计数, main以run_tests的返回值退出 (有失败时非零).
+// 测试在源码根目录下运行 (见CMakeLists.txt的rknn_add_test), 临时文件写到temp_dir()
+
+namespace test {
+
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char* file, int line, const char* expr) {
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", file, line, expr);
+        failures()++;
+    }
+
+    // 依次运行各测试函数, 返回进程退出码
+    template <typename... Funcs>
+    int run_tests(const char* name, Funcs... funcs) {
+        (funcs(), ...);
+        if(failures() > 0){
+            fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+            return 1;
+        }
+        printf("%s: all checks passed\n", name);
+        return 0;
+    }
+
+    // 进程内唯一的临时目录, 退出时不删除其中的文件, 由测试自己清理
+    inline std::string temp_dir() {
+        const char* base = getenv("TMPDIR");
+        std::string path = std::string(base != nullptr ? base : "/tmp") + "/rknn_test_XXXXXX";
+        if(mkdtemp(&path[0]) == nullptr){
+            perror("mkdtemp");
+            exit(1);
+        }
+        return path;
+    }
+
+    inline bool write_file(const std::string& path, const std::string& text) {
+        FILE* file = fopen(path.c_str(), "w");
+        if(file == nullptr){
+            return false;
+        }
+        bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+        return fclose(file) == 0 && ok;
+    }
+
+} // namespace test
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) test::fail(__FILE__, __LINE__, #cond); \
+    } while (0)
+
+// 失败时附带说明, 如比较的数值
+#define CHECK_MSG(cond, ...) \
+    do { \
+        if(!(cond)){ \
+            test::fail(__FILE__, __LINE__, #cond); \
+            fprintf(stderr, "    "); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
@@ -0,0 +1,126 @@
+// rknn::LatencyStats / StageTimer: 直方图分位数的误差上界, 多线程记录不丢计数, 关闭时不记录
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "latency.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    // 对数-线性分桶: 每个2的幂区间32个子桶, 取桶中点(不超过max), 相对误差不超过1/64
+    constexpr double MAX_RELATIVE_ERROR = 1.0 / 64;
+
+    bool close_to(double value, double expected) {
+        return fabs(value - expected) <= expected * MAX_RELATIVE_ERROR * (1 + 1e-9);
+    }
+
+    // 1..10000us各一次: 分位数与精确值的相对误差在界内, count/mean/max精确
+    void test_quantiles() {
+        rknn::LatencyStats::reset();
+        for(uint64_t us = 1; us <= 10000; us++){
+            rknn::LatencyStats::record(rknn::Stage::RUN, us * 1000);
+        }
+        rknn::LatencySummary stats = rknn::LatencyStats::summary(rknn::Stage::RUN);
+        CHECK(stats.count == 10000);
+        CHECK_MSG(fabs(stats.mean_us - 5000.5) < 1e-6, "mean %.3f", stats.mean_us);
+        CHECK(stats.max_us == 10000.0);
+        CHECK_MSG(close_to(stats.p50_us, 5000), "p50 %.1f", stats.p50_us);
+        CHECK_MSG(close_to(stats.p90_us, 9000), "p90 %.1f", stats.p90_us);
+        CHECK_MSG(close_to(stats.p99_us, 9900), "p99 %.1f", stats.p99_us);
+
+        // 其它阶段不受影响
+        CHECK(rknn::LatencyStats::summary(rknn::Stage::PREPROCESS).count == 0);
+    }
+
+    // 1ns到约18分钟之间对数均匀取值, 单个值的分位数与它的相对误差在界内
+    void test_error_bound() {
+        uint32_t rng = 12345;
+        double worst = 0;
+        for(int i = 0; i < 2000; i++){
+            rng = rng * 1664525u + 1013904223u;
+            uint64_t ns = (uint64_t)exp2(40.0 * (rng >> 8) / (1 << 24));
+            rknn::LatencyStats::reset();
+            rknn::LatencyStats::record(rknn::Stage::RUN, ns);
+            double p50 = rknn::LatencyStats::summary(rknn::Stage::RUN).p50_us * 1000.0;
+            worst = std::max(worst, fabs(p50 - (double)ns) / (double)ns);
+            CHECK_MSG(close_to(p50, (double)ns), "%llu ns reported as %.1f ns", (unsigned long long)ns, p50);
+        }
+        printf("worst relative error %.5f (bound %.5f)\n", worst, MAX_RELATIVE_ERROR);
+    }
+
+    // 小于32ns的值各占一个桶, 分位数精确; 超出范围的值记入最后一个桶, 分位数不超过max
+    void test_bucket_edges() {
+        rknn::LatencyStats::reset();
+        for(uint64_t ns = 0; ns < 32; ns++){
+            rknn::LatencyStats::record(rknn::Stage::NMS, ns);
+        }
+        rknn::LatencySummary small = rknn::LatencyStats::summary(rknn::Stage::NMS);
+        CHECK(small.count == 32);
+        CHECK_MSG(small.p50_us == 0.015, "p50 %.4f", small.p50_us);
+        CHECK(small.max_us == 0.031);
+
+        rknn::LatencyStats::reset();
+        uint64_t huge = 1ull << 45;
+        rknn::LatencyStats::record(rknn::Stage::NMS, huge);
+        rknn::LatencySummary large = rknn::LatencyStats::summary(rknn::Stage::NMS);
+        CHECK(large.count == 1);
+        CHECK(large.max_us == huge / 1000.0);
+        CHECK(large.p99_us <= large.max_us);
+    }
+
+    // 每个线程写自己的分片, 线程退出后分片连同计数保留
+    void test_concurrent_record() {
+        rknn::LatencyStats::reset();
+        const int thread_num = 4;
+        const int per_thread = 20000;
+        std::vector<std::thread> threads;
+        for(int t = 0; t < thread_num; t++){
+            threads.emplace_back([t]() {
+                for(int i = 0; i < per_thread; i++){
+                    rknn::LatencyStats::record(rknn::Stage::POSTPROCESS, (uint64_t)(t + 1) * 1000000);
+                }
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+        rknn::LatencySummary stats = rknn::LatencyStats::summary(rknn::Stage::POSTPROCESS);
+        CHECK_MSG(stats.count == (uint64_t)thread_num * per_thread, "count %llu", (unsigned long long)stats.count);
+        CHECK(fabs(stats.mean_us - 2500.0) < 1e-6);
+        CHECK(stats.max_us == 4000.0);
+        CHECK(close_to(stats.p50_us, 2000));
+
+        rknn::LatencyStats::reset();
+        CHECK(rknn::LatencyStats::summary(rknn::Stage::POSTPROCESS).count == 0);
+    }
+
+    // StageTimer: 关闭时不记录, 开启时记录作用域的耗时
+    void test_stage_timer() {
+        rknn::LatencyStats::reset();
+        rknn::LatencyStats::set_enabled(false);
+        {
+            rknn::StageTimer timer(rknn::Stage::TOTAL);
+        }
+        CHECK(rknn::LatencyStats::summary(rknn::Stage::TOTAL).count == 0);
+
+        rknn::LatencyStats::set_enabled(true);
+        for(int i = 0; i < 3; i++){
+            rknn::StageTimer timer(rknn::Stage::TOTAL);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        rknn::LatencyStats::set_enabled(false);
+        rknn::LatencySummary stats = rknn::LatencyStats::summary(rknn::Stage::TOTAL);
+        CHECK(stats.count == 3);
+        CHECK_MSG(stats.p50_us >= 2000 * (1 - MAX_RELATIVE_ERROR), "p50 %.1f", stats.p50_us);
+        CHECK(stats.max_us >= stats.p50_us);
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_latency", test_quantiles, test_error_bound, test_bucket_edges, test_concurrent_record,
+                           test_stage_timer);
+}
@@ -0,0 +1,143 @@
+// rknn::MetricsServer: 回环地址上用临时端口抓取/metrics, 检查注册的指标和collector都在输出中, 以及stop后端口关闭
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+
+#include "metrics.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    // 连接127.0.0.1:port; 失败返回-1
+    int connect_loopback(int port) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0){
+            return -1;
+        }
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0){
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // 发送一个GET请求, 读到服务端关闭连接为止, 返回完整响应 (失败时为空)
+    std::string http_get(int port, const std::string& path) {
+        int fd = connect_loopback(port);
+        if(fd < 0){
+            return "";
+        }
+        timeval timeout = {2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+        std::string response;
+        char buf[4096];
+        ssize_t n;
+        while((n = recv(fd, buf, sizeof(buf), 0)) > 0){
+            response.append(buf, n);
+        }
+        close(fd);
+        return response;
+    }
+
+    bool contains(const std::string& text, const std::string& part) {
+        return text.find(part) != std::string::npos;
+    }
+
+    // 响应体 (空行之后的部分), 并检查Content-Length与之相符
+    std::string body_of(const std::string& response) {
+        size_t end = response.find("\r\n\r\n");
+        if(end == std::string::npos){
+            return "";
+        }
+        std::string body = response.substr(end + 4);
+        CHECK_MSG(contains(response, "Content-Length: " + std::to_string(body.size()) + "\r\n"),
+                  "Content-Length does not match a %zu byte body", body.size());
+        return body;
+    }
+
+    // 注册的counter/gauge/histogram和collector都出现在/metrics中, 移除的collector不再出现
+    void test_scrape() {
+        rknn::MetricsRegistry& registry = rknn::MetricsRegistry::instance();
+        registry.counter("test_scrape_requests_total", "Requests seen by the test").inc(3);
+        registry.gauge("test_scrape_queue_depth", "Queue depth", "queue=\"input\"").set(7);
+        rknn::Histogram& histogram = registry.histogram("test_scrape_seconds", "Scrape durations", {0.1, 1});
+        histogram.observe(0.05);
+        histogram.observe(0.5);
+        int collector = registry.add_collector([](rknn::MetricsWriter& writer) {
+            writer.family("test_scrape_collected", "gauge", "Value written by a collector");
+            writer.sample("test_scrape_collected", "", 42);
+        });
+
+        rknn::MetricsServer server;
+        CHECK(server.start(0));
+        CHECK(server.port() > 0);
+        // 已在运行时再次start失败
+        CHECK(!server.start(0));
+
+        std::string response = http_get(server.port(), "/metrics");
+        CHECK_MSG(response.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0, "response: %.40s", response.c_str());
+        CHECK(contains(response, "Content-Type: text/plain; version=0.0.4\r\n"));
+        std::string body = body_of(response);
+        CHECK(contains(body, "# TYPE test_scrape_requests_total counter\n"));
+        CHECK(contains(body, "\ntest_scrape_requests_total 3\n"));
+        CHECK(contains(body, "# TYPE test_scrape_queue_depth gauge\n"));
+        CHECK(contains(body, "\ntest_scrape_queue_depth{queue=\"input\"} 7\n"));
+        CHECK(contains(body, "# TYPE test_scrape_seconds histogram\n"));
+        CHECK(contains(body, "\ntest_scrape_seconds_bucket{le=\"0.1\"} 1\n"));
+        CHECK(contains(body, "\ntest_scrape_seconds_bucket{le=\"+Inf\"} 2\n"));
+        CHECK(contains(body, "\ntest_scrape_seconds_count 2\n"));
+        CHECK(contains(body, "# HELP test_scrape_collected Value written by a collector\n"));
+        CHECK(contains(body, "\ntest_scrape_collected 42\n"));
+
+        // 其它路径返回404
+        std::string missing = http_get(server.port(), "/other");
+        CHECK_MSG(missing.compare(0, 22, "HTTP/1.1 404 Not Found") == 0, "response: %.40s", missing.c_str());
+
+        registry.remove_collector(collector);
+        body = body_of(http_get(server.port(), "/metrics"));
+        CHECK(contains(body, "test_scrape_requests_total 3\n"));
+        CHECK(!contains(body, "test_scrape_collected"));
+        server.stop();
+    }
+
+    // stop及时返回并关闭监听端口, 重复stop无副作用, 之后可以在同一端口重新start
+    void test_shutdown() {
+        rknn::MetricsServer server;
+        CHECK(server.start(0));
+        int port = server.port();
+        CHECK(!http_get(port, "/metrics").empty());
+
+        auto begin = std::chrono::steady_clock::now();
+        server.stop();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        CHECK_MSG(elapsed.count() < 1000, "stop took %lld ms", (long long)elapsed.count());
+
+        int fd = connect_loopback(port);
+        CHECK_MSG(fd < 0, "port %d still accepts connections after stop", port);
+        if(fd >= 0){
+            close(fd);
+        }
+        server.stop();
+
+        CHECK(server.start(port));
+        CHECK(server.port() == port);
+        CHECK(!http_get(port, "/metrics").empty());
+        // 析构时stop
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_metrics", test_scrape, test_shutdown);
+}
@@ -0,0 +1,151 @@
+// rknn::Model的推理入口 (CPU参考后端): 批量推理与逐帧推理结果相同, 预处理失败的帧返回空结果,
+// 各阶段耗时记入LatencyStats, 初始化失败时构造抛出异常
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "yolo11.hpp"
+#include "RknnPool.hpp"
+#include "latency.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    std::string g_dir;
+
+    std::unique_ptr<detector::YOLO11> create_yolo11(const std::string& spec) {
+        detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+        rknn::ModelConfig config;
+        config.backend = rknn::BackendType::CPU;
+        return std::make_unique<detector::YOLO11>(g_dir + "/" + spec, logger::Level::WARN, detect_param, config);
+    }
+
+    // 预处理后端不支持的输入(灰度图)不进入推理, 同一batch中的其它帧不受影响
+    void test_preprocess_failure() {
+        auto model = create_yolo11("yolo11.spec");
+        cv::Mat color(480, 640, CV_8UC3, cv::Scalar(64, 128, 192));
+        cv::Mat gray(480, 640, CV_8UC1, cv::Scalar(128));
+
+        CHECK(model->infer(color).count > 0);
+        CHECK(model->infer(gray).count == 0);
+        CHECK(!model->stage_preprocess(gray));
+
+        auto batched = create_yolo11("yolo11_b2.spec");
+        CHECK(batched->batch_size() == 2);
+        std::vector<object_detect_result_list> results = batched->infer_batch({color, gray, gray, color});
+        CHECK(results.size() == 4);
+        if(results.size() == 4){
+            CHECK(results[0].count > 0);
+            CHECK(results[1].count == 0);
+            CHECK(results[2].count == 0);
+            CHECK(results[3].count > 0);
+        }
+    }
+
+    bool same_results(const object_detect_result_list& a, const object_detect_result_list& b) {
+        if(a.count != b.count){
+            return false;
+        }
+        for(int i = 0; i < a.count; i++){
+            const object_detect_result& x = a.results[i];
+            const object_detect_result& y = b.results[i];
+            if(x.cls_id != y.cls_id || x.prop != y.prop || x.box.left != y.box.left || x.box.top != y.box.top ||
+               x.box.right != y.box.right || x.box.bottom != y.box.bottom){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 各帧尺寸不同(每个slot的letterbox比例和填充不同), 帧数不是batch的整数倍(最后一次rknn_run只填一个slot):
+    // 每帧的结果与batch为1的模型逐帧推理、以及同一模型逐帧推理的结果完全相同
+    void test_batch_matches_single() {
+        auto single = create_yolo11("yolo11.spec");
+        auto batched = create_yolo11("yolo11_b2.spec");
+        std::vector<cv::Mat> frames = {
+            cv::Mat(480, 640, CV_8UC3, cv::Scalar(64, 128, 192)),
+            cv::Mat(1080, 1920, CV_8UC3, cv::Scalar(10, 20, 30)),
+            cv::Mat(640, 360, CV_8UC3, cv::Scalar(200, 100, 50)),
+        };
+
+        std::vector<object_detect_result_list> results = batched->infer_batch(frames);
+        CHECK(results.size() == frames.size());
+        for(size_t i = 0; i < frames.size() && i < results.size(); i++){
+            object_detect_result_list expected = single->infer(frames[i]);
+            CHECK(expected.count > 0);
+            CHECK_MSG(same_results(results[i], expected), "frame %zu (%dx%d): batched %d boxes, single %d boxes", i,
+                      frames[i].cols, frames[i].rows, results[i].count, expected.count);
+            CHECK_MSG(same_results(batched->infer(frames[i]), expected), "frame %zu: batch-2 model infer differs", i);
+        }
+    }
+
+    // 每次推理各阶段记录一次; 模拟的rknn_run耗时2ms, 逐帧总耗时不小于rknn_run
+    void test_stage_latency() {
+        auto model = create_yolo11("yolo11_2ms.spec");
+        cv::Mat img(480, 640, CV_8UC3, cv::Scalar(64, 128, 192));
+        const int frame_num = 10;
+
+        rknn::LatencyStats::set_enabled(true);
+        rknn::LatencyStats::reset();
+        for(int i = 0; i < frame_num; i++){
+            model->infer(img);
+        }
+        rknn::LatencyStats::set_enabled(false);
+
+        for(rknn::Stage stage : {rknn::Stage::PREPROCESS, rknn::Stage::RUN, rknn::Stage::POSTPROCESS, rknn::Stage::NMS,
+                                 rknn::Stage::TOTAL}){
+            rknn::LatencySummary stats = rknn::LatencyStats::summary(stage);
+            CHECK_MSG(stats.count == (uint64_t)frame_num, "%s recorded %llu times", rknn::stage_name(stage),
+                      (unsigned long long)stats.count);
+        }
+        rknn::LatencySummary run = rknn::LatencyStats::summary(rknn::Stage::RUN);
+        rknn::LatencySummary total = rknn::LatencyStats::summary(rknn::Stage::TOTAL);
+        CHECK_MSG(run.p50_us >= 2000 * (1 - 1.0 / 64), "rknn_run p50 %.1f us", run.p50_us);
+        CHECK_MSG(total.mean_us >= run.mean_us, "total mean %.1f us < rknn_run mean %.1f us", total.mean_us,
+                  run.mean_us);
+    }
+
+    // 模型文件不存在: 构造抛出异常而不是得到未初始化的实例; 线程池init失败且第一个实例报告为failed
+    void test_init_failure() {
+        detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+        rknn::ModelConfig config;
+        config.backend = rknn::BackendType::CPU;
+        std::string missing = g_dir + "/missing.spec";
+
+        bool thrown = false;
+        try{
+            detector::YOLO11 model(missing, logger::Level::WARN, detect_param, config);
+        }catch(const std::runtime_error&){
+            thrown = true;
+        }
+        CHECK(thrown);
+
+        rknn::RknnPool<detector::YOLO11, cv::Mat, object_detect_result_list> pool(missing, 2, logger::Level::WARN);
+        CHECK(pool.init(detect_param, config) == -1);
+        std::vector<rknn::ModelStatus> status = pool.modelStatus();
+        CHECK(status.size() == 2 && status[0].failed && !status[0].ready);
+        CHECK(pool.readyCount() == 0);
+    }
+
+} // namespace
+
+int main() {
+    g_dir = test::temp_dir();
+    const char* specs[][2] = {
+        {"yolo11.spec", "model=yolo11\ninput=640x640\nclasses=80\ndtype=int8\nrun_us=0\nobjects=8\n"},
+        {"yolo11_b2.spec", "model=yolo11\ninput=640x640\nbatch=2\nclasses=80\ndtype=int8\nrun_us=0\nobjects=8\n"},
+        {"yolo11_2ms.spec", "model=yolo11\ninput=640x640\nclasses=80\ndtype=int8\nrun_us=2000\nobjects=8\n"},
+    };
+    for(auto& spec : specs){
+        test::write_file(g_dir + "/" + spec[0], spec[1]);
+    }
+
+    int ret = test::run_tests("test_model", test_batch_matches_single, test_preprocess_failure,
+                                 test_stage_latency, test_init_failure);
+
+    for(auto& spec : specs){
+        unlink((g_dir + "/" + spec[0]).c_str());
+    }
+    rmdir(g_dir.c_str());
+    return ret;
+}
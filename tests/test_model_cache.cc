@@ -0,0 +1,152 @@
+// rknn::ModelCache: 同一文件复用已映射的数据, dup的上下文不读文件, 文件被替换或修改时重新加载, 最后一个持有者释放后解除映射
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <memory>
+#include <string>
+
+#include "backend.hpp"
+#include "model_cache.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    std::string g_dir;
+
+    const char* SPEC_A = "model=yolo11\ninput=64x64\nclasses=4\ndtype=int8\nrun_us=0\nobjects=2\n";
+    const char* SPEC_B = "model=yolo11\ninput=64x64\nclasses=4\ndtype=int8\nrun_us=0\nobjects=3\n";
+
+    std::string content(const rknn::ModelBlob& blob) {
+        return std::string((const char*)blob.data(), blob.size());
+    }
+
+    // /proc/self/maps中是否有path的映射
+    bool is_mapped(const std::string& path) {
+        FILE* file = fopen("/proc/self/maps", "r");
+        if(file == nullptr){
+            return false;
+        }
+        char line[4096];
+        bool found = false;
+        while(!found && fgets(line, sizeof(line), file) != nullptr){
+            found = strstr(line, path.c_str()) != nullptr;
+        }
+        fclose(file);
+        return found;
+    }
+
+    // 再次acquire同一文件 (含不同写法的路径) 返回同一份数据, 只计hits
+    void test_hits_and_loads() {
+        std::string path = g_dir + "/hits.spec";
+        CHECK(test::write_file(path, SPEC_A));
+        rknn::ModelCache::Stats before = rknn::ModelCache::stats();
+
+        std::shared_ptr<const rknn::ModelBlob> first = rknn::ModelCache::acquire(path);
+        CHECK(first != nullptr);
+        std::shared_ptr<const rknn::ModelBlob> second = rknn::ModelCache::acquire(path);
+        std::shared_ptr<const rknn::ModelBlob> third = rknn::ModelCache::acquire(g_dir + "/./hits.spec");
+        CHECK(second == first && third == first);
+        if(first != nullptr){
+            CHECK(content(*first) == SPEC_A);
+        }
+
+        rknn::ModelCache::Stats after = rknn::ModelCache::stats();
+        CHECK_MSG(after.loads == before.loads + 1, "%llu loads", (unsigned long long)(after.loads - before.loads));
+        CHECK_MSG(after.hits == before.hits + 2, "%llu hits", (unsigned long long)(after.hits - before.hits));
+
+        CHECK(rknn::ModelCache::acquire(g_dir + "/missing.spec") == nullptr);
+        unlink(path.c_str());
+    }
+
+    // dup从已有上下文共享模型, 不打开文件: 文件删除后仍然成功, 缓存计数不变
+    void test_dup_skips_file() {
+        std::string path = g_dir + "/dup.spec";
+        CHECK(test::write_file(path, SPEC_A));
+        std::unique_ptr<rknn::Backend> source = rknn::create_backend(rknn::BackendType::CPU);
+        {
+            std::shared_ptr<const rknn::ModelBlob> blob = rknn::ModelCache::acquire(path);
+            CHECK(blob != nullptr && source->init(*blob) == RKNN_SUCC);
+        }
+        unlink(path.c_str());
+
+        rknn::ModelCache::Stats before = rknn::ModelCache::stats();
+        std::unique_ptr<rknn::Backend> copy = rknn::create_backend(rknn::BackendType::CPU);
+        CHECK(copy->dup(source->context()) == RKNN_SUCC);
+        rknn::ModelCache::Stats after = rknn::ModelCache::stats();
+        CHECK(after.loads == before.loads && after.hits == before.hits);
+        CHECK(copy->run() == RKNN_SUCC);
+    }
+
+    // rename覆盖或修改时间变化都重新加载; 旧数据对已有的持有者保持不变
+    void test_reload_on_change() {
+        std::string path = g_dir + "/reload.spec";
+        CHECK(test::write_file(path, SPEC_A));
+        std::shared_ptr<const rknn::ModelBlob> old_blob = rknn::ModelCache::acquire(path);
+        CHECK(old_blob != nullptr);
+
+        // 写新文件后rename覆盖: inode变化
+        std::string tmp = g_dir + "/reload.spec.tmp";
+        CHECK(test::write_file(tmp, SPEC_B));
+        CHECK(rename(tmp.c_str(), path.c_str()) == 0);
+        rknn::ModelCache::Stats before = rknn::ModelCache::stats();
+        std::shared_ptr<const rknn::ModelBlob> renamed = rknn::ModelCache::acquire(path);
+        CHECK(renamed != nullptr && renamed != old_blob);
+        CHECK(rknn::ModelCache::stats().loads == before.loads + 1);
+        if(renamed != nullptr && old_blob != nullptr){
+            CHECK(content(*renamed) == SPEC_B);
+            CHECK(content(*old_blob) == SPEC_A);
+        }
+
+        // 同一inode, 只有修改时间变化 (touch)
+        struct stat st;
+        CHECK(stat(path.c_str(), &st) == 0);
+        struct timespec times[2] = {st.st_atim, st.st_mtim};
+        times[1].tv_sec -= 10;
+        CHECK(utimensat(AT_FDCWD, path.c_str(), times, 0) == 0);
+        before = rknn::ModelCache::stats();
+        std::shared_ptr<const rknn::ModelBlob> touched = rknn::ModelCache::acquire(path);
+        CHECK(touched != nullptr && touched != renamed);
+        CHECK(rknn::ModelCache::stats().loads == before.loads + 1);
+
+        // 未变化时复用最新的数据
+        CHECK(rknn::ModelCache::acquire(path) == touched);
+        unlink(path.c_str());
+    }
+
+    // 缓存只持弱引用: 最后一个持有者释放后解除映射, 再次acquire重新读文件
+    void test_release_on_last_holder() {
+        std::string path = g_dir + "/release.spec";
+        CHECK(test::write_file(path, SPEC_A));
+        std::shared_ptr<const rknn::ModelBlob> first = rknn::ModelCache::acquire(path);
+        std::shared_ptr<const rknn::ModelBlob> second = rknn::ModelCache::acquire(path);
+        CHECK(first != nullptr && second == first);
+        std::weak_ptr<const rknn::ModelBlob> weak = first;
+        bool mapped = first != nullptr && first->mapped();
+        if(mapped){
+            CHECK(is_mapped(path));
+        }
+
+        first.reset();
+        CHECK(!weak.expired());
+        second.reset();
+        CHECK(weak.expired());
+        if(mapped){
+            CHECK_MSG(!is_mapped(path), "%s still mapped after the last holder released it", path.c_str());
+        }
+
+        rknn::ModelCache::Stats before = rknn::ModelCache::stats();
+        std::shared_ptr<const rknn::ModelBlob> again = rknn::ModelCache::acquire(path);
+        CHECK(again != nullptr);
+        CHECK(rknn::ModelCache::stats().loads == before.loads + 1);
+        again.reset();
+        unlink(path.c_str());
+    }
+
+} // namespace
+
+int main() {
+    g_dir = test::temp_dir();
+    int ret = test::run_tests("test_model_cache", test_hits_and_loads, test_dup_skips_file, test_reload_on_change,
+                              test_release_on_last_holder);
+    rmdir(g_dir.c_str());
+    return ret;
+}
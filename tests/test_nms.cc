@@ -0,0 +1,124 @@
+// NmsEngine与原实现 (quick_sort_indice_inverse + 逐类别nms()) 保留的框一致
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "nms.hpp"
+#include "utils.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    uint32_t g_rng = 1;
+
+    int next_random(int range) {
+        g_rng = g_rng * 1664525u + 1013904223u;
+        return (int)((g_rng >> 8) % (uint32_t)range);
+    }
+
+    struct Candidates {
+        std::vector<float> boxes;
+        std::vector<float> scores;
+        std::vector<int> class_ids;
+    };
+
+    // 候选集中在少数物体周围, 与低阈值下的真实输出相似; 分数互不相同, 排序结果唯一
+    Candidates make_candidates(int count, int class_num, int object_num) {
+        Candidates c;
+        c.boxes.resize(count * 4);
+        c.scores.resize(count);
+        c.class_ids.resize(count);
+        for(int i = 0; i < count; i++){
+            int object = next_random(object_num);
+            c.boxes[i * 4 + 0] = (float)((object * 37) % 560 + next_random(16));
+            c.boxes[i * 4 + 1] = (float)((object * 91) % 560 + next_random(16));
+            c.boxes[i * 4 + 2] = (float)(40 + next_random(24));
+            c.boxes[i * 4 + 3] = (float)(40 + next_random(24));
+            c.scores[i] = (float)((i * 7919) % count + 1) / count;
+            c.class_ids[i] = (object + next_random(3)) % class_num;
+        }
+        return c;
+    }
+
+    // 原实现: 分数降序排序后逐类别nms(), 保留的下标按分数从高到低
+    std::vector<int> reference_nms(const Candidates& c, int class_num, float threshold) {
+        int count = (int)c.scores.size();
+        std::vector<float> sorted_scores = c.scores;
+        std::vector<float> boxes = c.boxes;
+        std::vector<int> order(count);
+        for(int i = 0; i < count; i++){
+            order[i] = i;
+        }
+        if(count > 0){
+            quick_sort_indice_inverse(sorted_scores, 0, count - 1, order);
+        }
+        for(int cls = 0; cls < class_num; cls++){
+            nms(count, boxes, c.class_ids, order, cls, threshold);
+        }
+        std::vector<int> keep;
+        for(int i = 0; i < count; i++){
+            if(order[i] != -1){
+                keep.push_back(order[i]);
+            }
+        }
+        return keep;
+    }
+
+    std::vector<int> engine_keep(detector::NmsEngine& engine, const Candidates& c, float threshold, int max_output,
+                                 detector::NmsMode mode) {
+        int kept = engine.run(c.boxes.data(), c.scores.data(), c.class_ids.data(), (int)c.scores.size(), threshold,
+                              max_output, mode);
+        std::vector<int> keep(kept);
+        for(int k = 0; k < kept; k++){
+            keep[k] = engine.keep(k);
+        }
+        return keep;
+    }
+
+    void test_matches_reference() {
+        const detector::NmsMode modes[2] = {detector::NmsMode::PER_CLASS, detector::NmsMode::CLASS_OFFSET};
+        for(int class_num : {1, 3, 80}){
+            for(int count : {0, 1, 7, 100, 1000, 3000}){
+                for(float threshold : {0.45f, 0.1f, 0.7f}){
+                    Candidates c = make_candidates(count, class_num, std::max(1, count / 20));
+                    std::vector<int> expected = reference_nms(c, class_num, threshold);
+
+                    detector::NmsEngine engine;
+                    engine.reserve(count, class_num);
+                    for(auto mode : modes){
+                        std::vector<int> keep = engine_keep(engine, c, threshold, 0, mode);
+                        CHECK_MSG(keep == expected, "%d candidates, %d classes, iou %.2f, mode %d: kept %zu, expected %zu",
+                                  count, class_num, threshold, (int)mode, keep.size(), expected.size());
+
+                        // max_output只截断, 保留的是完整结果的前max_output个
+                        int max_output = (int)expected.size() / 2 + 1;
+                        std::vector<int> limited = engine_keep(engine, c, threshold, max_output, mode);
+                        std::vector<int> prefix(expected.begin(), expected.begin() + std::min(max_output, (int)expected.size()));
+                        CHECK(limited == prefix);
+                    }
+                }
+            }
+        }
+    }
+
+    // 同一位置的同类框只保留分数最高的一个, 不同类的框互不抑制
+    void test_class_separation() {
+        Candidates c;
+        for(int i = 0; i < 4; i++){
+            c.boxes.insert(c.boxes.end(), {100.f, 100.f, 50.f, 50.f});
+            c.scores.push_back(0.9f - i * 0.1f);
+            c.class_ids.push_back(i % 2);
+        }
+        detector::NmsEngine engine;
+        engine.reserve(4, 2);
+        for(auto mode : {detector::NmsMode::PER_CLASS, detector::NmsMode::CLASS_OFFSET}){
+            std::vector<int> keep = engine_keep(engine, c, 0.45f, 0, mode);
+            CHECK(keep == std::vector<int>({0, 1}));
+        }
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_nms", test_matches_reference, test_class_separation);
+}
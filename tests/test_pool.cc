@@ -0,0 +1,490 @@
+// rknn::RknnPool: 用假模型检查各分发模式的交付顺序, 以及推理失败的帧仍会完成
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "RknnPool.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    // 输入为以下值时在对应阶段失败, 其余输入的结果为 input * 2
+    constexpr int THROW_PREPROCESS = -1;
+    constexpr int THROW_RUN = -2;
+    constexpr int THROW_POSTPROCESS = -3;
+    constexpr int FAIL_PREPROCESS = -4;     // stage_preprocess返回false
+
+    // 满足RknnPool对模型类型的要求, 不使用NPU和CpuBackend; 实例轮流"绑定"到3个核心.
+    // 与rknn::Model一样初始化失败时构造抛出异常: 第一个实例读取模型文件 (路径为"fake"时不读),
+    // 共享权重的实例不读文件, s_failShared为true时失败
+    class FakeModel {
+    public:
+        FakeModel(const std::string& path, logger::Level /* level */) {
+            if(path != "fake" && access(path.c_str(), R_OK) != 0){
+                throw std::runtime_error("cannot open " + path);
+            }
+            m_core = s_instances++ % 3;
+        }
+        FakeModel(const std::string& /* path */, logger::Level /* level */, rknn_context* /* ctx */) {
+            if(s_failShared.load()){
+                throw std::runtime_error("shared instance");
+            }
+            m_core = s_instances++ % 3;
+        }
+
+        rknn_context* get_context() { return &m_ctx; }
+        int core_id() const { return m_core; }
+        int batch_size() const { return 1; }
+
+        int infer(int input) {
+            s_started++;
+            while(s_hold.load()){
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            check_throw(input);
+            return input == FAIL_PREPROCESS ? 0 : input * 2;
+        }
+
+        // 任一帧失败时整批抛出异常; s_shortBatch为true时少返回最后一帧的结果
+        std::vector<int> infer_batch(const std::vector<int>& inputs) {
+            std::vector<int> results;
+            for(int input : inputs){
+                results.push_back(infer(input));
+            }
+            if(s_shortBatch.load()){
+                results.pop_back();
+            }
+            return results;
+        }
+
+        bool stage_preprocess(int input) {
+            if(input == THROW_PREPROCESS){
+                throw std::runtime_error("preprocess");
+            }
+            m_input = input;
+            return input != FAIL_PREPROCESS;
+        }
+
+        bool stage_run() {
+            if(m_input == THROW_RUN){
+                throw std::runtime_error("run");
+            }
+            return true;
+        }
+
+        std::variant<int> stage_postprocess() {
+            if(m_input == THROW_POSTPROCESS){
+                throw std::runtime_error("postprocess");
+            }
+            return m_input * 2;
+        }
+
+        // s_hold为true时infer在开始后等待, 用于占住实例; s_started为开始执行的infer次数
+        static std::atomic<bool> s_hold;
+        static std::atomic<int> s_started;
+
+        // 已创建的实例数
+        static int instances() { return s_instances.load(); }
+
+        static std::atomic<bool> s_failShared;
+        static std::atomic<bool> s_shortBatch;
+
+    private:
+        static void check_throw(int input) {
+            if(input == THROW_PREPROCESS || input == THROW_RUN || input == THROW_POSTPROCESS){
+                throw std::runtime_error("infer");
+            }
+        }
+
+        static std::atomic<int> s_instances;
+        rknn_context m_ctx = 0;
+        int m_core = 0;
+        int m_input = 0;
+    };
+
+    std::atomic<int> FakeModel::s_instances(0);
+    std::atomic<bool> FakeModel::s_hold(false);
+    std::atomic<int> FakeModel::s_started(0);
+    std::atomic<bool> FakeModel::s_failShared(false);
+    std::atomic<bool> FakeModel::s_shortBatch(false);
+
+    template <typename Executor = dpool::ThreadPool>
+    using FakePool = rknn::RknnPool<FakeModel, int, int, Executor>;
+
+    bool is_failure(int input) {
+        return input == THROW_PREPROCESS || input == THROW_RUN || input == THROW_POSTPROCESS ||
+               input == FAIL_PREPROCESS;
+    }
+
+    // 提交inputs后逐个取回, 检查按提交顺序交付、结果正确、失败的帧带failed标记且结果为默认值.
+    // batched时与失败的帧同批的帧也可以失败
+    template <typename Pool>
+    void check_delivery(Pool& pool, const std::vector<int>& inputs, bool batched = false) {
+        for(int input : inputs){
+            CHECK(pool.put(input) == 0);
+        }
+        for(size_t i = 0; i < inputs.size(); i++){
+            int output = -100;
+            rknn::FrameInfo info;
+            // 带超时, 丢失的帧使测试失败而不是卡住
+            if(pool.getFor(output, info, std::chrono::milliseconds(5000)) != 0){
+                CHECK_MSG(false, "frame %zu of %zu was never delivered", i, inputs.size());
+                return;
+            }
+            CHECK_MSG(info.seq == i, "delivered seq %llu, expected %zu", (unsigned long long)info.seq, i);
+            bool failed = is_failure(inputs[i]) || (batched && info.failed);
+            CHECK_MSG(info.failed == failed, "frame %zu input %d failed=%d", i, inputs[i], (int)info.failed);
+            int expected = failed ? 0 : inputs[i] * 2;
+            CHECK_MSG(output == expected, "frame %zu input %d output %d, expected %d", i, inputs[i], output, expected);
+        }
+        CHECK(pool.getPendingCount() == 0);
+    }
+
+    // 每7帧一帧失败; 任务模式下infer只能以异常报告失败, throw_only时不含FAIL_PREPROCESS
+    std::vector<int> mixed_inputs(int count, bool throw_only = false) {
+        const int failures[] = {THROW_PREPROCESS, THROW_RUN, THROW_POSTPROCESS, FAIL_PREPROCESS};
+        int kinds = throw_only ? 3 : 4;
+        std::vector<int> inputs;
+        for(int i = 0; i < count; i++){
+            inputs.push_back(i % 7 == 3 ? failures[(i / 7) % kinds] : i);
+        }
+        return inputs;
+    }
+
+    size_t count_failures(const std::vector<int>& inputs) {
+        size_t count = 0;
+        for(int input : inputs){
+            count += is_failure(input) ? 1 : 0;
+        }
+        return count;
+    }
+
+    void test_pipeline_order() {
+        FakePool<> pool("fake", 3, logger::Level::WARN);
+        rknn::PoolConfig config;
+        config.pipeline = true;
+        config.depth = 2;
+        pool.setConfig(config);
+        CHECK(pool.init() == 0);
+
+        std::vector<int> inputs;
+        for(int i = 0; i < 200; i++){
+            inputs.push_back(i);
+        }
+        check_delivery(pool, inputs);
+        CHECK(pool.getFailedCount() == 0);
+    }
+
+    // 任一阶段抛出异常或返回失败: 帧按顺序以failed交付, 实例归还, 后面的帧不受影响
+    void test_pipeline_stage_failure() {
+        FakePool<> pool("fake", 2, logger::Level::WARN);
+        rknn::PoolConfig config;
+        config.pipeline = true;
+        config.depth = 2;
+        pool.setConfig(config);
+        CHECK(pool.init() == 0);
+
+        // 失败的帧多于实例数, 实例没有归还时put会卡住
+        std::vector<int> inputs = mixed_inputs(100);
+        check_delivery(pool, inputs);
+        CHECK(pool.getFailedCount() == count_failures(inputs));
+    }
+
+    // 任务模式使用工作窃取执行器
+    void test_work_stealing_executor() {
+        FakePool<dpool::WorkStealingPool> pool("fake", 3, logger::Level::WARN);
+        CHECK(pool.init() == 0);
+
+        std::vector<int> inputs;
+        for(int i = 0; i < 500; i++){
+            inputs.push_back(i);
+        }
+        check_delivery(pool, inputs);
+    }
+
+    // 不存在的CPU编号使setConfig失败且不改变配置
+    void test_cpu_affinity_validation() {
+        int cpu_num = (int)sysconf(_SC_NPROCESSORS_CONF);
+        CHECK(cpu_num > 0);
+        FakePool<> pool("fake", 2, logger::Level::WARN);
+        rknn::PoolConfig config;
+        config.coreAffine = true;
+        for(int cpu : {-1, cpu_num, CPU_SETSIZE, 1 << 20}){
+            config.cpuAffinity = {0, cpu};
+            CHECK_MSG(pool.setConfig(config) != 0, "cpu %d accepted", cpu);
+        }
+        config.cpuAffinity = {cpu_num - 1, 0};
+        CHECK(pool.setConfig(config) == 0);
+        CHECK(pool.init() == 0);
+
+        std::vector<int> inputs;
+        for(int i = 0; i < 100; i++){
+            inputs.push_back(i);
+        }
+        check_delivery(pool, inputs);
+    }
+
+    // 任务模式、核心绑定模式、动态批处理模式下infer/infer_batch抛出异常: 帧以failed交付, 工作线程继续处理后面的帧
+    void test_task_failure() {
+        for(int mode = 0; mode < 3; mode++){
+            FakePool<> pool("fake", 3, logger::Level::WARN);
+            rknn::PoolConfig config;
+            config.coreAffine = mode == 1;
+            config.maxBatch = mode == 2 ? 4 : 0;
+            pool.setConfig(config);
+            CHECK(pool.init() == 0);
+
+            std::vector<int> inputs = mixed_inputs(200, true);
+            check_delivery(pool, inputs, mode == 2);
+            if(mode == 2){
+                CHECK(pool.getFailedCount() >= count_failures(inputs));
+            }else{
+                CHECK_MSG(pool.getFailedCount() == count_failures(inputs), "mode %d failed %zu", mode,
+                          pool.getFailedCount());
+            }
+        }
+    }
+
+    // infer_batch返回的结果少于帧数: 没有结果的帧以failed交付并计入失败数, 而不是当作没有检测结果
+    void test_short_batch() {
+        FakePool<> pool("fake", 2, logger::Level::WARN);
+        rknn::PoolConfig config;
+        config.maxBatch = 4;
+        pool.setConfig(config);
+        CHECK(pool.init() == 0);
+
+        FakeModel::s_shortBatch = true;
+        size_t failed = 0;
+        for(int i = 0; i < 100; i++){
+            CHECK(pool.put(i + 1) == 0);
+        }
+        for(int i = 0; i < 100; i++){
+            int output = -100;
+            rknn::FrameInfo info;
+            if(pool.getFor(output, info, std::chrono::milliseconds(5000)) != 0){
+                CHECK_MSG(false, "frame %d was never delivered", i);
+                break;
+            }
+            int expected = info.failed ? 0 : (i + 1) * 2;
+            CHECK_MSG(output == expected, "frame %d failed=%d output %d, expected %d", i, (int)info.failed, output,
+                      expected);
+            failed += info.failed ? 1 : 0;
+        }
+        FakeModel::s_shortBatch = false;
+        // 每批最后一帧没有结果, 至少一帧失败
+        CHECK(failed > 0);
+        CHECK_MSG(pool.getFailedCount() == failed, "failed count %zu, %zu frames delivered as failed",
+                  pool.getFailedCount(), failed);
+    }
+
+    // 单线程任务模式, 积压上限2帧: 第0帧占住实例, 第1帧在队列中等待
+    void start_held_pool(FakePool<>& pool, rknn::OverflowPolicy overflow, size_t capacity) {
+        rknn::PoolConfig config;
+        config.capacity = capacity;
+        config.overflow = overflow;
+        CHECK(pool.setConfig(config) == 0);
+        CHECK(pool.init() == 0);
+        FakeModel::s_hold = true;
+        FakeModel::s_started = 0;
+        CHECK(pool.put(0) == 0);
+        while(FakeModel::s_started.load() == 0){
+            std::this_thread::yield();
+        }
+    }
+
+    // LAZY: 多个线程同时提交使实例按需增加, 每个实例槽只创建一次
+    void test_lazy_growth() {
+        const int model_num = 4;
+        const int producers = 8;
+        const int per_producer = 2;
+        for(int round = 0; round < 50; round++){
+            FakeModel::s_hold = true;
+            int before = FakeModel::instances();
+            FakePool<> pool("fake", model_num, logger::Level::WARN);
+            rknn::PoolConfig config;
+            config.initMode = rknn::InitMode::LAZY;
+            pool.setConfig(config);
+            CHECK(pool.init() == 0);
+            CHECK(pool.readyCount() == 1);
+
+            std::vector<std::thread> threads;
+            for(int p = 0; p < producers; p++){
+                threads.emplace_back([&pool]() {
+                    for(int i = 0; i < per_producer; i++){
+                        pool.put(i);
+                    }
+                });
+            }
+            for(auto& thread : threads){
+                thread.join();
+            }
+            CHECK(pool.waitReadyFor(model_num, std::chrono::milliseconds(5000)));
+            CHECK_MSG(FakeModel::instances() - before == model_num, "round %d: %d instances for %d slots", round,
+                      FakeModel::instances() - before, model_num);
+
+            FakeModel::s_hold = false;
+            for(int i = 0; i < producers * per_producer; i++){
+                int output;
+                CHECK(pool.getFor(output, std::chrono::milliseconds(5000)) == 0);
+            }
+            CHECK(pool.getPendingCount() == 0);
+        }
+    }
+
+    // 每个实例都已就绪或失败
+    bool settled(const std::vector<rknn::ModelStatus>& status) {
+        for(auto& model : status){
+            if(!model.ready && !model.failed){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 模型文件不存在: 第一个实例构造失败, init返回-1, 该实例报告为failed, 没有实例就绪
+    void test_missing_model() {
+        std::string dir = test::temp_dir();
+        FakePool<> pool(dir + "/missing.rknn", 3, logger::Level::WARN);
+        CHECK(pool.init() == -1);
+        std::vector<rknn::ModelStatus> status = pool.modelStatus();
+        CHECK(status.size() == 3);
+        if(status.size() == 3){
+            CHECK(status[0].failed && !status[0].ready);
+            CHECK(!status[1].ready && !status[2].ready);
+        }
+        CHECK(pool.readyCount() == 0);
+        rmdir(dir.c_str());
+    }
+
+    // 共享权重的实例构造失败: 实例标记为failed且不计入就绪数. SYNC/PARALLEL下init失败,
+    // ASYNC下init成功, 由就绪的实例处理全部帧
+    void test_shared_instance_failure() {
+        const rknn::InitMode modes[3] = {rknn::InitMode::SYNC, rknn::InitMode::PARALLEL, rknn::InitMode::ASYNC};
+        for(rknn::InitMode mode : modes){
+            FakeModel::s_failShared = true;
+            FakePool<> pool("fake", 3, logger::Level::WARN);
+            rknn::PoolConfig config;
+            config.initMode = mode;
+            pool.setConfig(config);
+            bool async = mode == rknn::InitMode::ASYNC;
+            CHECK(pool.init() == (async ? 0 : -1));
+            // SYNC/PARALLEL的init在全部实例创建结束后才返回
+            CHECK_MSG(async || settled(pool.modelStatus()), "init mode %d returned while instances were being created",
+                      (int)mode);
+            CHECK(!pool.waitReadyFor(3, std::chrono::milliseconds(5000)));
+            // ASYNC下后台创建的实例可能尚未结束
+            for(int i = 0; i < 500 && !settled(pool.modelStatus()); i++){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            FakeModel::s_failShared = false;
+
+            std::vector<rknn::ModelStatus> status = pool.modelStatus();
+            CHECK(status.size() == 3);
+            if(status.size() == 3){
+                CHECK(status[0].ready && !status[0].failed);
+                CHECK_MSG(status[1].failed && !status[1].ready && status[2].failed && !status[2].ready,
+                          "init mode %d: shared instances not reported as failed", (int)mode);
+            }
+            CHECK(pool.readyCount() == 1);
+            if(async){
+                std::vector<int> inputs;
+                for(int i = 0; i < 50; i++){
+                    inputs.push_back(i);
+                }
+                check_delivery(pool, inputs);
+            }
+        }
+    }
+
+    // 依次取回结果, 检查交付的帧序号; drained时检查之后没有未交付的帧
+    void check_seqs(FakePool<>& pool, const std::vector<uint64_t>& seqs, bool drained = true) {
+        for(uint64_t seq : seqs){
+            int output = -100;
+            rknn::FrameInfo info;
+            CHECK(pool.getFor(output, info, std::chrono::milliseconds(5000)) == 0);
+            CHECK_MSG(info.seq == seq && output == (int)seq * 2, "got seq %llu output %d, expected seq %llu",
+                      (unsigned long long)info.seq, output, (unsigned long long)seq);
+        }
+        if(drained){
+            int output;
+            CHECK(pool.tryGet(output) == 1);
+            CHECK(pool.getPendingCount() == 0);
+        }
+    }
+
+    // DROP_NEWEST: 达到上限时拒绝新帧
+    void test_overflow_drop_newest() {
+        FakePool<> pool("fake", 1, logger::Level::WARN);
+        start_held_pool(pool, rknn::OverflowPolicy::DROP_NEWEST, 2);
+        CHECK(pool.put(1) == 0);
+        CHECK(pool.put(2) == 1);
+        CHECK(pool.getDroppedCount() == 1);
+
+        // 没有完成的帧: tryGet立即返回, getFor超时返回
+        int output;
+        CHECK(pool.tryGet(output) == 1);
+        CHECK(pool.getFor(output, std::chrono::milliseconds(20)) == 1);
+
+        FakeModel::s_hold = false;
+        check_seqs(pool, {0, 1});
+    }
+
+    // DROP_OLDEST: 取消最早的还没开始推理的帧; 正在推理的帧不能丢弃, 没有可丢弃的帧时拒绝新帧
+    void test_overflow_drop_oldest() {
+        FakePool<> pool("fake", 1, logger::Level::WARN);
+        start_held_pool(pool, rknn::OverflowPolicy::DROP_OLDEST, 2);
+        CHECK(pool.put(1) == 0);
+        CHECK(pool.put(2) == 0);    // 取消第1帧
+        CHECK(pool.put(3) == 0);    // 取消第2帧
+        CHECK(pool.getDroppedCount() == 2);
+        FakeModel::s_hold = false;
+        check_seqs(pool, {0, 3});
+        CHECK(FakeModel::s_started.load() == 2);
+
+        FakePool<> single("fake", 1, logger::Level::WARN);
+        start_held_pool(single, rknn::OverflowPolicy::DROP_OLDEST, 1);
+        CHECK(single.put(1) == 1);
+        CHECK(single.getDroppedCount() == 1);
+        FakeModel::s_hold = false;
+        check_seqs(single, {0});
+    }
+
+    // BLOCK: put阻塞到有帧被取走 (put与get在不同线程, 见OverflowPolicy::BLOCK)
+    void test_overflow_block() {
+        FakePool<> pool("fake", 1, logger::Level::WARN);
+        start_held_pool(pool, rknn::OverflowPolicy::BLOCK, 2);
+        CHECK(pool.put(1) == 0);
+
+        std::atomic<bool> accepted(false);
+        std::thread producer([&]() {
+            CHECK(pool.put(2) == 0);
+            accepted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK_MSG(!accepted.load(), "put returned while the pool was at capacity");
+
+        FakeModel::s_hold = false;
+        check_seqs(pool, {0}, false);
+        producer.join();
+        CHECK(accepted.load());
+        check_seqs(pool, {1, 2});
+        CHECK(pool.getDroppedCount() == 0);
+    }
+
+} // namespace
+
+// 实例化全部成员, 工作窃取执行器不满足RknnPool的要求时编译失败
+template class rknn::RknnPool<FakeModel, int, int, dpool::WorkStealingPool>;
+
+int main() {
+    return test::run_tests("test_pool", test_pipeline_order, test_pipeline_stage_failure,
+                           test_work_stealing_executor, test_cpu_affinity_validation,
+                           test_task_failure, test_short_batch, test_overflow_drop_newest,
+                           test_overflow_drop_oldest, test_overflow_block, test_lazy_growth, test_missing_model,
+                           test_shared_instance_failure);
+}
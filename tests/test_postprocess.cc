@@ -0,0 +1,261 @@
+// 后处理组件与直接实现的比较: DFL查表解码, 类别分数扫描, top-K候选收集
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "postprocess.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    uint32_t g_rng = 1;
+
+    uint32_t next_random() {
+        g_rng = g_rng * 1664525u + 1013904223u;
+        return g_rng >> 8;
+    }
+
+    // 反量化后逐边做softmax并求期望, double精度
+    template <typename T>
+    void reference_dfl(const T* tensor, int grid_len, int dfl_len, int32_t zp, float scale, double box[4]) {
+        for(int b = 0; b < 4; b++){
+            double values[detector::DflDecoder::DFL_LEN_MAX];
+            double max_value = -1e30;
+            for(int i = 0; i < dfl_len; i++){
+                values[i] = ((double)tensor[(size_t)(b * dfl_len + i) * grid_len] - zp) * scale;
+                max_value = std::max(max_value, values[i]);
+            }
+            double exp_sum = 0;
+            double acc_sum = 0;
+            for(int i = 0; i < dfl_len; i++){
+                double w = exp(values[i] - max_value);
+                exp_sum += w;
+                acc_sum += w * i;
+            }
+            box[b] = acc_sum / exp_sum;
+        }
+    }
+
+    // 查表解码与exp/softmax的误差上限 (以stride为单位), 只来自float累加
+    constexpr double DFL_MAX_ERROR = 1e-4;
+
+    template <typename T>
+    void check_dfl(int dfl_len, int32_t zp, float scale) {
+        const int grid_len = 20 * 20;
+        std::vector<T> tensor((size_t)dfl_len * 4 * grid_len);
+        for(auto& v : tensor){
+            v = (T)(next_random() & 0xff);
+        }
+        // 全部相等与单个bin极大的极端情况
+        for(int i = 0; i < dfl_len * 4; i++){
+            tensor[(size_t)i * grid_len] = (T)zp;
+            tensor[(size_t)i * grid_len + 1] = (T)(i % dfl_len == dfl_len - 1 ? 127 : -128);
+        }
+
+        detector::DflDecoder decoder;
+        CHECK(decoder.init(scale, dfl_len));
+        CHECK(decoder.dfl_len() == dfl_len);
+        double max_error = 0;
+        for(int cell = 0; cell < grid_len; cell++){
+            float box[4];
+            double ref[4];
+            decoder.decode(tensor.data() + cell, grid_len, box);
+            reference_dfl(tensor.data() + cell, grid_len, dfl_len, zp, scale, ref);
+            for(int b = 0; b < 4; b++){
+                max_error = std::max(max_error, fabs(box[b] - ref[b]));
+            }
+        }
+        CHECK_MSG(max_error <= DFL_MAX_ERROR, "%s dfl_len %d zp %d scale %g: max error %g",
+                  std::is_signed<T>::value ? "int8" : "uint8", dfl_len, zp, scale, max_error);
+    }
+
+    void test_dfl_lut() {
+        for(int dfl_len : {16, 8, 1, detector::DflDecoder::DFL_LEN_MAX}){
+            check_dfl<int8_t>(dfl_len, -128, 0.1f);
+            check_dfl<int8_t>(dfl_len, 0, 0.0625f);
+            check_dfl<uint8_t>(dfl_len, 0, 0.1f);
+            check_dfl<uint8_t>(dfl_len, 128, 0.5f);
+        }
+        detector::DflDecoder decoder;
+        CHECK(!decoder.init(0.1f, detector::DflDecoder::DFL_LEN_MAX + 1));
+        CHECK(!decoder.init(0.1f, 0));
+    }
+
+    // 逐cell标量argmax: 同分取较小的类别号, 只输出最大分数 > threshold 的cell
+    template <typename T>
+    struct ScanHit {
+        int cell;
+        int class_id;
+        T score;
+    };
+
+    template <typename T>
+    std::vector<ScanHit<T>> reference_scan(const T* scores, int class_num, int grid_len, T threshold,
+                                           const T* gate, T gate_threshold) {
+        std::vector<ScanHit<T>> hits;
+        for(int x = 0; x < grid_len; x++){
+            if(gate != nullptr && gate[x] < gate_threshold){
+                continue;
+            }
+            int best = 0;
+            for(int c = 1; c < class_num; c++){
+                if(scores[(size_t)c * grid_len + x] > scores[(size_t)best * grid_len + x]){
+                    best = c;
+                }
+            }
+            T score = scores[(size_t)best * grid_len + x];
+            if(score > threshold){
+                hits.push_back(ScanHit<T>{x, best, score});
+            }
+        }
+        return hits;
+    }
+
+    template <typename T>
+    T random_score(int levels);
+
+    template <>
+    int8_t random_score<int8_t>(int levels) {
+        return (int8_t)((int)(next_random() % levels) - 128 + (256 - levels) / 2);
+    }
+
+    template <>
+    uint8_t random_score<uint8_t>(int levels) {
+        return (uint8_t)(next_random() % levels + (256 - levels) / 2);
+    }
+
+    template <>
+    float random_score<float>(int levels) {
+        return (float)(next_random() % levels) / levels - 0.5f;
+    }
+
+    // levels越小同分越多; grid_len覆盖不足一组SIMD lane的尾部
+    template <typename T>
+    void check_scan(const char* name, int class_num, int grid_len, int levels, bool use_gate) {
+        std::vector<T> scores((size_t)class_num * grid_len);
+        std::vector<T> gate(grid_len);
+        for(auto& v : scores){
+            v = random_score<T>(levels);
+        }
+        for(auto& v : gate){
+            v = random_score<T>(levels);
+        }
+        T threshold = random_score<T>(levels);
+        T gate_threshold = random_score<T>(levels);
+        const T* gate_ptr = use_gate ? gate.data() : nullptr;
+
+        detector::ClassScoreScanner<T> scanner;
+        scanner.reserve(grid_len / 2);
+        int count = scanner.scan(scores.data(), class_num, grid_len, threshold, gate_ptr, gate_threshold);
+        std::vector<ScanHit<T>> expected = reference_scan(scores.data(), class_num, grid_len, threshold, gate_ptr,
+                                                          gate_threshold);
+
+        bool same = count == (int)expected.size();
+        for(int k = 0; same && k < count; k++){
+            same = scanner.cell(k) == expected[k].cell && scanner.class_id(k) == expected[k].class_id &&
+                   scanner.score(k) == expected[k].score;
+        }
+        CHECK_MSG(same, "%s scan: %d classes x %d cells, %d levels, gate %d: %d candidates, expected %zu", name,
+                  class_num, grid_len, levels, use_gate, count, expected.size());
+    }
+
+    void test_class_scan() {
+        for(int class_num : {1, 3, 80}){
+            for(int grid_len : {1, 15, 17, 33, 400, 6400}){
+                for(int levels : {2, 16, 256}){
+                    for(bool use_gate : {false, true}){
+                        check_scan<int8_t>("int8", class_num, grid_len, levels, use_gate);
+                        check_scan<uint8_t>("uint8", class_num, grid_len, levels, use_gate);
+                        check_scan<float>("fp32", class_num, grid_len, levels, use_gate);
+                    }
+                }
+            }
+        }
+        detector::ClassScoreScanner<int8_t> scanner;
+        int8_t scores[4] = {10, 20, 30, 40};
+        CHECK(scanner.scan(scores, 0, 4, (int8_t)0) == 0);
+    }
+
+    // 收集结果与 std::partial_sort + 截断 的前top_k个比较. 分数相同的候选谁留下不确定,
+    // 因此比较保留的分数序列, 并要求分数严格高于第top_k个分数的候选全部保留
+    void check_collector(detector::CandidateCollector& collector, int capacity, int count, int top_k, int levels) {
+        std::vector<float> scores(count);
+        for(auto& score : scores){
+            score = levels > 0 ? (float)(next_random() % levels) / levels : (float)(next_random() % 1000003) / 1000003;
+        }
+
+        collector.reset(top_k);
+        for(int i = 0; i < count; i++){
+            bool accepted = collector.accept(scores[i]);
+            // 框坐标记录候选的下标, 用于检查数据随槽位一起移动
+            bool kept = collector.push((float)i, (float)i + 1, (float)i + 2, (float)i + 3, scores[i], i % 80);
+            CHECK(accepted == kept);
+        }
+
+        int limit = (top_k <= 0 || top_k > capacity) ? capacity : top_k;
+        std::vector<int> order(count);
+        for(int i = 0; i < count; i++){
+            order[i] = i;
+        }
+        int expected_num = std::min(limit, count);
+        std::partial_sort(order.begin(), order.begin() + expected_num, order.end(),
+                          [&scores](int a, int b) { return scores[a] > scores[b]; });
+        order.resize(expected_num);
+
+        CHECK_MSG(collector.size() == expected_num, "count %d top_k %d: kept %d, expected %d", count, top_k,
+                  collector.size(), expected_num);
+        if(collector.size() != expected_num){
+            return;
+        }
+
+        std::vector<float> kept_scores;
+        std::vector<bool> kept(count, false);
+        bool intact = true;
+        for(int k = 0; k < collector.size(); k++){
+            int index = (int)collector.boxes()[k * 4];
+            intact = intact && index >= 0 && index < count && !kept[index] && collector.scores()[k] == scores[index] &&
+                     collector.boxes()[k * 4 + 3] == (float)index + 3 && collector.class_ids()[k] == index % 80;
+            if(index >= 0 && index < count){
+                kept[index] = true;
+            }
+            kept_scores.push_back(collector.scores()[k]);
+        }
+        CHECK_MSG(intact, "count %d top_k %d: a kept candidate does not match its input", count, top_k);
+
+        std::vector<float> expected_scores;
+        for(int index : order){
+            expected_scores.push_back(scores[index]);
+        }
+        std::sort(kept_scores.begin(), kept_scores.end(), std::greater<float>());
+        CHECK_MSG(kept_scores == expected_scores, "count %d top_k %d levels %d: kept scores differ", count, top_k, levels);
+
+        float kth = expected_num > 0 ? scores[order.back()] : 0.f;
+        bool complete = true;
+        for(int i = 0; i < count; i++){
+            complete = complete && (scores[i] <= kth || kept[i]);
+        }
+        CHECK_MSG(complete, "count %d top_k %d: a candidate above the k-th score was dropped", count, top_k);
+    }
+
+    void test_candidate_collector() {
+        const int capacity = 1200;
+        detector::CandidateCollector collector;
+        collector.reserve(capacity);
+        for(int count : {0, 1, 10, 999, 1000, 1500}){
+            for(int top_k : {1, 5, 100, 1000, 1200, 2000, 0, -1}){
+                // levels为0时分数几乎不重复, 2/7时大量同分
+                for(int levels : {0, 2, 7}){
+                    check_collector(collector, capacity, count, top_k, levels);
+                }
+            }
+        }
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_postprocess", test_dfl_lut, test_class_scan, test_candidate_collector);
+}
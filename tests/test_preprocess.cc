@@ -0,0 +1,216 @@
+// 预处理后端与OpenCV参考实现(CvPreprocessor: letterbox() + cv::cvtColor)的比较
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "preprocess.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    // 确定性的伪随机BGR图像, 不依赖OpenCV版本的随机数实现
+    cv::Mat random_image(int width, int height, uint32_t seed) {
+        cv::Mat img(height, width, CV_8UC3);
+        uint32_t state = seed * 2654435761u + 1;
+        for(int y = 0; y < height; y++){
+            uint8_t* row = img.ptr<uint8_t>(y);
+            for(int x = 0; x < width * 3; x++){
+                state = state * 1664525u + 1013904223u;
+                row[x] = (uint8_t)(state >> 24);
+            }
+        }
+        return img;
+    }
+
+    // 确定性的伪随机YUV420SP帧 (Y与UV都覆盖0~255, 包括有限范围之外的值), 行跨度为w_stride
+    std::vector<uint8_t> random_yuv420sp(int height, int w_stride, uint32_t seed) {
+        std::vector<uint8_t> data((size_t)w_stride * height * 3 / 2);
+        uint32_t state = seed * 2654435761u + 1;
+        for(auto& value : data){
+            state = state * 1664525u + 1013904223u;
+            value = (uint8_t)(state >> 24);
+        }
+        return data;
+    }
+
+    image_buffer_t wrap_buffer(std::vector<uint8_t>& data, int width, int height, int w_stride, image_format_t format) {
+        image_buffer_t buffer;
+        memset(&buffer, 0, sizeof(buffer));
+        buffer.width = width;
+        buffer.height = height;
+        buffer.width_stride = w_stride;
+        buffer.height_stride = height;
+        buffer.format = format;
+        buffer.virt_addr = data.data();
+        buffer.size = (int)data.size();
+        buffer.fd = -1;
+        return buffer;
+    }
+
+    // 两幅图像不同的字节数, 以及最大差值
+    int count_mismatch(const cv::Mat& a, const cv::Mat& b, int& max_diff) {
+        int mismatch = 0;
+        max_diff = 0;
+        for(int y = 0; y < a.rows; y++){
+            const uint8_t* pa = a.ptr<uint8_t>(y);
+            const uint8_t* pb = b.ptr<uint8_t>(y);
+            for(int x = 0; x < a.cols * 3; x++){
+                int diff = abs(pa[x] - pb[x]);
+                if(diff != 0){
+                    mismatch++;
+                    max_diff = std::max(max_diff, diff);
+                }
+            }
+        }
+        return mismatch;
+    }
+
+    bool same_pads(const image_rect_t& a, const image_rect_t& b) {
+        return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+    }
+
+    // 融合内核按OpenCV通用INTER_LINEAR路径的定点运算实现, 在该路径上逐字节一致.
+    // 启用Carotene/IPP等HAL的OpenCV构建中cv::resize可能走舍入不同的实现, 因此允许最大差1,
+    // 同时输出不同的字节数便于确认通用构建中为0
+    const int CV_MAX_DIFF = 1;
+
+    // 融合内核与参考实现一致: 一般双线性缩放、放大、整2倍缩小(INTER_AREA快速路径, 含奇数源尺寸向上取整的半块)、
+    // 不缩放、奇数尺寸
+    void test_fused_matches_opencv() {
+        struct Case {
+            int src_w, src_h, dst_w, dst_h;
+        };
+        const Case cases[] = {
+            {1280, 720, 640, 640}, {810, 1080, 640, 640}, {1280, 720, 320, 320}, {640, 480, 320, 240},
+            {640, 480, 640, 480},  {333, 517, 640, 640},  {200, 150, 640, 640}, {1920, 1080, 416, 416},
+            {1280, 723, 640, 640}, {643, 1280, 640, 640},
+        };
+        auto reference = rknn::create_preprocessor(rknn::PreprocessType::OPENCV);
+        auto fused = rknn::create_preprocessor(rknn::PreprocessType::FUSED);
+        uint32_t seed = 1;
+        for(const Case& c : cases){
+            cv::Mat img = random_image(c.src_w, c.src_h, seed++);
+            float scale = std::min((float)c.dst_w / c.src_w, (float)c.dst_h / c.src_h);
+            for(uint8_t pad_value : {(uint8_t)114, (uint8_t)0}){
+                cv::Mat ref(c.dst_h, c.dst_w, CV_8UC3);
+                cv::Mat out(c.dst_h, c.dst_w, CV_8UC3);
+                image_rect_t ref_pads, out_pads;
+                CHECK(reference->run(img, ref, scale, ref_pads, pad_value));
+                CHECK(fused->run(img, out, scale, out_pads, pad_value));
+
+                int max_diff = 0;
+                int mismatch = count_mismatch(ref, out, max_diff);
+                CHECK_MSG(max_diff <= CV_MAX_DIFF, "%dx%d -> %dx%d pad %d: %d mismatched bytes (max diff %d)", c.src_w,
+                          c.src_h, c.dst_w, c.dst_h, pad_value, mismatch, max_diff);
+                if(mismatch != 0){
+                    printf("test_preprocess: %dx%d -> %dx%d: %d bytes differ by 1 from cv::resize\n", c.src_w, c.src_h,
+                           c.dst_w, c.dst_h, mismatch);
+                }
+                CHECK(same_pads(ref_pads, out_pads));
+            }
+        }
+    }
+
+    // 目标有行跨度(零拷贝输入tensor的w_stride)时同样一致, 且不写行尾的跨度区域
+    void test_fused_dst_stride() {
+        const int dst_w = 600, dst_h = 600, stride_w = 608;
+        cv::Mat img = random_image(1280, 720, 42);
+        float scale = std::min((float)dst_w / img.cols, (float)dst_h / img.rows);
+
+        auto reference = rknn::create_preprocessor(rknn::PreprocessType::OPENCV);
+        auto fused = rknn::create_preprocessor(rknn::PreprocessType::FUSED);
+        cv::Mat ref(dst_h, dst_w, CV_8UC3);
+        image_rect_t pads;
+        CHECK(reference->run(img, ref, scale, pads, 114));
+
+        std::vector<uint8_t> buffer((size_t)stride_w * 3 * dst_h, 0xA5);
+        cv::Mat out(dst_h, dst_w, CV_8UC3, buffer.data(), (size_t)stride_w * 3);
+        CHECK(fused->run(img, out, scale, pads, 114));
+
+        int max_diff = 0;
+        int mismatch = count_mismatch(ref, out, max_diff);
+        CHECK_MSG(max_diff <= CV_MAX_DIFF, "strided dst differs: %d bytes (max diff %d)", mismatch, max_diff);
+        bool untouched = true;
+        for(int y = 0; y < dst_h; y++){
+            for(int x = dst_w * 3; x < stride_w * 3; x++){
+                untouched = untouched && buffer[(size_t)y * stride_w * 3 + x] == 0xA5;
+            }
+        }
+        CHECK(untouched);
+    }
+
+    // 非BGR888输入被拒绝
+    void test_fused_rejects_gray() {
+        auto fused = rknn::create_preprocessor(rknn::PreprocessType::FUSED);
+        cv::Mat gray(480, 640, CV_8UC1, cv::Scalar(0));
+        cv::Mat out(640, 640, CV_8UC3);
+        image_rect_t pads;
+        CHECK(!fused->run(gray, out, 1.0f, pads, 114));
+    }
+
+    // NV12单遍转换+缩放与参考实现(cv::cvtColorTwoPlane整帧转换后letterbox)的比较.
+    // 两者都先按BT.601定点系数转换每个像素再缩放, 通用路径上逐字节一致 (整2倍缩小时参考实现走INTER_AREA,
+    // 融合内核的双线性插值在该比例下系数均为1/2, 结果相同); 容差与BGR输入相同, 只为HAL构建保留
+    void test_nv12_matches_opencv() {
+        struct Case {
+            int src_w, src_h, w_stride, dst_w, dst_h;
+        };
+        const Case cases[] = {
+            {1920, 1080, 1920, 640, 640}, {1280, 720, 1280, 640, 640}, {1280, 720, 1344, 640, 640},
+            {640, 480, 640, 640, 640},    {640, 360, 704, 416, 416},
+        };
+        auto reference = rknn::create_preprocessor(rknn::PreprocessType::OPENCV);
+        auto fused = rknn::create_preprocessor(rknn::PreprocessType::FUSED);
+        uint32_t seed = 100;
+        for(const Case& c : cases){
+            std::vector<uint8_t> nv12 = random_yuv420sp(c.src_h, c.w_stride, seed++);
+            image_buffer_t buffer = wrap_buffer(nv12, c.src_w, c.src_h, c.w_stride, IMAGE_FORMAT_YUV420SP_NV12);
+            float scale = std::min((float)c.dst_w / c.src_w, (float)c.dst_h / c.src_h);
+
+            cv::Mat ref(c.dst_h, c.dst_w, CV_8UC3);
+            cv::Mat out(c.dst_h, c.dst_w, CV_8UC3);
+            image_rect_t ref_pads, out_pads;
+            CHECK(reference->run_buffer(buffer, ref, scale, ref_pads, 114));
+            CHECK(fused->run_buffer(buffer, out, scale, out_pads, 114));
+            CHECK(same_pads(ref_pads, out_pads));
+
+            int max_diff = 0;
+            int mismatch = count_mismatch(ref, out, max_diff);
+            CHECK_MSG(max_diff <= CV_MAX_DIFF, "NV12 %dx%d (stride %d) -> %dx%d: max diff %d, %d mismatched bytes",
+                      c.src_w, c.src_h, c.w_stride, c.dst_w, c.dst_h, max_diff, mismatch);
+            if(mismatch != 0){
+                printf("test_preprocess: NV12 %dx%d -> %dx%d: %d bytes differ by 1 from cv::cvtColorTwoPlane + resize\n",
+                       c.src_w, c.src_h, c.dst_w, c.dst_h, mismatch);
+            }
+        }
+    }
+
+    // NV21与交换了U/V的NV12是同一幅图像, 融合内核的结果逐字节相同
+    void test_nv21_matches_nv12() {
+        const int width = 1280, height = 720;
+        std::vector<uint8_t> nv12 = random_yuv420sp(height, width, 7);
+        std::vector<uint8_t> nv21 = nv12;
+        for(size_t i = (size_t)width * height; i + 1 < nv21.size(); i += 2){
+            std::swap(nv21[i], nv21[i + 1]);
+        }
+        image_buffer_t nv12_buffer = wrap_buffer(nv12, width, height, width, IMAGE_FORMAT_YUV420SP_NV12);
+        image_buffer_t nv21_buffer = wrap_buffer(nv21, width, height, width, IMAGE_FORMAT_YUV420SP_NV21);
+
+        auto fused = rknn::create_preprocessor(rknn::PreprocessType::FUSED);
+        cv::Mat a(640, 640, CV_8UC3);
+        cv::Mat b(640, 640, CV_8UC3);
+        image_rect_t pads;
+        float scale = 640.0f / width;
+        CHECK(fused->run_buffer(nv12_buffer, a, scale, pads, 114));
+        CHECK(fused->run_buffer(nv21_buffer, b, scale, pads, 114));
+        int max_diff = 0;
+        CHECK_MSG(count_mismatch(a, b, max_diff) == 0, "NV21 differs from NV12 (max diff %d)", max_diff);
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_preprocess", test_fused_matches_opencv, test_fused_dst_stride, test_fused_rejects_gray,
+                           test_nv12_matches_opencv, test_nv21_matches_nv12);
+}
@@ -0,0 +1,240 @@
+// rknn::StreamIngest: 用假模型和内存帧来源检查各路流的计数、交付顺序和"最新帧"语义, 不需要NPU和视频文件
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "StreamIngest.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    // 结果为帧的第一个像素值 (帧来源写入的帧序号); s_delayMs > 0 时每帧推理耗时s_delayMs
+    class FakeModel {
+    public:
+        FakeModel(const std::string& /* path */, logger::Level /* level */) {}
+        FakeModel(const std::string& /* path */, logger::Level /* level */, rknn_context* /* ctx */) {}
+
+        rknn_context* get_context() { return &m_ctx; }
+        int core_id() const { return 0; }
+        int batch_size() const { return 1; }
+
+        int infer(const cv::Mat& frame) {
+            if(s_delayMs > 0){
+                std::this_thread::sleep_for(std::chrono::milliseconds(s_delayMs));
+            }
+            return frame.empty() ? -1 : frame.data[0];
+        }
+
+        std::vector<int> infer_batch(const std::vector<cv::Mat>& frames) {
+            std::vector<int> results;
+            for(auto& frame : frames){
+                results.push_back(infer(frame));
+            }
+            return results;
+        }
+
+        bool stage_preprocess(const cv::Mat& frame) {
+            m_result = infer(frame);
+            return true;
+        }
+        bool stage_run() { return true; }
+        std::variant<int> stage_postprocess() { return m_result; }
+
+        static std::atomic<int> s_delayMs;
+
+    private:
+        rknn_context m_ctx = 0;
+        int m_result = 0;
+    };
+
+    std::atomic<int> FakeModel::s_delayMs(0);
+
+    using Ingest = rknn::StreamIngest<FakeModel, int>;
+
+    // count帧4x4的BGR图像, 像素值为帧序号; 每帧读取耗时delay_ms
+    class CounterSource : public rknn::FrameSource {
+    public:
+        CounterSource(const std::string& uri, int count, int delay_ms)
+            : m_uri(uri), m_count(count), m_delayMs(delay_ms) {}
+
+        bool read(cv::Mat& frame) override {
+            if(m_next >= m_count){
+                return false;
+            }
+            if(m_delayMs > 0){
+                std::this_thread::sleep_for(std::chrono::milliseconds(m_delayMs));
+            }
+            frame = cv::Mat(4, 4, CV_8UC3, cv::Scalar::all(m_next));
+            m_next++;
+            return true;
+        }
+        bool rewind() override {
+            m_next = 0;
+            return true;
+        }
+        const std::string& uri() const override { return m_uri; }
+
+    private:
+        std::string m_uri;
+        int m_count;
+        int m_delayMs;
+        int m_next = 0;
+    };
+
+    // 各路流交付的结果, 按交付顺序
+    struct Delivered {
+        std::mutex mtx;
+        std::vector<std::vector<int>> results;
+        int mismatched = 0;     // 结果与回调中的帧不对应
+
+        explicit Delivered(int streams) : results(streams) {}
+
+        Ingest::ResultCallback callback() {
+            return [this](int stream, const cv::Mat& frame, int& result) {
+                std::lock_guard<std::mutex> lock(mtx);
+                results[stream].push_back(result);
+                if(frame.empty() || frame.data[0] != result){
+                    mismatched++;
+                }
+            };
+        }
+    };
+
+    // 每路流: decoded = 帧数, inferred + dropped = decoded, 交付的帧按解码顺序, 最后一帧总会推理
+    void check_stream(Ingest& ingest, Delivered& delivered, int stream, int frames) {
+        rknn::StreamStats stats = ingest.stats(stream);
+        const std::vector<int>& results = delivered.results[stream];
+        CHECK(stats.finished);
+        CHECK_MSG(stats.decoded == (uint64_t)frames, "stream %d decoded %llu of %d", stream,
+                  (unsigned long long)stats.decoded, frames);
+        CHECK_MSG(stats.inferred + stats.dropped == stats.decoded, "stream %d: %llu inferred + %llu dropped != %llu",
+                  stream, (unsigned long long)stats.inferred, (unsigned long long)stats.dropped,
+                  (unsigned long long)stats.decoded);
+        CHECK(stats.inferred == results.size());
+        for(size_t i = 1; i < results.size(); i++){
+            CHECK_MSG(results[i] > results[i - 1], "stream %d delivered frame %d after %d", stream, results[i],
+                      results[i - 1]);
+        }
+        CHECK(!results.empty() && results.back() == frames - 1);
+    }
+
+    void test_streams_in_order() {
+        const int stream_num = 3;
+        const int frames = 30;
+        FakeModel::s_delayMs = 0;
+        Delivered delivered(stream_num);
+        {
+            Ingest ingest("fake", 2, logger::Level::WARN);
+            rknn::StreamOptions options;
+            options.fps = 0;
+            options.maxInflight = 2;
+            for(int i = 0; i < stream_num; i++){
+                CHECK(ingest.addStream(std::make_unique<CounterSource>("counter" + std::to_string(i), frames, 2),
+                                       options) == i);
+            }
+            CHECK(ingest.init() == 0);
+            ingest.setResultCallback(delivered.callback());
+            ingest.start();
+            ingest.wait();
+            ingest.stop();
+            for(int i = 0; i < stream_num; i++){
+                check_stream(ingest, delivered, i, frames);
+            }
+        }
+        CHECK(delivered.mismatched == 0);
+    }
+
+    // 推理比解码慢: 过时的帧被覆盖丢弃, 在途帧不超过maxInflight, 最新帧仍会推理
+    void test_slow_model_drops() {
+        const int frames = 40;
+        FakeModel::s_delayMs = 5;
+        Delivered delivered(1);
+        {
+            Ingest ingest("fake", 1, logger::Level::WARN);
+            rknn::StreamOptions options;
+            options.fps = 0;
+            options.maxInflight = 1;
+            CHECK(ingest.addStream(std::make_unique<CounterSource>("fast", frames, 0), options) == 0);
+            CHECK(ingest.init() == 0);
+            ingest.setResultCallback(delivered.callback());
+            ingest.start();
+            ingest.wait();
+            ingest.stop();
+            check_stream(ingest, delivered, 0, frames);
+            CHECK(ingest.stats(0).dropped > 0);
+        }
+        FakeModel::s_delayMs = 0;
+        CHECK(delivered.mismatched == 0);
+    }
+
+    // 循环播放的流不会结束, stop停止解码并等待在途帧
+    void test_stop_looping() {
+        FakeModel::s_delayMs = 0;
+        Delivered delivered(1);
+        Ingest ingest("fake", 1, logger::Level::WARN);
+        rknn::StreamOptions options;
+        options.fps = 500;
+        options.loop = true;
+        CHECK(ingest.addStream(std::make_unique<CounterSource>("loop", 5, 0), options) == 0);
+        CHECK(ingest.init() == 0);
+        ingest.setResultCallback(delivered.callback());
+        ingest.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ingest.stop();
+
+        rknn::StreamStats stats = ingest.stats(0);
+        CHECK(stats.finished);
+        CHECK(stats.decoded > 5);
+        CHECK(stats.inferred + stats.dropped == stats.decoded);
+        CHECK(stats.inferred == delivered.results[0].size());
+        CHECK(delivered.mismatched == 0);
+    }
+
+    // raw:<宽>x<高>:<文件> 来源, 以及无法打开的来源
+    void test_raw_source() {
+        std::string dir = test::temp_dir();
+        std::string path = dir + "/frames.bgr";
+        const int width = 2, height = 2, frames = 3;
+        std::string data;
+        for(int f = 0; f < frames; f++){
+            data.append(width * height * 3, (char)(10 + f));
+        }
+        CHECK(test::write_file(path, data));
+
+        FakeModel::s_delayMs = 0;
+        Delivered delivered(1);
+        {
+            Ingest ingest("fake", 1, logger::Level::WARN);
+            rknn::StreamOptions options;
+            options.fps = 0;
+            options.maxInflight = 4;
+            CHECK(ingest.addStream("raw:2x2:" + dir + "/missing.bgr", options) == -1);
+            CHECK(ingest.addStream("raw:2by2:" + path, options) == -1);
+            CHECK(ingest.addStream("raw:2x2:" + path, options) == 0);
+            CHECK(ingest.init() == 0);
+            ingest.setResultCallback(delivered.callback());
+            ingest.start();
+            ingest.wait();
+            ingest.stop();
+
+            rknn::StreamStats stats = ingest.stats(0);
+            CHECK(stats.decoded == (uint64_t)frames);
+            CHECK(stats.inferred + stats.dropped == stats.decoded);
+            CHECK(!delivered.results[0].empty() && delivered.results[0].back() == 10 + frames - 1);
+        }
+        CHECK(delivered.mismatched == 0);
+
+        unlink(path.c_str());
+        rmdir(dir.c_str());
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_stream_ingest", test_streams_in_order, test_slow_model_drops, test_stop_looping,
+                           test_raw_source);
+}
@@ -0,0 +1,163 @@
+// dpool::MpmcQueue / dpool::ThreadPool: 竞争下每个任务恰好执行一次, 以及队列满时的阻塞(背压)
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    void test_queue_bounds() {
+        dpool::MpmcQueue<int> queue(5);
+        CHECK(queue.capacity() == 8);
+
+        int item = -1;
+        CHECK(!queue.tryPop(item));
+        for(int i = 0; i < 8; i++){
+            int value = i;
+            CHECK(queue.tryPush(std::move(value)));
+        }
+        int extra = 100;
+        CHECK(!queue.tryPush(std::move(extra)));
+        CHECK(queue.sizeApprox() == 8);
+
+        // 单线程下先进先出
+        for(int i = 0; i < 8; i++){
+            CHECK(queue.tryPop(item) && item == i);
+        }
+        CHECK(!queue.tryPop(item));
+    }
+
+    // 多个生产者多个消费者直接使用队列, 每个元素恰好被取出一次
+    void test_queue_contention() {
+        constexpr int PRODUCERS = 4;
+        constexpr int CONSUMERS = 4;
+        constexpr int PER_PRODUCER = 50000;
+        dpool::MpmcQueue<int> queue(16);
+        std::unique_ptr<std::atomic<int>[]> seen(new std::atomic<int>[PRODUCERS * PER_PRODUCER]);
+        for(int i = 0; i < PRODUCERS * PER_PRODUCER; i++){
+            seen[i] = 0;
+        }
+
+        std::atomic<int> consumed(0);
+        std::vector<std::thread> threads;
+        for(int p = 0; p < PRODUCERS; p++){
+            threads.emplace_back([&queue, p]() {
+                for(int i = 0; i < PER_PRODUCER; i++){
+                    int value = p * PER_PRODUCER + i;
+                    while(!queue.tryPush(std::move(value))){
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for(int c = 0; c < CONSUMERS; c++){
+            threads.emplace_back([&]() {
+                int value;
+                while(consumed.load() < PRODUCERS * PER_PRODUCER){
+                    if(queue.tryPop(value)){
+                        seen[value]++;
+                        consumed++;
+                    }else{
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for(auto& thread : threads){
+            thread.join();
+        }
+
+        int wrong = 0;
+        for(int i = 0; i < PRODUCERS * PER_PRODUCER; i++){
+            wrong += seen[i].load() != 1 ? 1 : 0;
+        }
+        CHECK_MSG(wrong == 0, "%d items not popped exactly once", wrong);
+    }
+
+    // 小容量使提交方经常阻塞; 析构时执行完全部已提交的任务
+    void test_each_task_once() {
+        constexpr int PRODUCERS = 4;
+        constexpr int PER_PRODUCER = 20000;
+        std::unique_ptr<std::atomic<int>[]> runs(new std::atomic<int>[PRODUCERS * PER_PRODUCER]);
+        for(int i = 0; i < PRODUCERS * PER_PRODUCER; i++){
+            runs[i] = 0;
+        }
+
+        std::vector<std::future<int>> futures;
+        {
+            dpool::ThreadPool pool(3, 4);
+            std::vector<std::thread> producers;
+            for(int p = 0; p < PRODUCERS; p++){
+                producers.emplace_back([&pool, &runs, p]() {
+                    for(int i = 0; i < PER_PRODUCER; i++){
+                        int id = p * PER_PRODUCER + i;
+                        pool.post([&runs, id]() { runs[id]++; });
+                    }
+                });
+            }
+            for(int i = 0; i < 100; i++){
+                futures.push_back(pool.submit([](int x) { return x * 3; }, i));
+            }
+            for(auto& producer : producers){
+                producer.join();
+            }
+        }
+
+        int wrong = 0;
+        for(int i = 0; i < PRODUCERS * PER_PRODUCER; i++){
+            wrong += runs[i].load() != 1 ? 1 : 0;
+        }
+        CHECK_MSG(wrong == 0, "%d tasks not run exactly once", wrong);
+        for(int i = 0; i < 100; i++){
+            CHECK(futures[i].get() == i * 3);
+        }
+    }
+
+    // 唯一的工作线程被占住、队列已满时, post阻塞到有任务被取走
+    void test_full_queue_blocks() {
+        std::promise<void> gate;
+        std::shared_future<void> opened = gate.get_future().share();
+        std::promise<void> started;
+        std::atomic<int> done(0);
+        std::atomic<bool> posted(false);
+
+        dpool::ThreadPool pool(1, 4);
+        pool.post([opened, &started]() {
+            started.set_value();
+            opened.wait();
+        });
+        started.get_future().wait();
+
+        for(size_t i = 0; i < pool.capacity(); i++){
+            pool.post([&done]() { done++; });
+        }
+        CHECK(pool.pendingNum() == pool.capacity());
+
+        std::thread producer([&]() {
+            pool.post([&done]() { done++; });
+            posted = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK_MSG(!posted.load(), "post returned while the queue was full");
+
+        gate.set_value();
+        producer.join();
+        CHECK(posted.load());
+        // 等待队列中的任务执行完
+        for(int i = 0; i < 500 && done.load() < (int)pool.capacity() + 1; i++){
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(done.load() == (int)pool.capacity() + 1);
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_thread_pool", test_queue_bounds, test_queue_contention, test_each_task_once,
+                           test_full_queue_blocks);
+}
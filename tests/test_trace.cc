@@ -0,0 +1,117 @@
+// rknn::Tracer: stop之后不再记录, start清空上一次的事件, 以及记录线程与start/stop/dump并发
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    std::string read_file(const std::string& path) {
+        std::string text;
+        FILE* file = fopen(path.c_str(), "r");
+        if(file == nullptr){
+            return text;
+        }
+        char buf[4096];
+        size_t n;
+        while((n = fread(buf, 1, sizeof(buf), file)) > 0){
+            text.append(buf, n);
+        }
+        fclose(file);
+        return text;
+    }
+
+    int count_of(const std::string& text, const std::string& part) {
+        int count = 0;
+        for(size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + part.size())){
+            count++;
+        }
+        return count;
+    }
+
+    // stop前开始、stop后结束的区间不记录; 再次start清空上一次的事件
+    void test_stop_and_restart() {
+        std::string dir = test::temp_dir();
+        std::string path = dir + "/trace.json";
+
+        rknn::Tracer::start();
+        for(int i = 0; i < 3; i++){
+            rknn::TraceScope scope("early");
+        }
+        {
+            rknn::TraceScope scope("late");
+            rknn::Tracer::stop();
+        }
+        CHECK(rknn::Tracer::dump(path));
+        std::string text = read_file(path);
+        CHECK_MSG(count_of(text, "\"name\":\"early\"") == 3, "%d early events", count_of(text, "\"name\":\"early\""));
+        CHECK(count_of(text, "\"name\":\"late\"") == 0);
+
+        rknn::Tracer::start();
+        {
+            rknn::TraceScope scope("second");
+        }
+        rknn::Tracer::stop();
+        CHECK(rknn::Tracer::dump(path));
+        text = read_file(path);
+        CHECK(count_of(text, "\"name\":\"early\"") == 0);
+        CHECK(count_of(text, "\"name\":\"second\"") == 1);
+
+        unlink(path.c_str());
+        rmdir(dir.c_str());
+    }
+
+    // 记录线程一直写, 主线程反复start (有时不经stop)/stop/dump: stop之后两次dump的内容相同,
+    // 事件数不超过各线程缓冲区容量之和
+    void test_concurrent_cycles() {
+        const int thread_num = 4;
+        const size_t capacity = 256;
+        std::string dir = test::temp_dir();
+        std::string first = dir + "/first.json";
+        std::string second = dir + "/second.json";
+
+        std::atomic<bool> done(false);
+        std::vector<std::thread> threads;
+        for(int t = 0; t < thread_num; t++){
+            threads.emplace_back([&done, t]() {
+                rknn::Tracer::set_thread_name("writer " + std::to_string(t));
+                for(int64_t i = 0; !done.load(); i++){
+                    rknn::TraceScope scope("work", "test", i);
+                }
+            });
+        }
+
+        for(int cycle = 0; cycle < 30; cycle++){
+            rknn::Tracer::start(capacity);
+            if(cycle % 3 == 0){
+                rknn::Tracer::start(capacity);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            rknn::Tracer::stop();
+            CHECK(rknn::Tracer::dump(first));
+            CHECK(rknn::Tracer::dump(second));
+            std::string text = read_file(first);
+            CHECK_MSG(text == read_file(second), "events recorded after stop in cycle %d", cycle);
+            CHECK(text.size() >= 4 && text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+            int events = count_of(text, "\"ph\":\"X\"");
+            CHECK_MSG(events <= (int)(thread_num * capacity), "%d events in cycle %d", events, cycle);
+        }
+        done = true;
+        for(auto& thread : threads){
+            thread.join();
+        }
+
+        unlink(first.c_str());
+        unlink(second.c_str());
+        rmdir(dir.c_str());
+    }
+
+} // namespace
+
+int main() {
+    return test::run_tests("test_trace", test_stop_and_restart, test_concurrent_cycles);
+}
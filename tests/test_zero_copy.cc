@@ -0,0 +1,80 @@
+// rknn::Model零拷贝模式: CPU参考后端上与拷贝模式的结果一致, 析构时先释放绑定的内存再销毁上下文
+#include <memory>
+#include <vector>
+
+#include "yolo11.hpp"
+#include "test_common.hpp"
+
+namespace {
+
+    std::string g_dir;
+    std::string g_spec;
+
+    std::unique_ptr<detector::YOLO11> create_yolo11(bool zero_copy, rknn_context* ctx_in = nullptr) {
+        detector::DetectParam detect_param = {0.25, 0.45, 114, 80};
+        rknn::ModelConfig config;
+        config.zero_copy = zero_copy;
+        config.backend = rknn::BackendType::CPU;
+        if(ctx_in != nullptr){
+            return std::make_unique<detector::YOLO11>(g_spec, logger::Level::WARN, ctx_in, detect_param, config);
+        }
+        return std::make_unique<detector::YOLO11>(g_spec, logger::Level::WARN, detect_param, config);
+    }
+
+    bool same_results(const object_detect_result_list& a, const object_detect_result_list& b) {
+        if(a.count != b.count){
+            return false;
+        }
+        for(int i = 0; i < a.count; i++){
+            const object_detect_result& x = a.results[i];
+            const object_detect_result& y = b.results[i];
+            if(x.cls_id != y.cls_id || x.prop != y.prop || x.box.left != y.box.left || x.box.top != y.box.top ||
+               x.box.right != y.box.right || x.box.bottom != y.box.bottom){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void test_same_results() {
+        cv::Mat img(480, 640, CV_8UC3, cv::Scalar(64, 128, 192));
+        auto copy = create_yolo11(false);
+        auto zero_copy = create_yolo11(true);
+        CHECK(!copy->is_zero_copy());
+        CHECK(zero_copy->is_zero_copy());
+        for(int i = 0; i < 3; i++){
+            object_detect_result_list expected = copy->infer(img);
+            object_detect_result_list result = zero_copy->infer(img);
+            CHECK(expected.count > 0);
+            CHECK_MSG(same_results(expected, result), "frame %d: %d vs %d objects", i, expected.count, result.count);
+        }
+    }
+
+    // 共享权重的实例各自绑定内存; 任意顺序析构, 上下文销毁时都不应还有未释放的内存
+    void test_teardown() {
+        uint64_t leaked = rknn::CpuBackend::leaked_mems();
+        cv::Mat img(360, 640, CV_8UC3, cv::Scalar(16, 32, 48));
+        {
+            auto primary = create_yolo11(true);
+            auto shared = create_yolo11(true, primary->get_context());
+            CHECK(same_results(primary->infer(img), shared->infer(img)));
+            primary.reset();
+            shared->infer(img);
+        }
+        CHECK_MSG(rknn::CpuBackend::leaked_mems() == leaked, "%llu tensor mems outlived their context",
+                  (unsigned long long)(rknn::CpuBackend::leaked_mems() - leaked));
+    }
+
+} // namespace
+
+int main() {
+    g_dir = test::temp_dir();
+    g_spec = g_dir + "/model.spec";
+    test::write_file(g_spec, "model=yolo11\ninput=640x640\nclasses=80\ndtype=int8\nrun_us=0\nobjects=8\n");
+
+    int ret = test::run_tests("test_zero_copy", test_same_results, test_teardown);
+
+    unlink(g_spec.c_str());
+    rmdir(g_dir.c_str());
+    return ret;
+}